@@ -8,16 +8,26 @@ and pattern recognition.
 Usage:
     python can_analyzer.py --input logfile.txt
     python can_analyzer.py --input logfile.txt --format csv
+    python can_analyzer.py --input logfile.txt --decoder gen/pt_decoder.py
+    python can_analyzer.py --input logfile.txt --accept 100/7F0,2A5,18DA00F1x
 """
 
 import argparse
+import importlib.util
 import re
+import sys
+from array import array
 from collections import defaultdict
 from dataclasses import dataclass
 from datetime import datetime
-from typing import List, Dict, Optional
+from typing import List, Dict, Optional, Tuple
 from enum import Enum
 
+try:
+    import numpy as np
+except ImportError:     # Optional: signal decoding falls back to array/list code
+    np = None
+
 
 class FrameType(Enum):
     DATA = "DATA"
@@ -56,6 +66,7 @@ class AnalysisResult:
     id_statistics: Dict[int, Dict]
     data_patterns: Dict[int, List[bytes]]
     errors: List[str]
+    repeated_frames: int = 0    # Data frames with the same payload as the previous one of their ID
 
 
 def parse_log_line(line: str) -> Optional[CANFrame]:
@@ -71,28 +82,29 @@ def parse_log_line(line: str) -> Optional[CANFrame]:
     if not line or line.startswith("#"):
         return None
     
-    # Try Vector CANoe format
+    # Try Vector CANoe format (channel column optional, 'x' = extended ID)
     # 0.000000  123  Rx  d 8 00 01 02 03 04 05 06 07
-    vector_pattern = r"(\d+\.\d+)\s+(\w+)\s+\w+\s+[dDrR]\s*(\d)\s*([0-9A-Fa-f\s]*)"
+    # 0.000000 1  18FF00F1x  Rx  d 8 00 01 02 03 04 05 06 07
+    vector_pattern = r"(\d+\.\d+)\s+(?:\d+\s+)?([0-9A-Fa-f]+)(x?)\s+[RT]x\s+[dDrR]\s*(\d)\s*([0-9A-Fa-f\s]*)"
     match = re.match(vector_pattern, line)
     if match:
         timestamp = float(match.group(1))
         can_id = int(match.group(2), 16)
-        dlc = int(match.group(3))
-        data_str = match.group(4).strip()
+        dlc = int(match.group(4))
+        data_str = match.group(5).strip()
         data = bytes.fromhex(data_str.replace(" ", ""))
         return CANFrame(
             timestamp=timestamp,
             id=can_id,
-            extended=can_id > 0x7FF,
+            extended=bool(match.group(3)) or can_id > 0x7FF,
             frame_type=FrameType.DATA,
             dlc=dlc,
             data=data
         )
     
     # Try SocketCAN format
-    # (000.000000) can0 123#0102030405060708
-    socketcan_pattern = r"\((\d+\.\d+)\)\s+\w+\s+([0-9A-Fa-f]+)#([0-9A-Fa-f]*)"
+    # (000.000000) can0 123#0102030405060708, FD: 123##<flags>0102...
+    socketcan_pattern = r"\((\d+\.\d+)\)\s+\w+\s+([0-9A-Fa-f]+)#(?:#[0-9A-Fa-f])?([0-9A-Fa-f]*)"
     match = re.match(socketcan_pattern, line)
     if match:
         timestamp = float(match.group(1))
@@ -170,7 +182,8 @@ def analyze_frames(frames: List[CANFrame]) -> AnalysisResult:
         "first_seen": float("inf"),
         "last_seen": 0,
         "interval_avg": 0,
-        "intervals": []
+        "intervals": [],
+        "repeats": 0
     })
     
     data_patterns = defaultdict(list)
@@ -188,6 +201,13 @@ def analyze_frames(frames: List[CANFrame]) -> AnalysisResult:
             interval = frame.timestamp - stats["last_timestamp"]
             stats["intervals"].append(interval)
         stats["last_timestamp"] = frame.timestamp
+
+        # Unchanged payloads: what on-change transmission would save
+        if frame.frame_type == FrameType.DATA:
+            payload = frame.data[:frame.dlc]
+            if stats.get("last_data") == payload:
+                stats["repeats"] += 1
+            stats["last_data"] = payload
         
         # Store data patterns (first 4 bytes)
         if frame.dlc >= 4:
@@ -223,10 +243,409 @@ def analyze_frames(frames: List[CANFrame]) -> AnalysisResult:
         avg_message_rate=avg_message_rate,
         id_statistics=dict(id_stats),
         data_patterns=dict(data_patterns),
-        errors=errors
+        errors=errors,
+        repeated_frames=sum(stats["repeats"] for stats in id_stats.values())
     )
 
 
+def load_decoder(path: str) -> Dict[int, Tuple]:
+    """Load a decoder module generated by can_dbc_import.py."""
+    spec = importlib.util.spec_from_file_location("can_decoder", path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module.MESSAGES
+
+
+def decode_frame(decoder: Dict[int, Tuple], frame: CANFrame) -> Optional[Tuple[str, Dict[str, float]]]:
+    """
+    Decode the signals of one frame.
+
+    The payload is read as one integer (little-endian for Intel,
+    big-endian for Motorola signals); each signal is then a shift and
+    a mask, as in can_signal.h.
+    """
+    entry = decoder.get(frame.id)
+    if entry is None:
+        return None
+    name, size, mux_index, signals = entry
+    payload = frame.data[:size].ljust(size, b"\x00")
+    words = (int.from_bytes(payload, "big"), int.from_bytes(payload, "little"))
+
+    mux_value = None
+    if mux_index is not None:
+        s = signals[mux_index]
+        mux_value = (words[s[1]] >> s[2]) & s[3]
+
+    values = {}
+    for sig, intel, shift, mask, sign, factor, offset, _, _, _, mux in signals:
+        if mux is not None and mux != mux_value:
+            continue
+        raw = (words[intel] >> shift) & mask
+        values[sig] = ((raw ^ sign) - sign) * factor + offset
+    return name, values
+
+
+@dataclass
+class SignalStats:
+    """Statistics of one decoded signal over the whole capture."""
+    message: str
+    name: str
+    unit: str
+    count: int
+    minimum: float
+    maximum: float
+    mean: float
+    max_rate: float         # Largest |dv/dt| between consecutive samples (unit per s)
+    stuck_s: float          # Longest time the value did not change
+    out_of_range: int       # Samples outside the database [min|max]
+
+
+def build_columns(frames: List[CANFrame], decoder: Dict[int, Tuple]) -> Dict[int, Tuple[array, bytearray]]:
+    """
+    Collect timestamps and payloads per known ID.
+
+    Payloads are stored back to back, padded to the message size, so one
+    ID's frames can be decoded as a single buffer.
+    """
+    columns: Dict[int, Tuple[array, bytearray]] = {}
+    for frame in frames:
+        entry = decoder.get(frame.id)
+        if entry is None:
+            continue
+        column = columns.get(frame.id)
+        if column is None:
+            column = columns[frame.id] = (array("d"), bytearray())
+        size = entry[1]
+        column[0].append(frame.timestamp)
+        column[1].extend(frame.data[:size].ljust(size, b"\x00"))
+    return columns
+
+
+def _load_words(payload: bytearray, size: int):
+    """Payload buffer -> (big-endian, little-endian) integer columns."""
+    if size == 8 and np is not None:
+        le = np.frombuffer(bytes(payload), dtype="<u8")
+        return le.byteswap(), le
+    if size == 8:
+        le = array("Q", bytes(payload))
+        if sys.byteorder == "big":
+            le.byteswap()
+        be = array("Q", le)
+        be.byteswap()
+        return be, le
+    # Other sizes (DLC < 8 padded, CAN-FD): Python integers per frame
+    frames = [payload[i:i + size] for i in range(0, len(payload), size)]
+    be = [int.from_bytes(f, "big") for f in frames]
+    le = [int.from_bytes(f, "little") for f in frames]
+    if np is not None and size < 8:
+        return np.array(be, dtype=np.uint64), np.array(le, dtype=np.uint64)
+    return be, le
+
+
+def decode_columns(entry: Tuple, payload: bytearray) -> Dict[str, Tuple[Optional[object], object]]:
+    """
+    Decode every signal of one ID over all its frames at once.
+
+    Returns signal -> (rows, values): rows selects the frames carrying the
+    signal (multiplexed signals) or is None for all frames. With numpy the
+    values are float64 arrays, otherwise lists.
+    """
+    name, size, mux_index, signals = entry
+    words = _load_words(payload, size)
+    vectorized = np is not None and isinstance(words[0], np.ndarray)
+
+    def raw_column(intel, shift, mask):
+        w = words[intel]
+        if vectorized:
+            return (w >> np.uint64(shift)) & np.uint64(mask)
+        return [(x >> shift) & mask for x in w]
+
+    mux_values = None
+    if mux_index is not None:
+        s = signals[mux_index]
+        mux_values = raw_column(s[1], s[2], s[3])
+
+    result = {}
+    for sig, intel, shift, mask, sign, factor, offset, _, _, _, mux in signals:
+        raw = raw_column(intel, shift, mask)
+        rows = None
+        if mux is not None and mux_values is not None:
+            if vectorized:
+                rows = np.flatnonzero(mux_values == np.uint64(mux))
+                raw = raw[rows]
+            else:
+                rows = [i for i, m in enumerate(mux_values) if m == mux]
+                raw = [raw[i] for i in rows]
+        if vectorized:
+            values = raw.astype(np.int64)
+            if sign:
+                values = (values ^ np.int64(sign)) - np.int64(sign)
+            values = values * factor + offset
+        else:
+            values = [((r ^ sign) - sign) * factor + offset for r in raw]
+        result[sig] = (rows, values)
+    return result
+
+
+def signal_statistics(message: str, signal: Tuple, timestamps, values) -> SignalStats:
+    """min/max/mean, max rate of change, longest constant run, range check."""
+    sig, _, _, _, _, _, _, sig_min, sig_max, unit, _ = signal
+    checked = sig_max > sig_min    # [0|0] in a DBC means "no range"
+
+    if np is not None and isinstance(values, np.ndarray):
+        t = np.asarray(timestamps)
+        count = len(values)
+        dv = np.diff(values)
+        dt = np.diff(t)
+        moving = dt > 0
+        max_rate = float(np.max(np.abs(dv[moving] / dt[moving]))) if moving.any() else 0.0
+        # Constant runs end where the value changes
+        edges = np.concatenate(([0], np.flatnonzero(dv != 0) + 1, [count]))
+        stuck_s = float(np.max(t[edges[1:] - 1] - t[edges[:-1]])) if count else 0.0
+        out_of_range = int(np.count_nonzero((values < sig_min) | (values > sig_max))) if checked else 0
+        return SignalStats(message, sig, unit, count, float(values.min()), float(values.max()),
+                           float(values.mean()), max_rate, stuck_s, out_of_range)
+
+    t = list(timestamps)
+    count = len(values)
+    max_rate = 0.0
+    stuck_s = 0.0
+    run_start = t[0]
+    for i in range(1, count):
+        dt = t[i] - t[i - 1]
+        if dt > 0:
+            max_rate = max(max_rate, abs(values[i] - values[i - 1]) / dt)
+        if values[i] != values[i - 1]:
+            stuck_s = max(stuck_s, t[i - 1] - run_start)
+            run_start = t[i]
+    stuck_s = max(stuck_s, t[-1] - run_start)
+    out_of_range = sum(1 for v in values if v < sig_min or v > sig_max) if checked else 0
+    return SignalStats(message, sig, unit, count, min(values), max(values),
+                       sum(values) / count, max_rate, stuck_s, out_of_range)
+
+
+def analyze_signals(frames: List[CANFrame], decoder: Dict[int, Tuple]) -> List[SignalStats]:
+    """Decode all known IDs column-wise and compute per-signal statistics."""
+    stats = []
+    for can_id, (timestamps, payload) in build_columns(frames, decoder).items():
+        entry = decoder[can_id]
+        signals = {s[0]: s for s in entry[3]}
+        if np is not None:
+            timestamps = np.frombuffer(timestamps, dtype=np.float64)
+        for sig, (rows, values) in decode_columns(entry, payload).items():
+            if len(values) == 0:
+                continue
+            if rows is None:
+                t = timestamps
+            elif np is not None and isinstance(rows, np.ndarray):
+                t = timestamps[rows]
+            else:
+                t = [timestamps[i] for i in rows]
+            stats.append(signal_statistics(entry[0], signals[sig], t, values))
+    return stats
+
+
+# Acceptance keys as in can-swfilter.template.c: ID in bits 28:0, RTR bit
+# 30, IDE bit 31; bit 29 is never set in a key
+KEY_RTR = 1 << 30
+KEY_IDE = 1 << 31
+ACCEPT_CHUNK = 4096     # Keys compared per numpy step (chunk x entries matrix)
+
+
+@dataclass
+class AcceptEntry:
+    """One software filter entry (CanSwf_Add)."""
+    id: int
+    mask: int
+    extended: bool
+    data_only: bool
+    text: str
+
+    @property
+    def key_code(self) -> int:
+        width = 0x1FFFFFFF if self.extended else 0x7FF
+        return (self.id & self.mask & width) | (KEY_IDE if self.extended else 0)
+
+    @property
+    def key_mask(self) -> int:
+        width = 0x1FFFFFFF if self.extended else 0x7FF
+        return (self.mask & width) | KEY_IDE | (KEY_RTR if self.data_only else 0)
+
+    @property
+    def exact(self) -> bool:
+        return (self.mask & (0x1FFFFFFF if self.extended else 0x7FF)) == \
+            (0x1FFFFFFF if self.extended else 0x7FF)
+
+
+def parse_accept_spec(spec: str) -> List[AcceptEntry]:
+    """
+    Parse a filter list: a file with one entry per line (# comments) or a
+    comma separated list. Entry: ID[/MASK] in hex, suffix x = extended,
+    d = data frames only. Without a mask the ID must match exactly.
+    """
+    try:
+        with open(spec) as f:
+            items = [line.split("#")[0] for line in f]
+    except OSError:
+        items = spec.split(",")
+
+    entries = []
+    for item in items:
+        text = item.strip()
+        if not text:
+            continue
+        match = re.fullmatch(r"([0-9A-Fa-f]+)(?:/([0-9A-Fa-f]+))?([xXdD]*)", text)
+        if not match:
+            raise ValueError(f"bad filter entry '{text}' (ID[/MASK][x][d], hex)")
+        flags = match.group(3).lower()
+        can_id = int(match.group(1), 16)
+        extended = "x" in flags or can_id > 0x7FF
+        width = 0x1FFFFFFF if extended else 0x7FF
+        mask = int(match.group(2), 16) if match.group(2) else width
+        entries.append(AcceptEntry(can_id, mask, extended, "d" in flags, text))
+    return entries
+
+
+def frame_key(frame: CANFrame) -> int:
+    key = frame.id & (0x1FFFFFFF if frame.extended else 0x7FF)
+    if frame.extended:
+        key |= KEY_IDE
+    if frame.frame_type == FrameType.REMOTE:
+        key |= KEY_RTR
+    return key
+
+
+def match_keys(entries: List[AcceptEntry], keys: List[int]) -> Dict[int, int]:
+    """
+    First matching entry per key (-1: rejected). Vectorized with numpy:
+    a (keys x entries) xor/and/compare per chunk, argmax picks the first
+    hit. Without numpy, standard IDs go through a 2048-entry lookup table
+    per frame type and extended IDs scan the entry list.
+    """
+    if not entries:
+        return {key: -1 for key in keys}
+
+    codes = [e.key_code for e in entries]
+    masks = [e.key_mask for e in entries]
+
+    if np is not None:
+        code_v = np.array(codes, dtype=np.uint32)
+        mask_v = np.array(masks, dtype=np.uint32)
+        result = {}
+        for start in range(0, len(keys), ACCEPT_CHUNK):
+            chunk = keys[start:start + ACCEPT_CHUNK]
+            key_v = np.array(chunk, dtype=np.uint32)[:, None]
+            hit = ((key_v ^ code_v) & mask_v) == 0
+            first = np.where(hit.any(axis=1), hit.argmax(axis=1), -1)
+            result.update(zip(chunk, first.tolist()))
+        return result
+
+    def scan(key: int) -> int:
+        for i, (code, mask) in enumerate(zip(codes, masks)):
+            if (key ^ code) & mask == 0:
+                return i
+        return -1
+
+    std_table = {}
+    for rtr in (0, KEY_RTR):
+        table = array("h", [-1]) * 2048
+        for i in reversed(range(len(entries))):
+            if codes[i] & KEY_IDE or (masks[i] & KEY_RTR and rtr):
+                continue
+            free = ~masks[i] & 0x7FF
+            sub = 0
+            while True:     # Every ID the entry matches: subsets of its don't-care bits
+                table[(codes[i] & 0x7FF) | sub] = i
+                sub = (sub - free) & free
+                if sub == 0:
+                    break
+        std_table[rtr] = table
+
+    return {key: (scan(key) if key & KEY_IDE else std_table[key & KEY_RTR][key & 0x7FF])
+            for key in keys}
+
+
+def bxcan_banks(entries: List[AcceptEntry]) -> int:
+    """Filter banks the same list needs on bxCAN (filter-config.md packing)."""
+    std_exact = sum(1 for e in entries if not e.extended and e.exact)
+    ext_exact = sum(1 for e in entries if e.extended and e.exact)
+    std_mask = sum(1 for e in entries if not e.extended and not e.exact)
+    ext_mask = sum(1 for e in entries if e.extended and not e.exact)
+    return (std_exact + 3) // 4 + (ext_exact + 1) // 2 + (std_mask + 1) // 2 + ext_mask
+
+
+def apply_acceptance(frames: List[CANFrame], entries: List[AcceptEntry]) -> Tuple[List[CANFrame], Dict]:
+    """Frames an ECU with this filter list would receive, plus a report."""
+    candidates = [f for f in frames if f.frame_type in (FrameType.DATA, FrameType.REMOTE)]
+    keys = sorted({frame_key(f) for f in candidates})
+    first = match_keys(entries, keys)
+
+    accepted = []
+    hits = [0] * len(entries)
+    rejected_ids: Dict[Tuple[int, bool], int] = defaultdict(int)
+    for frame in candidates:
+        entry = first[frame_key(frame)]
+        if entry >= 0:
+            accepted.append(frame)
+            hits[entry] += 1
+        else:
+            rejected_ids[(frame.id, frame.extended)] += 1
+
+    report = {
+        "offered": len(candidates),
+        "accepted": len(accepted),
+        "ids_accepted": sum(1 for k in keys if first[k] >= 0),
+        "ids_rejected": len(rejected_ids),
+        "rejected_top": sorted(rejected_ids.items(), key=lambda x: x[1], reverse=True)[:10],
+        "hits": hits,
+        "banks": bxcan_banks(entries),
+    }
+    return accepted, report
+
+
+def print_acceptance(entries: List[AcceptEntry], report: Dict):
+    """Print what the filter list let through and what it cost."""
+    offered = report["offered"]
+    print(f"\n[Acceptance Filter] {len(entries)} entries")
+    print(f"  Frames accepted:   {report['accepted']} of {offered} "
+          f"({100.0 * report['accepted'] / offered if offered else 0.0:.1f}%)")
+    print(f"  IDs accepted:      {report['ids_accepted']}, rejected: {report['ids_rejected']}")
+    print(f"  bxCAN banks:       {report['banks']} (28 shared by CAN1/CAN2)")
+    print(f"  {'Entry':<24} {'Frames':>10}")
+    for entry, hits in zip(entries, report["hits"]):
+        print(f"  {entry.text:<24} {hits:>10}{'  never matched' if hits == 0 else ''}")
+    if report["rejected_top"]:
+        ids = ", ".join(f"{i:08X}" if ext else f"{i:03X}" for (i, ext), _ in report["rejected_top"])
+        print(f"  Busiest rejected IDs: {ids}")
+
+
+def print_signal_stats(stats: List[SignalStats], stuck_s: float, unknown_ids: List[int]):
+    """Print the signal table and stuck / out-of-range findings."""
+    print(f"\n[Signal Statistics]")
+    print(f"  {'Message.Signal':<32} {'Count':>8} {'Min':>11} {'Max':>11} {'Mean':>11} "
+          f"{'Max d/dt':>11}  Unit")
+    for st in stats:
+        label = f"{st.message}.{st.name}"
+        print(f"  {label:<32} {st.count:>8} {st.minimum:>11.5g} {st.maximum:>11.5g} "
+              f"{st.mean:>11.5g} {st.max_rate:>11.5g}  {st.unit}")
+
+    findings = []
+    for st in stats:
+        if st.out_of_range:
+            findings.append(f"{st.message}.{st.name}: {st.out_of_range}/{st.count} samples "
+                            f"out of range")
+        if st.count > 1 and st.stuck_s >= stuck_s:
+            findings.append(f"{st.message}.{st.name}: unchanged for {st.stuck_s:.2f} s")
+    if findings:
+        print(f"\n[Signal Warnings]")
+        for finding in findings:
+            print(f"  - {finding}")
+    if unknown_ids:
+        ids = ", ".join(f"{i:X}" for i in unknown_ids[:10])
+        print(f"\n  IDs not in database: {len(unknown_ids)} "
+              f"({ids}{', ...' if len(unknown_ids) > 10 else ''})")
+
+
 def print_analysis(result: AnalysisResult):
     """Print analysis results."""
     print("\n" + "=" * 50)
@@ -241,11 +660,12 @@ def print_analysis(result: AnalysisResult):
     print(f"  Unique IDs:        {result.unique_ids}")
     print(f"  Avg Message Rate:  {result.avg_message_rate:.1f} msg/s")
     print(f"  Estimated Load:    {result.bus_load_percent:.1f}%")
+    print(f"  Unchanged Repeats: {result.repeated_frames}")
     
     if result.id_statistics:
         print(f"\n[ID Statistics]")
-        print(f"  {'ID':>8}  {'Count':>8}  {'DLC':>6}  {'Interval (ms)':>15}")
-        print(f"  {'-'*8}  {'-'*8}  {'-'*6}  {'-'*15}")
+        print(f"  {'ID':>8}  {'Count':>8}  {'DLC':>6}  {'Interval (ms)':>15}  {'Repeat':>8}")
+        print(f"  {'-'*8}  {'-'*8}  {'-'*6}  {'-'*15}  {'-'*8}")
         
         # Sort by count
         sorted_ids = sorted(
@@ -257,7 +677,8 @@ def print_analysis(result: AnalysisResult):
         for can_id, stats in sorted_ids[:20]:  # Top 20 IDs
             id_str = f"{can_id:08X}" if can_id > 0x7FF else f"{can_id:03X}"
             interval_ms = stats["interval_avg"] * 1000 if stats["interval_avg"] > 0 else 0
-            print(f"  {id_str:>8}  {stats['count']:>8}  {stats['dlc_min']:>6}  {interval_ms:>15.2f}")
+            print(f"  {id_str:>8}  {stats['count']:>8}  {stats['dlc_min']:>6}  {interval_ms:>15.2f}  "
+                  f"{stats['repeats']:>8}")
     
     if result.errors:
         print(f"\n[Warnings]")
@@ -292,6 +713,25 @@ def main():
         help="Show only summary statistics"
     )
     
+    parser.add_argument(
+        "--decoder", "-d",
+        help="Signal decoder generated by can_dbc_import.py"
+    )
+    
+    parser.add_argument(
+        "--accept", "-a",
+        metavar="SPEC",
+        help="Analyze only frames this filter list accepts: file or comma list of "
+             "ID[/MASK][x][d] (hex; x extended, d data frames only)"
+    )
+    
+    parser.add_argument(
+        "--stuck",
+        type=float,
+        default=2.0,
+        help="Report signals unchanged for this many seconds (default: 2.0)"
+    )
+    
     args = parser.parse_args()
     
     # Read and parse log file
@@ -313,11 +753,27 @@ def main():
         print("ERROR: No valid CAN frames found in log file")
         return 1
     
+    entries = None
+    if args.accept:
+        try:
+            entries = parse_accept_spec(args.accept)
+        except ValueError as e:
+            print(f"ERROR: {e}")
+            return 1
+        frames, accept_report = apply_acceptance(frames, entries)
+    
     # Analyze
     result = analyze_frames(frames)
     
     # Print results
     print_analysis(result)
+    if entries is not None:
+        print_acceptance(entries, accept_report)
+    
+    if args.decoder:
+        decoder = load_decoder(args.decoder)
+        unknown = sorted(i for i in result.id_statistics if i not in decoder)
+        print_signal_stats(analyze_signals(frames, decoder), args.stuck, unknown)
     
     return 0
 
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""
+CAN Driver Benchmark Runner
+
+Runs the host microbenchmarks of the driver templates
+(sub-skills/can-testing/assets/can-bench.template.c, built against the
+peripheral simulator) plus the bit timing search of can_bit_timing.py,
+prints ns and instructions per frame with their spread, stores a JSON
+baseline and flags regressions against one.
+
+A case regresses when its median is more than --threshold percent above
+the baseline median and its lower quartile is above the baseline upper
+quartile (the two distributions no longer overlap). Instructions per
+frame are compared on the threshold alone; they barely vary between runs.
+Cases counted per verification (SecOC) also print verifications/s.
+
+Usage:
+    python can_bench.py --bin ./can_bench --save baseline.json
+    python can_bench.py --bin ./can_bench --baseline baseline.json
+    python can_bench.py --baseline baseline.json --threshold 5
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+from typing import Dict, List, Optional
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from can_bit_timing import calculate_timing   # noqa: E402
+
+BENCH_SAMPLES = 31
+
+# (clock, baud) pairs of the bit timing case: common MCU clocks and rates
+TIMING_CASES = [
+    (36000000, 500000), (36000000, 125000), (42000000, 1000000),
+    (48000000, 250000), (80000000, 500000), (16000000, 500000),
+    (8000000, 125000), (170000000, 1000000),
+]
+
+
+def quartiles(values: List[float]) -> Dict[str, float]:
+    values = sorted(values)
+    n = len(values)
+    return {
+        "median": values[n // 2],
+        "p25": values[n // 4],
+        "p75": values[(3 * n) // 4],
+        "min": values[0],
+    }
+
+
+def bench_bit_timing(samples: int = BENCH_SAMPLES, sample_s: float = 0.02) -> Dict:
+    """Time calculate_timing() over TIMING_CASES, ns per search."""
+    batch = 1
+    while True:
+        start = time.perf_counter_ns()
+        for _ in range(batch):
+            for clock, baud in TIMING_CASES:
+                calculate_timing(clock, baud)
+        if time.perf_counter_ns() - start >= sample_s * 1e9 or batch >= 1 << 16:
+            break
+        batch *= 2
+
+    per_search = []
+    for _ in range(samples):
+        start = time.perf_counter_ns()
+        for _ in range(batch):
+            for clock, baud in TIMING_CASES:
+                calculate_timing(clock, baud)
+        per_search.append((time.perf_counter_ns() - start) / (batch * len(TIMING_CASES)))
+
+    return {"name": "can_bit_timing.calculate_timing", "unit": "search", "batch": batch,
+            "ns": quartiles(per_search), "instructions": None}
+
+
+def bench_driver(binary: str, only: Optional[str]) -> List[Dict]:
+    """Run the C benchmark binary and return its cases."""
+    cmd = [binary] + ([only] if only else [])
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return json.loads(out)["cases"]
+
+
+def compare(case: Dict, base: Dict, threshold: float) -> List[str]:
+    """Regression findings of one case against its baseline."""
+    findings = []
+    limit = 1.0 + threshold / 100.0
+
+    ns, ns_base = case["ns"], base["ns"]
+    if ns["median"] > ns_base["median"] * limit and ns["p25"] > ns_base["p75"]:
+        findings.append(f"time {ns_base['median']:.1f} -> {ns['median']:.1f} ns/{case['unit']} "
+                        f"(+{(ns['median'] / ns_base['median'] - 1) * 100:.1f}%)")
+
+    instr, instr_base = case.get("instructions"), base.get("instructions")
+    if instr is not None and instr_base and instr > instr_base * limit:
+        findings.append(f"instructions {instr_base:.0f} -> {instr:.0f} /{case['unit']} "
+                        f"(+{(instr / instr_base - 1) * 100:.1f}%)")
+    return findings
+
+
+def print_results(cases: List[Dict], baseline: Dict[str, Dict]):
+    print(f"\n  {'Case':<34} {'Median':>10} {'P25':>10} {'P75':>10} {'Instr':>8} {'vs base':>9}")
+    print(f"  {'-'*34} {'-'*10} {'-'*10} {'-'*10} {'-'*8} {'-'*9}")
+    for case in cases:
+        ns = case["ns"]
+        instr = case.get("instructions")
+        instr_str = f"{instr:.0f}" if instr is not None else "-"
+        delta = ""
+        base = baseline.get(case["name"])
+        if base:
+            delta = f"{(ns['median'] / base['ns']['median'] - 1) * 100:+.1f}%"
+        print(f"  {case['name']:<34} {ns['median']:>10.1f} {ns['p25']:>10.1f} {ns['p75']:>10.1f} "
+              f"{instr_str:>8} {delta:>9}")
+    print(f"\n  ns and instructions per unit ({', '.join(sorted({c['unit'] for c in cases}))})")
+    for case in cases:
+        if case["unit"] == "verify":
+            print(f"  {case['name']}: {1e9 / case['ns']['median']:,.0f} verifications/s")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="CAN Driver Benchmark Runner",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  python can_bench.py --bin ./can_bench --save baseline.json
+  python can_bench.py --bin ./can_bench --baseline baseline.json --threshold 5
+  python can_bench.py --bin ./can_bench --only CAN_RX
+        """
+    )
+
+    parser.add_argument(
+        "--bin", "-b",
+        help="Benchmark binary built from can-bench.template.c (omit: bit timing only)"
+    )
+
+    parser.add_argument(
+        "--only",
+        help="Run only driver cases whose name starts with this"
+    )
+
+    parser.add_argument(
+        "--save", "-s",
+        help="Write the results as a baseline JSON file"
+    )
+
+    parser.add_argument(
+        "--baseline", "-B",
+        help="Compare against a baseline JSON file"
+    )
+
+    parser.add_argument(
+        "--threshold", "-t",
+        type=float,
+        default=10.0,
+        help="Regression threshold in percent (default: 10)"
+    )
+
+    args = parser.parse_args()
+
+    cases = []
+    if args.bin:
+        try:
+            cases.extend(bench_driver(args.bin, args.only))
+        except (OSError, subprocess.CalledProcessError, ValueError) as e:
+            print(f"ERROR: benchmark binary failed: {e}")
+            return 2
+    if not args.only:
+        cases.append(bench_bit_timing())
+
+    baseline: Dict[str, Dict] = {}
+    if args.baseline:
+        try:
+            with open(args.baseline) as f:
+                baseline = {c["name"]: c for c in json.load(f)["cases"]}
+        except (OSError, ValueError, KeyError) as e:
+            print(f"ERROR reading baseline: {e}")
+            return 2
+
+    print("CAN Driver Benchmarks")
+    print("=" * 40)
+    print_results(cases, baseline)
+
+    regressions = []
+    for case in cases:
+        if case["name"] in baseline:
+            for finding in compare(case, baseline[case["name"]], args.threshold):
+                regressions.append(f"{case['name']}: {finding}")
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"threshold": args.threshold, "cases": cases}, f, indent=2)
+        print(f"\nBaseline written to {args.save}")
+
+    if baseline:
+        missing = sorted(set(baseline) - {c["name"] for c in cases})
+        if missing and not args.only:
+            print(f"\nNOTE: not run, in baseline: {', '.join(missing)}")
+        if regressions:
+            print(f"\n[Regressions] threshold {args.threshold:g}%")
+            for line in regressions:
+                print(f"  - {line}")
+            return 1
+        print(f"\nNo regressions (threshold {args.threshold:g}%)")
+
+    return 0
+
+
+if __name__ == "__main__":
+    exit(main())
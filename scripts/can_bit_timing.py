@@ -5,14 +5,44 @@ CAN Bit Timing Calculator
 Calculates optimal CAN bit timing parameters for a given clock frequency
 and target baud rate.
 
+With --node (one per ECU: clock, controller, oscillator tolerance),
+solves the whole network: every node's BRP/TS1/TS2/SJW (and FD data
+phase with TDC) is searched exhaustively and the settings that give the
+largest common tolerance margin under the ISO 11898-1 / CiA 601-3
+conditions are chosen, with the propagation segment sized for
+--cable-length and --transceiver-delay.
+
+With --analyze, infers the timing of an unknown bus from a CAN_RX capture
+(VCD, CSV or raw samples, see can_bitstream.py):
+- Bit rate from a histogram of edge intervals (shortest cluster = one
+  bit), nominal / FD data rate chosen by decoding the start of the
+  capture at each candidate
+- Bit times fitted per decoded frame (falling edges against the frame's
+  own bit grid): measured rates and oscillator drift per CAN ID, IDs
+  grouped into nodes
+- Edge positions against the bit grid: usable sample point range and
+  margins; FD: BRS bit length, which ties the nominal and data sample
+  points together
+- BTR candidates from the calculator for the inferred rates (--clock)
+The capture is streamed: raw files are read in chunks and decoded in
+windows, so its length is not limited by memory.
+
 Usage:
     python can_bit_timing.py --clock 36000000 --baud 500000
     python can_bit_timing.py --clock 36M --baud 500k
+    python can_bit_timing.py --baud 500k --data 2M --node GW:80M --node BCM:40M:0.3
+    python can_bit_timing.py --analyze capture.bin --rate 100M --clock 80M
 """
 
 import argparse
-from dataclasses import dataclass
-from typing import List, Optional
+import time
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+try:
+    import numpy as np
+except ImportError:     # Needed by --analyze only
+    np = None
 
 
 @dataclass
@@ -162,6 +192,796 @@ Total Tq:     {result.total_tq}
 """
 
 
+# ============================================================================
+# Network Timing (--node)
+# ============================================================================
+
+@dataclass(frozen=True)
+class ControllerLimits:
+    """Bit timing ranges of a CAN controller (in Tq, not register codes)."""
+    brp: int
+    ts1: int
+    ts2: int
+    sjw: int
+    dbrp: int = 0   # Data phase, 0 = classic CAN only
+    dts1: int = 0
+    dts2: int = 0
+    dsjw: int = 0
+    tdco: int = 0   # Largest TDC offset (mtq)
+
+
+CONTROLLERS = {
+    "bxcan": ControllerLimits(brp=1024, ts1=16, ts2=8, sjw=4),
+    "fdcan": ControllerLimits(brp=512, ts1=256, ts2=128, sjw=128,
+                              dbrp=32, dts1=32, dts2=16, dsjw=16, tdco=127),
+}
+CABLE_DELAY = 5e-9          # s/m
+MIN_NOMINAL_TQ = 8          # ISO 11898-1 bit length limits (Tq)
+MIN_DATA_TQ = 5
+MIN_PS2 = 2                 # Nominal Phase_Seg2 >= information processing time
+MAX_TOLERANCE = 0.0158      # Largest df of any bit timing; rate errors beyond it are not searched
+TDC_MIN_DATA = 1000000      # CiA 601-3: TDC on above this data rate
+TDC_MAX_DBRP = 2            # ISO 11898-1: data prescaler with TDC on
+MAX_LEVELS = 1024           # Rate error levels in the network search
+SP_SPAN = 5.0               # Sample points searched: requested +/- this (%)
+CONDITIONS = (
+    "",
+    "nominal SJW (resync over 10 bits)",
+    "nominal phase segments (error flag, 13 bits)",
+    "data SJW (resync over 10 bits)",
+    "data -> nominal switch (CRC delimiter)",
+    "nominal -> data switch (BRS)",
+)
+
+
+@dataclass
+class Node:
+    """One ECU of the network."""
+    name: str
+    clock_hz: int
+    controller: str
+    tolerance: float    # Oscillator tolerance (fraction)
+
+
+@dataclass
+class NodeTiming:
+    """Bit timing chosen for one node."""
+    node: Node
+    nominal: TimingResult
+    prop: int                               # Tq of TS1 that cover the round trip
+    data: Optional[TimingResult] = None
+    tdco: int = 0                           # TDC offset (mtq), 0 = TDC off
+    allowed: float = 0.0                    # Clock error to any node it tolerates (2 df)
+    limit: int = 0                          # Condition that sets it
+    errors: Tuple[float, float] = (0.0, 0.0)  # Nominal / data rate error (fraction)
+
+
+def parse_node(spec: str, controller: str, tolerance: float) -> Node:
+    """NAME:CLOCK[:CONTROLLER][:TOL%]"""
+    fields = spec.split(":")
+    if len(fields) < 2 or not fields[0]:
+        raise ValueError(f"Node '{spec}': expected NAME:CLOCK[:CONTROLLER][:TOL%]")
+    for extra in fields[2:]:
+        if extra.lower() in CONTROLLERS:
+            controller = extra.lower()
+        else:
+            tolerance = float(extra.rstrip("%")) / 100
+    return Node(fields[0], parse_frequency(fields[1]), controller, tolerance)
+
+
+def phase_settings(clock_hz: int, rate: int, brp_max: int, ts1_max: int, ts2_max: int,
+                   sjw_max: int, min_tq: int, min_ps2: int, prop_s: float) -> Dict[str, "np.ndarray"]:
+    """
+    Every BRP/TS1/TS2 of one phase within MAX_TOLERANCE of the rate.
+
+    SJW is not searched: all tolerance conditions grow with it, so the
+    largest legal value, min(PS1, PS2, controller max), dominates.
+    TS1 holds ceil(prop_s / Tq) Tq of propagation segment; the rest is PS1.
+    """
+    brp, tq = np.meshgrid(np.arange(1, brp_max + 1), np.arange(min_tq, ts1_max + ts2_max + 2),
+                          indexing="ij")
+    err = clock_hz / (brp * tq * float(rate)) - 1.0
+    near = np.abs(err) < MAX_TOLERANCE
+    ts2 = np.arange(min_ps2, ts2_max + 1)
+    brp, tq, err = (np.repeat(a[near], len(ts2)) for a in (brp, tq, err))
+    ts2 = np.tile(ts2, int(near.sum()))
+    ts1 = tq - 1 - ts2
+    prop = np.ceil(prop_s * clock_hz / brp - 1e-9).astype(np.int64)
+    ps1 = ts1 - prop
+    ok = (ts1 <= ts1_max) & (ps1 >= 1)
+    s = {"brp": brp[ok], "tq": tq[ok], "ts1": ts1[ok], "ts2": ts2[ok],
+         "prop": prop[ok], "ps1": ps1[ok], "err": err[ok]}
+    s["sjw"] = np.minimum(np.minimum(s["ps1"], s["ts2"]), sjw_max)
+    s["sp"] = (1 + s["ts1"]) / s["tq"] * 100
+    return s
+
+
+def node_settings(node: Node, nominal: int, data: Optional[int], prop_s: float,
+                  loop_s: float, sp: float, dsp: float) -> Dict[str, "np.ndarray"]:
+    """
+    All settings of one node with the clock error they tolerate.
+
+    'allowed' is the relative clock error between this node and any
+    transmitter (2 df) for which the node as receiver still samples
+    correctly: the minimum of the ISO 11898-1 / CiA 601-3 conditions,
+    with 'limit' the one that sets it. FD settings are every nominal
+    setting crossed with every data setting. 'lo' / 'hi' bound the rate
+    errors of the setting for the network search.
+
+    Sample points stay within SP_SPAN of sp / dsp: the conditions alone
+    favour ever earlier sample points (longer Phase_Seg2).
+    """
+    lim = CONTROLLERS[node.controller]
+    n = phase_settings(node.clock_hz, nominal, lim.brp, lim.ts1, lim.ts2, lim.sjw,
+                       MIN_NOMINAL_TQ, MIN_PS2, prop_s)
+    n = {k: v[np.abs(n["sp"] - sp) <= SP_SPAN] for k, v in n.items()}
+    ps_n = np.minimum(n["ps1"], n["ts2"])
+    c1 = n["sjw"] / (10.0 * n["tq"])
+    c2 = ps_n / (13.0 * n["tq"] - n["ts2"])
+    if not data:
+        allowed = np.minimum(c1, c2)
+        return {"n": np.arange(len(c1)), "d": np.full(len(c1), -1), "nom": n, "dat": None,
+                "allowed": allowed, "limit": np.where(c1 <= c2, 1, 2),
+                "lo": n["err"], "hi": n["err"], "tdco": np.zeros(len(c1), np.int64)}
+
+    # Data phase: no arbitration, so no propagation segment
+    d = phase_settings(node.clock_hz, data, lim.dbrp, lim.dts1, lim.dts2, lim.dsjw,
+                       MIN_DATA_TQ, 1, 0.0)
+    d = {k: v[np.abs(d["sp"] - dsp) <= SP_SPAN] for k, v in d.items()}
+    # TDC: the transmitter samples its own bit one loop delay late
+    tdc = (data > TDC_MIN_DATA) | (loop_s >= d["brp"] * (1 + d["ts1"]) / node.clock_hz)
+    tdco = np.where(tdc, d["brp"] * (1 + d["ts1"]), 0)
+    ok = ~tdc | ((d["brp"] <= TDC_MAX_DBRP) & (tdco <= lim.tdco))
+    d = {k: v[ok] for k, v in d.items()}
+    tdco = tdco[ok]
+
+    i, k = (a.ravel() for a in np.meshgrid(np.arange(len(c1)), np.arange(len(tdco)), indexing="ij"))
+    ratio = n["brp"][i] / d["brp"][k]       # Nominal Tq in data Tq
+    c3 = d["sjw"][k] / (10.0 * d["tq"][k])
+    c4 = ps_n[i] / ((6.0 * d["tq"][k] - d["ts1"][k]) / ratio + 7.0 * n["tq"][i])
+    c5 = ((d["ts2"][k] - np.maximum(0.0, ratio - 1.0))
+          / ((2.0 * n["tq"][i] - n["ts2"][i]) * ratio + d["ts2"][k] + 4.0 * d["tq"][k]))
+    conds = np.stack([c1[i], c2[i], c3, c4, c5])
+    return {"n": i, "d": k, "nom": n, "dat": d,
+            "allowed": conds.min(axis=0), "limit": conds.argmin(axis=0) + 1,
+            "lo": np.minimum(n["err"][i], d["err"][k]), "hi": np.maximum(n["err"][i], d["err"][k]),
+            "tdco": tdco[k]}
+
+
+def _best_window(settings: List[Dict[str, "np.ndarray"]], need: List[float]):
+    """
+    Rate error window [lo, hi] that maximizes the network margin.
+
+    Any two nodes whose settings fall in the window differ by at most its
+    width, so the margin of the window is min over nodes of (best
+    'allowed' in it - need) - width. Errors are quantized outward to at
+    most MAX_LEVELS levels; every window is scored at once from one
+    lo x hi table per node.
+    """
+    step = 1e-7
+    while True:
+        lo = [np.floor(s["lo"] / step).astype(np.int64) for s in settings]
+        hi = [np.ceil(s["hi"] / step).astype(np.int64) for s in settings]
+        levels = np.unique(np.concatenate(lo + hi))
+        if len(levels) <= MAX_LEVELS:
+            break
+        step *= 2
+    n_lv = len(levels)
+    width = (levels[None, :] - levels[:, None]) * step
+    score = np.where(width >= 0, np.inf, -np.inf)
+    for s, l, h, nd in zip(settings, lo, hi, need):
+        key = np.searchsorted(levels, l) * n_lv + np.searchsorted(levels, h)
+        order = np.lexsort((s["allowed"], key))
+        key = key[order]
+        last = np.r_[key[1:] != key[:-1], True]
+        best = np.full(n_lv * n_lv, -np.inf)
+        best[key[last]] = s["allowed"][order][last]
+        best = best.reshape(n_lv, n_lv)
+        # Window (a, b) holds settings with lo >= a and hi <= b
+        best = np.maximum.accumulate(best[::-1], axis=0)[::-1]
+        best = np.maximum.accumulate(best, axis=1)
+        score = np.minimum(score, best - nd)
+    score -= np.where(width >= 0, width, 0)
+    a, b = np.unravel_index(np.argmax(score), score.shape)
+    return score[a, b], width[a, b], [(l >= levels[a]) & (h <= levels[b]) for l, h in zip(lo, hi)]
+
+
+def _pick(s: Dict[str, "np.ndarray"], mask: "np.ndarray", sp: float, dsp: float) -> int:
+    """Setting in mask closest to the sample points, then smallest BRP (CiA 601-3), then most tolerant."""
+    idx = np.flatnonzero(mask)
+    n, d = s["nom"], s["dat"]
+    i = s["n"][idx]
+    keys = [np.abs(n["sp"][i] - sp)]
+    if d is not None:
+        k = s["d"][idx]
+        keys += [np.abs(d["sp"][k] - dsp), d["brp"][k] != n["brp"][i], d["brp"][k]]
+    keys += [n["brp"][i], -s["allowed"][idx]]
+    return int(idx[np.lexsort(keys[::-1])[0]])
+
+
+def _timing_result(p: Dict[str, "np.ndarray"], j: int, clock_hz: int) -> TimingResult:
+    brp, tq = int(p["brp"][j]), int(p["tq"][j])
+    return TimingResult(prescaler=brp, total_tq=tq, ts1=int(p["ts1"][j]), ts2=int(p["ts2"][j]),
+                        sjw=int(p["sjw"][j]), sample_point=float(p["sp"][j]),
+                        actual_baud=clock_hz // (brp * tq), error_percent=abs(float(p["err"][j])) * 100)
+
+
+def optimize_network(nodes: List[Node], nominal: int, data: Optional[int],
+                     prop_s: float, loop_s: float, sample_point: float = 87.5,
+                     data_sample_point: float = 75.0) -> Tuple[List[NodeTiming], int]:
+    """
+    Bit timing for every node that maximizes the network's tolerance margin.
+
+    A node's margin is the clock error it tolerates minus what it must
+    tolerate: its own oscillator tolerance plus, against every node
+    (itself included: a second unit of the same type), that node's
+    tolerance and rate error difference. The network margin is the
+    smallest node margin. Sample points are searched within SP_SPAN of
+    the requested ones; nodes with slack take the sample points of the
+    limiting node (CiA 601-3: the same sample point in all nodes).
+
+    Returns the chosen timings and the number of settings searched;
+    raises ValueError if a node has no legal setting.
+    """
+    settings = []
+    for node in nodes:
+        s = node_settings(node, nominal, data, prop_s, loop_s, sample_point, data_sample_point)
+        if not len(s["allowed"]):
+            raise ValueError(f"{node.name}: no bit timing for {nominal:,} bit/s"
+                             + (f" / {data:,} bit/s" if data else "")
+                             + f" at {node.clock_hz:,} Hz on {node.controller} (rate within "
+                             f"{MAX_TOLERANCE * 100:.2f}%, sample point within {SP_SPAN:g}%, "
+                             f"{prop_s * 1e9:.0f} ns propagation segment)")
+        settings.append(s)
+    worst = max(node.tolerance for node in nodes)
+    need = [node.tolerance + worst for node in nodes]
+    margin, width, windows = _best_window(settings, need)
+
+    # Limiting node first, closest to the requested sample points
+    slack = [float(s["allowed"][w].max()) - nd for s, w, nd in zip(settings, windows, need)]
+    first = int(np.argmin(slack))
+    order = [first] + [j for j in range(len(nodes)) if j != first]
+    picks = {}
+    sp, dsp = sample_point, data_sample_point
+    for j in order:
+        s = settings[j]
+        keep = windows[j] & (s["allowed"] - need[j] - width >= margin - 1e-12)
+        picks[j] = _pick(s, keep, sp, dsp)
+        if j == first:
+            sp = float(s["nom"]["sp"][s["n"][picks[j]]])
+            if data:
+                dsp = float(s["dat"]["sp"][s["d"][picks[j]]])
+
+    result = []
+    for j, node in enumerate(nodes):
+        s, k = settings[j], picks[j]
+        nom = _timing_result(s["nom"], s["n"][k], node.clock_hz)
+        dat = _timing_result(s["dat"], s["d"][k], node.clock_hz) if data else None
+        errors = (float(s["nom"]["err"][s["n"][k]]), float(s["dat"]["err"][s["d"][k]]) if data else 0.0)
+        result.append(NodeTiming(node, nom, int(s["nom"]["prop"][s["n"][k]]), dat,
+                                 int(s["tdco"][k]), float(s["allowed"][k]), int(s["limit"][k]), errors))
+    return result, sum(len(s["allowed"]) for s in settings)
+
+
+def network_margins(timings: List[NodeTiming]) -> List[Tuple[float, float]]:
+    """Per node: (margin, common tolerance) with the chosen settings' exact rate errors.
+
+    The common tolerance is the largest oscillator tolerance that every
+    node could have, the same for all, with the margin still >= 0.
+    """
+    out = []
+    worst = max(t.node.tolerance for t in timings)
+    for t in timings:
+        spread = max(max(abs(a - b) for a, b in zip(o.errors, t.errors)) for o in timings)
+        out.append((t.allowed - t.node.tolerance - worst - spread, (t.allowed - spread) / 2))
+    return out
+
+
+def generate_fdcan_config(t: NodeTiming) -> str:
+    """STM32 FDCAN (M_CAN) NBTP / DBTP / TDCR."""
+    n, d = t.nominal, t.data
+    lines = [
+        f"// {t.node.name}: STM32 FDCAN, clock {t.node.clock_hz} Hz",
+        f"FDCAN->NBTP = (({n.sjw} - 1) << 25) |    // NSJW",
+        f"              (({n.prescaler} - 1) << 16) |    // NBRP",
+        f"              (({n.ts1} - 1) << 8) |     // NTSEG1",
+        f"              (({n.ts2} - 1) << 0);      // NTSEG2",
+    ]
+    if d:
+        lines += [
+            f"FDCAN->DBTP = ({1 if t.tdco else 0}U << 23) |      // TDC",
+            f"              (({d.prescaler} - 1) << 16) |    // DBRP",
+            f"              (({d.ts1} - 1) << 8) |     // DTSEG1",
+            f"              (({d.ts2} - 1) << 4) |     // DTSEG2",
+            f"              (({d.sjw} - 1) << 0);      // DSJW",
+        ]
+        if t.tdco:
+            lines.append(f"FDCAN->TDCR = ({t.tdco}U << 8);            // TDCO: SSP at the data sample point")
+    return "\n".join(lines) + "\n"
+
+
+def network_timing(args) -> int:
+    """--node: one bit timing per node, maximizing the network tolerance margin."""
+    if np is None:
+        print("ERROR: network timing needs numpy")
+        return 1
+    nominal = parse_frequency(args.baud)
+    data = parse_frequency(args.data) if args.data else None
+    default_ctrl = "fdcan" if data else "bxcan"
+    try:
+        nodes = [parse_node(spec, default_ctrl, args.tolerance / 100) for spec in args.node]
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return 1
+    if data:
+        classic = [n.name for n in nodes if not CONTROLLERS[n.controller].dbrp]
+        if classic:
+            print(f"ERROR: No CAN FD on {', '.join(classic)} (controller)")
+            return 1
+    loop_s = args.transceiver_delay * 1e-9
+    prop_s = 2 * (args.cable_length * CABLE_DELAY + loop_s)
+
+    start = time.perf_counter()
+    try:
+        timings, searched = optimize_network(nodes, nominal, data, prop_s, loop_s,
+                                             args.sample, args.data_sample)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return 1
+    elapsed = time.perf_counter() - start
+    margins = network_margins(timings)
+
+    print("CAN Network Timing")
+    print("=" * 40)
+    print(f"Nominal Rate:      {nominal:,} bps")
+    if data:
+        print(f"Data Rate:         {data:,} bps")
+    print(f"Propagation:       {args.cable_length:g} m cable, {args.transceiver_delay:g} ns "
+          f"transceiver loop -> {prop_s * 1e9:.0f} ns round trip")
+    print(f"Searched:          {searched:,} settings in {elapsed * 1e3:.0f} ms")
+    print()
+
+    print("[Nominal Phase]")
+    print(f"  {'Node':<10} {'Clock':>12} {'BRP':>4} {'Tq':>4} {'TS1':>4} {'Prop':>5} "
+          f"{'TS2':>4} {'SJW':>4} {'SP %':>6} {'Rate ppm':>9}")
+    for t in timings:
+        r = t.nominal
+        print(f"  {t.node.name:<10} {t.node.clock_hz:>12,} {r.prescaler:>4} {r.total_tq:>4} {r.ts1:>4} "
+              f"{t.prop:>5} {r.ts2:>4} {r.sjw:>4} {r.sample_point:>6.1f} "
+              f"{round(t.errors[0] * 1e6):>+9d}")
+    print()
+    if data:
+        print("[Data Phase]")
+        print(f"  {'Node':<10} {'DBRP':>5} {'Tq':>4} {'TS1':>4} {'TS2':>4} {'SJW':>4} "
+              f"{'SP %':>6} {'Rate ppm':>9} {'TDCO':>5}")
+        for t in timings:
+            r = t.data
+            tdc = f"{t.tdco:>5}" if t.tdco else f"{'off':>5}"
+            print(f"  {t.node.name:<10} {r.prescaler:>5} {r.total_tq:>4} {r.ts1:>4} {r.ts2:>4} "
+                  f"{r.sjw:>4} {r.sample_point:>6.1f} {round(t.errors[1] * 1e6):>+9d} {tdc}")
+        print("  TDCO in clock periods; the secondary sample point is the loop delay "
+              "measured at BRS + TDCO.")
+        print()
+
+    print("[Tolerance] (clock error between two nodes, ISO 11898-1 / CiA 601-3 conditions)")
+    print(f"  {'Node':<10} {'Osc %':>6} {'Allowed %':>10} {'Margin %':>9}  Limited by")
+    for t, (margin, _) in zip(timings, margins):
+        print(f"  {t.node.name:<10} {t.node.tolerance * 100:>6.3f} {t.allowed * 100:>10.3f} "
+              f"{margin * 100:>+9.3f}  {t.limit}: {CONDITIONS[t.limit]}")
+    worst = min(range(len(timings)), key=lambda j: margins[j][0])
+    common = min(c for _, c in margins)
+    print(f"  Common oscillator tolerance: +/-{common * 100:.3f}% per node "
+          f"(limited by {timings[worst].node.name})")
+    print("  Allowed = 2 x df; a node needs its own tolerance, the worst other node's and the")
+    print("  rate error difference (BRP/Tq quantization) below it.")
+    print()
+
+    print("[Register Configuration]")
+    for t in timings:
+        if t.node.controller == "fdcan":
+            print(generate_fdcan_config(t))
+        else:
+            print(f"// {t.node.name}" + generate_register_config(t.nominal, "stm32"))
+
+    if margins[worst][0] < 0:
+        print(f"ERROR: {timings[worst].node.name} is short of {-margins[worst][0] * 100:.3f}% "
+              f"tolerance; use better oscillators, a shorter bus or a lower rate.")
+        return 1
+    return 0
+
+
+# ============================================================================
+# Capture Analysis (--analyze)
+# ============================================================================
+
+NOMINAL_RATES = (10000, 20000, 33333, 50000, 62500, 83333, 100000, 125000, 250000, 500000, 800000, 1000000)
+DATA_RATES = (1000000, 2000000, 4000000, 5000000, 8000000, 10000000)
+FD_MIN_NOMINAL = 125000     # Slowest nominal rate tried for FD
+SNAP_TOLERANCE = 0.02       # A measured rate this close to a standard one is taken as that one
+HIST_RANGE = (20e-9, 20e-3)  # Edge intervals in the histogram (s)
+HIST_STEP = 1.005           # Bin width ratio
+CLUSTER_SHARE = 0.01        # Share of all intervals the one-bit cluster needs
+FIT_EDGES = 20000           # Edges decoded with each rate candidate
+ERR_BINS = 1000             # Edge position histogram, -50 % .. +50 % of a bit
+DRIFT_GROUP_PPM = 50        # IDs whose bit times differ less are taken as one node
+NOMINAL, DATA = 0, 1        # Phases
+
+
+def snap_rate(rate: float, table: Tuple[int, ...]) -> int:
+    """The standard rate within SNAP_TOLERANCE, else the measured one."""
+    best = min(table, key=lambda r: abs(rate - r) / r)
+    return best if abs(rate - best) / best <= SNAP_TOLERANCE else int(round(rate))
+
+
+def interval_histogram(pieces) -> Tuple["np.ndarray", "np.ndarray"]:
+    """
+    Log-spaced histograms of edge-to-edge intervals: bin edges and
+    counts[level] for dominant (0) and recessive (1) pulses.
+    """
+    bins = np.exp(np.arange(np.log(HIST_RANGE[0]), np.log(HIST_RANGE[1]), np.log(HIST_STEP)))
+    counts = np.zeros((2, len(bins) - 1), np.int64)
+    last_t, last_level = None, None
+    for cap in pieces:
+        t, levels = cap.times, cap.levels
+        if last_t is not None:
+            t, levels = np.concatenate(([last_t], t)), np.concatenate(([last_level], levels))
+        width = np.diff(t)
+        for level in (0, 1):
+            counts[level] += np.histogram(width[levels[:-1] == level], bins)[0]
+        if len(t):
+            last_t, last_level = t[-1], levels[-1]
+    return bins, counts
+
+
+def shortest_cluster(bins: "np.ndarray", counts: "np.ndarray") -> Tuple[float, float]:
+    """
+    Center and share of the shortest interval cluster (one bit) of one
+    pulse level. The histogram is summed over +-3 % first, so jitter does
+    not split the cluster.
+    """
+    total = counts.sum()
+    if not total:
+        raise ValueError("no edges in the capture")
+    smooth = np.convolve(counts, np.ones(13, np.int64), mode="same")
+    strong = np.flatnonzero(smooth >= CLUSTER_SHARE * total)
+    if not len(strong):
+        raise ValueError("no interval cluster, not a CAN signal?")
+    run_end = strong[0]
+    while run_end + 1 < len(smooth) and smooth[run_end + 1] >= CLUSTER_SHARE * total:
+        run_end += 1
+    peak = strong[0] + int(np.argmax(smooth[strong[0]:run_end + 1]))
+    centers = np.sqrt(bins[:-1] * bins[1:])
+    near = np.abs(centers / centers[peak] - 1.0) <= 0.10
+    return float(np.average(centers[near], weights=counts[near] + 1e-12)), float(counts[near].sum() / total)
+
+
+def bit_cluster(bins: "np.ndarray", counts: "np.ndarray") -> Tuple[float, float, float]:
+    """
+    One bit time from the shortest dominant and recessive pulses, and the
+    asymmetry: a slow recessive edge (or transceiver loop delay) stretches
+    dominant pulses by as much as it shortens recessive ones.
+    Returns (bit time, dominant stretch, share of pulses in the clusters).
+    """
+    dom, dom_share = shortest_cluster(bins, counts[0])
+    rec, rec_share = shortest_cluster(bins, counts[1])
+    return (dom + rec) / 2, (dom - rec) / 2, (dom_share + rec_share) / 2
+
+
+def rate_candidates(t_bit: float) -> List[Tuple[int, Optional[int]]]:
+    """(nominal, data) pairs the shortest cluster allows: one classic, FD at slower nominals."""
+    data = snap_rate(1.0 / t_bit, DATA_RATES)
+    candidates = [(snap_rate(1.0 / t_bit, NOMINAL_RATES), None)]
+    if data < DATA_RATES[0] * (1.0 - SNAP_TOLERANCE):
+        return candidates
+    for rate in NOMINAL_RATES:
+        if rate >= FD_MIN_NOMINAL and 1.9 <= 1.0 / (rate * t_bit) <= 16.5:
+            candidates.append((rate, data))
+    return candidates
+
+
+def leading_edges(pieces, n_edges: int):
+    """The pieces up to the n-th edge."""
+    from can_bitstream import slice_capture
+    for cap in pieces:
+        if len(cap.times) > n_edges:
+            yield slice_capture(cap, cap.start, float(cap.times[n_edges]))
+            return
+        n_edges -= len(cap.times)
+        yield cap
+
+
+@dataclass
+class EdgeTiming:
+    """
+    Bit time fits and edge positions of decoded frames.
+
+    Each frame is re-encoded for its bit grid. Its falling edges (the ones
+    receivers synchronize on; rising edges carry the driver asymmetry)
+    are fitted per phase: slope = bit time of the transmitting node. Every
+    edge is also placed against the last falling edge before it at the
+    network bit time tn / td: where an ideal receiver sees it.
+    """
+    tn: float
+    td: float
+    hist: Dict[Tuple[int, int], "np.ndarray"] = field(default_factory=dict)   # (phase, rise) -> counts
+    lo: Dict[int, float] = field(default_factory=dict)     # Earliest edge per phase (fraction of a bit)
+    hi: Dict[int, float] = field(default_factory=dict)     # Latest
+    ids: List[Tuple[int, bool]] = field(default_factory=list)
+    frame_tn: List[float] = field(default_factory=list)
+    frame_td: List[float] = field(default_factory=list)
+    brs_bit: List[float] = field(default_factory=list)     # Length of the BRS bit (s)
+    skipped: int = 0
+
+    def add(self, cap, frames):
+        from can_bitstream import encode_frame
+        pos, idx, fid, phase = [], [], [], []
+        brs_of, ts = [], []
+        for f in frames:
+            enc = encode_frame(f)
+            bits = np.frombuffer(bytes(enc.bits[:enc.crc_delimiter + 1]), np.uint8)
+            change = np.concatenate(([0], np.flatnonzero(bits[1:] != bits[:-1]) + 1))
+            k = int(np.searchsorted(cap.times, f.timestamp - 0.25 * self.tn))
+            if k + len(change) > len(cap.times) or (cap.levels[k:k + len(change)] != bits[change]).any():
+                self.skipped += 1
+                continue
+            n = len(ts)
+            pos.append(np.arange(k, k + len(change)))
+            idx.append(change)
+            fid.append(np.full(len(change), n))
+            phase.append((change > enc.brs_bit) if enc.brs_bit >= 0 else np.zeros(len(change), bool))
+            brs_of.append(enc.brs_bit)
+            ts.append(f.timestamp)
+            self.ids.append((f.id, f.ide))
+        if not ts:
+            return
+        pos, idx, fid = np.concatenate(pos), np.concatenate(idx), np.concatenate(fid)
+        ph = np.concatenate(phase).astype(np.int64)
+        brs_of, ts = np.array(brs_of), np.array(ts)
+        t = cap.times[pos] - ts[fid]
+        rise = cap.levels[pos].astype(bool)
+        x = np.where(ph == DATA, idx - brs_of[fid] - 1, idx).astype(np.float64)
+        group = 2 * fid + ph
+
+        # Bit time per frame and phase: least squares over the falling edges
+        fall = ~rise
+        n_groups = 2 * len(ts)
+        sums = [np.bincount(group[fall], w, n_groups) for w in
+                (None, x[fall], t[fall], x[fall] * x[fall], x[fall] * t[fall])]
+        n, sx, sy, sxx, sxy = sums
+        span = np.zeros(n_groups)
+        np.maximum.at(span, group[fall], x[fall])
+        den = n * sxx - sx * sx
+        ok = (n >= 3) & (span >= 8) & (den > 0)
+        slope = np.where(ok, (n * sxy - sx * sy) / np.where(ok, den, 1), np.nan)
+        icpt = np.where(ok, (sy - slope * sx) / np.maximum(n, 1), np.nan)
+        self.frame_tn.extend(slope[0::2].tolist())
+        self.frame_td.extend(slope[1::2].tolist())
+        has_brs = (brs_of >= 0) & ok[0::2] & ok[1::2]
+        length = icpt[1::2] - icpt[0::2] - brs_of * slope[0::2]
+        self.brs_bit.extend(length[has_brs].tolist())
+
+        # Edge positions against the last falling edge of the same phase
+        at = np.arange(len(t))
+        last_fall = np.maximum.accumulate(np.where(fall, at, -1))
+        prev = np.concatenate(([-1], last_fall[:-1]))
+        valid = (prev >= 0) & (group[np.maximum(prev, 0)] == group)
+        prev = prev[valid]
+        tbit = np.where(ph[valid] == DATA, self.td, self.tn)
+        frac = ((t[valid] - t[prev]) - (x[valid] - x[prev]) * tbit) / tbit
+        for p in (NOMINAL, DATA):
+            sel = ph[valid] == p
+            if not sel.any():
+                continue
+            self.lo[p] = min(self.lo.get(p, 0.0), float(frac[sel].min()))
+            self.hi[p] = max(self.hi.get(p, 0.0), float(frac[sel].max()))
+            for r in (False, True):
+                cell = np.clip(np.round((frac[sel & (rise[valid] == r)] + 0.5) * ERR_BINS), 0, ERR_BINS)
+                counts = np.bincount(cell.astype(np.int64), minlength=ERR_BINS + 1)
+                self.hist[(p, r)] = self.hist.get((p, r), 0) + counts
+
+
+def _center(values) -> float:
+    """Mean of the middle 80 %: robust to outliers, and unlike the median not
+    stuck on the sample grid when edges move by less than a sample."""
+    values = np.sort(np.asarray(values, np.float64))
+    values = values[np.isfinite(values)]
+    cut = len(values) // 10
+    return float(values[cut:len(values) - cut].mean()) if len(values) else float("nan")
+
+
+def _edge_range(counts: "np.ndarray") -> Tuple[float, float, float]:
+    """Mean, 0.1 % and 99.9 % points of an edge position histogram (fraction of a bit)."""
+    frac = np.arange(ERR_BINS + 1) / ERR_BINS - 0.5
+    cum = np.cumsum(counts) / counts.sum()
+    return (float(np.average(frac, weights=counts)), float(frac[np.searchsorted(cum, 0.001)]),
+            float(frac[np.searchsorted(cum, 0.999)]))
+
+
+def _id_str(can_id: int, ide: bool) -> str:
+    return f"{can_id:08X}" if ide else f"{can_id:03X}"
+
+
+def print_drift(timing: EdgeTiming, nominal: int):
+    """Per-ID bit time offsets, IDs grouped into nodes."""
+    ppm = (1.0 / (np.asarray(timing.frame_tn) * nominal) - 1.0) * 1e6
+    per_id: Dict[Tuple[int, bool], List[float]] = {}
+    for key, value in zip(timing.ids, ppm):
+        if np.isfinite(value):
+            per_id.setdefault(key, []).append(value)
+    rows = sorted((_center(v), key, len(v), float(np.subtract(*np.percentile(v, [75, 25]))))
+                  for key, v in per_id.items() if len(v) >= 3)
+    if not rows:
+        print("  Not enough frames per ID")
+        return
+    groups = [[rows[0]]]
+    for row in rows[1:]:
+        if row[0] - groups[-1][-1][0] > DRIFT_GROUP_PPM:
+            groups.append([])
+        groups[-1].append(row)
+    print(f"  {'Node':>4}  {'Offset':>10}  {'Frames':>8}  IDs (ppm, IQR)")
+    print(f"  {'-' * 4}  {'-' * 10}  {'-' * 8}  {'-' * 40}")
+    for n, group in enumerate(groups):
+        frames = sum(r[2] for r in group)
+        center = float(np.average([r[0] for r in group], weights=[r[2] for r in group]))
+        ids = ", ".join(f"{_id_str(*r[1])} ({round(r[0]):+d}, {r[3]:.0f})" for r in group[:6])
+        more = f" +{len(group) - 6} more" if len(group) > 6 else ""
+        print(f"  {chr(65 + n % 26):>4}  {round(center):>+7d} ppm  {frames:>8,}  {ids}{more}")
+    if len(groups) > 1:
+        print(f"  Spread between nodes: {groups[-1][-1][0] - groups[0][0][0]:.0f} ppm")
+
+
+def print_btr(clock_hz: int, rate: int, sample_point: float, label: str, mcu: str):
+    results = calculate_timing(clock_hz, rate, sample_point)
+    if not results:
+        print(f"  {label}: no configuration for {rate:,} bit/s at {clock_hz:,} Hz")
+        return
+    results.sort(key=lambda r: (r.error_percent, abs(r.sample_point - sample_point)))
+    print(f"  {label} {rate:,} bit/s, sample point {sample_point:.1f}%:")
+    print(f"  {'BRP':>5} {'Tq':>4} {'TS1':>4} {'TS2':>4} {'SJW':>4} {'SP %':>6} {'Error %':>8}")
+    for r in results[:5]:
+        print(f"  {r.prescaler:>5} {r.total_tq:>4} {r.ts1:>4} {r.ts2:>4} {r.sjw:>4} "
+              f"{r.sample_point:>6.1f} {r.error_percent:>8.2f}")
+    if label == "Nominal":
+        print(generate_register_config(results[0], mcu))
+
+
+def analyze_capture(args) -> int:
+    """--analyze: rates, drift, edge margins and BTR candidates of a capture."""
+    if np is None:
+        print("ERROR: --analyze needs numpy")
+        return 1
+    from can_bitstream import DecodeStats, decode_stream, iter_capture
+
+    rate = parse_frequency(args.rate) if args.rate else None
+
+    def pieces():
+        return iter_capture(args.analyze, rate, args.channel, args.signal, args.glitch * 1e-9)
+
+    try:
+        stats = DecodeStats()
+        bins, counts = interval_histogram(stats.count(pieces()))
+        t_bit, stretch, share = bit_cluster(bins, counts)
+        fit = list(leading_edges(pieces(), FIT_EDGES))
+    except FileNotFoundError:
+        print(f"ERROR: File not found: {args.analyze}")
+        return 1
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return 1
+
+    # Histogram: one bit; decoding decides nominal / data
+    scores = []
+    for nominal, data in rate_candidates(t_bit):
+        frames = errors = 0
+        for _, dec in decode_stream(iter(fit), nominal, data):
+            frames += len(dec.frames)
+            errors += len(dec.errors)
+        scores.append((frames, -errors, nominal, data))
+    best = max(scores, key=lambda s: s[:2])
+    frames, _, nominal, data = best
+
+    print("CAN Capture Analysis")
+    print("=" * 40)
+    print(f"Capture:          {args.analyze} ({stats.end - stats.start:.6f} s, {stats.edges:,} edges)")
+    print(f"Shortest pulses:  {t_bit * 1e9:.1f} ns ({1.0 / t_bit:,.0f} bit/s, {share * 100:.0f}% of pulses), "
+          f"dominant {stretch * 1e9:+.1f} ns")
+    print()
+    print("[Rate Candidates] (first {:,} edges decoded)".format(sum(len(c.times) for c in fit)))
+    for f, e, n, d in scores:
+        rates = f"{n:,}" + (f" / {d:,}" if d else "")
+        mark = "  <-" if (n, d) == (nominal, data) else ""
+        print(f"  {rates:>22} bit/s  {f:>6,} frames  {-e:>6,} errors{mark}")
+    print()
+    if not frames:
+        print("ERROR: no frame decodes at any candidate rate")
+        print("Check the signal (CAN_RX, not CAN_H/CAN_L) and --glitch for ringing.")
+        return 1
+
+    # Network bit times from the fit window, then the whole capture
+    td0 = 1.0 / data if data else 1.0 / nominal
+    pilot = EdgeTiming(1.0 / nominal, td0)
+    for cap, dec in decode_stream(iter(fit), nominal, data):
+        pilot.add(cap, dec.frames)
+    tn = _center(pilot.frame_tn) if np.isfinite(_center(pilot.frame_tn)) else 1.0 / nominal
+    td = _center(pilot.frame_td) if data and np.isfinite(_center(pilot.frame_td)) else td0
+    nominal = snap_rate(1.0 / tn, NOMINAL_RATES)
+    data = snap_rate(1.0 / td, DATA_RATES) if data else None
+    timing = EdgeTiming(tn, td)
+    total = DecodeStats()
+    for cap, dec in decode_stream(pieces(), nominal, data):
+        total.add(dec)
+        timing.add(cap, dec.frames)
+
+    tn_meas = _center(timing.frame_tn)
+    print("[Bit Rate]")
+    print(f"  Nominal:        {nominal:,} bit/s (measured {1.0 / tn_meas:,.0f}, "
+          f"{round((1.0 / (tn_meas * nominal) - 1.0) * 1e6):+d} ppm)")
+    if data:
+        td_meas = _center(timing.frame_td)
+        if np.isfinite(td_meas):
+            print(f"  FD data:        {data:,} bit/s (measured {1.0 / td_meas:,.0f}, "
+                  f"{round((1.0 / (td_meas * data) - 1.0) * 1e6):+d} ppm)")
+    print(f"  Frames:         {total.frames:,} ({total.fd_frames:,} FD), "
+          f"{sum(total.errors.values()):,} errors, {timing.skipped:,} not fitted")
+    print("  Rates are in the capture's time base; its clock error adds to all of them.")
+    print()
+
+    print("[Edge Timing] (against the last falling edge, % of a bit)")
+    print(f"  {'Phase':<8} {'Falls':>20} {'Rises':>20} {'Usable SP':>16}")
+    chosen = {NOMINAL: args.sample / 100, DATA: args.data_sample / 100}
+    for p, name, tb in ((NOMINAL, "Nominal", tn), (DATA, "Data", td)):
+        if (p, False) not in timing.hist:
+            continue
+        cells = []
+        for r in (False, True):
+            counts_r = timing.hist.get((p, r))
+            if counts_r is None or not counts_r.sum():
+                cells.append("-")
+                continue
+            mean, lo, hi = _edge_range(counts_r)
+            cells.append(f"{mean * 100:+.1f} ({lo * 100:+.1f}..{hi * 100:+.1f})")
+        window = f"{timing.hi[p] * 100:.1f}..{(1 + timing.lo[p]) * 100:.1f}%"
+        print(f"  {name:<8} {cells[0]:>20} {cells[1]:>20} {window:>16}")
+        sp = chosen[p]
+        before, after = sp - timing.hi[p], 1 + timing.lo[p] - sp
+        print(f"  {'':<8} margin at {sp * 100:.1f}%: {before * tb * 1e9:.0f} ns after the latest edge, "
+              f"{after * tb * 1e9:.0f} ns before the earliest")
+    print("  Rises later than falls: dominant bits stretched (transceiver loop asymmetry).")
+    print()
+
+    print("[Sample Point]")
+    sp_nominal = args.sample
+    if data and timing.brs_bit:
+        brs = _center(timing.brs_bit)
+        u = brs - td
+        print(f"  BRS bit:        {brs * 1e9:.1f} ns = sp * tn + (1 - spd) * td "
+              f"({len(timing.brs_bit):,} frames)")
+        print(f"  {'Data SP':>10} {'Nominal SP':>12}")
+        for spd in sorted({60.0, 70.0, 75.0, 80.0, args.data_sample}):
+            sp = (u + spd / 100 * td) / tn * 100
+            print(f"  {spd:>9.1f}% {sp:>11.1f}%")
+        sp_nominal = (u + args.data_sample / 100 * td) / tn * 100
+        print(f"  Nominal SP {sp_nominal:.1f}% taken for the BTR candidates (data SP {args.data_sample:.1f}%).")
+    else:
+        print("  Classic frames do not show the sample point on the wire; any point in the")
+        print(f"  usable range works, candidates below use {sp_nominal:.1f}%.")
+    print()
+
+    print("[Oscillator Drift] (bit rate per frame from the transmitter's falling edges, vs nominal)")
+    print_drift(timing, nominal)
+    print()
+
+    print("[BTR Candidates]")
+    if not args.clock:
+        print("  Give --clock (CAN peripheral clock) for BRP/TS1/TS2 candidates.")
+        return 0
+    clock_hz = parse_frequency(args.clock)
+    print_btr(clock_hz, nominal, sp_nominal, "Nominal", args.mcu)
+    if data:
+        print_btr(clock_hz, data, args.data_sample, "Data", args.mcu)
+    return 0
+
+
 def main():
     parser = argparse.ArgumentParser(
         description="CAN Bit Timing Calculator",
@@ -171,18 +991,20 @@ Examples:
   python can_bit_timing.py --clock 36000000 --baud 500000
   python can_bit_timing.py --clock 36M --baud 500k --sample 87.5
   python can_bit_timing.py --clock 48M --baud 1M --mcu stm32
+  python can_bit_timing.py --baud 500k --node BCM:16M --node GW:80M --node ECM:40M:0.3
+  python can_bit_timing.py --baud 500k --data 2M --node GW:80M --node ADAS:40M --cable-length 25
+  python can_bit_timing.py --analyze capture.vcd
+  python can_bit_timing.py --analyze capture.bin --rate 100M --clock 80M
         """
     )
     
     parser.add_argument(
         "--clock", "-c",
-        required=True,
         help="CAN peripheral clock frequency (e.g., 36000000, 36M, 36m)"
     )
     
     parser.add_argument(
         "--baud", "-b",
-        required=True,
         help="Target baud rate (e.g., 500000, 500k, 1M)"
     )
     
@@ -190,7 +1012,14 @@ Examples:
         "--sample", "-s",
         type=float,
         default=87.5,
-        help="Target sample point percentage (default: 87.5)"
+        help="Target sample point percentage (default: 87.5; --node: +/-5%% searched)"
+    )
+    
+    parser.add_argument(
+        "--data-sample",
+        type=float,
+        default=75.0,
+        help="FD data phase sample point percentage (default: 75)"
     )
     
     parser.add_argument(
@@ -206,8 +1035,43 @@ Examples:
         help="Show all valid configurations"
     )
     
+    parser.add_argument(
+        "--analyze",
+        metavar="CAPTURE",
+        help="Infer rates and timing from a CAN_RX capture (.vcd, .csv or raw samples)"
+    )
+    
+    capture = parser.add_argument_group("capture (--analyze)")
+    capture.add_argument("--rate", help="Sample rate of raw/level-only captures (e.g. 100M)")
+    capture.add_argument("--channel", type=int, default=0,
+                         help="Raw: bit of the sample byte; CSV: column after time (default: 0)")
+    capture.add_argument("--signal", help="VCD: signal name (substring)")
+    capture.add_argument("--glitch", type=float, default=0.0,
+                         help="Drop pulses shorter than this many ns (default: off)")
+    
+    network = parser.add_argument_group("network (--node)")
+    network.add_argument("--node", action="append", metavar="NAME:CLOCK[:CTRL][:TOL]",
+                         help="One ECU: CAN clock, controller (bxcan, fdcan), oscillator "
+                              "tolerance %%; repeat per node to solve the network")
+    network.add_argument("--data", help="CAN FD data rate (e.g. 2M)")
+    network.add_argument("--tolerance", type=float, default=0.1,
+                         help="Oscillator tolerance %% of nodes without one (default: 0.1)")
+    network.add_argument("--cable-length", type=float, default=40.0,
+                         help="Bus length in m (default: 40)")
+    network.add_argument("--transceiver-delay", type=float, default=250.0,
+                         help="Transceiver loop delay TXD->RXD in ns, isolators included (default: 250)")
+    
     args = parser.parse_args()
     
+    if args.analyze:
+        return analyze_capture(args)
+    if args.node:
+        if not args.baud:
+            parser.error("--baud is required with --node")
+        return network_timing(args)
+    if not args.clock or not args.baud:
+        parser.error("--clock and --baud are required (or --node ..., --analyze CAPTURE)")
+    
     # Parse input values
     clock_hz = parse_frequency(args.clock)
     target_baud = parse_frequency(args.baud)
@@ -0,0 +1,1061 @@
+#!/usr/bin/env python3
+"""
+CAN Bit-Level Codec
+
+Encodes CAN and CAN FD frames into their exact on-wire bit stream and
+decodes logic analyzer captures of CAN_RX back into frames and errors:
+- encode: SOF to EOF with dynamic stuff bits, CRC-15/17/21, the ISO FD
+  stuff count and fixed stuff bits; field by field listing, optional
+  VCD/CSV waveform (to hold against a scope, or to test the decoder)
+- decode: VCD, CSV (time,level rows, transitions or every sample) or raw
+  binary samples (one byte per sample, --rate, --channel = bit number);
+  raw files are read in chunks and decoded in windows, any length fits
+- Sampling is vectorized over the signal edges, resynchronizing on every
+  recessive to dominant edge (a receiver with unlimited SJW); only the
+  data phase of FD frames with BRS is resampled per frame
+- CRCs are table driven, one byte per step
+- Reports stuff, CRC, stuff count, form and ACK errors with the field
+  and time they occurred in
+
+Frames are written in candump syntax, the fields of CAN_TxMsg_t:
+123#DEADBEEF, 18DAF110#0211, 123#R, 123##1<data> for FD (flags digit:
+1 = BRS, 2 = ESI). Decoded frames print in the same syntax, which
+can_analyzer.py reads; errors print as comment lines.
+
+CAN FD is ISO 11898-1:2015 FD (stuff count, CRC register starting with
+a leading 1, dynamic stuff bits inside the CRC). Non-ISO FD controllers
+decode with CRC errors.
+
+Usage:
+    python can_bitstream.py encode 123#DEADBEEF
+    python can_bitstream.py encode 123##1DEADBEEF --nominal 500k --data 2M --vcd frame.vcd
+    python can_bitstream.py decode capture.vcd --nominal 500k
+    python can_bitstream.py decode capture.csv --nominal 500k --data 2M
+    python can_bitstream.py decode capture.bin --rate 100M --channel 0 --nominal 500k
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+from bisect import bisect_left
+from dataclasses import dataclass, field
+from typing import List, Optional, Tuple
+
+try:
+    import numpy as np
+except ImportError:     # Needed by decode only
+    np = None
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from can_bit_timing import parse_frequency   # noqa: E402
+
+DLC_TO_LEN = (0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64)
+
+# (polynomial without the top bit, width)
+CRC15 = (0x4599, 15)
+CRC17 = (0x1685B, 17)
+CRC21 = (0x102899, 21)
+
+STUFF_COUNT_GRAY = (0b000, 0b001, 0b011, 0b010, 0b110, 0b111, 0b101, 0b100)
+
+# Raw bit kinds in an encoded frame
+DATA_BIT, STUFF_BIT, FIXED_STUFF_BIT = 0, 1, 2
+
+TX_SAMPLE_POINT = 0.80      # encode: transmitter sample point (BRS and CRC delimiter length)
+RX_SAMPLE_POINT = 0.50      # decode: mid-bit, most margin to both edges of a captured bit
+IDLE_BITS = 10              # Recessive bits before a SOF (11, or 10 + SOF in the third intermission bit)
+RAW_CHUNK = 1 << 26         # Samples per step when reading raw captures
+STREAM_BITS = 1 << 22       # Nominal bits per decode window (decode_stream)
+FEW_BITS = 16               # Resampled in a scalar loop (switch back after the CRC delimiter)
+
+_BIT_ASCII = bytes.maketrans(b"\x00\x01", b"01")
+_ASCII_BIT = bytes.maketrans(b"01", b"\x00\x01")
+
+
+def _bit_string(value: int, width: int) -> str:
+    return format(value, f"0{width}b") if width else ""
+
+
+def _crc_table(poly: int, width: int) -> List[int]:
+    top = 1 << (width - 1)
+    mask = (1 << width) - 1
+    table = []
+    for byte in range(256):
+        crc = byte << (width - 8)
+        for _ in range(8):
+            crc = ((crc << 1) ^ poly) & mask if crc & top else (crc << 1) & mask
+        table.append(crc)
+    return table
+
+
+CRC_TABLES = {spec: _crc_table(*spec) for spec in (CRC15, CRC17, CRC21)}
+
+
+def crc_bits(bits, spec: Tuple[int, int], init: int = 0) -> int:
+    """CRC of a bit sequence (bytes of 0/1), MSB first, a table step per 8 bits."""
+    poly, width = spec
+    table = CRC_TABLES[spec]
+    mask = (1 << width) - 1
+    shift = width - 8
+    full = len(bits) & ~7
+    crc = init
+    if full:
+        packed = int(bytes(bits[:full]).translate(_BIT_ASCII), 2).to_bytes(full // 8, "big")
+        for byte in packed:
+            crc = ((crc << 8) & mask) ^ table[((crc >> shift) ^ byte) & 0xFF]
+    for bit in bits[full:]:
+        feedback = ((crc >> (width - 1)) & 1) ^ bit
+        crc = (crc << 1) & mask
+        if feedback:
+            crc ^= poly
+    return crc
+
+
+@dataclass
+class BitFrame:
+    """A frame as CAN_TxMsg_t holds it, plus the FD flags and what decoding saw."""
+    id: int
+    ide: bool = False
+    rtr: bool = False
+    dlc: int = 0
+    data: bytes = b""
+    fd: bool = False
+    brs: bool = False
+    esi: bool = False
+    timestamp: float = 0.0      # SOF
+    crc: int = 0
+    stuff_bits: int = 0         # Dynamic and fixed
+    wire_bits: int = 0          # SOF through EOF
+    duration: float = 0.0       # SOF through EOF (s)
+    ack: bool = True
+
+    def __str__(self) -> str:
+        id_str = f"{self.id:08X}" if self.ide else f"{self.id:03X}"
+        if self.fd:
+            body = f"#{int(self.brs) | (int(self.esi) << 1):X}{self.data.hex().upper()}"
+        elif self.rtr:
+            body = f"R{self.dlc:X}" if self.dlc else "R"
+        else:
+            body = self.data.hex().upper()
+        return f"({self.timestamp:.6f}) can0 {id_str}#{body}"
+
+
+@dataclass
+class BitError:
+    """An error the decoder found; the bus carries an error frame after it."""
+    timestamp: float            # Sample point of the offending bit
+    kind: str                   # stuff, crc, stuff-count, form, ack
+    field: str
+    frame_time: float           # SOF of the broken frame
+    frame_id: Optional[int] = None
+
+    def __str__(self) -> str:
+        frame = f"frame {self.frame_id:X}" if self.frame_id is not None else "frame"
+        return f"# {self.timestamp:.6f} {self.kind} error in {self.field} ({frame} at {self.frame_time:.6f})"
+
+
+@dataclass
+class Encoded:
+    """On-wire bits of one frame, SOF through EOF."""
+    bits: bytearray             # Levels, 0 = dominant
+    kinds: bytearray            # DATA_BIT, STUFF_BIT, FIXED_STUFF_BIT
+    fields: List[Tuple[str, int, int]] = field(default_factory=list)    # name, raw [start, end)
+    brs_bit: int = -1           # Raw index of BRS when the data phase is fast
+    crc_delimiter: int = -1
+    crc: int = 0
+    stuff_count: int = 0        # Dynamic stuff bits
+
+
+def parse_frame_spec(spec: str) -> BitFrame:
+    """Parse candump syntax: ID#DATA, ID#R[dlc], ID##<flags><data> (FD)."""
+    m = re.fullmatch(r"([0-9A-Fa-f]{1,8})#(?:#([0-9A-Fa-f]))?(R[0-9A-Fa-f]?|[0-9A-Fa-f.]*)", spec.strip())
+    if not m:
+        raise ValueError(f"bad frame '{spec}' (expected ID#DATA, ID#R or ID##<flags><data>)")
+    can_id = int(m.group(1), 16)
+    ide = len(m.group(1)) == 8 or can_id > 0x7FF
+    if can_id > (0x1FFFFFFF if ide else 0x7FF):
+        raise ValueError(f"ID {m.group(1)} out of range")
+    frame = BitFrame(id=can_id, ide=ide)
+    body = m.group(3)
+    if m.group(2) is not None:
+        flags = int(m.group(2), 16)
+        frame.fd, frame.brs, frame.esi = True, bool(flags & 1), bool(flags & 2)
+        if body.startswith("R"):
+            raise ValueError("CAN FD has no remote frames")
+    if body.startswith("R"):
+        frame.rtr = True
+        frame.dlc = int(body[1:], 16) if len(body) > 1 else 0
+        return frame
+    data = bytes.fromhex(body.replace(".", ""))
+    if len(data) > (64 if frame.fd else 8):
+        raise ValueError(f"{len(data)} data bytes do not fit a {'FD' if frame.fd else 'classic'} frame")
+    frame.dlc = next(d for d, n in enumerate(DLC_TO_LEN) if n >= len(data))
+    frame.data = data + bytes(DLC_TO_LEN[frame.dlc] - len(data))     # FD padding: 00
+    return frame
+
+
+def _header_fields(frame: BitFrame) -> List[Tuple[str, int, int]]:
+    """(name, value, width) from SOF through the data field."""
+    f = [("SOF", 0, 1)]
+    if frame.ide:
+        f += [("ID", frame.id >> 18, 11), ("SRR", 1, 1), ("IDE", 1, 1), ("ID ext", frame.id & 0x3FFFF, 18)]
+        f += [("RRS", 0, 1), ("FDF", 1, 1), ("res", 0, 1)] if frame.fd else \
+             [("RTR", int(frame.rtr), 1), ("r1", 0, 1), ("r0", 0, 1)]
+    else:
+        f += [("ID", frame.id, 11)]
+        f += [("RRS", 0, 1), ("IDE", 0, 1), ("FDF", 1, 1), ("res", 0, 1)] if frame.fd else \
+             [("RTR", int(frame.rtr), 1), ("IDE", 0, 1), ("r0", 0, 1)]
+    if frame.fd:
+        f += [("BRS", int(frame.brs), 1), ("ESI", int(frame.esi), 1)]
+    f.append(("DLC", frame.dlc, 4))
+    if not frame.rtr:
+        length = DLC_TO_LEN[frame.dlc] if frame.fd else min(frame.dlc, 8)
+        data = frame.data[:length].ljust(length, b"\x00")
+        if length:
+            f.append(("DATA", int.from_bytes(data, "big"), 8 * length))
+    return f
+
+
+def encode_frame(frame: BitFrame, ack: bool = True) -> Encoded:
+    """
+    Bit stream of a frame as it appears on the bus.
+
+    Args:
+        frame: Frame to send (id, ide, rtr, dlc, data, fd, brs, esi)
+        ack: ACK slot dominant (some receiver acknowledged)
+    """
+    enc = Encoded(bits=bytearray(), kinds=bytearray())
+    bits, kinds = enc.bits, enc.kinds
+    run, last = 0, 1
+
+    def stuffed(name: str, value: int, width: int):
+        """Copy the field up to each fifth equal bit (string search), stuff after it."""
+        nonlocal run, last
+        start = len(bits)
+        field_bits = _bit_string(value, width)
+        pos = 0
+        while pos < width:
+            if run == 5:
+                last ^= 1
+                bits.append(last)
+                kinds.append(STUFF_BIT)
+                enc.stuff_count += 1
+                run = 1
+            ahead = "01"[last] * run + field_bits[pos:]
+            ends = [i + 4 for i in (ahead.find("00000"), ahead.find("11111")) if i >= 0]
+            take = min(ends) + 1 - run if ends else width - pos
+            chunk = field_bits[pos:pos + take]
+            bits.extend(chunk.encode().translate(_ASCII_BIT))
+            kinds.extend(bytes(take))
+            pos += take
+            tail = ahead[:run + take]
+            last = int(tail[-1])
+            run = 5 if ends else len(tail) - len(tail.rstrip(tail[-1]))
+        enc.fields.append((name, start, len(bits)))
+
+    def fixed(name: str, value: int, width: int, fixed_every: int = 0):
+        start = len(bits)
+        for i in range(width - 1, -1, -1):
+            if fixed_every and i != width - 1 and (width - 1 - i) % fixed_every == 0:
+                bits.append(bits[-1] ^ 1)
+                kinds.append(FIXED_STUFF_BIT)
+            bits.append((value >> i) & 1)
+            kinds.append(DATA_BIT)
+        enc.fields.append((name, start, len(bits)))
+
+    header = _header_fields(frame)
+    for name, value, width in header:
+        stuffed(name, value, width)
+        if name == "BRS" and frame.brs:
+            enc.brs_bit = len(bits) - 1
+
+    if not frame.fd:
+        destuffed = "".join(_bit_string(value, width) for _, value, width in header)
+        enc.crc = crc_bits(destuffed.encode().translate(_ASCII_BIT), CRC15)
+        stuffed("CRC", enc.crc, 15)
+        if run == 5:                            # Stuffing covers the CRC sequence too
+            bits.append(last ^ 1)
+            kinds.append(STUFF_BIT)
+            enc.stuff_count += 1
+            enc.fields[-1] = ("CRC", enc.fields[-1][1], len(bits))
+    else:
+        count = enc.stuff_count % 8
+        gray = STUFF_COUNT_GRAY[count]
+        parity = bin(gray).count("1") & 1
+        spec = CRC17 if len(frame.data) <= 16 else CRC21
+        covered = bytes(bits) + bytes(((gray >> 2) & 1, (gray >> 1) & 1, gray & 1, parity))
+        enc.crc = crc_bits(covered, spec, 1 << (spec[1] - 1))
+        bits.append(bits[-1] ^ 1)               # Fixed stuff bit before the stuff count
+        kinds.append(FIXED_STUFF_BIT)
+        fixed("Stuff count", (gray << 1) | parity, 4)
+        enc.fields[-1] = ("Stuff count", enc.fields[-1][1] - 1, len(bits))
+        bits.append(bits[-1] ^ 1)
+        kinds.append(FIXED_STUFF_BIT)
+        fixed("CRC", enc.crc, spec[1], fixed_every=4)
+        enc.fields[-1] = ("CRC", enc.fields[-1][1] - 1, len(bits))
+
+    fixed("CRC del", 1, 1)
+    enc.crc_delimiter = len(bits) - 1
+    fixed("ACK", 0 if ack else 1, 1)
+    fixed("ACK del", 1, 1)
+    fixed("EOF", 0x7F, 7)
+    return enc
+
+
+def bit_durations(enc: Encoded, nominal: float, data: Optional[float] = None,
+                  sample_point: float = TX_SAMPLE_POINT,
+                  data_sample_point: Optional[float] = None) -> List[float]:
+    """Length (s) of each raw bit: BRS and CRC delimiter switch rate at their sample point."""
+    tn = 1.0 / nominal
+    td = 1.0 / data if data else tn
+    spd = sample_point if data_sample_point is None else data_sample_point
+    durations = [tn] * len(enc.bits)
+    if enc.brs_bit >= 0:
+        for i in range(enc.brs_bit + 1, enc.crc_delimiter):
+            durations[i] = td
+        durations[enc.brs_bit] = sample_point * tn + (1.0 - spd) * td
+        durations[enc.crc_delimiter] = spd * td + (1.0 - sample_point) * tn
+    return durations
+
+
+def waveform(frames: List[Tuple[BitFrame, Encoded]], nominal: float, data: Optional[float] = None,
+             sample_point: float = TX_SAMPLE_POINT, data_sample_point: Optional[float] = None,
+             idle_bits: int = 11, gap_bits: int = 3) -> Tuple[List[Tuple[float, int]], float]:
+    """
+    Edges (time, level) of frames sent back to back.
+
+    Starts with idle_bits of idle bus, then one frame after the other with
+    gap_bits (intermission) between them; sets each frame's timestamp.
+    """
+    tn = 1.0 / nominal
+    t = idle_bits * tn
+    level = 1
+    edges = [(0.0, 1)]
+    for frame, enc in frames:
+        frame.timestamp = t
+        for bit, dt in zip(enc.bits, bit_durations(enc, nominal, data, sample_point, data_sample_point)):
+            if bit != level:
+                edges.append((t, bit))
+                level = bit
+            t += dt
+        t += gap_bits * tn
+    return edges, t
+
+
+def write_vcd(path: str, edges: List[Tuple[float, int]], end: float, name: str = "CAN_RX"):
+    """Single-wire VCD, 1 ps resolution."""
+    with open(path, "w") as f:
+        f.write("$timescale 1ps $end\n$scope module can $end\n")
+        f.write(f"$var wire 1 ! {name} $end\n$upscope $end\n$enddefinitions $end\n")
+        for t, level in edges:
+            f.write(f"#{round(t * 1e12)}\n{level}!\n")
+        f.write(f"#{round(end * 1e12)}\n")
+
+
+def write_csv(path: str, edges: List[Tuple[float, int]], end: float):
+    """Transitions as time,level rows (logic analyzer export format)."""
+    with open(path, "w") as f:
+        f.write("Time [s],CAN_RX\n")
+        for t, level in edges:
+            f.write(f"{t:.12f},{level}\n")
+        f.write(f"{end:.12f},1\n")
+
+
+def describe(frame: BitFrame, enc: Encoded, nominal: float, data: Optional[float],
+             sample_point: float = TX_SAMPLE_POINT, data_sample_point: Optional[float] = None) -> str:
+    """Field by field bit listing; [x] = dynamic stuff bit, {x} = fixed stuff bit."""
+    lines = [f"Frame:          {frame}", f"{'Field':<12} Bits"]
+    for name, a, b in enc.fields:
+        text = "".join(str(enc.bits[i]) if enc.kinds[i] == DATA_BIT else
+                       (f"[{enc.bits[i]}]" if enc.kinds[i] == STUFF_BIT else f"{{{enc.bits[i]}}}")
+                       for i in range(a, b))
+        lines.append(f"{name:<12} {text}")
+    fixed = sum(1 for k in enc.kinds if k == FIXED_STUFF_BIT)
+    duration = sum(bit_durations(enc, nominal, data, sample_point, data_sample_point))
+    lines += ["",
+              f"CRC:            0x{enc.crc:X}",
+              f"Stuff bits:     {enc.stuff_count} dynamic, {fixed} fixed",
+              f"Bits on wire:   {len(enc.bits)} (SOF to EOF, + 3 intermission)",
+              f"Duration:       {duration * 1e6:.2f} us"]
+    return "\n".join(lines)
+
+
+# ============================================================================
+# Decoder
+# ============================================================================
+
+@dataclass
+class Capture:
+    """CAN_RX as edges: the level changes to levels[i] at times[i]."""
+    times: "np.ndarray"
+    levels: "np.ndarray"
+    start: float
+    end: float
+    initial: int                # Level before the first edge
+
+
+def _edges(times, values, start: float, end: float) -> Capture:
+    values = (np.asarray(values) != 0).astype(np.uint8)
+    times = np.asarray(times, dtype=np.float64)
+    if len(values) == 0:
+        return Capture(times, values, start, end, 1)
+    change = np.flatnonzero(np.diff(values)) + 1
+    return Capture(times[change], values[change], start, end, int(values[0]))
+
+
+def load_vcd(path: str, signal: Optional[str] = None) -> Capture:
+    """One 1-bit wire of a VCD file (first one, or the first whose name contains signal)."""
+    with open(path, "rb") as f:
+        text = f.read()
+    head_end = text.find(b"$enddefinitions")
+    if head_end < 0:
+        raise ValueError("no $enddefinitions, not a VCD file")
+    head = text[:head_end].decode(errors="replace")
+    m = re.search(r"\$timescale\s+(\d+)\s*(s|ms|us|ns|ps|fs)\s+\$end", head)
+    scale = int(m.group(1)) * {"s": 1, "ms": 1e-3, "us": 1e-6, "ns": 1e-9, "ps": 1e-12, "fs": 1e-15}[m.group(2)] \
+        if m else 1e-9
+    wires = re.findall(r"\$var\s+\w+\s+1\s+(\S+)\s+(\S+)", head)
+    if signal:
+        wires = [w for w in wires if signal.lower() in w[1].lower()]
+    if not wires:
+        raise ValueError(f"no 1-bit signal{' matching ' + signal if signal else ''} in {path}")
+    code = wires[0][0].encode()
+    token = re.compile(rb"#(\d+)|(?<!\S)([01xXzZ])" + re.escape(code) + rb"(?!\S)")
+    times, values = [], []
+    now = 0
+    for m in token.finditer(text, head_end):
+        if m.group(1) is not None:
+            now = int(m.group(1))
+        else:
+            times.append(now)
+            values.append(0 if m.group(2) == b"0" else 1)     # x/z: released bus, recessive
+    last = now
+    values_np = np.array(values, dtype=np.uint8)
+    times_np = np.array(times, dtype=np.float64) * scale
+    if len(times_np) == 0:
+        raise ValueError(f"signal {wires[0][1]} never changes")
+    return _edges(times_np, values_np, times_np[0], max(last * scale, times_np[-1]))
+
+
+def load_csv(path: str, rate: Optional[float] = None, channel: int = 0) -> Capture:
+    """time,level rows (transitions or every sample), or level-only rows with --rate."""
+    skip = 0
+    with open(path) as f:
+        for line in f:
+            cells = line.replace(";", ",").split(",")
+            try:
+                float(cells[0])
+                break
+            except ValueError:
+                skip += 1
+        delimiter = ";" if ";" in line and "," not in line else ","
+    rows = np.loadtxt(path, delimiter=delimiter, skiprows=skip, ndmin=2)
+    if rows.shape[1] == 1 or rate:
+        if not rate:
+            raise ValueError("CSV without a time column needs --rate")
+        values = rows[:, min(channel, rows.shape[1] - 1)]
+        times = np.arange(len(values)) / rate
+        return _edges(times, values, 0.0, len(values) / rate)
+    return _edges(rows[:, 0], rows[:, 1 + channel], rows[0, 0], rows[-1, 0])
+
+
+def iter_raw(path: str, rate: float, channel: int = 0):
+    """
+    One byte per sample (sigrok/analyzer binary export), CAN_RX in bit channel.
+
+    Yields one Capture per RAW_CHUNK samples, so a long capture never has
+    to fit in memory as a whole.
+    """
+    if os.path.getsize(path) == 0:
+        raise ValueError(f"{path}: empty capture")
+    raw = np.memmap(path, dtype=np.uint8, mode="r")
+    mask = np.uint8(1 << channel)
+    prev = raw[0] & mask
+    for off in range(0, len(raw), RAW_CHUNK):
+        level = raw[off:off + RAW_CHUNK] & mask
+        change = np.flatnonzero(level[1:] != level[:-1]) + (off + 1)
+        if level[0] != prev:
+            change = np.concatenate(([off], change))
+        initial = int(prev != 0)
+        levels = np.empty(len(change), np.uint8)
+        levels[0::2] = initial ^ 1
+        levels[1::2] = initial
+        yield Capture(change / rate, levels, off / rate, (off + len(level)) / rate, initial)
+        prev = level[-1]
+
+
+def load_raw(path: str, rate: float, channel: int = 0) -> Capture:
+    """The whole raw capture as one Capture."""
+    pieces = list(iter_raw(path, rate, channel))
+    return Capture(np.concatenate([c.times for c in pieces]), np.concatenate([c.levels for c in pieces]),
+                   pieces[0].start, pieces[-1].end, pieces[0].initial)
+
+
+def slice_capture(cap: Capture, start: float, end: float) -> Capture:
+    """The edges in [start, end), with the level at start."""
+    i, j = np.searchsorted(cap.times, (start, end))
+    initial = int(cap.levels[i - 1]) if i else cap.initial
+    return Capture(cap.times[i:j], cap.levels[i:j], start, end, initial)
+
+
+def deglitch(cap: Capture, min_pulse: float) -> Capture:
+    """Drop pulses shorter than min_pulse (both edges), e.g. ringing on a slow edge."""
+    if min_pulse <= 0 or len(cap.times) < 2:
+        return cap
+    keep = np.ones(len(cap.times), bool)
+    for i in np.flatnonzero(np.diff(cap.times) < min_pulse):
+        if keep[i] and keep[i + 1]:
+            keep[i] = keep[i + 1] = False
+    return Capture(cap.times[keep], cap.levels[keep], cap.start, cap.end, cap.initial)
+
+
+def sample_bits(cap: Capture, after: float, start: float, level: int, tbit: float, sp: float,
+                count: Optional[int] = None) -> Tuple["np.ndarray", "np.ndarray"]:
+    """
+    Sample the capture like a CAN receiver.
+
+    The next bit begins at start (its sample point at start + sp * tbit);
+    every recessive to dominant edge after 'after' restarts the bit grid.
+    level is the bus level at 'after'. Returns (levels, sample times) of
+    count bits, or of all bits to the end of the capture.
+    """
+    t, v = cap.times, cap.levels
+    j = int(np.searchsorted(t, after, side="right"))
+    if count is not None and count <= FEW_BITS:
+        return _sample_few(cap, j, start, level, tbit, sp, count)
+    width = len(t) - j if count is None else count + 8
+    while True:
+        e = t[j:j + width]
+        lv = v[j:j + width]
+        cut = j + width < len(t)
+        falls = e[lv == 0]
+        starts = np.concatenate(([start], falls))
+        ends = np.concatenate((falls, [e[-1] if cut else cap.end]))
+        n_tot = np.maximum(np.ceil((ends - starts) / tbit - sp), 0).astype(np.int64)
+        total = int(n_tot.sum())
+        if count is not None and total < count and cut:
+            width *= 2
+            continue
+        if count is not None:
+            total = min(total, count)
+        seg = np.repeat(np.arange(len(starts)), n_tot)[:total]
+        first = np.cumsum(n_tot) - n_tot
+        times = starts[seg] + (np.arange(total) - first[seg] + sp) * tbit
+        if not len(e):
+            return np.full(total, level, np.uint8), times
+        k = np.searchsorted(e, times, side="right") - 1
+        bits = np.where(k >= 0, lv[np.maximum(k, 0)], level).astype(np.uint8)
+        return bits, times
+
+
+def _sample_few(cap: Capture, j: int, start: float, level: int, tbit: float, sp: float,
+                count: int) -> Tuple["np.ndarray", "np.ndarray"]:
+    """sample_bits for a few bits (edges from index j); numpy setup would dominate."""
+    t, v = cap.times, cap.levels
+    bits, times = [], []
+    ts = start + sp * tbit
+    while len(bits) < count and ts < cap.end:
+        while j < len(t) and t[j] <= ts:
+            level = int(v[j])
+            if level == 0:
+                ts = t[j] + sp * tbit
+            j += 1
+        if ts >= cap.end:
+            break
+        bits.append(level)
+        times.append(ts)
+        ts += tbit
+    return np.array(bits, np.uint8), np.array(times)
+
+
+class _FrameError(Exception):
+    def __init__(self, kind: str, field_name: str, index: int):
+        super().__init__(kind)
+        self.kind = kind
+        self.field = field_name
+        self.index = index
+
+
+def stuff_marks(bits: "np.ndarray") -> List[int]:
+    """Indexes that complete a run of five equal bits; the bit after each is a stuff bit."""
+    if len(bits) < 5:
+        return []
+    idx = np.arange(len(bits))
+    change = np.concatenate(([True], bits[1:] != bits[:-1]))
+    run = idx - np.maximum.accumulate(np.where(change, idx, 0)) + 1
+    return np.flatnonzero(run == 5).tolist()
+
+
+class _Reader:
+    """
+    Raw bits of one frame with destuffing; the source changes at rate switches.
+
+    Stuff bit positions come from the run table of the whole source
+    (stuff_marks), so data is read in slices between them. The table only
+    applies after a level change inside the frame: the run before SOF or
+    a rate switch is not the frame's, those bits go through the bit loop.
+    """
+
+    def __init__(self, bits: bytes, times, marks: Optional[List[int]], pos: int):
+        self.bits = bits
+        self.times = times
+        self.marks = marks
+        self.pos = pos
+        self.synced = False
+        self.run = 0
+        self.last = 1
+        self.dynamic = 0
+        self.fixed_stuffs = 0
+        self.wire_bits = 0
+        self.destuffed = bytearray()    # CRC input, classic
+        self.raw = bytearray()          # CRC input, FD (dynamic stuff bits included)
+
+    def switch(self, bits: bytes, times):
+        self.bits, self.times, self.marks, self.pos = bits, times, None, 0
+        self.synced = False
+
+    def time(self, index: Optional[int] = None) -> float:
+        return float(self.times[self.pos - 1 if index is None else index])
+
+    def read(self, n: int, name: str) -> int:
+        """n destuffed bits as an integer, MSB first."""
+        value = 0
+        while n and not self.synced:
+            value = (value << 1) | self._read_bit(name)
+            n -= 1
+        if not n:
+            return value
+        if self.marks is None:
+            self.marks = stuff_marks(np.frombuffer(self.bits, np.uint8))
+        bits, p, marks = self.bits, self.pos, self.marks
+        end = len(bits)
+        out = bytearray()
+        while n:
+            k = bisect_left(marks, p - 1)
+            s = marks[k] + 1 if k < len(marks) else end + n
+            if s >= p + n:
+                if p + n > end:
+                    raise _FrameError("truncated", name, end - 1)
+                out += bits[p:p + n]
+                p += n
+                break
+            out += bits[p:s]
+            n -= s - p
+            if s >= end:
+                raise _FrameError("truncated", name, end - 1)
+            if bits[s] == bits[s - 1]:
+                raise _FrameError("stuff", name, s)
+            self.dynamic += 1
+            p = s + 1
+        self.raw += bits[self.pos:p]
+        self.destuffed += out
+        self.wire_bits += p - self.pos
+        self.pos = p
+        self.last = bits[p - 1]
+        self.run = self._run_at(p - 1)
+        return (value << len(out)) | int(out.translate(_BIT_ASCII), 2)
+
+    def _run_at(self, i: int) -> int:
+        """Run length ending at bit i (synced, so at most five)."""
+        bits, b, j = self.bits, self.bits[i], i
+        while j > 0 and bits[j - 1] == b and i - j < 4:
+            j -= 1
+        return i - j + 1
+
+    def _read_bit(self, name: str) -> int:
+        bits, p = self.bits, self.pos
+        if p >= len(bits):
+            raise _FrameError("truncated", name, p - 1)
+        b = bits[p]
+        p += 1
+        if self.run == 5:
+            if b == self.last:
+                raise _FrameError("stuff", name, p - 1)
+            self.raw.append(b)
+            self.dynamic += 1
+            self.run, self.last, self.synced = 1, b, True
+            if p >= len(bits):
+                raise _FrameError("truncated", name, p - 1)
+            b = bits[p]
+            p += 1
+        if b == self.last:
+            self.run += 1
+        else:
+            self.run, self.last, self.synced = 1, b, True
+        self.destuffed.append(b)
+        self.raw.append(b)
+        self.wire_bits += p - self.pos
+        self.pos = p
+        return b
+
+    def stuff_tail(self, name: str):
+        """Classic: a stuff bit after the CRC sequence when it ends in five equal bits."""
+        if self.run == 5:
+            b = self.fixed(1, name)
+            if b == self.last:
+                raise _FrameError("stuff", name, self.pos - 1)
+            self.dynamic += 1
+
+    def fixed(self, n: int, name: str, expect: Optional[int] = None) -> int:
+        """n raw bits (no destuffing); expect: required level of each."""
+        p = self.pos
+        chunk = self.bits[p:p + n]
+        if expect is not None:
+            bad = chunk.find(expect ^ 1)
+            if bad >= 0:
+                raise _FrameError("form", name, p + bad)
+        if len(chunk) < n:
+            raise _FrameError("truncated", name, len(self.bits) - 1)
+        self.pos = p + n
+        self.wire_bits += n
+        return int(chunk.translate(_BIT_ASCII), 2)
+
+    def fixed_stuff(self, name: str):
+        """FD fixed stuff bit: the complement of the bit before it."""
+        previous = self.bits[self.pos - 1]
+        if self.fixed(1, name) == previous:
+            raise _FrameError("form", name, self.pos - 1)
+        self.fixed_stuffs += 1
+
+
+class Decoder:
+    """
+    Frames and errors of a capture at given nominal / data bit rates.
+
+    The decoder samples every bit in its middle (RX_SAMPLE_POINT);
+    sample_point / data_sample_point are the network's, they place the
+    bit rate switches in BRS and the CRC delimiter.
+    """
+
+    def __init__(self, cap: Capture, nominal: float, data: Optional[float] = None,
+                 sample_point: float = TX_SAMPLE_POINT, data_sample_point: Optional[float] = None,
+                 idle_at_start: bool = True):
+        self.cap = cap
+        self.idle_at_start = idle_at_start    # A fall right after the start may be a SOF
+        self.tn = 1.0 / nominal
+        self.td = 1.0 / data if data else self.tn
+        self.spn = sample_point
+        self.spd = sample_point if data_sample_point is None else data_sample_point
+        self.frames: List[BitFrame] = []
+        self.errors: List[BitError] = []
+        self.truncated = 0
+        self.resume = float("inf")     # SOF of the frame cut by the end of the capture
+
+    def run(self):
+        bits, times = sample_bits(self.cap, self.cap.start, self.cap.start, self.cap.initial,
+                                  self.tn, RX_SAMPLE_POINT)
+        self.bits = bits.tobytes()
+        self.times = times
+        self.marks = stuff_marks(bits)
+        sof = self._sof_candidates(bits)
+        sof_times = times[sof]
+        k = 0
+        while k < len(sof):
+            end_time = self._decode_at(int(sof[k]))
+            k = max(k + 1, int(np.searchsorted(sof_times, end_time, side="right")))
+        return self
+
+    def _sof_candidates(self, b) -> "np.ndarray":
+        """Dominant bits after at least IDLE_BITS recessive ones (or the capture start)."""
+        if len(b) < 2:
+            return np.zeros(0, np.int64)
+        falls = np.flatnonzero((b[1:] == 0) & (b[:-1] == 1)) + 1
+        rises = np.flatnonzero((b[1:] == 1) & (b[:-1] == 0)) + 1
+        k = np.searchsorted(rises, falls) - 1
+        idle_from = rises[np.maximum(k, 0)] if len(rises) else np.zeros(len(falls), np.int64)
+        from_start = (k < 0) & (b[0] == 1) & (self.idle_at_start | (falls >= IDLE_BITS))
+        return falls[((k >= 0) & (falls - idle_from >= IDLE_BITS)) | from_start]
+
+    def _switch(self, rd: _Reader, t_from: float, sp_from: float, to_data: bool, count: int):
+        """Resample from the rate switch inside the bit just read."""
+        ts = rd.time()
+        bit_start = ts - RX_SAMPLE_POINT * t_from
+        if to_data:
+            nxt = bit_start + self.spn * self.tn + (1.0 - self.spd) * self.td
+            tbit = self.td
+        else:
+            nxt = bit_start + self.spd * self.td + (1.0 - self.spn) * self.tn
+            tbit = self.tn
+        bits, times = sample_bits(self.cap, ts, nxt, rd.bits[rd.pos - 1], tbit, RX_SAMPLE_POINT, count)
+        rd.switch(bits.tobytes(), times)
+
+    def _decode_at(self, sof: int) -> float:
+        """Decode the frame starting at raw bit sof; returns where the next one may start."""
+        rd = _Reader(self.bits, self.times, self.marks, sof)
+        t0 = float(self.times[sof]) - RX_SAMPLE_POINT * self.tn
+        frame = BitFrame(id=0, timestamp=t0)
+        known_id = None
+        length = 0
+        try:
+            rd.read(1, "SOF")
+            base = rd.read(11, "ID")
+            rtr_std = rd.read(1, "RTR")
+            frame.ide = bool(rd.read(1, "IDE"))
+            if frame.ide:
+                frame.id = (base << 18) | rd.read(18, "ID ext")
+                frame.rtr = bool(rd.read(1, "RTR"))
+            else:
+                frame.id = base
+                frame.rtr = bool(rtr_std)
+            known_id = frame.id
+            frame.fd = bool(rd.read(1, "FDF"))
+            if frame.fd:
+                frame.rtr = False
+                if rd.read(1, "res"):
+                    raise _FrameError("form", "res", rd.pos - 1)
+                frame.brs = bool(rd.read(1, "BRS"))
+                if frame.brs:
+                    self._switch(rd, self.tn, self.spn, True, 720)
+                frame.esi = bool(rd.read(1, "ESI"))
+            elif frame.ide:
+                rd.read(1, "r0")
+            frame.dlc = rd.read(4, "DLC")
+            length = 0 if frame.rtr else (DLC_TO_LEN[frame.dlc] if frame.fd else min(frame.dlc, 8))
+            if length:
+                frame.data = rd.read(8 * length, "DATA").to_bytes(length, "big")
+
+            if not frame.fd:
+                covered = bytes(rd.destuffed)
+                frame.crc = rd.read(15, "CRC")
+                rd.stuff_tail("CRC")
+                if crc_bits(covered, CRC15) != frame.crc:
+                    raise _FrameError("crc", "CRC", rd.pos - 1)
+            else:
+                covered = bytes(rd.raw)
+                rd.fixed_stuff("Stuff count")
+                count = rd.fixed(4, "Stuff count")
+                gray, parity = count >> 1, count & 1
+                rd.fixed_stuff("Stuff count")
+                spec = CRC17 if length <= 16 else CRC21
+                crc = rd.fixed(4, "CRC")
+                for i in range(4, spec[1], 4):
+                    rd.fixed_stuff("CRC")
+                    k = min(4, spec[1] - i)
+                    crc = (crc << k) | rd.fixed(k, "CRC")
+                frame.crc = crc
+                if bin(gray).count("1") & 1 != parity or STUFF_COUNT_GRAY[rd.dynamic % 8] != gray:
+                    raise _FrameError("stuff-count", "Stuff count", rd.pos - 1)
+                covered += bytes(((gray >> 2) & 1, (gray >> 1) & 1, gray & 1, parity))
+                if crc_bits(covered, spec, 1 << (spec[1] - 1)) != crc:
+                    raise _FrameError("crc", "CRC", rd.pos - 1)
+
+            rd.fixed(1, "CRC del", expect=1)
+            if frame.brs:
+                self._switch(rd, self.td, self.spd, False, 9)
+            frame.ack = rd.fixed(1, "ACK") == 0
+            if not frame.ack:
+                raise _FrameError("ack", "ACK", rd.pos - 1)
+            rd.fixed(1, "ACK del", expect=1)
+            rd.fixed(7, "EOF", expect=1)
+        except _FrameError as e:
+            if e.kind == "truncated":
+                self.truncated += 1
+                self.resume = t0
+                return float("inf")
+            t = rd.time(min(max(e.index, 0), len(rd.times) - 1))
+            self.errors.append(BitError(timestamp=t, kind=e.kind, field=e.field,
+                                        frame_time=t0, frame_id=known_id))
+            return t
+
+        end = rd.time() + (1.0 - RX_SAMPLE_POINT) * self.tn
+        frame.duration = end - t0
+        frame.stuff_bits = rd.dynamic + rd.fixed_stuffs
+        frame.wire_bits = rd.wire_bits
+        self.frames.append(frame)
+        return end
+
+
+def iter_capture(path: str, rate: Optional[float], channel: int, signal: Optional[str],
+                 glitch: float = 0.0):
+    """Captures in pieces: raw files streamed chunk by chunk, VCD/CSV in one piece."""
+    ext = os.path.splitext(path)[1].lower()
+    if ext == ".vcd":
+        pieces = [load_vcd(path, signal)]
+    elif ext in (".csv", ".txt"):
+        pieces = [load_csv(path, rate, channel)]
+    elif not rate:
+        raise ValueError("raw sample files need --rate")
+    else:
+        pieces = iter_raw(path, rate, channel)
+    for cap in pieces:
+        yield deglitch(cap, glitch)
+
+
+def decode_stream(pieces, nominal: float, data: Optional[float] = None,
+                  sample_point: float = TX_SAMPLE_POINT, data_sample_point: Optional[float] = None,
+                  window_bits: int = STREAM_BITS):
+    """
+    Decode a capture piece by piece; yields (capture, Decoder) per window.
+
+    Windows are at most window_bits nominal bits long, so the sampled bits
+    stay small whatever the capture length. A frame cut by the end of a
+    window is decoded again with the next one (its Decoder does not count
+    it as truncated).
+    """
+    tn = 1.0 / nominal
+
+    def windows():
+        for piece in pieces:
+            t = piece.start
+            while t < piece.end:
+                yield slice_capture(piece, t, min(t + window_bits * tn, piece.end))
+                t += window_bits * tn
+
+    carry = None
+    it = windows()
+    cur = next(it, None)
+    while cur is not None:
+        nxt = next(it, None)
+        cap = cur if carry is None else Capture(np.concatenate((carry.times, cur.times)),
+                                                np.concatenate((carry.levels, cur.levels)),
+                                                carry.start, cur.end, carry.initial)
+        dec = Decoder(cap, nominal, data, sample_point, data_sample_point, carry is None).run()
+        carry = None
+        if nxt is not None:
+            carry = slice_capture(cap, max(min(dec.resume, cap.end) - (IDLE_BITS + 2) * tn, cap.start), cap.end)
+            dec.truncated = 0
+        yield cap, dec
+        cur = nxt
+
+
+@dataclass
+class DecodeStats:
+    """Totals of a streamed decode."""
+    start: float = float("inf")
+    end: float = float("-inf")
+    edges: int = 0
+    frames: int = 0
+    fd_frames: int = 0
+    busy: float = 0.0           # Sum of frame durations (s)
+    errors: dict = field(default_factory=dict)
+    truncated: int = 0
+
+    def count(self, pieces):
+        """Pass pieces through, counting edges and span."""
+        for cap in pieces:
+            self.start = min(self.start, cap.start)
+            self.end = max(self.end, cap.end)
+            self.edges += len(cap.times)
+            yield cap
+
+    def add(self, dec: "Decoder"):
+        self.frames += len(dec.frames)
+        self.fd_frames += sum(f.fd for f in dec.frames)
+        self.busy += sum(f.duration for f in dec.frames)
+        for e in dec.errors:
+            self.errors[e.kind] = self.errors.get(e.kind, 0) + 1
+        self.truncated += dec.truncated
+
+
+def print_decode_summary(path: str, st: DecodeStats, nominal: int, data: Optional[int], elapsed: float):
+    span = st.end - st.start
+    print("CAN Bit-Level Decoder")
+    print("=" * 40)
+    print(f"Capture:         {path} ({span:.6f} s, {st.edges:,} edges)")
+    rates = f"{nominal:,}" + (f" / {data:,}" if data else "")
+    print(f"Bit rate:        {rates} bit/s")
+    print(f"Frames:          {st.frames:,} ({st.fd_frames:,} FD)")
+    print(f"Errors:          {sum(st.errors.values()):,}" +
+          (f" ({', '.join(f'{k} {n}' for k, n in sorted(st.errors.items()))})" if st.errors else ""))
+    if st.truncated:
+        print(f"Truncated:       {st.truncated} (capture ends inside a frame)")
+    if span > 0:
+        print(f"Bus load:        {st.busy / span * 100:.1f}%")
+    print(f"Decode time:     {elapsed:.2f} s")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="CAN Bit-Level Codec",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  python can_bitstream.py encode 123#DEADBEEF
+  python can_bitstream.py encode 18DAF110#0211 123##1112233 --nominal 500k --data 2M --vcd out.vcd
+  python can_bitstream.py decode capture.vcd --nominal 500k
+  python can_bitstream.py decode capture.bin --rate 100M --channel 0 --nominal 500k --data 2M
+        """
+    )
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    enc_p = sub.add_parser("encode", help="Bit stream of frames (candump syntax)")
+    enc_p.add_argument("frames", nargs="+", help="ID#DATA, ID#R, ID##<flags><data>")
+    enc_p.add_argument("--no-ack", action="store_true", help="Recessive ACK slot")
+    enc_p.add_argument("--vcd", help="Write the waveform of all frames to a VCD file")
+    enc_p.add_argument("--csv", help="Write the waveform as time,level transitions")
+
+    dec_p = sub.add_parser("decode", help="Frames and errors of a CAN_RX capture")
+    dec_p.add_argument("capture", help=".vcd, .csv or raw samples (one byte each)")
+    dec_p.add_argument("--rate", help="Sample rate of raw/level-only captures (e.g. 100M)")
+    dec_p.add_argument("--channel", type=int, default=0,
+                       help="Raw: bit of the sample byte; CSV: column after time (default: 0)")
+    dec_p.add_argument("--signal", help="VCD: signal name (substring), default first 1-bit wire")
+    dec_p.add_argument("--glitch", type=float, default=0.0,
+                       help="Drop pulses shorter than this many ns (default: off)")
+    dec_p.add_argument("--summary", action="store_true", help="Only the summary, no frame list")
+
+    for p in (enc_p, dec_p):
+        p.add_argument("--nominal", "-n", default="500k", help="Nominal bit rate (default: 500k)")
+        p.add_argument("--data", "-d", help="FD data bit rate (default: nominal)")
+        p.add_argument("--sample-point", type=float, default=TX_SAMPLE_POINT * 100,
+                       help=f"Nominal sample point %% of the network; places the FD rate "
+                            f"switches (default: {TX_SAMPLE_POINT * 100:g})")
+        p.add_argument("--data-sample-point", type=float,
+                       help="FD data phase sample point %% (default: --sample-point)")
+
+    args = parser.parse_args()
+    nominal = parse_frequency(args.nominal)
+    data = parse_frequency(args.data) if args.data else None
+    sp = args.sample_point / 100
+    spd = args.data_sample_point / 100 if args.data_sample_point else None
+
+    if args.command == "encode":
+        try:
+            frames = [parse_frame_spec(s) for s in args.frames]
+        except ValueError as e:
+            print(f"ERROR: {e}")
+            return 1
+        encoded = [(f, encode_frame(f, ack=not args.no_ack)) for f in frames]
+        edges, end = waveform(encoded, nominal, data, sp, spd)
+        for i, (frame, enc) in enumerate(encoded):
+            if i:
+                print()
+            print(describe(frame, enc, nominal, data, sp, spd))
+        if args.vcd:
+            write_vcd(args.vcd, edges, end)
+            print(f"\nWaveform written to {args.vcd}")
+        if args.csv:
+            write_csv(args.csv, edges, end)
+            print(f"\nWaveform written to {args.csv}")
+        return 0
+
+    if np is None:
+        print("ERROR: decode needs numpy")
+        return 1
+    t_start = time.perf_counter()
+    stats = DecodeStats()
+    pieces = iter_capture(args.capture, parse_frequency(args.rate) if args.rate else None,
+                          args.channel, args.signal, args.glitch * 1e-9)
+    try:
+        for _, dec in decode_stream(stats.count(pieces), nominal, data, sp, spd):
+            stats.add(dec)
+            if not args.summary:
+                events = sorted([(f.timestamp, str(f)) for f in dec.frames] +
+                                [(e.timestamp, str(e)) for e in dec.errors])
+                for _, line in events:
+                    print(line)
+    except FileNotFoundError:
+        print(f"ERROR: File not found: {args.capture}")
+        return 1
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return 1
+    if not args.summary:
+        print()
+    print_decode_summary(args.capture, stats, nominal, data, time.perf_counter() - t_start)
+    return 0
+
+if __name__ == "__main__":
+    exit(main())
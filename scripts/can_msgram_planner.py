@@ -0,0 +1,480 @@
+#!/usr/bin/env python3
+"""
+CAN Message RAM Planner (M_CAN / FDCAN)
+
+Plans the message RAM layout of an M_CAN style controller from the
+message set: dedicated RX/TX buffers for critical IDs (Full CAN), RX FIFO
+depths from measured burst lengths (Basic CAN), packed filter elements
+and the TX event FIFO, all within the RAM word budget. Prints the layout,
+the worst-case overrun headroom and the register configuration.
+
+Usage:
+    python can_msgram_planner.py messages.json
+    python can_msgram_planner.py messages.json --ram-words 800 --latency-us 500
+
+Message set (JSON):
+    {
+      "bitrate": 500000,
+      "fd": false,
+      "rx": [
+        {"id": "0x100", "period_ms": 10, "priority": "critical"},
+        {"id": "0x7E0", "burst": 64, "priority": "bulk"},
+        {"id": "0x18FF0010", "ext": true, "period_ms": 100, "dlc": 8}
+      ],
+      "tx": [
+        {"id": "0x200", "period_ms": 10, "priority": "critical"},
+        {"id": "0x7E8"}
+      ]
+    }
+
+priority: "critical" -> dedicated buffer, "normal" -> RX FIFO 0,
+"bulk" (diagnostics, downloads) -> RX FIFO 1.
+burst: frames arriving back to back per occurrence (measured).
+"""
+
+import argparse
+import json
+import math
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+
+# M_CAN element limits
+MAX_STD_FILTERS = 128
+MAX_EXT_FILTERS = 64
+MAX_RX_FIFO = 64
+MAX_RX_BUFFERS = 64
+MAX_TX_EVENTS = 32
+MAX_TX_BUFFERS = 32
+
+# Data field size codes (xxDS): bytes per element payload
+DATA_SIZES = [8, 12, 16, 20, 24, 32, 48, 64]
+
+# Shortest classic frame incl. intermission: highest possible frame rate
+MIN_FRAME_BITS = 47
+
+
+@dataclass
+class Message:
+    """One CAN message of the set."""
+    id: int
+    ext: bool = False
+    dlc: int = 8
+    period_ms: Optional[float] = None   # None: event/diagnostic
+    burst: int = 1
+    priority: str = "normal"            # critical / normal / bulk
+
+    def __str__(self) -> str:
+        return f"{self.id:08X}x" if self.ext else f"{self.id:03X}"
+
+
+@dataclass
+class Region:
+    """One section of message RAM."""
+    name: str
+    start: int              # Word offset
+    elements: int
+    element_words: int
+
+    @property
+    def words(self) -> int:
+        return self.elements * self.element_words
+
+
+@dataclass
+class FifoPlan:
+    """RX FIFO sizing result."""
+    messages: List[Message]
+    needed: int             # Worst-case frames between two services
+    depth: int = 0
+
+    @property
+    def headroom(self) -> int:
+        return self.depth - self.needed
+
+
+@dataclass
+class Plan:
+    """Complete layout."""
+    std_filters: List[Tuple[int, int, int, int]] = field(default_factory=list)
+    ext_filters: List[Tuple[int, int, int, int]] = field(default_factory=list)
+    rx_buffers: List[Message] = field(default_factory=list)
+    fifo0: Optional[FifoPlan] = None
+    fifo1: Optional[FifoPlan] = None
+    tx_buffers: List[Message] = field(default_factory=list)
+    tx_fifo_depth: int = 0
+    tx_events: int = 0
+    rx_data_bytes: int = 8
+    tx_data_bytes: int = 8
+    regions: List[Region] = field(default_factory=list)
+    warnings: List[str] = field(default_factory=list)
+
+    @property
+    def total_words(self) -> int:
+        return sum(r.words for r in self.regions)
+
+
+def parse_id(value) -> int:
+    """Accept 256, "256" or "0x100"."""
+    return int(value, 0) if isinstance(value, str) else int(value)
+
+
+def load_messages(entries: List[Dict], default_dlc: int) -> List[Message]:
+    messages = []
+    for e in entries:
+        messages.append(Message(
+            id=parse_id(e["id"]),
+            ext=bool(e.get("ext", False)),
+            dlc=int(e.get("dlc", default_dlc)),
+            period_ms=e.get("period_ms"),
+            burst=int(e.get("burst", 1)),
+            priority=e.get("priority", "normal"),
+        ))
+    return messages
+
+
+def element_words(data_bytes: int) -> int:
+    """Two header words plus payload words."""
+    return 2 + data_bytes // 4
+
+
+def data_size_code(data_bytes: int) -> int:
+    return DATA_SIZES.index(data_bytes)
+
+
+def round_data_size(max_dlc_bytes: int) -> int:
+    for size in DATA_SIZES:
+        if size >= max_dlc_bytes:
+            return size
+    return 64
+
+
+def frames_in_window(messages: List[Message], window_us: float, frame_us: float) -> int:
+    """
+    Worst-case frames arriving for these messages within one window.
+
+    Every periodic message may land at both window edges (floor + 1);
+    event messages are assumed to send one burst. The result is capped
+    by what the bus can physically carry in the window.
+    """
+    total = 0
+    for m in messages:
+        if m.period_ms:
+            occurrences = int(window_us // (m.period_ms * 1000.0)) + 1
+        else:
+            occurrences = 1
+        total += occurrences * m.burst
+    bus_cap = int(window_us // frame_us) + 1
+    return min(total, bus_cap)
+
+
+def pack_filters(messages: List[Message], target: int) -> List[Tuple[int, int, int, int]]:
+    """
+    Pack IDs into filter elements.
+
+    Returns (kind, target, id1, id2) with M_CAN filter types:
+    0 = range id1..id2, 1 = dual id1 | id2 (kind 2 is used for
+    dedicated RX buffer elements).
+    Consecutive IDs share one range element, remaining IDs are paired.
+    """
+    ids = sorted({m.id for m in messages})
+    elements = []
+    singles = []
+    i = 0
+    while i < len(ids):
+        j = i
+        while j + 1 < len(ids) and ids[j + 1] == ids[j] + 1:
+            j += 1
+        if j - i >= 2:
+            elements.append((0, target, ids[i], ids[j]))
+        else:
+            singles.extend(ids[i:j + 1])
+        i = j + 1
+    for k in range(0, len(singles), 2):
+        pair = singles[k:k + 2]
+        elements.append((1, target, pair[0], pair[-1]))
+    return elements
+
+
+def plan_layout(
+    rx: List[Message],
+    tx: List[Message],
+    ram_words: int,
+    bitrate: int,
+    latency_us: float,
+    margin: float,
+    tx_event_fifo: bool = True,
+) -> Plan:
+    """
+    Build the message RAM layout.
+
+    Args:
+        rx: Received messages
+        tx: Transmitted messages
+        ram_words: Message RAM available to this controller (32-bit words)
+        bitrate: Nominal bit rate (arrival rate bound)
+        latency_us: Worst-case time between two services of a FIFO/buffer
+        margin: Extra FIFO depth above the worst case (0.25 = 25%)
+        tx_event_fifo: Reserve a TX event FIFO for TX timestamps/confirmation
+    """
+    plan = Plan()
+    frame_us = MIN_FRAME_BITS * 1e6 / bitrate
+
+    # Element payload sizes follow the largest frame in each direction
+    plan.rx_data_bytes = round_data_size(max((m.dlc for m in rx), default=8))
+    plan.tx_data_bytes = round_data_size(max((m.dlc for m in tx), default=8))
+
+    # --- RX: Full CAN for critical, single-frame periodic IDs ---
+    fifo0_msgs, fifo1_msgs = [], []
+    for m in sorted(rx, key=lambda m: m.period_ms or math.inf):
+        if m.priority == "critical":
+            if m.burst > 1:
+                plan.warnings.append(
+                    f"{m}: burst {m.burst} cannot use a dedicated buffer, moved to FIFO 0")
+                fifo0_msgs.append(m)
+            elif len(plan.rx_buffers) >= MAX_RX_BUFFERS:
+                plan.warnings.append(f"{m}: no dedicated RX buffer left, moved to FIFO 0")
+                fifo0_msgs.append(m)
+            else:
+                plan.rx_buffers.append(m)
+        elif m.priority == "bulk":
+            fifo1_msgs.append(m)
+        else:
+            fifo0_msgs.append(m)
+
+    for fifo_name, msgs in (("fifo0", fifo0_msgs), ("fifo1", fifo1_msgs)):
+        if not msgs:
+            continue
+        needed = frames_in_window(msgs, latency_us, frame_us)
+        depth = min(MAX_RX_FIFO, max(1, math.ceil(needed * (1.0 + margin))))
+        setattr(plan, fifo_name, FifoPlan(msgs, needed, depth))
+
+    # --- Filters: dedicated buffers need one element each (SFEC = 7) ---
+    for idx, m in enumerate(plan.rx_buffers):
+        entry = (2, 7, m.id, idx)   # kind 2: store into RX buffer idx
+        (plan.ext_filters if m.ext else plan.std_filters).append(entry)
+    for target, msgs in ((1, fifo0_msgs), (2, fifo1_msgs)):
+        plan.std_filters += pack_filters([m for m in msgs if not m.ext], target)
+        plan.ext_filters += pack_filters([m for m in msgs if m.ext], target)
+
+    if len(plan.std_filters) > MAX_STD_FILTERS:
+        plan.warnings.append(f"{len(plan.std_filters)} standard filters exceed {MAX_STD_FILTERS}")
+    if len(plan.ext_filters) > MAX_EXT_FILTERS:
+        plan.warnings.append(f"{len(plan.ext_filters)} extended filters exceed {MAX_EXT_FILTERS}")
+
+    # --- TX: dedicated buffers for critical IDs, queue for the rest ---
+    for m in tx:
+        if m.priority == "critical" and len(plan.tx_buffers) < MAX_TX_BUFFERS - 1:
+            plan.tx_buffers.append(m)
+    others = len(tx) - len(plan.tx_buffers)
+    plan.tx_fifo_depth = min(MAX_TX_BUFFERS - len(plan.tx_buffers), max(others, 3 if others else 0))
+    if tx_event_fifo:
+        plan.tx_events = min(MAX_TX_EVENTS, len(plan.tx_buffers) + plan.tx_fifo_depth)
+
+    _place_regions(plan)
+
+    # --- Fit: trim FIFO margins (bulk first) until the budget holds ---
+    for fifo in (plan.fifo1, plan.fifo0):
+        while fifo is not None and plan.total_words > ram_words and fifo.depth > fifo.needed:
+            fifo.depth -= 1
+            _place_regions(plan)
+    if plan.total_words > ram_words:
+        plan.warnings.append(
+            f"Layout needs {plan.total_words} words, budget is {ram_words}: "
+            "reduce FIFO depths (overrun risk) or payload size")
+    else:
+        # Spend the remaining words on FIFO 0 headroom
+        while plan.fifo0 is not None and plan.fifo0.depth < MAX_RX_FIFO:
+            plan.fifo0.depth += 1
+            _place_regions(plan)
+            if plan.total_words > ram_words:
+                plan.fifo0.depth -= 1
+                _place_regions(plan)
+                break
+
+    return plan
+
+
+def _place_regions(plan: Plan):
+    """Lay the sections out back to back in M_CAN order."""
+    rx_ew = element_words(plan.rx_data_bytes)
+    tx_ew = element_words(plan.tx_data_bytes)
+    sections = [
+        ("Standard filters", len(plan.std_filters), 1),
+        ("Extended filters", len(plan.ext_filters), 2),
+        ("RX FIFO 0", plan.fifo0.depth if plan.fifo0 else 0, rx_ew),
+        ("RX FIFO 1", plan.fifo1.depth if plan.fifo1 else 0, rx_ew),
+        ("RX buffers", len(plan.rx_buffers), rx_ew),
+        ("TX event FIFO", plan.tx_events, 2),
+        ("TX buffers", len(plan.tx_buffers) + plan.tx_fifo_depth, tx_ew),
+    ]
+    plan.regions = []
+    offset = 0
+    for name, count, ew in sections:
+        plan.regions.append(Region(name, offset, count, ew))
+        offset += count * ew
+
+
+def overrun_report(plan: Plan, bitrate: int, latency_us: float) -> List[str]:
+    """Worst-case headroom per receive object."""
+    frame_us = MIN_FRAME_BITS * 1e6 / bitrate
+    lines = []
+    for name, fifo in (("RX FIFO 0", plan.fifo0), ("RX FIFO 1", plan.fifo1)):
+        if fifo is None:
+            continue
+        # Extra service latency tolerated while the bus runs at full rate
+        slack_us = fifo.headroom * frame_us
+        status = "OK" if fifo.headroom >= 0 else "OVERRUN"
+        lines.append(
+            f"{name}: depth {fifo.depth}, worst case {fifo.needed} frames in "
+            f"{latency_us:.0f} us -> headroom {fifo.headroom} frames "
+            f"(+{slack_us:.0f} us latency) {status}")
+    for idx, m in enumerate(plan.rx_buffers):
+        if m.period_ms:
+            slack_us = m.period_ms * 1000.0 - latency_us
+            status = "OK" if slack_us > 0 else "OVERWRITE"
+            lines.append(f"RX buffer {idx} ({m}): period {m.period_ms} ms -> "
+                         f"headroom {slack_us:.0f} us {status}")
+        else:
+            lines.append(f"RX buffer {idx} ({m}): event message, read within "
+                         f"its minimum repetition time")
+    return lines
+
+
+def print_layout(plan: Plan, ram_words: int):
+    print(f"{'Section':<18} {'Start':>6} {'Elems':>6} {'W/elem':>7} {'Words':>6}")
+    print("-" * 47)
+    for r in plan.regions:
+        if r.elements:
+            print(f"{r.name:<18} {r.start:>6} {r.elements:>6} {r.element_words:>7} {r.words:>6}")
+    print("-" * 47)
+    print(f"{'Total':<18} {'':>6} {'':>6} {'':>7} {plan.total_words:>6} / {ram_words}")
+
+
+def generate_register_config(plan: Plan) -> str:
+    """M_CAN register values (addresses relative to the message RAM start)."""
+    r = {reg.name: reg for reg in plan.regions}
+    rx_ds = data_size_code(plan.rx_data_bytes)
+    tx_ds = data_size_code(plan.tx_data_bytes)
+    f0 = plan.fifo0.depth if plan.fifo0 else 0
+    f1 = plan.fifo1.depth if plan.fifo1 else 0
+
+    def addr(name: str) -> str:
+        return f"MSGRAM_OFFSET + 0x{r[name].start * 4:04X}U"
+
+    lines = [
+        "// M_CAN message RAM configuration (generated by can_msgram_planner.py)",
+        "// MSGRAM_OFFSET: byte offset of this controller's RAM section",
+        f"FDCAN->SIDFC = ({addr('Standard filters')}) | ({len(plan.std_filters)}U << 16);",
+        f"FDCAN->XIDFC = ({addr('Extended filters')}) | ({len(plan.ext_filters)}U << 16);",
+        f"FDCAN->RXF0C = ({addr('RX FIFO 0')}) | ({f0}U << 16);  // F0WM = 0: no watermark delay",
+        f"FDCAN->RXF1C = ({addr('RX FIFO 1')}) | ({f1}U << 16);",
+        f"FDCAN->RXBC  = ({addr('RX buffers')});",
+        f"FDCAN->RXESC = ({rx_ds}U << 0) | ({rx_ds}U << 4) | ({rx_ds}U << 8);  // F0DS/F1DS/RBDS",
+        f"FDCAN->TXEFC = ({addr('TX event FIFO')}) | ({plan.tx_events}U << 16);",
+        f"FDCAN->TXBC  = ({addr('TX buffers')}) | ({len(plan.tx_buffers)}U << 16) | "
+        f"({plan.tx_fifo_depth}U << 24);  // TFQM = 0: TX FIFO",
+        f"FDCAN->TXESC = ({tx_ds}U << 0);  // TBDS",
+        "FDCAN->GFC   = (2U << 4) | (2U << 2);  // Reject frames no filter accepts",
+        "",
+    ]
+
+    def std_element(f):
+        kind, target, id1, id2 = f
+        if kind == 2:   # Store into dedicated RX buffer id2
+            return (7 << 27) | (id1 << 16) | id2
+        return (kind << 30) | (target << 27) | (id1 << 16) | id2
+
+    def ext_element(f):
+        kind, target, id1, id2 = f
+        if kind == 2:
+            return ((7 << 29) | id1, id2)
+        return ((target << 29) | id1, (kind << 30) | id2)
+
+    lines.append("static const uint32_t std_filter_elements[] = {")
+    for f in plan.std_filters:
+        lines.append(f"    0x{std_element(f):08X}U,")
+    lines.append("};")
+    lines.append("static const uint32_t ext_filter_elements[][2] = {")
+    for f in plan.ext_filters:
+        f0w, f1w = ext_element(f)
+        lines.append(f"    {{ 0x{f0w:08X}U, 0x{f1w:08X}U }},")
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="M_CAN/FDCAN Message RAM Planner",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  python can_msgram_planner.py messages.json
+  python can_msgram_planner.py messages.json --ram-words 212 --latency-us 1000
+        """
+    )
+
+    parser.add_argument("input", help="Message set (JSON)")
+    parser.add_argument(
+        "--ram-words", "-r",
+        type=int,
+        default=2560,
+        help="Message RAM words for this controller (default: 2560)"
+    )
+    parser.add_argument(
+        "--latency-us", "-l",
+        type=float,
+        default=1000.0,
+        help="Worst-case time between two RX services in us (default: 1000)"
+    )
+    parser.add_argument(
+        "--margin", "-m",
+        type=float,
+        default=25.0,
+        help="FIFO depth margin above worst case in percent (default: 25)"
+    )
+    parser.add_argument(
+        "--no-tx-events",
+        action="store_true",
+        help="Do not reserve a TX event FIFO"
+    )
+
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        spec = json.load(f)
+
+    bitrate = int(spec.get("bitrate", 500000))
+    default_dlc = 64 if spec.get("fd") else 8
+    rx = load_messages(spec.get("rx", []), default_dlc)
+    tx = load_messages(spec.get("tx", []), default_dlc)
+
+    plan = plan_layout(rx, tx, args.ram_words, bitrate, args.latency_us,
+                       args.margin / 100.0, not args.no_tx_events)
+
+    print("CAN Message RAM Planner")
+    print("=" * 47)
+    print(f"RX messages: {len(rx)}  TX messages: {len(tx)}  Bit rate: {bitrate:,} bps")
+    print(f"RX element: {plan.rx_data_bytes} bytes  TX element: {plan.tx_data_bytes} bytes")
+    print()
+    print_layout(plan, args.ram_words)
+    print()
+    print("Worst-Case Overrun Headroom:")
+    print("-" * 20)
+    for line in overrun_report(plan, bitrate, args.latency_us):
+        print(line)
+    print()
+    print("Register Configuration:")
+    print("-" * 20)
+    print(generate_register_config(plan))
+
+    if plan.warnings:
+        print()
+        for w in plan.warnings:
+            print(f"WARNING: {w}")
+
+    return 1 if plan.total_words > args.ram_words else 0
+
+
+if __name__ == "__main__":
+    exit(main())
@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+"""
+CAN Driver Trace Decoder
+
+Decodes a dump of the driver trace ring (CAN_TraceRing_t in
+can-handle.template.h, built with -DCAN_TRACE) into a timeline and
+duration statistics: RX/TX ISR time, callback time, FIFO depth at RX
+ISR entry and TX attempts that found no free mailbox.
+
+Getting a dump:
+    gdb:        dump binary value can1.trc hcan1.trace
+    simulator:  fwrite(&hcan1.trace, sizeof(hcan1.trace), 1, f)
+
+Usage:
+    python can_trace_decode.py can1.trc
+    python can_trace_decode.py can1.trc --timeline 200
+    python can_trace_decode.py can1.trc --cpu-mhz 168
+"""
+
+import argparse
+import struct
+from dataclasses import dataclass
+from typing import Dict, List, Optional, Tuple
+
+TRACE_MAGIC = 0x43525443        # "CTRC"
+HEADER = struct.Struct("<IHBBII")   # magic, size, index, version, cycles_per_us, head
+RECORD = struct.Struct("<IBBH")     # cycles, event, arg8, arg16
+
+# CAN_TraceEvent_t
+RX_ISR_ENTER, RX_ISR_EXIT, RX_CB_ENTER, RX_CB_EXIT = 1, 2, 3, 4
+TX_ISR_ENTER, TX_ISR_EXIT, TX_CB_ENTER, TX_CB_EXIT = 5, 6, 7, 8
+TX_MAILBOX = 9
+
+EVENT_NAMES = {
+    RX_ISR_ENTER: "RX ISR >", RX_ISR_EXIT: "RX ISR <",
+    RX_CB_ENTER: "RX cb >", RX_CB_EXIT: "RX cb <",
+    TX_ISR_ENTER: "TX ISR >", TX_ISR_EXIT: "TX ISR <",
+    TX_CB_ENTER: "TX cb >", TX_CB_EXIT: "TX cb <",
+    TX_MAILBOX: "TX mailbox",
+}
+
+# exit event -> (enter event, span name)
+SPANS = {
+    RX_ISR_EXIT: (RX_ISR_ENTER, "RX ISR"),
+    TX_ISR_EXIT: (TX_ISR_ENTER, "TX ISR"),
+    RX_CB_EXIT: (RX_CB_ENTER, "RX callback"),
+    TX_CB_EXIT: (TX_CB_ENTER, "TX callback"),
+}
+
+
+@dataclass
+class TraceRecord:
+    """One decoded trace point."""
+    time_us: float          # Since the oldest record in the ring
+    event: int
+    arg8: int
+    arg16: int
+    depth: int = 0          # Nesting level in the timeline
+    duration_us: Optional[float] = None
+
+
+@dataclass
+class Trace:
+    """Decoded ring of one controller."""
+    index: int
+    cycles_per_us: float
+    written: int            # Records ever written
+    records: List[TraceRecord]
+
+    @property
+    def lost(self) -> int:
+        return self.written - len(self.records)
+
+
+def load_trace(path: str, cpu_mhz: Optional[float] = None) -> Trace:
+    """Read a ring dump and return its records oldest first."""
+    with open(path, "rb") as f:
+        blob = f.read()
+    if len(blob) < HEADER.size:
+        raise ValueError(f"{path}: too short for a trace header")
+
+    magic, size, index, version, cycles_per_us, head = HEADER.unpack_from(blob, 0)
+    if magic != TRACE_MAGIC:
+        raise ValueError(f"{path}: bad magic {magic:#010x} (CAN_Init() not run, or not a trace)")
+    if version != 1:
+        raise ValueError(f"{path}: unsupported trace version {version}")
+    if size == 0 or size & (size - 1):
+        raise ValueError(f"{path}: ring size {size} is not a power of two")
+    if len(blob) < HEADER.size + size * RECORD.size:
+        raise ValueError(f"{path}: truncated, expected {size} records")
+    if cpu_mhz:
+        cycles_per_us = cpu_mhz
+
+    count = min(head, size)
+    first = head - count
+    records = []
+    elapsed = 0
+    prev = None
+    for seq in range(first, head):
+        cycles, event, arg8, arg16 = RECORD.unpack_from(blob, HEADER.size + (seq % size) * RECORD.size)
+        if event not in EVENT_NAMES:
+            continue        # Slot reserved but not written when the dump was taken
+        if prev is not None:
+            elapsed += (cycles - prev) & 0xFFFFFFFF     # Counter wraps
+        prev = cycles
+        records.append(TraceRecord(elapsed / cycles_per_us, event, arg8, arg16))
+
+    pair_spans(records)
+    return Trace(index, cycles_per_us, head, records)
+
+
+def pair_spans(records: List[TraceRecord]):
+    """Match ENTER/EXIT pairs (nested interrupts included), set durations."""
+    open_spans: Dict[int, List[TraceRecord]] = {enter: [] for enter, _ in SPANS.values()}
+    depth = 0
+    for rec in records:
+        if rec.event in open_spans:
+            rec.depth = depth
+            open_spans[rec.event].append(rec)
+            depth += 1
+        elif rec.event in SPANS:
+            stack = open_spans[SPANS[rec.event][0]]
+            if stack:
+                start = stack.pop()
+                rec.duration_us = rec.time_us - start.time_us
+                depth = max(depth - 1, 0)
+            rec.depth = depth
+        else:
+            rec.depth = depth
+
+
+def describe(rec: TraceRecord) -> str:
+    if rec.event == RX_ISR_ENTER:
+        return f"fifo={rec.arg8}"
+    if rec.event == RX_ISR_EXIT:
+        return f"frames={rec.arg16}"
+    if rec.event == RX_CB_ENTER:
+        return f"id={rec.arg16:#06x} fmi={rec.arg8}"
+    if rec.event == TX_ISR_ENTER:
+        done = [str(mb) for mb in range(3) if rec.arg8 & (1 << mb)]
+        return "done=" + (",".join(done) or "-")
+    if rec.event == TX_ISR_EXIT:
+        return f"queued={rec.arg16}"
+    if rec.event in (TX_CB_ENTER, TX_CB_EXIT):
+        return f"mb={rec.arg8}"
+    if rec.event == TX_MAILBOX:
+        mb = "none" if rec.arg8 == 0xFF else str(rec.arg8)
+        return f"mb={mb} id={rec.arg16:#06x}"
+    return ""
+
+
+def print_timeline(trace: Trace, limit: int):
+    records = trace.records[-limit:] if limit > 0 else trace.records
+    print(f"\n[Timeline] CAN{trace.index + 1}, last {len(records)} records")
+    print(f"  {'Time (us)':>12}  {'Event':<24} {'Args':<24} {'Took (us)':>10}")
+    for rec in records:
+        name = "  " * rec.depth + EVENT_NAMES[rec.event]
+        took = f"{rec.duration_us:10.2f}" if rec.duration_us is not None else ""
+        print(f"  {rec.time_us:12.2f}  {name:<24} {describe(rec):<24} {took}")
+
+
+def percentile(values: List[float], p: float) -> float:
+    idx = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[idx]
+
+
+def histogram(values: List[float]) -> List[Tuple[str, int]]:
+    """Power-of-two buckets in us, from the smallest populated one."""
+    buckets: Dict[int, int] = {}
+    for v in values:
+        b = 0
+        while b < 20 and v >= 0.25 * (1 << b):
+            b += 1
+        buckets[b] = buckets.get(b, 0) + 1
+    rows = []
+    for b in range(min(buckets), max(buckets) + 1):
+        lo = 0.0 if b == 0 else 0.25 * (1 << (b - 1))
+        hi = 0.25 * (1 << b)
+        rows.append((f"{lo:g}-{hi:g}", buckets.get(b, 0)))
+    return rows
+
+
+def print_durations(trace: Trace):
+    spans: Dict[str, List[float]] = {}
+    for rec in trace.records:
+        if rec.duration_us is not None:
+            spans.setdefault(SPANS[rec.event][1], []).append(rec.duration_us)
+
+    print(f"\n[Durations] CAN{trace.index + 1} ({trace.cycles_per_us:g} cycles/us)")
+    if not spans:
+        print("  No complete ISR or callback spans in the ring")
+        return
+    print(f"  {'Span':<12} {'Count':>7} {'Min':>9} {'Median':>9} {'P99':>9} {'Max':>9}  (us)")
+    for name, values in spans.items():
+        values.sort()
+        print(f"  {name:<12} {len(values):>7} {values[0]:>9.2f} {percentile(values, 50):>9.2f} "
+              f"{percentile(values, 99):>9.2f} {values[-1]:>9.2f}")
+
+    for name, values in spans.items():
+        print(f"\n  {name} histogram (us):")
+        rows = histogram(values)
+        peak = max(count for _, count in rows)
+        for label, count in rows:
+            bar = "#" * (0 if peak == 0 else (count * 40 + peak - 1) // peak)
+            print(f"    {label:>12} {count:>7}  {bar}")
+
+
+def print_summary(trace: Trace):
+    depths: Dict[int, int] = {}
+    no_mailbox = 0
+    tx_requests = 0
+    for rec in trace.records:
+        if rec.event == RX_ISR_ENTER:
+            depths[rec.arg8] = depths.get(rec.arg8, 0) + 1
+        elif rec.event == TX_MAILBOX:
+            tx_requests += 1
+            if rec.arg8 == 0xFF:
+                no_mailbox += 1
+
+    span_us = trace.records[-1].time_us if trace.records else 0.0
+    print(f"\n[Trace] CAN{trace.index + 1}")
+    print(f"  Records:         {len(trace.records)} of {trace.written} written "
+          f"({trace.lost} overwritten)")
+    print(f"  Covered:         {span_us:.1f} us")
+    if depths:
+        dist = ", ".join(f"{d}:{n}" for d, n in sorted(depths.items()))
+        print(f"  FIFO depth at RX ISR entry: {dist}")
+        if any(d >= 3 for d in depths):
+            print("  WARNING: FIFO full at ISR entry - RX latency close to overrun")
+    if tx_requests:
+        print(f"  TX mailbox:      {tx_requests - no_mailbox} written, {no_mailbox} found none free")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="CAN Driver Trace Decoder",
+        formatter_class=argparse.RawDescriptionHelpFormatter,
+        epilog="""
+Examples:
+  python can_trace_decode.py can1.trc
+  python can_trace_decode.py can1.trc can2.trc --timeline 100
+        """
+    )
+
+    parser.add_argument("input", nargs="+", help="Trace ring dump(s)")
+
+    parser.add_argument(
+        "--timeline", "-t",
+        type=int,
+        default=0,
+        metavar="N",
+        help="Print the last N records as a timeline (-1: all)"
+    )
+
+    parser.add_argument(
+        "--cpu-mhz",
+        type=float,
+        help="Override cycles per us from the dump header"
+    )
+
+    args = parser.parse_args()
+
+    for path in args.input:
+        try:
+            trace = load_trace(path, args.cpu_mhz)
+        except (OSError, ValueError) as e:
+            print(f"ERROR: {e}")
+            return 1
+
+        print_summary(trace)
+        if args.timeline:
+            print_timeline(trace, args.timeline if args.timeline > 0 else 0)
+        print_durations(trace)
+
+    return 0
+
+
+if __name__ == "__main__":
+    exit(main())
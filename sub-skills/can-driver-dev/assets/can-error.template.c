@@ -0,0 +1,726 @@
+/**
+ * CAN Error Management Template
+ *
+ * This template provides an error management layer driven by the status
+ * change (SCE) interrupt:
+ * - Error active / warning / passive / bus-off state tracking
+ * - Tiered bus-off recovery: fast retries first, then slow retries, with
+ *   the waits on the timer wheel (no polling, no busy waits between tries)
+ * - TX policy on bus-off: hold queued frames or flush them
+ * - Counters for a DTC (bus-off, error passive, LEC per error type)
+ * - Telemetry: TEC/REC sampled into a ring every sample_ms, a log of state
+ *   transitions with timestamps, and lock-free snapshot/ring reads so a
+ *   task can correlate throughput drops with error bursts
+ *
+ * Automatic bus-off management (MCR.ABOM) is disabled so that software
+ * decides when the controller may rejoin the bus.
+ *
+ * Requires: can-handle.template.h, can-timer.template.c
+ * Adapt register names and addresses for your specific MCU.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "can_handle.h"
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+/* Recovery timing (see can-diagnosis/references/busoff-recovery.md).
+ * After each wait the controller still needs 128 x 11 recessive bits
+ * before it may transmit again */
+#define CANERR_FAST_RECOVERY_MS     10U      /* Wait before fast retries */
+#define CANERR_SLOW_RECOVERY_MS     1000U    /* Wait before slow retries */
+#define CANERR_FAST_RECOVERY_MAX    5U       /* Fast retries before slow */
+
+/* Time allowed to see 128 x 11 recessive bits after a recovery attempt
+ * (11 ms at 125 kbps) before the attempt counts as failed */
+#define CANERR_REJOIN_TIMEOUT_MS    20U
+
+/* Interrupt lock for clearing the counters */
+#define CANERR_ENTER_CRITICAL()     /* __disable_irq() */
+#define CANERR_EXIT_CRITICAL()      /* __enable_irq()  */
+
+/* Telemetry ring sizes (power of two). A reader gets at most size - 1
+ * entries; older ones are overwritten */
+#define CANERR_SAMPLE_RING          64U     /* TEC/REC samples */
+#define CANERR_EVENT_RING           16U     /* State transitions */
+
+/* ============================================================================
+ * Register Definitions
+ * ============================================================================ */
+
+#define CAN_MCR_ABOM        (1U << 6)    /* Automatic Bus-Off Management */
+#define CAN_MSR_ERRI        (1U << 2)    /* Error Interrupt (write 1 to clear) */
+
+#define CAN_ESR_EWGF        (1U << 0)    /* Error Warning Flag */
+#define CAN_ESR_EPVF        (1U << 1)    /* Error Passive Flag */
+#define CAN_ESR_BOFF        (1U << 2)    /* Bus-Off Flag */
+#define CAN_ESR_LEC_Pos     4U
+#define CAN_ESR_LEC         (0x7U << CAN_ESR_LEC_Pos)
+#define CAN_ESR_TEC_Pos     16U
+#define CAN_ESR_REC_Pos     24U
+
+#define CAN_IER_EWGIE       (1U << 8)    /* Error Warning Interrupt */
+#define CAN_IER_EPVIE       (1U << 9)    /* Error Passive Interrupt */
+#define CAN_IER_BOFIE       (1U << 10)   /* Bus-Off Interrupt */
+#define CAN_IER_LECIE       (1U << 11)   /* Last Error Code Interrupt */
+#define CAN_IER_ERRIE       (1U << 15)   /* Error Interrupt (SCE) */
+
+#define CAN_TSR_ABRQ0       (1U << 7)    /* Abort Request Mailbox 0 */
+#define CAN_TSR_ABRQ1       (1U << 15)   /* Abort Request Mailbox 1 */
+#define CAN_TSR_ABRQ2       (1U << 23)   /* Abort Request Mailbox 2 */
+
+/* LEC value written by software so that a new error is always visible */
+#define CANERR_LEC_SW       7U
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Fault confinement state
+ */
+typedef enum {
+    CANERR_ACTIVE = 0,      /* TEC and REC < 96 */
+    CANERR_WARNING,         /* TEC or REC >= 96 */
+    CANERR_PASSIVE,         /* TEC or REC > 127 */
+    CANERR_BUSOFF           /* TEC > 255 */
+} CanErr_State_t;
+
+/**
+ * @brief What happens to pending TX frames on bus-off
+ */
+typedef enum {
+    CANERR_TX_HOLD = 0,     /* Keep mailboxes and queue, send after recovery */
+    CANERR_TX_FLUSH         /* Abort mailboxes and drop the TX queue */
+} CanErr_TxPolicy_t;
+
+/**
+ * @brief Last error code (ESR.LEC)
+ */
+typedef enum {
+    CANERR_LEC_NONE = 0,
+    CANERR_LEC_STUFF,
+    CANERR_LEC_FORM,
+    CANERR_LEC_ACK,
+    CANERR_LEC_BIT1,        /* Recessive bit sent, dominant read */
+    CANERR_LEC_BIT0,        /* Dominant bit sent, recessive read */
+    CANERR_LEC_CRC,
+    CANERR_LEC_COUNT = 8
+} CanErr_Lec_t;
+
+/**
+ * @brief Counters for diagnostics (DTC debounce and freeze frame)
+ */
+typedef struct {
+    uint32_t warning_events;        /* Entries into error warning */
+    uint32_t passive_events;        /* Entries into error passive */
+    uint32_t busoff_events;         /* Entries into bus-off */
+    uint32_t fast_recoveries;       /* Recovery attempts after a fast wait */
+    uint32_t slow_recoveries;       /* Recovery attempts after a slow wait */
+    uint32_t recoveries;            /* Successful recoveries (TX confirmed) */
+    uint32_t flushed_frames;        /* Frames dropped by CANERR_TX_FLUSH */
+    uint32_t lec[CANERR_LEC_COUNT]; /* Errors by type */
+    uint32_t last_busoff_tick;      /* Timer wheel tick of last bus-off */
+    uint32_t last_recovery_ticks;   /* Bus-off -> first successful TX */
+    uint8_t  consecutive_busoff;    /* Bus-offs without a successful TX */
+    uint8_t  max_tec;
+    uint8_t  max_rec;
+    uint8_t  dtc_failed;            /* 1 while fast recovery is exhausted */
+} CanErr_Counters_t;
+
+/**
+ * @brief TEC/REC sample, taken every CanErr_Config_t.sample_ms
+ */
+typedef struct {
+    uint32_t tick;                  /* Timer wheel tick */
+    uint8_t  tec;
+    uint8_t  rec;
+    uint8_t  state;                 /* CanErr_State_t */
+    uint8_t  lec;                   /* Last error type (valid if errors != 0) */
+    uint16_t errors;                /* LEC errors since the previous sample */
+} CanErr_Sample_t;
+
+/**
+ * @brief Error state transition
+ */
+typedef struct {
+    uint32_t tick;                  /* Timer wheel tick */
+    uint8_t  from;                  /* CanErr_State_t */
+    uint8_t  to;
+    uint8_t  tec;                   /* Counters that caused it */
+    uint8_t  rec;
+} CanErr_Event_t;
+
+/**
+ * @brief Consistent view of the error state, see CanErr_Snapshot()
+ */
+typedef struct {
+    CanErr_Counters_t counters;
+    uint32_t tick;                  /* When taken */
+    uint32_t samples;               /* Samples written so far */
+    uint32_t events;                /* Transitions logged so far */
+    uint8_t  state;                 /* CanErr_State_t */
+    uint8_t  tec;                   /* Live ESR values */
+    uint8_t  rec;
+} CanErr_Snapshot_t;
+
+typedef struct CanErr_Channel_s CanErr_Channel_t;
+
+/**
+ * @brief Error management configuration
+ */
+typedef struct {
+    CanErr_TxPolicy_t tx_policy;
+    uint16_t sample_ms;             /* TEC/REC sample interval, 0: no samples */
+
+    /* Optional: state change notification (SCE interrupt context) */
+    void (*state_changed)(CanErr_Channel_t *ch, CanErr_State_t from, CanErr_State_t to);
+
+    /* Optional: bus-off DTC test result changed (failed = fast recovery
+     * exhausted, passed = recovered); forward to the DEM */
+    void (*dtc_changed)(CanErr_Channel_t *ch, bool failed);
+} CanErr_Config_t;
+
+/**
+ * @brief Error management state of one controller
+ */
+struct CanErr_Channel_s {
+    CAN_Handle_t *hcan;
+    const CanErr_Config_t *config;
+    CanErr_State_t state;
+    uint8_t recovering;             /* Rejoining, waiting for a TX success */
+    uint16_t init_wait;             /* Ticks waited for INAK before rejoining */
+    CanTimer_t timer;               /* Recovery wait / rejoin supervision */
+    CanErr_Counters_t counters;
+
+    /* Telemetry. The SCE and TX interrupts and the timer tick write, tasks
+     * read without locking: seq is odd while counters change, ring heads
+     * are published after the entry is written (single core) */
+    volatile uint32_t seq;
+    volatile uint32_t sample_head;
+    volatile uint32_t event_head;
+    uint32_t lec_total;             /* LEC errors, never cleared */
+    uint32_t sampled_total;         /* lec_total at the previous sample */
+    uint8_t  last_lec;
+    CanTimer_t sample_timer;
+    CanErr_Sample_t samples[CANERR_SAMPLE_RING];
+    CanErr_Event_t events[CANERR_EVENT_RING];
+};
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Take over error handling of a controller
+ * Call after CAN_Init(); disables ABOM and enables the SCE interrupts
+ */
+void CanErr_Init(CanErr_Channel_t *ch, CAN_Handle_t *hcan, const CanErr_Config_t *config);
+
+/**
+ * @brief SCE interrupt handler
+ * Call from your ISR (e.g. CAN1_SCE_IRQHandler -> CanErr_IRQHandler(&can1_err))
+ */
+void CanErr_IRQHandler(CanErr_Channel_t *ch);
+
+/**
+ * @brief Report a successfully transmitted frame
+ * Call from the TX complete callback; ends a recovery and lowers the state
+ */
+void CanErr_TxConfirmation(CanErr_Channel_t *ch);
+
+/**
+ * @brief Get current fault confinement state
+ */
+CanErr_State_t CanErr_GetState(const CanErr_Channel_t *ch);
+
+/**
+ * @brief Copy the diagnostic counters (lock-free, see CanErr_Snapshot())
+ */
+void CanErr_GetCounters(const CanErr_Channel_t *ch, CanErr_Counters_t *counters);
+
+/**
+ * @brief Take a consistent copy of counters, state and ring positions
+ * Lock-free: retries while an interrupt updates the counters, so call it
+ * from task level (or a priority below the SCE/TX interrupts)
+ */
+void CanErr_Snapshot(const CanErr_Channel_t *ch, CanErr_Snapshot_t *snap);
+
+/**
+ * @brief Read TEC/REC samples newer than *cursor
+ * @param cursor Reader position, start at 0; advanced past the returned
+ *               entries. An advance larger than the return value means
+ *               samples were overwritten before they were read
+ * @return Number of samples copied to out (oldest first)
+ */
+uint16_t CanErr_ReadSamples(const CanErr_Channel_t *ch, uint32_t *cursor,
+                            CanErr_Sample_t *out, uint16_t max);
+
+/**
+ * @brief Read state transitions newer than *cursor (as CanErr_ReadSamples)
+ */
+uint16_t CanErr_ReadEvents(const CanErr_Channel_t *ch, uint32_t *cursor,
+                           CanErr_Event_t *out, uint16_t max);
+
+/**
+ * @brief Clear the diagnostic counters (e.g. on UDS ClearDTC)
+ */
+void CanErr_ClearCounters(CanErr_Channel_t *ch);
+
+/* ============================================================================
+ * Implementation - Telemetry
+ * ============================================================================ */
+
+/* Bracket counter updates for lock-free readers */
+static inline void CanErr_WriteBegin(CanErr_Channel_t *ch)
+{
+    ch->seq++;
+    CAN_BARRIER();
+}
+
+static inline void CanErr_WriteEnd(CanErr_Channel_t *ch)
+{
+    CAN_BARRIER();
+    ch->seq++;
+}
+
+static void CanErr_LogEvent(CanErr_Channel_t *ch, CanErr_State_t from, CanErr_State_t to)
+{
+    uint32_t esr = ch->hcan->regs->ESR;
+    CanErr_Event_t *e = &ch->events[ch->event_head & (CANERR_EVENT_RING - 1U)];
+
+    e->tick = CanTimer_Now();
+    e->from = (uint8_t)from;
+    e->to = (uint8_t)to;
+    e->tec = (uint8_t)(esr >> CAN_ESR_TEC_Pos);
+    e->rec = (uint8_t)(esr >> CAN_ESR_REC_Pos);
+    CAN_BARRIER();
+    ch->event_head++;
+}
+
+static void CanErr_SampleTimeout(CanTimer_t *timer, void *arg)
+{
+    CanErr_Channel_t *ch = (CanErr_Channel_t *)arg;
+    uint32_t esr = ch->hcan->regs->ESR;
+    uint32_t total = ch->lec_total;
+    uint32_t errors = total - ch->sampled_total;
+    CanErr_Sample_t *s = &ch->samples[ch->sample_head & (CANERR_SAMPLE_RING - 1U)];
+
+    CanTimer_Start(timer, CAN_TIMER_MS_TO_TICKS(ch->config->sample_ms));
+
+    s->tick = CanTimer_Now();
+    s->tec = (uint8_t)(esr >> CAN_ESR_TEC_Pos);
+    s->rec = (uint8_t)(esr >> CAN_ESR_REC_Pos);
+    s->state = (uint8_t)ch->state;
+    s->lec = ch->last_lec;
+    s->errors = (errors > 0xFFFFU) ? 0xFFFFU : (uint16_t)errors;
+    ch->sampled_total = total;
+    CAN_BARRIER();
+    ch->sample_head++;
+}
+
+/* Copy ring entries [*cursor, head) and drop those the writer may have
+ * overwritten meanwhile (slot of head - size can be mid-write) */
+static uint16_t CanErr_ReadRing(const void *ring, uint32_t size, uint32_t entry,
+                                const volatile uint32_t *head_ptr, uint32_t *cursor,
+                                void *out, uint16_t max)
+{
+    uint32_t head = *head_ptr;
+    uint32_t first = *cursor;
+    uint32_t oldest;
+    uint16_t n = 0;
+
+    CAN_BARRIER();
+    if (head - first >= size) {
+        first = head - (size - 1U);
+    }
+    while (n < max && first + n != head) {
+        memcpy((uint8_t *)out + (uint32_t)n * entry,
+               (const uint8_t *)ring + ((first + n) & (size - 1U)) * entry, entry);
+        n++;
+    }
+    CAN_BARRIER();
+
+    oldest = *head_ptr - (size - 1U);
+    if ((int32_t)(oldest - first) > 0) {
+        uint32_t lost = oldest - first;
+        if (lost > n) {
+            lost = n;
+        }
+        memmove(out, (uint8_t *)out + lost * entry, (n - lost) * entry);
+        *cursor = first + n;
+        return (uint16_t)(n - lost);
+    }
+
+    *cursor = first + n;
+    return n;
+}
+
+/* ============================================================================
+ * Implementation - State Tracking
+ * ============================================================================ */
+
+static CanErr_State_t CanErr_StateFromEsr(uint32_t esr)
+{
+    if (esr & CAN_ESR_BOFF) return CANERR_BUSOFF;
+    if (esr & CAN_ESR_EPVF) return CANERR_PASSIVE;
+    if (esr & CAN_ESR_EWGF) return CANERR_WARNING;
+    return CANERR_ACTIVE;
+}
+
+static void CanErr_SetState(CanErr_Channel_t *ch, CanErr_State_t state)
+{
+    CanErr_State_t from = ch->state;
+
+    if (state == from) {
+        return;
+    }
+    ch->state = state;
+    CanErr_LogEvent(ch, from, state);
+
+    /* Count entries into a worse state only */
+    if (state > from) {
+        switch (state) {
+        case CANERR_WARNING: ch->counters.warning_events++; break;
+        case CANERR_PASSIVE: ch->counters.passive_events++; break;
+        case CANERR_BUSOFF:  ch->counters.busoff_events++;  break;
+        default: break;
+        }
+    }
+
+    if (ch->config->state_changed != NULL) {
+        ch->config->state_changed(ch, from, state);
+    }
+}
+
+/* ============================================================================
+ * Implementation - Bus-Off Handling
+ * ============================================================================ */
+
+static void CanErr_FlushTx(CanErr_Channel_t *ch)
+{
+    CAN_TypeDef *can = ch->hcan->regs;
+    CAN_TxQueue_t *q = &ch->hcan->tx;
+
+    /* Aborted mailboxes complete without TXOK: no TX confirmation */
+    can->TSR = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2;
+    CAN_HW_SYNC(can);
+
+    ch->counters.flushed_frames += (uint16_t)(q->head - q->tail);
+    q->tail = q->head;
+}
+
+static void CanErr_EnterBusOff(CanErr_Channel_t *ch);
+
+static void CanErr_RecoveryTimeout(CanTimer_t *timer, void *arg)
+{
+    CanErr_Channel_t *ch = (CanErr_Channel_t *)arg;
+
+    if (ch->recovering) {
+        /* Rejoin supervision expired: still off means the bus never
+         * went recessive long enough - counts as another bus-off */
+        if (ch->hcan->regs->ESR & CAN_ESR_BOFF) {
+            CanErr_WriteBegin(ch);
+            ch->counters.busoff_events++;
+            CanErr_EnterBusOff(ch);
+            CanErr_WriteEnd(ch);
+        }
+        return;
+    }
+
+    /* With ABOM = 0, leaving init mode starts the hardware wait for
+     * 128 x 11 recessive bits; TEC/REC are reset when it completes.
+     * INAK is checked once per tick instead of spinning on it */
+    if (!CAN_EnterInitMode(ch->hcan) &&
+        ++ch->init_wait < CAN_TIMER_MS_TO_TICKS(CANERR_REJOIN_TIMEOUT_MS)) {
+        CanTimer_Start(timer, 1U);
+        return;
+    }
+
+    /* Also when INAK never came: the rejoin supervision then counts the
+     * attempt as failed if the controller stays off */
+    ch->init_wait = 0;
+    CAN_ExitInitMode(ch->hcan);
+    ch->recovering = 1;
+    CanTimer_Start(timer, CAN_TIMER_MS_TO_TICKS(CANERR_REJOIN_TIMEOUT_MS));
+}
+
+static void CanErr_EnterBusOff(CanErr_Channel_t *ch)
+{
+    CanErr_Counters_t *c = &ch->counters;
+    uint32_t wait_ms;
+
+    c->last_busoff_tick = CanTimer_Now();
+    ch->recovering = 0;
+    ch->init_wait = 0;
+
+    if (ch->config->tx_policy == CANERR_TX_FLUSH) {
+        CanErr_FlushTx(ch);
+    }
+
+    if (c->consecutive_busoff < 0xFFU) {
+        c->consecutive_busoff++;
+    }
+
+    if (c->consecutive_busoff <= CANERR_FAST_RECOVERY_MAX) {
+        wait_ms = CANERR_FAST_RECOVERY_MS;
+        c->fast_recoveries++;
+    } else {
+        /* Fast recovery exhausted: persistent fault, stop hammering */
+        wait_ms = CANERR_SLOW_RECOVERY_MS;
+        c->slow_recoveries++;
+        if (!c->dtc_failed) {
+            c->dtc_failed = 1;
+            if (ch->config->dtc_changed != NULL) {
+                ch->config->dtc_changed(ch, true);
+            }
+        }
+    }
+
+    CanTimer_Start(&ch->timer, CAN_TIMER_MS_TO_TICKS(wait_ms));
+}
+
+/* ============================================================================
+ * Implementation - Public API
+ * ============================================================================ */
+
+void CanErr_Init(CanErr_Channel_t *ch, CAN_Handle_t *hcan, const CanErr_Config_t *config)
+{
+    CAN_TypeDef *can = hcan->regs;
+
+    memset(ch, 0, sizeof(*ch));
+    ch->hcan = hcan;
+    ch->config = config;
+    CanTimer_Setup(&ch->timer, CanErr_RecoveryTimeout, ch);
+    CanTimer_Setup(&ch->sample_timer, CanErr_SampleTimeout, ch);
+
+    /* Software controlled recovery (MCR options are writable in any mode,
+     * no init mode round trip needed) */
+    can->MCR &= ~CAN_MCR_ABOM;
+
+    can->ESR = (can->ESR & ~CAN_ESR_LEC) | (CANERR_LEC_SW << CAN_ESR_LEC_Pos);
+    CAN_HW_SYNC(can);
+    ch->state = CanErr_StateFromEsr(can->ESR);
+
+    can->IER |= CAN_IER_EWGIE | CAN_IER_EPVIE | CAN_IER_BOFIE |
+                CAN_IER_LECIE | CAN_IER_ERRIE;
+
+    if (config->sample_ms != 0) {
+        CanTimer_Start(&ch->sample_timer, CAN_TIMER_MS_TO_TICKS(config->sample_ms));
+    }
+}
+
+void CanErr_IRQHandler(CanErr_Channel_t *ch)
+{
+    CAN_TypeDef *can = ch->hcan->regs;
+    CanErr_Counters_t *c = &ch->counters;
+    uint32_t esr = can->ESR;
+    uint8_t tec = (uint8_t)(esr >> CAN_ESR_TEC_Pos);
+    uint8_t rec = (uint8_t)(esr >> CAN_ESR_REC_Pos);
+    uint32_t lec = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos;
+    CanErr_State_t state;
+
+    can->MSR = CAN_MSR_ERRI;
+    CAN_HW_SYNC(can);
+
+    CanErr_WriteBegin(ch);
+
+    /* Error type statistics; re-arm LEC so the next error changes it */
+    if (lec != CANERR_LEC_NONE && lec != CANERR_LEC_SW) {
+        c->lec[lec]++;
+        ch->lec_total++;
+        ch->last_lec = (uint8_t)lec;
+        can->ESR = (esr & ~CAN_ESR_LEC) | (CANERR_LEC_SW << CAN_ESR_LEC_Pos);
+        CAN_HW_SYNC(can);
+    }
+
+    if (tec > c->max_tec) c->max_tec = tec;
+    if (rec > c->max_rec) c->max_rec = rec;
+
+    state = CanErr_StateFromEsr(esr);
+
+    if (state == CANERR_BUSOFF && ch->state == CANERR_BUSOFF) {
+        /* Off again before the rejoin was confirmed (the warning/passive
+         * interrupts in between may have been coalesced) */
+        if (ch->recovering) {
+            c->busoff_events++;
+            CanErr_EnterBusOff(ch);
+        }
+        CanErr_WriteEnd(ch);
+        return;
+    }
+
+    CanErr_SetState(ch, state);
+    if (state == CANERR_BUSOFF) {
+        CanErr_EnterBusOff(ch);
+    }
+    CanErr_WriteEnd(ch);
+}
+
+void CanErr_TxConfirmation(CanErr_Channel_t *ch)
+{
+    CanErr_Counters_t *c;
+
+    /* Fast path: nothing to do while error active */
+    if (ch->state == CANERR_ACTIVE && !ch->recovering) {
+        return;
+    }
+
+    c = &ch->counters;
+    CanErr_WriteBegin(ch);
+
+    if (ch->recovering) {
+        /* First frame acknowledged after bus-off: back to full throughput */
+        ch->recovering = 0;
+        c->recoveries++;
+        c->consecutive_busoff = 0;
+        c->last_recovery_ticks = CanTimer_Now() - c->last_busoff_tick;
+        if (c->dtc_failed) {
+            c->dtc_failed = 0;
+            if (ch->config->dtc_changed != NULL) {
+                ch->config->dtc_changed(ch, false);
+            }
+        }
+    }
+
+    /* Status change interrupts only fire when flags are set, so a lower
+     * state is picked up here */
+    CanErr_SetState(ch, CanErr_StateFromEsr(ch->hcan->regs->ESR));
+    CanErr_WriteEnd(ch);
+}
+
+CanErr_State_t CanErr_GetState(const CanErr_Channel_t *ch)
+{
+    return ch->state;
+}
+
+void CanErr_GetCounters(const CanErr_Channel_t *ch, CanErr_Counters_t *counters)
+{
+    uint32_t seq;
+
+    do {
+        seq = ch->seq;
+        CAN_BARRIER();
+        *counters = ch->counters;
+        CAN_BARRIER();
+    } while ((seq & 1U) != 0 || seq != ch->seq);
+}
+
+void CanErr_Snapshot(const CanErr_Channel_t *ch, CanErr_Snapshot_t *snap)
+{
+    uint32_t seq;
+    uint32_t esr;
+
+    do {
+        seq = ch->seq;
+        CAN_BARRIER();
+        snap->counters = ch->counters;
+        snap->state = (uint8_t)ch->state;
+        snap->samples = ch->sample_head;
+        snap->events = ch->event_head;
+        CAN_BARRIER();
+    } while ((seq & 1U) != 0 || seq != ch->seq);
+
+    esr = ch->hcan->regs->ESR;
+    snap->tec = (uint8_t)(esr >> CAN_ESR_TEC_Pos);
+    snap->rec = (uint8_t)(esr >> CAN_ESR_REC_Pos);
+    snap->tick = CanTimer_Now();
+}
+
+uint16_t CanErr_ReadSamples(const CanErr_Channel_t *ch, uint32_t *cursor,
+                            CanErr_Sample_t *out, uint16_t max)
+{
+    return CanErr_ReadRing(ch->samples, CANERR_SAMPLE_RING, sizeof(CanErr_Sample_t),
+                           &ch->sample_head, cursor, out, max);
+}
+
+uint16_t CanErr_ReadEvents(const CanErr_Channel_t *ch, uint32_t *cursor,
+                           CanErr_Event_t *out, uint16_t max)
+{
+    return CanErr_ReadRing(ch->events, CANERR_EVENT_RING, sizeof(CanErr_Event_t),
+                           &ch->event_head, cursor, out, max);
+}
+
+void CanErr_ClearCounters(CanErr_Channel_t *ch)
+{
+    CANERR_ENTER_CRITICAL();
+    CanErr_WriteBegin(ch);
+    memset(&ch->counters, 0, sizeof(ch->counters));
+    CanErr_WriteEnd(ch);
+    CANERR_EXIT_CRITICAL();
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+CAN_Handle_t hcan1;
+static CanErr_Channel_t can1_err;
+
+static void can1_state(CanErr_Channel_t *ch, CanErr_State_t from, CanErr_State_t to)
+{
+    (void)ch;
+    (void)from;
+    if (to == CANERR_BUSOFF) {
+        Com_StopTimeoutMonitoring();   // Don't flag RX timeouts while off
+    }
+}
+
+static void can1_dtc(CanErr_Channel_t *ch, bool failed)
+{
+    (void)ch;
+    Dem_ReportStatus(DTC_CAN1_BUSOFF, failed ? DEM_FAILED : DEM_PASSED);
+}
+
+static const CanErr_Config_t can1_err_config = {
+    .tx_policy = CANERR_TX_HOLD,       // Periodic frames: CANERR_TX_FLUSH
+    .sample_ms = 100,
+    .state_changed = can1_state,
+    .dtc_changed = can1_dtc,
+};
+
+static void can1_tx_done(CAN_Handle_t *hcan, uint8_t mailbox)
+{
+    (void)hcan;
+    (void)mailbox;
+    CanErr_TxConfirmation(&can1_err);
+}
+
+void CAN1_SCE_IRQHandler(void)
+{
+    CanErr_IRQHandler(&can1_err);
+}
+
+void main(void)
+{
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);
+    CanErr_Init(&can1_err, &hcan1, &can1_err_config);
+    hcan1.tx_callback = can1_tx_done;
+    // NVIC_EnableIRQ(CAN1_SCE_IRQn);
+}
+
+// Background task: forward new telemetry to a logger / diagnostic stream
+void ErrTelemetry_Task(void)
+{
+    static uint32_t sample_cursor, event_cursor;
+    CanErr_Sample_t samples[16];
+    CanErr_Event_t events[4];
+    CanErr_Snapshot_t snap;
+    uint16_t n;
+
+    CanErr_Snapshot(&can1_err, &snap);
+    Log_Write(LOG_CAN_ERR_SNAPSHOT, &snap, sizeof(snap));
+    while ((n = CanErr_ReadSamples(&can1_err, &sample_cursor, samples, 16)) != 0) {
+        Log_Write(LOG_CAN_ERR_SAMPLES, samples, n * sizeof(samples[0]));
+    }
+    while ((n = CanErr_ReadEvents(&can1_err, &event_cursor, events, 4)) != 0) {
+        Log_Write(LOG_CAN_ERR_EVENTS, events, n * sizeof(events[0]));
+    }
+}
+*/
@@ -2,79 +2,98 @@
  * CAN Filter Configuration Template
  * 
  * This template provides CAN filter configuration examples.
+ * Each function configures the first bank(s) owned by the given instance;
+ * on dual bxCAN the banks live in the CAN1 registers (hcan->filter_regs).
  * Adapt register names and addresses for your specific MCU.
  */
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "can_handle.h"
 
 /* ============================================================================
  * Filter Configuration Examples
  * ============================================================================ */
 
+/**
+ * @brief Enter filter initialization mode, deactivate the instance's banks
+ * Every configuration function replaces the previous one: banks left
+ * active by a longer list would otherwise keep accepting their IDs.
+ * The instance owns banks below CAN2SB (CAN1) or from CAN2SB on (CAN2).
+ */
+static void CAN_Filter_Begin(CAN_Handle_t *hcan)
+{
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint32_t below = (1UL << ((fc->FMR >> 8) & 0x3FU)) - 1U;
+    
+    fc->FMR |= (1U << 0);
+    fc->FA1R &= (hcan->index == 0) ? ~below : below;
+}
+
 /**
  * @brief Configure filter to accept all messages
  */
-void CAN_Filter_AcceptAll(void)
+void CAN_Filter_AcceptAll(CAN_Handle_t *hcan)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 32-bit scale */
-    CAN->FS1R |= (1U << 0);
+    fc->FS1R |= (1U << bank);
     
     /* Set mask mode */
-    CAN->FM1R &= ~(1U << 0);
+    fc->FM1R &= ~(1U << bank);
     
     /* Set ID and mask (both 0 = accept all) */
-    CAN->sFilterRegister[0].FR1 = 0;
-    CAN->sFilterRegister[0].FR2 = 0;
+    fc->sFilterRegister[bank].FR1 = 0;
+    fc->sFilterRegister[bank].FR2 = 0;
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /**
  * @brief Configure filter for single standard ID
  * @param id Standard ID to accept (11-bit)
  */
-void CAN_Filter_SingleStdId(uint16_t id)
+void CAN_Filter_SingleStdId(CAN_Handle_t *hcan, uint16_t id)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 32-bit scale */
-    CAN->FS1R |= (1U << 0);
+    fc->FS1R |= (1U << bank);
     
     /* Set mask mode */
-    CAN->FM1R &= ~(1U << 0);
+    fc->FM1R &= ~(1U << bank);
     
     /* Set ID (shifted for standard ID position) */
-    CAN->sFilterRegister[0].FR1 = (id << 21);
+    fc->sFilterRegister[bank].FR1 = (uint32_t)(id & 0x7FFU) << 21;
     
-    /* Set mask - all ID bits must match */
-    CAN->sFilterRegister[0].FR2 = (0x7FF << 21);
+    /* Set mask - all ID bits must match, IDE = 0 (no extended frame
+     * whose upper 11 bits equal the ID) */
+    fc->sFilterRegister[bank].FR2 = (0x7FFU << 21) | (1U << 2);
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /**
@@ -82,34 +101,34 @@ void CAN_Filter_SingleStdId(uint16_t id)
  * @param base_id Base ID of range
  * @param mask Mask for range (set bits must match)
  */
-void CAN_Filter_IdRange(uint16_t base_id, uint16_t mask)
+void CAN_Filter_IdRange(CAN_Handle_t *hcan, uint16_t base_id, uint16_t mask)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 32-bit scale */
-    CAN->FS1R |= (1U << 0);
+    fc->FS1R |= (1U << bank);
     
     /* Set mask mode */
-    CAN->FM1R &= ~(1U << 0);
+    fc->FM1R &= ~(1U << bank);
     
     /* Set base ID */
-    CAN->sFilterRegister[0].FR1 = (base_id << 21);
+    fc->sFilterRegister[bank].FR1 = (uint32_t)(base_id & 0x7FFU) << 21;
     
-    /* Set mask */
-    CAN->sFilterRegister[0].FR2 = (mask << 21);
+    /* Set mask, IDE must be 0 */
+    fc->sFilterRegister[bank].FR2 = ((uint32_t)(mask & 0x7FFU) << 21) | (1U << 2);
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /**
@@ -117,101 +136,102 @@ void CAN_Filter_IdRange(uint16_t base_id, uint16_t mask)
  * @param id1 First ID to accept
  * @param id2 Second ID to accept
  */
-void CAN_Filter_TwoIds(uint16_t id1, uint16_t id2)
+void CAN_Filter_TwoIds(CAN_Handle_t *hcan, uint16_t id1, uint16_t id2)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 32-bit scale */
-    CAN->FS1R |= (1U << 0);
+    fc->FS1R |= (1U << bank);
     
     /* Set list mode (two IDs in FR1 and FR2) */
-    CAN->FM1R |= (1U << 0);
+    fc->FM1R |= (1U << bank);
     
     /* Set two IDs */
-    CAN->sFilterRegister[0].FR1 = (id1 << 21);
-    CAN->sFilterRegister[0].FR2 = (id2 << 21);
+    fc->sFilterRegister[bank].FR1 = (uint32_t)(id1 & 0x7FFU) << 21;
+    fc->sFilterRegister[bank].FR2 = (uint32_t)(id2 & 0x7FFU) << 21;
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /**
  * @brief Configure filter for four IDs (16-bit list mode)
  * @param ids Array of 4 IDs
  */
-void CAN_Filter_FourIds(const uint16_t ids[4])
+void CAN_Filter_FourIds(CAN_Handle_t *hcan, const uint16_t ids[4])
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 16-bit scale */
-    CAN->FS1R &= ~(1U << 0);
+    fc->FS1R &= ~(1U << bank);
     
     /* Set list mode */
-    CAN->FM1R |= (1U << 0);
+    fc->FM1R |= (1U << bank);
     
-    /* Pack four IDs into two registers */
-    /* FR1: ID1 (bits 31-21) + ID2 (bits 15-5) */
-    CAN->sFilterRegister[0].FR1 = (ids[0] << 21) | (ids[1] << 5);
+    /* Pack four IDs into two registers; the low half of FR1 is filter
+     * number n, so ids[k] reports FMI k */
+    /* FR1: ID2 (bits 31-21) + ID1 (bits 15-5) */
+    fc->sFilterRegister[bank].FR1 = ((uint32_t)(ids[1] & 0x7FFU) << 21) | ((uint32_t)(ids[0] & 0x7FFU) << 5);
     
-    /* FR2: ID3 (bits 31-21) + ID4 (bits 15-5) */
-    CAN->sFilterRegister[0].FR2 = (ids[2] << 21) | (ids[3] << 5);
+    /* FR2: ID4 (bits 31-21) + ID3 (bits 15-5) */
+    fc->sFilterRegister[bank].FR2 = ((uint32_t)(ids[3] & 0x7FFU) << 21) | ((uint32_t)(ids[2] & 0x7FFU) << 5);
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /**
  * @brief Configure filter for extended ID
  * @param id Extended ID to accept (29-bit)
  */
-void CAN_Filter_ExtendedId(uint32_t id)
+void CAN_Filter_ExtendedId(CAN_Handle_t *hcan, uint32_t id)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
     
-    /* Deactivate filter 0 */
-    CAN->FA1R &= ~(1U << 0);
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
     /* Set 32-bit scale */
-    CAN->FS1R |= (1U << 0);
+    fc->FS1R |= (1U << bank);
     
     /* Set mask mode */
-    CAN->FM1R &= ~(1U << 0);
+    fc->FM1R &= ~(1U << bank);
     
     /* Set extended ID with IDE bit set */
-    CAN->sFilterRegister[0].FR1 = (id << 3) | (1U << 2);
+    fc->sFilterRegister[bank].FR1 = ((id & 0x1FFFFFFFU) << 3) | (1U << 2);
     
     /* Set mask - all ID bits must match, plus IDE */
-    CAN->sFilterRegister[0].FR2 = (0x1FFFFFFF << 3) | (1U << 2);
+    fc->sFilterRegister[bank].FR2 = (0x1FFFFFFFU << 3) | (1U << 2);
     
     /* Assign to FIFO 0 */
-    CAN->FFA1R &= ~(1U << 0);
+    fc->FFA1R &= ~(1U << bank);
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /* ============================================================================
@@ -220,35 +240,115 @@ void CAN_Filter_ExtendedId(uint32_t id)
 
 /**
  * @brief Configure multiple filters
- * Example: Filter 0 for IDs 0x100-0x1FF, Filter 1 for ID 0x200
+ * Example: first bank for IDs 0x100-0x1FF, next bank for ID 0x200
  */
-void CAN_Filter_MultipleExample(void)
+void CAN_Filter_MultipleExample(CAN_Handle_t *hcan)
 {
-    /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
+    
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
     
-    /* === Filter 0: ID range 0x100-0x1FF === */
-    CAN->FA1R &= ~(1U << 0);        /* Deactivate */
-    CAN->FS1R |= (1U << 0);         /* 32-bit */
-    CAN->FM1R &= ~(1U << 0);        /* Mask mode */
-    CAN->FFA1R &= ~(1U << 0);       /* FIFO 0 */
+    /* === Filter bank: ID range 0x100-0x1FF === */
+    fc->FA1R &= ~(1U << bank);        /* Deactivate */
+    fc->FS1R |= (1U << bank);         /* 32-bit */
+    fc->FM1R &= ~(1U << bank);        /* Mask mode */
+    fc->FFA1R &= ~(1U << bank);       /* FIFO 0 */
     
-    CAN->sFilterRegister[0].FR1 = (0x100 << 21);  /* Base ID */
-    CAN->sFilterRegister[0].FR2 = (0x700 << 21);  /* Mask: upper 4 bits */
+    fc->sFilterRegister[bank].FR1 = (0x100U << 21);  /* Base ID */
+    fc->sFilterRegister[bank].FR2 = (0x700U << 21);  /* Mask: upper 3 bits */
     
-    CAN->FA1R |= (1U << 0);         /* Activate */
+    fc->FA1R |= (1U << bank);         /* Activate */
     
-    /* === Filter 1: Single ID 0x200 === */
-    CAN->FA1R &= ~(1U << 1);        /* Deactivate */
-    CAN->FS1R |= (1U << 1);         /* 32-bit */
-    CAN->FM1R &= ~(1U << 1);        /* Mask mode */
-    CAN->FFA1R |= (1U << 1);        /* FIFO 1 */
+    /* === Filter bank + 1: Single ID 0x200 === */
+    fc->FA1R &= ~(1U << (bank + 1));        /* Deactivate */
+    fc->FS1R |= (1U << (bank + 1));         /* 32-bit */
+    fc->FM1R &= ~(1U << (bank + 1));        /* Mask mode */
+    fc->FFA1R |= (1U << (bank + 1));        /* FIFO 1 */
     
-    CAN->sFilterRegister[1].FR1 = (0x200 << 21);
-    CAN->sFilterRegister[1].FR2 = (0x7FF << 21);
+    fc->sFilterRegister[bank + 1].FR1 = (0x200U << 21);
+    fc->sFilterRegister[bank + 1].FR2 = (0x7FFU << 21);
     
-    CAN->FA1R |= (1U << 1);         /* Activate */
+    fc->FA1R |= (1U << (bank + 1));         /* Activate */
+    
+    /* Exit filter initialization mode */
+    fc->FMR &= ~(1U << 0);
+}
+
+/* ============================================================================
+ * ID List Configuration (generated ID lists)
+ * ============================================================================ */
+
+/**
+ * @brief Configure exact-match filters for an ID list
+ *
+ * Standard IDs use 16-bit list mode (4 IDs per bank), extended IDs 32-bit
+ * list mode (2 IDs per bank). Partially used banks repeat the last ID.
+ * The FMI of a match is the ID's index in std_ids, or 4 x (standard
+ * banks) + its index in ext_ids. List entries match data frames only.
+ * If the list needs more than max_banks banks, one accept-all bank is
+ * configured instead and false is returned - software dispatch must then
+ * reject unknown IDs.
+ *
+ * @param std_ids Standard IDs (11-bit)
+ * @param std_count Number of standard IDs
+ * @param ext_ids Extended IDs (29-bit)
+ * @param ext_count Number of extended IDs
+ * @param max_banks Banks available to this instance
+ * @return true if every ID got an exact-match entry
+ */
+bool CAN_Filter_IdList(CAN_Handle_t *hcan,
+                       const uint16_t *std_ids, uint16_t std_count,
+                       const uint32_t *ext_ids, uint16_t ext_count,
+                       uint8_t max_banks)
+{
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
+    uint16_t needed = (uint16_t)((std_count + 3U) / 4U + (ext_count + 1U) / 2U);
+    uint16_t i;
+    
+    if (needed > max_banks) {
+        CAN_Filter_AcceptAll(hcan);
+        return false;
+    }
+    
+    /* Enter filter initialization mode, previous configuration off */
+    CAN_Filter_Begin(hcan);
+    
+    /* Standard IDs: 16-bit list, STID in bits 15:5 of each half */
+    for (i = 0; i < std_count; i += 4U, bank++) {
+        uint32_t f[4];
+        uint8_t k;
+        
+        for (k = 0; k < 4U; k++) {
+            uint16_t idx = (uint16_t)((i + k < std_count) ? (i + k) : (std_count - 1U));
+            f[k] = (uint32_t)(std_ids[idx] & 0x7FFU) << 5;
+        }
+        fc->FA1R &= ~(1U << bank);
+        fc->FS1R &= ~(1U << bank);          /* 16-bit */
+        fc->FM1R |= (1U << bank);           /* List mode */
+        fc->FFA1R &= ~(1U << bank);         /* FIFO 0 */
+        fc->sFilterRegister[bank].FR1 = (f[1] << 16) | f[0];   /* Low half first: FMI = list index */
+        fc->sFilterRegister[bank].FR2 = (f[3] << 16) | f[2];
+        fc->FA1R |= (1U << bank);
+    }
+    
+    /* Extended IDs: 32-bit list, EXID in bits 31:3 plus IDE */
+    for (i = 0; i < ext_count; i += 2U, bank++) {
+        uint16_t second = (uint16_t)((i + 1U < ext_count) ? (i + 1U) : i);
+        
+        fc->FA1R &= ~(1U << bank);
+        fc->FS1R |= (1U << bank);           /* 32-bit */
+        fc->FM1R |= (1U << bank);           /* List mode */
+        fc->FFA1R &= ~(1U << bank);         /* FIFO 0 */
+        fc->sFilterRegister[bank].FR1 = ((ext_ids[i] & 0x1FFFFFFFU) << 3) | (1U << 2);
+        fc->sFilterRegister[bank].FR2 = ((ext_ids[second] & 0x1FFFFFFFU) << 3) | (1U << 2);
+        fc->FA1R |= (1U << bank);
+    }
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
+    
+    return true;
 }
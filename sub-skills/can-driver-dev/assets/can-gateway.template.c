@@ -0,0 +1,501 @@
+/**
+ * CAN Gateway Routing Template
+ *
+ * This template provides a PduR-style CAN-to-CAN routing engine:
+ * - Precomputed ID -> route lookup (direct table for 11-bit IDs, sorted
+ *   table with binary search for 29-bit IDs)
+ * - 1:1 and 1:N routing, optional ID remapping, CAN <-> CAN-FD
+ * - Zero-copy: a received frame is stored once in a reference counted
+ *   pool; every destination queue only holds a reference to it
+ * - Per-bus TX FIFOs absorb rate mismatch (e.g. 2 Mbps FD -> 500 kbps CAN)
+ * - Per-route counters: forwarded, dropped, forwarding latency
+ *
+ * Adapt link_tx and the critical section macros for your MCU.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define GW_MAX_BUSES        6U       /* CAN controllers on the gateway */
+#define GW_MAX_ROUTES       254U     /* Route table entries (index fits uint8_t) */
+#define GW_MAX_DESTS        4U       /* Destinations per route (1:N) */
+#define GW_POOL_SIZE        64U      /* Frames buffered across all buses */
+#define GW_TXQ_DEPTH        32U      /* Per-bus TX FIFO depth (power of two) */
+
+/* Interrupt lock around pool and queue updates. RX and TX interrupts of
+ * different controllers touch the same pool, so this must mask them all */
+#define GW_ENTER_CRITICAL() /* __disable_irq() */
+#define GW_EXIT_CRITICAL()  /* __enable_irq()  */
+
+/* Frame flags */
+#define GW_FLAG_FD          0x01U    /* CAN-FD frame */
+#define GW_FLAG_BRS         0x02U    /* Bit rate switch in data phase */
+
+#define GW_STD_ID_COUNT     2048U
+#define GW_NO_ROUTE         0U
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Buffered frame (pool element)
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t  ide;
+    uint8_t  flags;         /* GW_FLAG_* of the received frame */
+    uint8_t  len;           /* Payload length in bytes (0-64) */
+    uint8_t  refs;          /* Destinations still holding this frame */
+    uint32_t rx_time_us;    /* Reception timestamp for latency */
+    uint8_t  data[64];
+} Gw_Frame_t;
+
+/**
+ * @brief Route destination
+ */
+typedef struct {
+    uint8_t  bus;           /* Destination bus */
+    uint8_t  ide;           /* Destination ID type */
+    uint8_t  flags;         /* GW_FLAG_* used on the destination bus */
+    uint32_t id;            /* Destination CAN ID (remapping allowed) */
+} Gw_Dest_t;
+
+/**
+ * @brief Routing path (one source frame, 1..N destinations)
+ */
+typedef struct {
+    uint8_t  src_bus;
+    uint8_t  src_ide;
+    uint32_t src_id;
+    uint8_t  dest_count;
+    Gw_Dest_t dest[GW_MAX_DESTS];
+} Gw_Route_t;
+
+/**
+ * @brief Counters per route destination
+ */
+typedef struct {
+    uint32_t forwarded;
+    uint32_t dropped_queue;     /* Destination TX FIFO or pool full */
+    uint32_t dropped_format;    /* FD payload > 8 bytes to classic bus */
+    uint32_t latency_max_us;    /* RX timestamp -> handed to controller */
+    uint64_t latency_sum_us;
+} Gw_RouteStats_t;
+
+/**
+ * @brief Lower layer hooks
+ */
+typedef struct {
+    /* Copy one frame into a free TX mailbox; false if none is free */
+    bool (*link_tx)(uint8_t bus, uint32_t id, uint8_t ide, uint8_t flags,
+                    const uint8_t *data, uint8_t len);
+
+    /* Free running microsecond clock for latency measurement */
+    uint32_t (*get_time_us)(void);
+} Gw_Callbacks_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Build lookup tables from the route configuration
+ * @param routes Route table (kept by reference)
+ * @param count Number of routes (<= GW_MAX_ROUTES)
+ * @return false on invalid or duplicate routes
+ */
+bool Gw_Init(const Gw_Route_t *routes, uint16_t count, const Gw_Callbacks_t *callbacks);
+
+/**
+ * @brief Route a received frame (call from the RX interrupt of 'bus')
+ * Frames without a route are rejected before any copy is made
+ * @return true if the frame matched a route
+ */
+bool Gw_RxIndication(uint8_t bus, uint32_t id, uint8_t ide, uint8_t flags,
+                     const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Feed queued frames to free mailboxes of 'bus'
+ * Call from the TX complete interrupt of 'bus'
+ */
+void Gw_TxPump(uint8_t bus);
+
+/**
+ * @brief Read counters of one route destination
+ */
+bool Gw_GetRouteStats(uint16_t route, uint8_t dest, Gw_RouteStats_t *stats);
+
+/**
+ * @brief Reset all counters
+ */
+void Gw_ResetStats(void);
+
+/* ============================================================================
+ * Implementation - Tables and State
+ * ============================================================================ */
+
+/* TX FIFO entry: pool frame + route leg */
+typedef struct {
+    uint8_t  frame;
+    uint8_t  dest;
+    uint16_t route;
+} Gw_TxEntry_t;
+
+typedef struct {
+    Gw_TxEntry_t entry[GW_TXQ_DEPTH];
+    uint16_t head;
+    uint16_t tail;
+} Gw_TxQueue_t;
+
+/* 29-bit lookup entry, sorted by (bus, id) */
+typedef struct {
+    uint32_t key;           /* bus << 29 | id */
+    uint16_t route;
+} Gw_ExtIndex_t;
+
+static const Gw_Route_t *gw_routes = NULL;
+static uint16_t gw_route_count = 0;
+static const Gw_Callbacks_t *gw_cb = NULL;
+
+/* 11-bit: route index + 1 per (bus, id), 0 = not routed */
+static uint8_t gw_std_index[GW_MAX_BUSES][GW_STD_ID_COUNT];
+static Gw_ExtIndex_t gw_ext_index[GW_MAX_ROUTES];
+static uint16_t gw_ext_count = 0;
+
+static Gw_Frame_t gw_pool[GW_POOL_SIZE];
+static uint8_t gw_free[GW_POOL_SIZE];   /* Free list (stack) */
+static uint8_t gw_free_count = 0;
+
+static Gw_TxQueue_t gw_txq[GW_MAX_BUSES];
+static Gw_RouteStats_t gw_stats[GW_MAX_ROUTES][GW_MAX_DESTS];
+
+/* ============================================================================
+ * Implementation - Initialization
+ * ============================================================================ */
+
+bool Gw_Init(const Gw_Route_t *routes, uint16_t count, const Gw_Callbacks_t *callbacks)
+{
+    if (routes == NULL || callbacks == NULL || callbacks->link_tx == NULL ||
+        count > GW_MAX_ROUTES) {
+        return false;
+    }
+
+    gw_routes = routes;
+    gw_route_count = count;
+    gw_cb = callbacks;
+    gw_ext_count = 0;
+    memset(gw_std_index, 0, sizeof(gw_std_index));
+    memset(gw_txq, 0, sizeof(gw_txq));
+    memset(gw_stats, 0, sizeof(gw_stats));
+
+    for (uint8_t i = 0; i < GW_POOL_SIZE; i++) {
+        gw_free[i] = i;
+    }
+    gw_free_count = GW_POOL_SIZE;
+
+    for (uint16_t r = 0; r < count; r++) {
+        const Gw_Route_t *route = &routes[r];
+
+        if (route->src_bus >= GW_MAX_BUSES || route->dest_count == 0 ||
+            route->dest_count > GW_MAX_DESTS) {
+            return false;
+        }
+        for (uint8_t d = 0; d < route->dest_count; d++) {
+            if (route->dest[d].bus >= GW_MAX_BUSES) {
+                return false;
+            }
+        }
+
+        if (!route->src_ide) {
+            if (route->src_id >= GW_STD_ID_COUNT ||
+                gw_std_index[route->src_bus][route->src_id] != GW_NO_ROUTE) {
+                return false;
+            }
+            gw_std_index[route->src_bus][route->src_id] = (uint8_t)(r + 1U);
+        } else {
+            /* Insertion sort keeps the table ordered for binary search */
+            uint32_t key = ((uint32_t)route->src_bus << 29) | (route->src_id & 0x1FFFFFFFU);
+            uint16_t pos = gw_ext_count;
+
+            while (pos > 0 && gw_ext_index[pos - 1U].key > key) {
+                gw_ext_index[pos] = gw_ext_index[pos - 1U];
+                pos--;
+            }
+            if (pos > 0 && gw_ext_index[pos - 1U].key == key) {
+                return false;
+            }
+            gw_ext_index[pos].key = key;
+            gw_ext_index[pos].route = r;
+            gw_ext_count++;
+        }
+    }
+
+    return true;
+}
+
+/* ============================================================================
+ * Implementation - Lookup, Pool, Queues
+ * ============================================================================ */
+
+/**
+ * @brief Find the route of a frame
+ * @return Route index or -1
+ */
+static int32_t Gw_Lookup(uint8_t bus, uint32_t id, uint8_t ide)
+{
+    if (!ide) {
+        uint8_t idx = gw_std_index[bus][id & (GW_STD_ID_COUNT - 1U)];
+        return (idx != GW_NO_ROUTE) ? (int32_t)idx - 1 : -1;
+    } else {
+        uint32_t key = ((uint32_t)bus << 29) | (id & 0x1FFFFFFFU);
+        uint16_t lo = 0;
+        uint16_t hi = gw_ext_count;
+
+        while (lo < hi) {
+            uint16_t mid = (uint16_t)((lo + hi) / 2U);
+
+            if (gw_ext_index[mid].key == key) {
+                return gw_ext_index[mid].route;
+            }
+            if (gw_ext_index[mid].key < key) {
+                lo = mid + 1U;
+            } else {
+                hi = mid;
+            }
+        }
+        return -1;
+    }
+}
+
+static void Gw_ReleaseFrame(uint8_t frame)
+{
+    if (--gw_pool[frame].refs == 0) {
+        gw_free[gw_free_count++] = frame;
+    }
+}
+
+static bool Gw_Enqueue(uint8_t bus, uint8_t frame, uint16_t route, uint8_t dest)
+{
+    Gw_TxQueue_t *q = &gw_txq[bus];
+
+    if ((uint16_t)(q->head - q->tail) >= GW_TXQ_DEPTH) {
+        return false;
+    }
+    q->entry[q->head & (GW_TXQ_DEPTH - 1U)].frame = frame;
+    q->entry[q->head & (GW_TXQ_DEPTH - 1U)].route = route;
+    q->entry[q->head & (GW_TXQ_DEPTH - 1U)].dest = dest;
+    q->head++;
+    return true;
+}
+
+/* ============================================================================
+ * Implementation - Routing
+ * ============================================================================ */
+
+bool Gw_RxIndication(uint8_t bus, uint32_t id, uint8_t ide, uint8_t flags,
+                     const uint8_t *data, uint8_t len)
+{
+    const Gw_Route_t *route;
+    Gw_Frame_t *frame;
+    uint8_t frame_idx;
+    uint8_t queued_mask = 0;
+    int32_t r;
+
+    if (bus >= GW_MAX_BUSES || len > 64) {
+        return false;
+    }
+
+    /* Unrouted IDs cost one table read */
+    r = Gw_Lookup(bus, id, ide);
+    if (r < 0) {
+        return false;
+    }
+    route = &gw_routes[r];
+
+    GW_ENTER_CRITICAL();
+    if (gw_free_count == 0) {
+        GW_EXIT_CRITICAL();
+        for (uint8_t d = 0; d < route->dest_count; d++) {
+            gw_stats[r][d].dropped_queue++;
+        }
+        return true;
+    }
+    frame_idx = gw_free[--gw_free_count];
+    GW_EXIT_CRITICAL();
+
+    /* The only copy: controller RX buffer -> pool */
+    frame = &gw_pool[frame_idx];
+    frame->id = id;
+    frame->ide = ide;
+    frame->flags = flags;
+    frame->len = len;
+    frame->refs = 1;    /* Held by this function until all legs queued */
+    frame->rx_time_us = (gw_cb->get_time_us != NULL) ? gw_cb->get_time_us() : 0;
+    memcpy(frame->data, data, len);
+
+    for (uint8_t d = 0; d < route->dest_count; d++) {
+        const Gw_Dest_t *dest = &route->dest[d];
+
+        /* Classic CAN destinations take at most 8 bytes */
+        if (len > 8 && !(dest->flags & GW_FLAG_FD)) {
+            gw_stats[r][d].dropped_format++;
+            continue;
+        }
+
+        GW_ENTER_CRITICAL();
+        frame->refs++;
+        if (Gw_Enqueue(dest->bus, frame_idx, (uint16_t)r, d)) {
+            queued_mask |= (uint8_t)(1U << dest->bus);
+        } else {
+            frame->refs--;
+            gw_stats[r][d].dropped_queue++;
+        }
+        GW_EXIT_CRITICAL();
+    }
+
+    GW_ENTER_CRITICAL();
+    Gw_ReleaseFrame(frame_idx);
+    GW_EXIT_CRITICAL();
+
+    /* Start transmission on idle destination controllers right away */
+    for (uint8_t b = 0; b < GW_MAX_BUSES; b++) {
+        if (queued_mask & (1U << b)) {
+            Gw_TxPump(b);
+        }
+    }
+
+    return true;
+}
+
+void Gw_TxPump(uint8_t bus)
+{
+    Gw_TxQueue_t *q = &gw_txq[bus];
+
+    GW_ENTER_CRITICAL();
+    while (q->tail != q->head) {
+        Gw_TxEntry_t *e = &q->entry[q->tail & (GW_TXQ_DEPTH - 1U)];
+        Gw_Frame_t *frame = &gw_pool[e->frame];
+        const Gw_Dest_t *dest = &gw_routes[e->route].dest[e->dest];
+        Gw_RouteStats_t *stats = &gw_stats[e->route][e->dest];
+        uint32_t latency;
+
+        /* Format conversion is done here by the destination descriptor:
+         * the payload itself is never copied or rewritten */
+        if (!gw_cb->link_tx(bus, dest->id, dest->ide, dest->flags,
+                            frame->data, frame->len)) {
+            break;  /* No free mailbox - resumed from TX interrupt */
+        }
+
+        latency = (gw_cb->get_time_us != NULL) ?
+                  gw_cb->get_time_us() - frame->rx_time_us : 0;
+        stats->forwarded++;
+        stats->latency_sum_us += latency;
+        if (latency > stats->latency_max_us) {
+            stats->latency_max_us = latency;
+        }
+
+        q->tail++;
+        Gw_ReleaseFrame(e->frame);
+    }
+    GW_EXIT_CRITICAL();
+}
+
+/* ============================================================================
+ * Implementation - Statistics
+ * ============================================================================ */
+
+bool Gw_GetRouteStats(uint16_t route, uint8_t dest, Gw_RouteStats_t *stats)
+{
+    if (route >= gw_route_count || dest >= gw_routes[route].dest_count || stats == NULL) {
+        return false;
+    }
+
+    GW_ENTER_CRITICAL();
+    *stats = gw_stats[route][dest];
+    GW_EXIT_CRITICAL();
+    return true;
+}
+
+void Gw_ResetStats(void)
+{
+    GW_ENTER_CRITICAL();
+    memset(gw_stats, 0, sizeof(gw_stats));
+    GW_EXIT_CRITICAL();
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Bus 0: powertrain CAN 500k, bus 1: chassis CAN 500k, bus 2: backbone FD 2M
+enum { BUS_PT = 0, BUS_CH = 1, BUS_FD = 2 };
+
+static const Gw_Route_t routes[] = {
+    // 1:1, same format, same ID
+    { BUS_PT, 0, 0x120, 1, { { BUS_CH, 0, 0, 0x120 } } },
+    // 1:N, classic -> classic + FD (payload shared, flags per leg)
+    { BUS_PT, 0, 0x0A0, 2, { { BUS_CH, 0, 0, 0x0A0 },
+                             { BUS_FD, 0, GW_FLAG_FD | GW_FLAG_BRS, 0x0A0 } } },
+    // FD -> classic with ID remap (only forwarded while len <= 8)
+    { BUS_FD, 1, 0x18FF0010, 1, { { BUS_PT, 0, 0, 0x310 } } },
+};
+
+// One driver handle per bus, indexed by bus number (hcan->index == bus)
+CAN_Handle_t hcan1, hcan2;
+FDCAN_Handle_t hfdcan1;
+
+static bool link_tx(uint8_t bus, uint32_t id, uint8_t ide, uint8_t flags,
+                    const uint8_t *data, uint8_t len)
+{
+    CAN_TxMsg_t msg = { .id = id, .ide = ide, .rtr = 0, .dlc = len };
+
+    if (bus == BUS_FD) {
+        return FDCAN_Transmit(&hfdcan1, id, ide, flags, data, len);
+    }
+    memcpy(msg.data, data, len);
+    return CAN_Transmit((bus == BUS_PT) ? &hcan1 : &hcan2, &msg);
+}
+
+static const Gw_Callbacks_t gw_callbacks = {
+    .link_tx = link_tx,
+    .get_time_us = GetTimeUs,
+};
+
+// Shared by all classic controllers - the handle tells which bus
+static void gw_rx(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    if (!Gw_RxIndication(hcan->index, msg->id, msg->ide, 0, msg->data, msg->dlc)) {
+        // Not routed - local application
+    }
+}
+
+static void gw_tx_done(CAN_Handle_t *hcan, uint8_t mailbox)
+{
+    (void)mailbox;
+    Gw_TxPump(hcan->index);
+}
+
+void CAN1_RX0_IRQHandler(void) { CAN_RX_IRQHandler(&hcan1); }
+void CAN1_TX_IRQHandler(void)  { CAN_TX_IRQHandler(&hcan1); }
+void CAN2_RX0_IRQHandler(void) { CAN_RX_IRQHandler(&hcan2); }
+void CAN2_TX_IRQHandler(void)  { CAN_TX_IRQHandler(&hcan2); }
+
+void main(void)
+{
+    CAN_Init(&hcan1, CAN1, BUS_PT);
+    CAN_Init(&hcan2, CAN2, BUS_CH);
+    CAN_RegisterRxCallback(&hcan1, gw_rx);
+    CAN_RegisterRxCallback(&hcan2, gw_rx);
+    hcan1.tx_callback = gw_tx_done;
+    hcan2.tx_callback = gw_tx_done;
+    Gw_Init(routes, sizeof(routes) / sizeof(routes[0]), &gw_callbacks);
+    ...
+}
+*/
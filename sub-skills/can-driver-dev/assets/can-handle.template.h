@@ -0,0 +1,288 @@
+/**
+ * CAN Handle Template
+ *
+ * Shared types for the driver templates (init, filter, tx, rx).
+ * Every controller instance is described by one CAN_Handle_t that holds
+ * its register base, callbacks, RX ring and TX queue, so the same driver
+ * code serves CAN1, CAN2, ... without duplicated functions.
+ *
+ * Save as can_handle.h and include it from the driver sources.
+ */
+
+#ifndef CAN_HANDLE_H
+#define CAN_HANDLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* CAN_TypeDef comes from the MCU device header (or can-init.template.c)
+ * and CanTimer_t from can-timer.template.c; both must be included first */
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CAN_RX_RING_SIZE    32U     /* Frames buffered per instance (power of two) */
+#define CAN_TX_QUEUE_SIZE   16U     /* Frames queued when mailboxes are busy (power of two) */
+
+/* Hybrid RX (CAN_RxHybridTick): switch to polling when a rate window of
+ * CAN_RX_HYBRID_WINDOW ticks sees at least CAN_RX_HYBRID_ENTER frames,
+ * back to interrupts after CAN_RX_HYBRID_DRY_POLLS empty polls */
+#define CAN_RX_HYBRID_WINDOW        10U
+#define CAN_RX_HYBRID_ENTER         20U
+#define CAN_RX_HYBRID_DRY_POLLS     2U
+
+/* D-cache line size (Cortex-M7: 32 bytes). RX and TX state are kept on
+ * separate lines so the RX ISR and the TX path never share a line */
+#define CAN_CACHE_LINE      32U
+#define CAN_ALIGNED(n)      __attribute__((aligned(n)))
+
+/* Orders ring slot writes against index updates (single core) */
+#define CAN_BARRIER()       __asm volatile ("" ::: "memory")
+
+/* Called after register writes with hardware side effects (FIFO release,
+ * TX request, write-1-to-clear flags, mode requests). Empty on target;
+ * the host simulator (can-testing/assets/can-sim.template.c) defines it
+ * as CanSim_Sync(can) */
+#ifndef CAN_HW_SYNC
+#define CAN_HW_SYNC(can)    ((void)(can))
+#endif
+
+/* Hot path trace points (CAN_TRACE_POINT). Build with -DCAN_TRACE to log
+ * ISR entry/exit, FIFO depth, mailbox choice and callback duration into
+ * a per-instance ring (hcan->trace); without it they compile to nothing.
+ * Decode a dump of the ring with scripts/can_trace_decode.py */
+#ifdef CAN_TRACE
+#define CAN_TRACE_RING_SIZE     256U    /* Records per instance (power of two) */
+
+/* Timestamp source, default the Cortex-M3/4/7 DWT cycle counter. The host
+ * simulator (can_sim.h) supplies its own */
+#ifndef CAN_TRACE_CYCLES
+#define CAN_TRACE_CYCLES()      (*(volatile uint32_t *)0xE0001004U)  /* DWT_CYCCNT */
+#define CAN_TRACE_CYCLES_PER_US 72U     /* Core clock in MHz */
+#define CAN_TRACE_CLOCK_START() do { \
+        *(volatile uint32_t *)0xE000EDFCU |= (1U << 24);  /* DEMCR.TRCENA */ \
+        *(volatile uint32_t *)0xE0001000U |= 1U;          /* DWT_CTRL.CYCCNTENA */ \
+    } while (0)
+#endif
+#endif /* CAN_TRACE */
+
+/* Software acceptance filter (can-swfilter.template.c). Build with
+ * -DCAN_SW_FILTER when the node needs more RX IDs than filter banks:
+ * frames the hardware passes are checked against hcan->sw_filter before
+ * they reach the callback or the RX ring */
+#ifdef CAN_SW_FILTER
+struct CanSwf_Table_s;
+bool CanSwf_Accept(const struct CanSwf_Table_s *t, uint32_t id, uint8_t ide, uint8_t rtr);
+#endif
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief CAN TX message structure
+ */
+typedef struct {
+    uint32_t id;            /* Standard or Extended ID */
+    uint8_t  ide;           /* 0=Standard (11-bit), 1=Extended (29-bit) */
+    uint8_t  rtr;           /* 0=Data frame, 1=Remote frame */
+    uint8_t  dlc;           /* Data Length Code (0-8) */
+    uint8_t  data[8];       /* Data payload */
+} CAN_TxMsg_t;
+
+/**
+ * @brief CAN RX message structure
+ */
+typedef struct {
+    uint32_t id;            /* Standard or Extended ID */
+    uint8_t  ide;           /* 0=Standard (11-bit), 1=Extended (29-bit) */
+    uint8_t  rtr;           /* 0=Data frame, 1=Remote frame */
+    uint8_t  dlc;           /* Data Length Code (0-8) */
+    uint8_t  data[8];       /* Data payload */
+    uint8_t  fmi;           /* Filter Match Index */
+    uint16_t timestamp;     /* Hardware timestamp (if available) */
+} CAN_RxMsg_t;
+
+typedef struct CAN_Handle_s CAN_Handle_t;
+
+/* RX callback, runs in the RX interrupt of the instance */
+typedef void (*CAN_RxCallback_t)(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg);
+
+/* TX complete callback (frame acknowledged), runs in the TX interrupt */
+typedef void (*CAN_TxCallback_t)(CAN_Handle_t *hcan, uint8_t mailbox);
+
+/* Mode change done (CAN_SetMode), ok = false if not acknowledged in time.
+ * Runs in CanTimer_Tick(), or in the caller if acknowledged at once */
+typedef void (*CAN_ModeCallback_t)(CAN_Handle_t *hcan, bool ok);
+
+/**
+ * @brief Received frames not consumed by a callback
+ * Single producer (RX ISR) / single consumer (task)
+ */
+typedef struct {
+    volatile uint16_t head;         /* Written by RX ISR only */
+    volatile uint16_t tail;         /* Written by reader only */
+    uint32_t ring_overruns;         /* Dropped: ring full */
+    uint32_t fifo_overruns;         /* Dropped: hardware FIFO overrun */
+    CAN_RxMsg_t msg[CAN_RX_RING_SIZE];
+} CAN_RxRing_t;
+
+/**
+ * @brief Adaptive interrupt/polling state of the RX path
+ */
+typedef struct {
+    uint8_t  polling;               /* 1: FMPIE0 off, drained by CAN_RxHybridTick() */
+    uint8_t  dry_polls;             /* Consecutive polls that found the FIFO empty */
+    uint16_t window_ticks;
+    uint32_t window_frames;
+    uint32_t frames;                /* All frames read from the FIFO */
+    uint32_t irqs;                  /* RX interrupts taken (FMP0 + FULL0) */
+    uint32_t safety_irqs;           /* FULL0 interrupts while polling */
+    uint32_t mode_switches;
+} CAN_RxHybrid_t;
+
+/**
+ * @brief Frames waiting for a free mailbox
+ * Filled by CAN_TransmitQueued(), drained by CAN_TX_IRQHandler()
+ */
+typedef struct {
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    uint32_t dropped;               /* Dropped: queue full */
+    uint32_t timeouts;              /* Mailboxes aborted by CAN_TransmitTimeout() */
+    CAN_TxMsg_t msg[CAN_TX_QUEUE_SIZE];
+} CAN_TxQueue_t;
+
+#ifdef CAN_TRACE
+/**
+ * @brief Trace point IDs (CAN_TraceRec_t.event)
+ */
+typedef enum {
+    CAN_TRACE_RX_ISR_ENTER = 1,     /* arg8 = FIFO 0 depth */
+    CAN_TRACE_RX_ISR_EXIT,          /* arg16 = frames read */
+    CAN_TRACE_RX_CB_ENTER,          /* arg8 = FMI, arg16 = ID (low 16 bits) */
+    CAN_TRACE_RX_CB_EXIT,
+    CAN_TRACE_TX_ISR_ENTER,         /* arg8 = RQCP mailbox mask */
+    CAN_TRACE_TX_ISR_EXIT,          /* arg16 = frames left in the TX queue */
+    CAN_TRACE_TX_CB_ENTER,          /* arg8 = mailbox */
+    CAN_TRACE_TX_CB_EXIT,
+    CAN_TRACE_TX_MAILBOX            /* arg8 = mailbox (0xFF: none free), arg16 = ID */
+} CAN_TraceEvent_t;
+
+/**
+ * @brief Trace record (8 bytes)
+ */
+typedef struct {
+    uint32_t cycles;                /* CAN_TRACE_CYCLES() */
+    uint8_t  event;                 /* CAN_TraceEvent_t */
+    uint8_t  arg8;
+    uint16_t arg16;
+} CAN_TraceRec_t;
+
+#define CAN_TRACE_MAGIC     0x43525443U     /* "CTRC" in memory (little endian) */
+#define CAN_TRACE_VERSION   1U
+
+/**
+ * @brief Trace ring, also the dump format of scripts/can_trace_decode.py
+ * (e.g. gdb: dump binary value can1.trc hcan1.trace)
+ */
+typedef struct {
+    uint32_t magic;                 /* Header written by CAN_Init() */
+    uint16_t size;                  /* CAN_TRACE_RING_SIZE */
+    uint8_t  index;                 /* Controller number */
+    uint8_t  version;
+    uint32_t cycles_per_us;
+    uint32_t head;                  /* Records written, slots taken atomically */
+    CAN_TraceRec_t rec[CAN_TRACE_RING_SIZE];
+} CAN_TraceRing_t;
+#endif /* CAN_TRACE */
+
+/**
+ * @brief Controller instance
+ *
+ * Allocate one static handle per controller. Interrupt handlers pass the
+ * address of their own handle, which is a link-time constant, so the
+ * instance costs one pointer load (regs) per call and no table lookup.
+ */
+struct CAN_Handle_s {
+    /* Read-mostly, set by CAN_Init() */
+    CAN_TypeDef *regs;              /* Register base of this instance */
+    CAN_TypeDef *filter_regs;       /* Filter bank owner (CAN1 on dual bxCAN) */
+    uint8_t filter_base;            /* First filter bank of this instance */
+    uint8_t index;                  /* Controller number (0 = CAN1) */
+    CAN_RxCallback_t rx_callback;   /* NULL: frames go to the RX ring */
+    CAN_TxCallback_t tx_callback;
+    void *user;                     /* Owner context for callbacks */
+
+    /* Init/normal mode change in progress, acknowledge polled on the wheel */
+    CanTimer_t mode_timer;
+    CAN_ModeCallback_t mode_done;
+    uint16_t mode_wait;             /* Ticks left for INAK to follow INRQ */
+    uint8_t mode_init;              /* Requested mode: 1 = init, 0 = normal */
+
+    /* RX interrupt side */
+    CAN_ALIGNED(CAN_CACHE_LINE) CAN_RxRing_t rx;
+    CAN_RxHybrid_t rx_mode;
+#ifdef CAN_SW_FILTER
+    const struct CanSwf_Table_s *sw_filter; /* NULL: accept all */
+    uint32_t sw_rejected;           /* Dropped by sw_filter */
+#endif
+
+    /* TX side */
+    CAN_ALIGNED(CAN_CACHE_LINE) CAN_TxQueue_t tx;
+    CanTimer_t tx_timer[3];         /* Per mailbox, CAN_TransmitTimeout() */
+
+#ifdef CAN_TRACE
+    CAN_ALIGNED(CAN_CACHE_LINE) CAN_TraceRing_t trace;
+#endif
+};
+
+/* ============================================================================
+ * Trace Points
+ * ============================================================================ */
+
+#ifdef CAN_TRACE
+/* Timestamp first, then reserve the slot: a writer that preempts between
+ * the two lands in a later slot with a later timestamp, so ring order is
+ * time order without a lock (LDREX/STREX on Cortex-M3 and up) */
+static inline void CAN_TraceWrite(CAN_TraceRing_t *t, uint8_t event,
+                                  uint8_t arg8, uint16_t arg16)
+{
+    uint32_t cycles = CAN_TRACE_CYCLES();
+    uint32_t slot = __atomic_fetch_add(&t->head, 1U, __ATOMIC_RELAXED);
+    CAN_TraceRec_t *r = &t->rec[slot & (CAN_TRACE_RING_SIZE - 1U)];
+
+    r->cycles = cycles;
+    r->event = event;
+    r->arg8 = arg8;
+    r->arg16 = arg16;
+}
+
+#define CAN_TRACE_POINT(hcan, event, arg8, arg16) \
+    CAN_TraceWrite(&(hcan)->trace, (uint8_t)(event), (uint8_t)(arg8), (uint16_t)(arg16))
+#else
+#define CAN_TRACE_POINT(hcan, event, arg8, arg16)   ((void)0)
+#endif
+
+/* ============================================================================
+ * Software Acceptance Filter
+ * ============================================================================ */
+
+#ifdef CAN_SW_FILTER
+static inline bool CAN_SwAccept(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    if (hcan->sw_filter == NULL ||
+        CanSwf_Accept(hcan->sw_filter, msg->id, msg->ide, msg->rtr)) {
+        return true;
+    }
+    hcan->sw_rejected++;
+    return false;
+}
+
+#define CAN_SW_ACCEPT(hcan, msg)    CAN_SwAccept((hcan), (msg))
+#else
+#define CAN_SW_ACCEPT(hcan, msg)    (true)
+#endif
+
+#endif /* CAN_HANDLE_H */
@@ -2,11 +2,16 @@
  * CAN Initialization Template
  * 
  * This template provides a basic CAN initialization structure.
+ * All functions take the controller handle (can-handle.template.h), so one
+ * copy of the driver serves every CAN instance.
+ * Mode changes never spin on INAK: the acknowledge is polled on the timer
+ * wheel (can-timer.template.c) and reported through a callback.
  * Adapt register names and addresses for your specific MCU.
  */
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 /* ============================================================================
  * Configuration - Modify these for your application
@@ -31,6 +36,15 @@
 #define CAN_GPIO_PORT       /* GPIO port */
 #define CAN_AF_NUM          /* Alternate function number */
 
+/* INAK must follow INRQ within this time: entering init mode waits for
+ * the frame on the bus to end, leaving it for 11 recessive bits */
+#define CAN_MODE_TIMEOUT_MS     20U
+
+/* Dual bxCAN: filter banks live in the master (CAN1) registers and are
+ * split at CAN2SB between the two instances */
+#define CAN_MASTER_REGS     CAN1
+#define CAN_SLAVE_FILTER_START  14U
+
 /* ============================================================================
  * Register Definitions - Adapt for your MCU
  * ============================================================================ */
@@ -52,64 +66,91 @@ typedef struct {
 
 /* Register bit definitions */
 #define CAN_MCR_INRQ        (1U << 0)    /* Initialization Request */
+#define CAN_MCR_SLEEP       (1U << 1)    /* Sleep Mode Request (set after reset) */
 #define CAN_MCR_ABOM        (1U << 6)    /* Automatic Bus-Off Management */
 #define CAN_MSR_INAK        (1U << 0)    /* Initialization Acknowledge */
 
+#include "can_handle.h"
+
 /* ============================================================================
  * Function Prototypes
  * ============================================================================ */
 
 /**
  * @brief Initialize CAN peripheral
- * @return true if successful, false otherwise
+ * Bit timing is written once init mode is acknowledged, then normal mode
+ * is requested; both steps complete on the timer wheel. Filters,
+ * interrupts and TX requests may be set up right away - frames go out
+ * once the controller has synchronized to the bus.
+ * @param hcan Handle of this instance (state is reset)
+ * @param regs Register base (CAN1, CAN2, ...)
+ * @param index Controller number (0 = CAN1)
+ * @return true if started
  */
-bool CAN_Init(void);
+bool CAN_Init(CAN_Handle_t *hcan, CAN_TypeDef *regs, uint8_t index);
 
 /**
  * @brief Configure CAN GPIO pins
  */
-void CAN_GPIO_Init(void);
+void CAN_GPIO_Init(CAN_Handle_t *hcan);
 
 /**
  * @brief Configure CAN clock
  */
-void CAN_Clock_Init(void);
+void CAN_Clock_Init(CAN_Handle_t *hcan);
 
 /**
  * @brief Configure CAN filters
  */
-void CAN_Filter_Init(void);
+void CAN_Filter_Init(CAN_Handle_t *hcan);
+
+/**
+ * @brief Request initialization mode (does not wait)
+ * @return true if already acknowledged (INAK set)
+ */
+bool CAN_EnterInitMode(CAN_Handle_t *hcan);
+
+/**
+ * @brief Request normal mode (does not wait)
+ * @return true if already acknowledged (INAK clear)
+ */
+bool CAN_ExitInitMode(CAN_Handle_t *hcan);
+
+/**
+ * @brief Check if the controller is in initialization mode (INAK)
+ */
+bool CAN_IsInitMode(const CAN_Handle_t *hcan);
 
 /**
- * @brief Enter initialization mode
- * @return true if successful
+ * @brief Change mode and get called back when it is acknowledged
+ * INAK is checked every tick for up to CAN_MODE_TIMEOUT_MS. A new
+ * request replaces one still waiting (its callback is not called).
+ * @param hcan Controller handle
+ * @param init true: initialization mode, false: normal mode
+ * @param done Completion callback (may be NULL)
  */
-bool CAN_EnterInitMode(void);
+void CAN_SetMode(CAN_Handle_t *hcan, bool init, CAN_ModeCallback_t done);
 
 /**
- * @brief Exit initialization mode
- * @return true if successful
+ * @brief Check if a mode change (CAN_Init() included) is still waiting
  */
-bool CAN_ExitInitMode(void);
+bool CAN_IsModePending(const CAN_Handle_t *hcan);
 
 /* ============================================================================
  * Implementation
  * ============================================================================ */
 
-bool CAN_Init(void)
+static void CAN_ModePoll(CanTimer_t *timer, void *arg);
+
+static void CAN_InitConfigure(CAN_Handle_t *hcan, bool ok)
 {
-    /* Step 1: Enable clocks */
-    CAN_Clock_Init();
-    
-    /* Step 2: Configure GPIO */
-    CAN_GPIO_Init();
+    CAN_TypeDef *can = hcan->regs;
     
-    /* Step 3: Enter initialization mode */
-    if (!CAN_EnterInitMode()) {
-        return false;
+    if (!ok) {
+        return;  /* Still in the previous mode, see CAN_IsInitMode() */
     }
     
-    /* Step 4: Configure bit timing */
+    /* Configure bit timing */
     /* BTR register format:
      * [9:0]   BRP  - Baud Rate Prescaler (value - 1)
      * [15:10] Reserved
@@ -117,83 +158,170 @@ bool CAN_Init(void)
      * [22:20] TS2  - Time Segment 2 (value - 1)
      * [25:24] SJW  - Synchronization Jump Width (value - 1)
      */
-    CAN->BTR = ((CAN_PRESCALER - 1) << 0) |
+    can->BTR = ((CAN_PRESCALER - 1) << 0) |
                ((CAN_TIME_SEG1 - 1) << 16) |
                ((CAN_TIME_SEG2 - 1) << 20) |
                ((CAN_SJW - 1) << 24);
     
-    /* Step 5: Configure options */
-    CAN->MCR |= CAN_MCR_ABOM;  /* Enable automatic bus-off management */
-    
-    /* Step 6: Configure filters */
-    CAN_Filter_Init();
+    /* Join the bus */
+    CAN_SetMode(hcan, false, NULL);
+}
+
+bool CAN_Init(CAN_Handle_t *hcan, CAN_TypeDef *regs, uint8_t index)
+{
+    CAN_TypeDef *can = regs;
     
-    /* Step 7: Exit initialization mode */
-    if (!CAN_ExitInitMode()) {
-        return false;
+    /* Step 0: Reset instance state (timers of a previous init disarmed first) */
+    CanTimer_Stop(&hcan->mode_timer);
+    for (uint8_t mb = 0; mb < 3; mb++) {
+        CanTimer_Stop(&hcan->tx_timer[mb]);
     }
+    memset(hcan, 0, sizeof(*hcan));
+    hcan->regs = regs;
+    hcan->index = index;
+    hcan->filter_regs = CAN_MASTER_REGS;
+    hcan->filter_base = (index == 0) ? 0 : CAN_SLAVE_FILTER_START;
+    CanTimer_Setup(&hcan->mode_timer, CAN_ModePoll, hcan);
+#ifdef CAN_TRACE
+    hcan->trace.magic = CAN_TRACE_MAGIC;
+    hcan->trace.size = CAN_TRACE_RING_SIZE;
+    hcan->trace.index = index;
+    hcan->trace.version = CAN_TRACE_VERSION;
+    hcan->trace.cycles_per_us = CAN_TRACE_CYCLES_PER_US;
+    CAN_TRACE_CLOCK_START();
+#endif
+    
+    /* Step 1: Enable clocks */
+    CAN_Clock_Init(hcan);
+    
+    /* Step 2: Configure GPIO */
+    CAN_GPIO_Init(hcan);
+    
+    /* Step 3: Configure options */
+    /* Enable automatic bus-off management
+     * (CanErr_Init() in can-error.template.c takes this over) */
+    can->MCR |= CAN_MCR_ABOM;
+    
+    /* Step 4: Configure filters (own init mode, FMR.FINIT) */
+    CAN_Filter_Init(hcan);
+    
+    /* Step 5: Enter initialization mode; bit timing and the switch to
+     * normal mode follow in CAN_InitConfigure() once INAK is set */
+    CAN_SetMode(hcan, true, CAN_InitConfigure);
     
     return true;
 }
 
-bool CAN_EnterInitMode(void)
+bool CAN_EnterInitMode(CAN_Handle_t *hcan)
 {
-    uint32_t timeout = 0xFFFF;
+    CAN_TypeDef *can = hcan->regs;
+    
+    /* Leave sleep mode (reset state) together with the init request */
+    can->MCR = (can->MCR & ~CAN_MCR_SLEEP) | CAN_MCR_INRQ;
+    CAN_HW_SYNC(can);
     
-    CAN->MCR |= CAN_MCR_INRQ;
+    return (can->MSR & CAN_MSR_INAK) != 0;
+}
+
+bool CAN_ExitInitMode(CAN_Handle_t *hcan)
+{
+    CAN_TypeDef *can = hcan->regs;
     
-    while (!(CAN->MSR & CAN_MSR_INAK)) {
-        if (--timeout == 0) {
-            return false;  /* Timeout */
-        }
+    can->MCR &= ~CAN_MCR_INRQ;
+    CAN_HW_SYNC(can);
+    
+    return (can->MSR & CAN_MSR_INAK) == 0;
+}
+
+bool CAN_IsInitMode(const CAN_Handle_t *hcan)
+{
+    return (hcan->regs->MSR & CAN_MSR_INAK) != 0;
+}
+
+static void CAN_ModeDone(CAN_Handle_t *hcan, bool ok)
+{
+    CAN_ModeCallback_t done = hcan->mode_done;
+    
+    hcan->mode_done = NULL;
+    if (done != NULL) {
+        done(hcan, ok);
     }
+}
+
+static void CAN_ModePoll(CanTimer_t *timer, void *arg)
+{
+    CAN_Handle_t *hcan = (CAN_Handle_t *)arg;
     
-    return true;
+    if (CAN_IsInitMode(hcan) == (hcan->mode_init != 0)) {
+        CAN_ModeDone(hcan, true);
+    } else if (--hcan->mode_wait == 0) {
+        CAN_ModeDone(hcan, false);
+    } else {
+        CanTimer_Start(timer, 1U);
+    }
 }
 
-bool CAN_ExitInitMode(void)
+void CAN_SetMode(CAN_Handle_t *hcan, bool init, CAN_ModeCallback_t done)
 {
-    uint32_t timeout = 0xFFFF;
+    bool acked = init ? CAN_EnterInitMode(hcan) : CAN_ExitInitMode(hcan);
     
-    CAN->MCR &= ~CAN_MCR_INRQ;
+    CanTimer_Stop(&hcan->mode_timer);
+    hcan->mode_done = done;
+    hcan->mode_init = init ? 1U : 0U;
     
-    while (CAN->MSR & CAN_MSR_INAK) {
-        if (--timeout == 0) {
-            return false;  /* Timeout */
-        }
+    if (acked) {
+        CAN_ModeDone(hcan, true);
+        return;
     }
     
-    return true;
+    hcan->mode_wait = (uint16_t)CAN_TIMER_MS_TO_TICKS(CAN_MODE_TIMEOUT_MS);
+    CanTimer_Start(&hcan->mode_timer, 1U);
+}
+
+bool CAN_IsModePending(const CAN_Handle_t *hcan)
+{
+    return CanTimer_IsActive(&hcan->mode_timer);
 }
 
-void CAN_Filter_Init(void)
+void CAN_Filter_Init(CAN_Handle_t *hcan)
 {
+    CAN_TypeDef *fc = hcan->filter_regs;
+    uint8_t bank = hcan->filter_base;
+    
     /* Enter filter initialization mode */
-    CAN->FMR |= (1U << 0);
+    fc->FMR |= (1U << 0);
+    
+    /* Master instance assigns banks from CAN2SB on to the slave */
+    if (hcan->index == 0) {
+        fc->FMR = (fc->FMR & ~(0x3FU << 8)) | (CAN_SLAVE_FILTER_START << 8);
+    }
     
-    /* Configure Filter 0:
+    /* Configure the first bank of this instance:
      * - 32-bit mask mode
      * - Accept all messages
      */
     /* Set filter to accept all (ID=0, Mask=0) */
-    CAN->sFilterRegister[0].FR1 = 0;
-    CAN->sFilterRegister[0].FR2 = 0;
+    fc->sFilterRegister[bank].FR1 = 0;
+    fc->sFilterRegister[bank].FR2 = 0;
     
-    /* Activate filter 0 */
-    CAN->FA1R |= (1U << 0);
+    /* Activate filter */
+    fc->FA1R |= (1U << bank);
     
     /* Exit filter initialization mode */
-    CAN->FMR &= ~(1U << 0);
+    fc->FMR &= ~(1U << 0);
 }
 
 /* ============================================================================
  * Clock and GPIO Configuration (MCU-specific)
  * ============================================================================ */
 
-void CAN_Clock_Init(void)
+void CAN_Clock_Init(CAN_Handle_t *hcan)
 {
+    (void)hcan;
+    
     /* TODO: Implement for your MCU
-     * - Enable CAN peripheral clock
+     * - Enable CAN peripheral clock of hcan->index
+     *   (CAN2 on bxCAN also needs the CAN1 clock for the filter banks)
      * - Enable GPIO port clock
      * 
      * Example for STM32:
@@ -202,9 +330,11 @@ void CAN_Clock_Init(void)
      */
 }
 
-void CAN_GPIO_Init(void)
+void CAN_GPIO_Init(CAN_Handle_t *hcan)
 {
-    /* TODO: Implement for your MCU
+    (void)hcan;
+    
+    /* TODO: Implement for your MCU, pins selected by hcan->index
      * - Set GPIO mode to alternate function
      * - Set alternate function number
      * - Configure pull-up/pull-down
@@ -216,3 +346,19 @@ void CAN_GPIO_Init(void)
      * GPIOA->AFR[1] |= (9U << ((11 - 8) * 4));  // AF9 for CAN1
      */
 }
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+CAN_Handle_t hcan1;
+CAN_Handle_t hcan2;
+
+void main(void)
+{
+    CanTimer_Init();                // Mode changes complete on the wheel
+    CAN_Init(&hcan1, CAN1, 0);
+    CAN_Init(&hcan2, CAN2, 1);
+}
+*/
@@ -0,0 +1,665 @@
+/**
+ * CAN Network Management (CanNm) Template
+ *
+ * This template provides the AUTOSAR-style CanNm state machine for
+ * coordinated sleep/wakeup on top of the CAN TX/RX templates:
+ * - Bus-Sleep, Prepare Bus-Sleep and Network Mode (Repeat Message,
+ *   Normal Operation, Ready Sleep) per channel
+ * - T_NM_MessageCycle, T_NM_Timeout, T_Repeat_Message and T_Wait_BusSleep
+ *   run on the shared timer wheel: no per-channel polling, a tick costs
+ *   only the timers that are due, however many channels are configured
+ * - Immediate NM transmissions (fast burst) after an active wakeup
+ * - NM frame fast path: one mask compare per received frame rejects
+ *   non-NM traffic before any other dispatch
+ *
+ * Requires: can-timer.template.c
+ * Read references/cannm-network-management.md for the state machine.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANNM_MAX_CHANNELS      8U       /* One per CAN bus with NM */
+#define CANNM_PDU_LENGTH        8U       /* NM PDU: NID, CBV, 6 user bytes */
+#define CANNM_USER_DATA_LENGTH  (CANNM_PDU_LENGTH - 2U)
+
+/* Default timing (references/cannm-network-management.md) */
+#define CANNM_MSG_CYCLE_MS      500U     /* T_NM_MessageCycle */
+#define CANNM_TIMEOUT_MS        2000U    /* T_NM_Timeout */
+#define CANNM_REPEAT_MESSAGE_MS 1500U    /* T_Repeat_Message */
+#define CANNM_WAIT_BUS_SLEEP_MS 5000U    /* T_Wait_BusSleep */
+#define CANNM_IMMEDIATE_CYCLE_MS 20U     /* Cycle of immediate transmissions */
+
+/* ============================================================================
+ * Protocol Definitions
+ * ============================================================================ */
+
+/* NM PDU byte positions */
+#define CANNM_PDU_NID           0U       /* Source node identifier */
+#define CANNM_PDU_CBV           1U       /* Control bit vector */
+
+/* Control bit vector */
+#define CANNM_CBV_REPEAT_MSG    0x01U    /* Repeat Message Request */
+#define CANNM_CBV_ACTIVE_WAKEUP 0x10U    /* Node woke the network */
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef enum {
+    CANNM_STATE_BUS_SLEEP = 0,
+    CANNM_STATE_PREPARE_BUS_SLEEP,
+    CANNM_STATE_REPEAT_MESSAGE,
+    CANNM_STATE_NORMAL_OPERATION,
+    CANNM_STATE_READY_SLEEP
+} CanNm_State_t;
+
+typedef enum {
+    CANNM_MODE_BUS_SLEEP = 0,
+    CANNM_MODE_PREPARE_BUS_SLEEP,
+    CANNM_MODE_NETWORK
+} CanNm_Mode_t;
+
+/**
+ * @brief Static channel configuration
+ * NM frames are recognised by (id & rx_mask) == rx_base, e.g. base 0x500,
+ * mask 0x700 for the usual 0x500-0x5FF NM range.
+ */
+typedef struct {
+    uint32_t tx_id;             /* NM PDU ID of this node */
+    uint32_t rx_base;           /* NM ID range */
+    uint32_t rx_mask;
+    uint8_t  ide;               /* 0=Standard (11-bit), 1=Extended (29-bit) */
+    uint8_t  node_id;           /* Sent in byte CANNM_PDU_NID */
+    uint8_t  immediate_count;   /* NM frames sent fast after active wakeup, 0: off */
+    uint16_t msg_cycle_ms;      /* 0 = CANNM_MSG_CYCLE_MS */
+    uint16_t msg_offset_ms;     /* First frame after entering Repeat Message */
+    uint16_t timeout_ms;        /* 0 = CANNM_TIMEOUT_MS */
+    uint16_t repeat_message_ms; /* 0 = CANNM_REPEAT_MESSAGE_MS */
+    uint16_t wait_bus_sleep_ms; /* 0 = CANNM_WAIT_BUS_SLEEP_MS */
+    uint16_t immediate_cycle_ms; /* 0 = CANNM_IMMEDIATE_CYCLE_MS */
+} CanNm_ChannelConfig_t;
+
+/**
+ * @brief Lower layer and ComM/application hooks (NULL: not used, except link_tx)
+ */
+typedef struct {
+    /* Queue the NM PDU; false if no TX mailbox is free (retried next tick) */
+    bool (*link_tx)(uint8_t channel, uint32_t id, uint8_t ide,
+                    const uint8_t *data, uint8_t len);
+
+    /* NM frame received in Bus-Sleep: wake up and call CanNm_PassiveStartUp() */
+    void (*network_start)(uint8_t channel);
+
+    /* Network Mode entered: start application TX */
+    void (*network_mode)(uint8_t channel);
+
+    /* Prepare Bus-Sleep entered: stop application TX */
+    void (*prepare_bus_sleep)(uint8_t channel);
+
+    /* Bus-Sleep entered: transceiver to sleep/standby */
+    void (*bus_sleep)(uint8_t channel);
+
+    /* Any state change */
+    void (*state_change)(uint8_t channel, CanNm_State_t from, CanNm_State_t to);
+} CanNm_Callbacks_t;
+
+/**
+ * @brief Counters per channel
+ */
+typedef struct {
+    uint32_t rx_pdus;
+    uint32_t tx_pdus;
+    uint32_t tx_busy;           /* link_tx refused, retried */
+    uint32_t timeouts;          /* T_NM_Timeout in Repeat Message / Normal */
+    uint32_t wakeups;           /* Bus-Sleep / Prepare -> Network Mode */
+} CanNm_Stats_t;
+
+/**
+ * @brief Channel runtime state
+ */
+typedef struct {
+    const CanNm_ChannelConfig_t *cfg;
+    uint8_t  state;             /* CanNm_State_t */
+    uint8_t  requested;         /* Network requested by this node */
+    uint8_t  immediate_left;    /* Immediate transmissions still to send */
+    uint8_t  last_rx_node;      /* NID of the last received NM PDU */
+    uint8_t  pdu[CANNM_PDU_LENGTH];
+    CanTimer_t msg_timer;       /* T_NM_MessageCycle, immediate cycle, TX retry */
+    CanTimer_t timeout_timer;   /* T_NM_Timeout */
+    CanTimer_t state_timer;     /* T_Repeat_Message or T_Wait_BusSleep */
+    CanNm_Stats_t stats;
+} CanNm_Channel_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Initialize CanNm, all channels start in Bus-Sleep
+ * @param configs Array of channel configurations (index = channel number)
+ * @param count Number of channels (<= CANNM_MAX_CHANNELS)
+ * @param callbacks Lower layer and ComM hooks
+ * @return true if successful
+ */
+bool CanNm_Init(const CanNm_ChannelConfig_t *configs, uint8_t count,
+                const CanNm_Callbacks_t *callbacks);
+
+/**
+ * @brief This node needs the network (active wakeup from sleep)
+ */
+bool CanNm_NetworkRequest(uint8_t channel);
+
+/**
+ * @brief This node no longer needs the network
+ */
+bool CanNm_NetworkRelease(uint8_t channel);
+
+/**
+ * @brief Join the network after network_start (passive wakeup)
+ */
+bool CanNm_PassiveStartUp(uint8_t channel);
+
+/**
+ * @brief Ask all nodes to enter Repeat Message (node detection)
+ */
+bool CanNm_RepeatMessageRequest(uint8_t channel);
+
+/**
+ * @brief Set the user data bytes of the NM PDU
+ */
+bool CanNm_SetUserData(uint8_t channel, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Get state and mode of a channel
+ */
+bool CanNm_GetState(uint8_t channel, CanNm_State_t *state, CanNm_Mode_t *mode);
+
+/**
+ * @brief Feed a received frame (call first in the RX callback of the bus)
+ * @param channel NM channel of the controller that received the frame
+ * @return true if the frame was an NM PDU (consumed)
+ */
+bool CanNm_RxIndication(uint8_t channel, uint32_t id, uint8_t ide,
+                        const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Link layer confirmed transmission of the NM PDU
+ */
+void CanNm_TxConfirmation(uint8_t channel);
+
+const CanNm_Stats_t *CanNm_GetStats(uint8_t channel);
+
+/* ============================================================================
+ * Implementation - Helpers
+ * ============================================================================ */
+
+static CanNm_Channel_t cannm_channels[CANNM_MAX_CHANNELS];
+static uint8_t cannm_channel_count = 0;
+static const CanNm_Callbacks_t *cannm_cb = NULL;
+
+static void CanNm_MsgTimeout(CanTimer_t *timer, void *arg);
+static void CanNm_NmTimeout(CanTimer_t *timer, void *arg);
+static void CanNm_StateTimeout(CanTimer_t *timer, void *arg);
+
+static uint8_t CanNm_Index(const CanNm_Channel_t *ch)
+{
+    return (uint8_t)(ch - cannm_channels);
+}
+
+/* Configured time or the default, in timer ticks */
+static uint32_t CanNm_Ticks(uint16_t ms, uint16_t default_ms)
+{
+    return CAN_TIMER_MS_TO_TICKS(ms ? ms : default_ms);
+}
+
+static void CanNm_StartTimeout(CanNm_Channel_t *ch)
+{
+    CanTimer_Start(&ch->timeout_timer,
+                   CanNm_Ticks(ch->cfg->timeout_ms, CANNM_TIMEOUT_MS));
+}
+
+static void CanNm_SetState(CanNm_Channel_t *ch, CanNm_State_t state)
+{
+    CanNm_State_t from = (CanNm_State_t)ch->state;
+
+    ch->state = (uint8_t)state;
+    if (cannm_cb->state_change != NULL) {
+        cannm_cb->state_change(CanNm_Index(ch), from, state);
+    }
+}
+
+/**
+ * @brief Send the NM PDU and schedule the next one
+ * Immediate transmissions use the short cycle; a busy link retries on
+ * the next tick without consuming one.
+ */
+static void CanNm_Transmit(CanNm_Channel_t *ch)
+{
+    const CanNm_ChannelConfig_t *cfg = ch->cfg;
+
+    if (!cannm_cb->link_tx(CanNm_Index(ch), cfg->tx_id, cfg->ide,
+                           ch->pdu, CANNM_PDU_LENGTH)) {
+        ch->stats.tx_busy++;
+        CanTimer_Start(&ch->msg_timer, 1);
+        return;
+    }
+
+    ch->stats.tx_pdus++;
+    if (ch->immediate_left > 0) {
+        ch->immediate_left--;
+    }
+    if (ch->immediate_left > 0) {
+        CanTimer_Start(&ch->msg_timer,
+                       CanNm_Ticks(cfg->immediate_cycle_ms, CANNM_IMMEDIATE_CYCLE_MS));
+    } else {
+        CanTimer_Start(&ch->msg_timer,
+                       CanNm_Ticks(cfg->msg_cycle_ms, CANNM_MSG_CYCLE_MS));
+    }
+}
+
+/* ============================================================================
+ * Implementation - State Transitions
+ * ============================================================================ */
+
+static void CanNm_EnterRepeatMessage(CanNm_Channel_t *ch)
+{
+    const CanNm_ChannelConfig_t *cfg = ch->cfg;
+    bool wakeup = (ch->state == CANNM_STATE_BUS_SLEEP ||
+                   ch->state == CANNM_STATE_PREPARE_BUS_SLEEP);
+
+    CanNm_SetState(ch, CANNM_STATE_REPEAT_MESSAGE);
+    CanTimer_Start(&ch->state_timer,
+                   CanNm_Ticks(cfg->repeat_message_ms, CANNM_REPEAT_MESSAGE_MS));
+    CanNm_StartTimeout(ch);
+
+    if (ch->immediate_left > 0) {
+        CanNm_Transmit(ch);                 /* First burst frame right away */
+    } else if (!CanTimer_IsActive(&ch->msg_timer)) {
+        CanTimer_Start(&ch->msg_timer, CAN_TIMER_MS_TO_TICKS(cfg->msg_offset_ms));
+    }
+
+    if (wakeup) {
+        ch->stats.wakeups++;
+        if (cannm_cb->network_mode != NULL) {
+            cannm_cb->network_mode(CanNm_Index(ch));
+        }
+    }
+}
+
+static void CanNm_EnterNormalOperation(CanNm_Channel_t *ch)
+{
+    ch->pdu[CANNM_PDU_CBV] &= (uint8_t)~CANNM_CBV_REPEAT_MSG;
+    CanNm_SetState(ch, CANNM_STATE_NORMAL_OPERATION);
+    if (!CanTimer_IsActive(&ch->msg_timer)) {
+        CanTimer_Start(&ch->msg_timer, 1);  /* From Ready Sleep: resume TX */
+    }
+}
+
+static void CanNm_EnterReadySleep(CanNm_Channel_t *ch)
+{
+    ch->pdu[CANNM_PDU_CBV] &= (uint8_t)~CANNM_CBV_REPEAT_MSG;
+    ch->immediate_left = 0;
+    CanTimer_Stop(&ch->msg_timer);          /* NM TX stops, application TX goes on */
+    CanTimer_Stop(&ch->state_timer);
+    CanNm_SetState(ch, CANNM_STATE_READY_SLEEP);
+}
+
+static void CanNm_EnterPrepareBusSleep(CanNm_Channel_t *ch)
+{
+    CanTimer_Stop(&ch->msg_timer);
+    CanTimer_Stop(&ch->timeout_timer);
+    CanTimer_Start(&ch->state_timer,
+                   CanNm_Ticks(ch->cfg->wait_bus_sleep_ms, CANNM_WAIT_BUS_SLEEP_MS));
+    ch->pdu[CANNM_PDU_CBV] = 0;
+    CanNm_SetState(ch, CANNM_STATE_PREPARE_BUS_SLEEP);
+
+    if (cannm_cb->prepare_bus_sleep != NULL) {
+        cannm_cb->prepare_bus_sleep(CanNm_Index(ch));
+    }
+}
+
+static void CanNm_EnterBusSleep(CanNm_Channel_t *ch)
+{
+    CanTimer_Stop(&ch->msg_timer);
+    CanTimer_Stop(&ch->timeout_timer);
+    CanTimer_Stop(&ch->state_timer);
+    CanNm_SetState(ch, CANNM_STATE_BUS_SLEEP);
+
+    if (cannm_cb->bus_sleep != NULL) {
+        cannm_cb->bus_sleep(CanNm_Index(ch));
+    }
+}
+
+/* ============================================================================
+ * Implementation - API
+ * ============================================================================ */
+
+bool CanNm_Init(const CanNm_ChannelConfig_t *configs, uint8_t count,
+                const CanNm_Callbacks_t *callbacks)
+{
+    if (configs == NULL || callbacks == NULL || callbacks->link_tx == NULL ||
+        count > CANNM_MAX_CHANNELS) {
+        return false;
+    }
+
+    cannm_cb = callbacks;
+    cannm_channel_count = count;
+
+    for (uint8_t i = 0; i < count; i++) {
+        CanNm_Channel_t *ch = &cannm_channels[i];
+
+        memset(ch, 0, sizeof(*ch));
+        ch->cfg = &configs[i];
+        ch->state = CANNM_STATE_BUS_SLEEP;
+        ch->pdu[CANNM_PDU_NID] = configs[i].node_id;
+        CanTimer_Setup(&ch->msg_timer, CanNm_MsgTimeout, ch);
+        CanTimer_Setup(&ch->timeout_timer, CanNm_NmTimeout, ch);
+        CanTimer_Setup(&ch->state_timer, CanNm_StateTimeout, ch);
+    }
+
+    return true;
+}
+
+bool CanNm_NetworkRequest(uint8_t channel)
+{
+    CanNm_Channel_t *ch;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    ch = &cannm_channels[channel];
+    ch->requested = 1;
+
+    switch (ch->state) {
+    case CANNM_STATE_BUS_SLEEP:
+    case CANNM_STATE_PREPARE_BUS_SLEEP:
+        /* Active wakeup: tell the others fast */
+        ch->pdu[CANNM_PDU_CBV] |= CANNM_CBV_ACTIVE_WAKEUP;
+        ch->immediate_left = ch->cfg->immediate_count;
+        CanNm_EnterRepeatMessage(ch);
+        break;
+    case CANNM_STATE_READY_SLEEP:
+        CanNm_EnterNormalOperation(ch);
+        break;
+    default:
+        break;  /* Repeat Message decides on expiry, Normal stays */
+    }
+
+    return true;
+}
+
+bool CanNm_NetworkRelease(uint8_t channel)
+{
+    CanNm_Channel_t *ch;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    ch = &cannm_channels[channel];
+    ch->requested = 0;
+
+    if (ch->state == CANNM_STATE_NORMAL_OPERATION) {
+        CanNm_EnterReadySleep(ch);
+    }
+
+    return true;
+}
+
+bool CanNm_PassiveStartUp(uint8_t channel)
+{
+    CanNm_Channel_t *ch;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    ch = &cannm_channels[channel];
+
+    if (ch->state != CANNM_STATE_BUS_SLEEP &&
+        ch->state != CANNM_STATE_PREPARE_BUS_SLEEP) {
+        return false;
+    }
+    CanNm_EnterRepeatMessage(ch);
+
+    return true;
+}
+
+bool CanNm_RepeatMessageRequest(uint8_t channel)
+{
+    CanNm_Channel_t *ch;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    ch = &cannm_channels[channel];
+
+    if (ch->state != CANNM_STATE_NORMAL_OPERATION &&
+        ch->state != CANNM_STATE_READY_SLEEP) {
+        return false;
+    }
+    ch->pdu[CANNM_PDU_CBV] |= CANNM_CBV_REPEAT_MSG;
+    CanNm_EnterRepeatMessage(ch);
+
+    return true;
+}
+
+bool CanNm_SetUserData(uint8_t channel, const uint8_t *data, uint8_t len)
+{
+    if (channel >= cannm_channel_count || len > CANNM_USER_DATA_LENGTH) {
+        return false;
+    }
+    memcpy(&cannm_channels[channel].pdu[2], data, len);
+
+    return true;
+}
+
+bool CanNm_GetState(uint8_t channel, CanNm_State_t *state, CanNm_Mode_t *mode)
+{
+    CanNm_State_t s;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    s = (CanNm_State_t)cannm_channels[channel].state;
+
+    *state = s;
+    *mode = (s == CANNM_STATE_BUS_SLEEP) ? CANNM_MODE_BUS_SLEEP :
+            (s == CANNM_STATE_PREPARE_BUS_SLEEP) ? CANNM_MODE_PREPARE_BUS_SLEEP :
+            CANNM_MODE_NETWORK;
+
+    return true;
+}
+
+bool CanNm_RxIndication(uint8_t channel, uint32_t id, uint8_t ide,
+                        const uint8_t *data, uint8_t len)
+{
+    CanNm_Channel_t *ch;
+    const CanNm_ChannelConfig_t *cfg;
+
+    if (channel >= cannm_channel_count) {
+        return false;
+    }
+    ch = &cannm_channels[channel];
+    cfg = ch->cfg;
+
+    /* Fast path: one compare rejects all application frames */
+    if ((id & cfg->rx_mask) != cfg->rx_base || ide != cfg->ide) {
+        return false;
+    }
+
+    ch->stats.rx_pdus++;
+    if (len > CANNM_PDU_NID) {
+        ch->last_rx_node = data[CANNM_PDU_NID];
+    }
+
+    switch (ch->state) {
+    case CANNM_STATE_BUS_SLEEP:
+        if (cannm_cb->network_start != NULL) {
+            cannm_cb->network_start(channel);
+        }
+        break;
+    case CANNM_STATE_PREPARE_BUS_SLEEP:
+        /* Another node keeps the network up: restart without wakeup bit */
+        CanNm_EnterRepeatMessage(ch);
+        break;
+    default:
+        CanNm_StartTimeout(ch);
+        if (len > CANNM_PDU_CBV && (data[CANNM_PDU_CBV] & CANNM_CBV_REPEAT_MSG) &&
+            ch->state != CANNM_STATE_REPEAT_MESSAGE) {
+            CanNm_EnterRepeatMessage(ch);
+        }
+        break;
+    }
+
+    return true;
+}
+
+void CanNm_TxConfirmation(uint8_t channel)
+{
+    CanNm_Channel_t *ch;
+
+    if (channel >= cannm_channel_count) {
+        return;
+    }
+    ch = &cannm_channels[channel];
+
+    if (ch->state == CANNM_STATE_REPEAT_MESSAGE ||
+        ch->state == CANNM_STATE_NORMAL_OPERATION) {
+        CanNm_StartTimeout(ch);
+    }
+}
+
+const CanNm_Stats_t *CanNm_GetStats(uint8_t channel)
+{
+    return (channel < cannm_channel_count) ? &cannm_channels[channel].stats : NULL;
+}
+
+/* ============================================================================
+ * Implementation - Timer Callbacks
+ * ============================================================================ */
+
+static void CanNm_MsgTimeout(CanTimer_t *timer, void *arg)
+{
+    CanNm_Channel_t *ch = (CanNm_Channel_t *)arg;
+    (void)timer;
+
+    if (ch->state == CANNM_STATE_REPEAT_MESSAGE ||
+        ch->state == CANNM_STATE_NORMAL_OPERATION) {
+        CanNm_Transmit(ch);
+    }
+}
+
+static void CanNm_NmTimeout(CanTimer_t *timer, void *arg)
+{
+    CanNm_Channel_t *ch = (CanNm_Channel_t *)arg;
+    (void)timer;
+
+    if (ch->state == CANNM_STATE_READY_SLEEP) {
+        /* Nobody needs the network any more */
+        CanNm_EnterPrepareBusSleep(ch);
+    } else if (ch->state == CANNM_STATE_REPEAT_MESSAGE ||
+               ch->state == CANNM_STATE_NORMAL_OPERATION) {
+        /* Own NM PDUs are not confirmed: bus problem, keep going */
+        ch->stats.timeouts++;
+        CanNm_StartTimeout(ch);
+    }
+}
+
+static void CanNm_StateTimeout(CanTimer_t *timer, void *arg)
+{
+    CanNm_Channel_t *ch = (CanNm_Channel_t *)arg;
+    (void)timer;
+
+    if (ch->state == CANNM_STATE_REPEAT_MESSAGE) {
+        /* T_Repeat_Message over */
+        if (ch->requested) {
+            CanNm_EnterNormalOperation(ch);
+        } else {
+            CanNm_EnterReadySleep(ch);
+        }
+    } else if (ch->state == CANNM_STATE_PREPARE_BUS_SLEEP) {
+        /* T_Wait_BusSleep over */
+        CanNm_EnterBusSleep(ch);
+    }
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// One NM channel per CAN controller, NM IDs 0x500-0x5FF
+static const CanNm_ChannelConfig_t cannm_config[] = {
+    { .tx_id = 0x510, .rx_base = 0x500, .rx_mask = 0x700, .ide = 0,
+      .node_id = 0x10, .immediate_count = 5, .msg_offset_ms = 10 },
+    { .tx_id = 0x510, .rx_base = 0x500, .rx_mask = 0x700, .ide = 0,
+      .node_id = 0x10, .immediate_count = 5, .msg_offset_ms = 10 },
+};
+
+CAN_Handle_t hcan1, hcan2;
+static CAN_Handle_t *const nm_bus[] = { &hcan1, &hcan2 };
+static uint8_t nm_mailbox[2] = { 0xFF, 0xFF };
+
+static bool link_tx(uint8_t channel, uint32_t id, uint8_t ide,
+                    const uint8_t *data, uint8_t len)
+{
+    CAN_TxMsg_t msg = { .id = id, .ide = ide, .rtr = 0, .dlc = len };
+    int8_t mailbox = CAN_GetEmptyMailbox(nm_bus[channel]);
+
+    if (mailbox < 0) {
+        return false;
+    }
+    memcpy(msg.data, data, len);
+    nm_mailbox[channel] = (uint8_t)mailbox;
+    return CAN_Transmit(nm_bus[channel], &msg);
+}
+
+static void network_start(uint8_t channel)
+{
+    CanTrcv_Wakeup(channel);
+    CanNm_PassiveStartUp(channel);
+}
+
+static const CanNm_Callbacks_t cannm_callbacks = {
+    .link_tx = link_tx,
+    .network_start = network_start,
+    .network_mode = Com_StartTx,            // Application frames on
+    .prepare_bus_sleep = Com_StopTx,        // Application frames off
+    .bus_sleep = CanTrcv_Sleep,
+};
+
+static void can_rx(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    // NM first: one mask compare for every other frame
+    if (CanNm_RxIndication(hcan->index, msg->id, msg->ide, msg->data, msg->dlc)) {
+        return;
+    }
+    App_RxDispatch(hcan, msg);
+}
+
+static void can_tx_done(CAN_Handle_t *hcan, uint8_t mailbox)
+{
+    if (mailbox == nm_mailbox[hcan->index]) {
+        CanNm_TxConfirmation(hcan->index);
+    }
+}
+
+void main(void)
+{
+    CanTimer_Init();
+    CanNm_Init(cannm_config, 2, &cannm_callbacks);
+    for (uint8_t i = 0; i < 2; i++) {
+        CAN_RegisterRxCallback(nm_bus[i], can_rx);
+        nm_bus[i]->tx_callback = can_tx_done;
+    }
+
+    CanNm_NetworkRequest(0);                // Ignition on: wake the bus
+    ...
+    CanNm_NetworkRelease(0);                // Done: sleep when all others are
+}
+*/
@@ -2,29 +2,17 @@
  * CAN Receive Template
  * 
  * This template provides CAN reception functions.
+ * Functions take the controller handle (can-handle.template.h); the RX
+ * interrupt either calls the instance callback or fills the instance's
+ * RX ring. A hybrid mode switches between interrupts and polling with
+ * the RX rate.
  * Adapt register names and addresses for your specific MCU.
  */
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-
-/* ============================================================================
- * Type Definitions
- * ============================================================================ */
-
-/**
- * @brief CAN RX message structure
- */
-typedef struct {
-    uint32_t id;            /* Standard or Extended ID */
-    uint8_t  ide;           /* 0=Standard (11-bit), 1=Extended (29-bit) */
-    uint8_t  rtr;           /* 0=Data frame, 1=Remote frame */
-    uint8_t  dlc;           /* Data Length Code (0-8) */
-    uint8_t  data[8];       /* Data payload */
-    uint8_t  fmi;           /* Filter Match Index */
-    uint16_t timestamp;     /* Hardware timestamp (if available) */
-} CAN_RxMsg_t;
+#include "can_handle.h"
 
 /* ============================================================================
  * Register Definitions
@@ -44,6 +32,9 @@ typedef struct {
 #define CAN_RF0R_FOVR0       (1U << 4)     /* FIFO 0 Overrun */
 #define CAN_RF0R_RFOM0       (1U << 5)     /* Release FIFO 0 Output */
 
+#define CAN_IER_FMPIE0       (1U << 1)     /* FIFO 0 Message Pending Interrupt */
+#define CAN_IER_FFIE0        (1U << 2)     /* FIFO 0 Full Interrupt */
+
 #define CAN_RIR_IDE          (1U << 2)     /* ID Extended */
 #define CAN_RIR_RTR          (1U << 1)     /* Remote TX Request */
 
@@ -55,50 +46,71 @@ typedef struct {
  * @brief Check if RX message is pending
  * @return true if message available
  */
-bool CAN_IsRxMessage(void);
+bool CAN_IsRxMessage(CAN_Handle_t *hcan);
 
 /**
  * @brief Receive a CAN message (polling)
+ * @param hcan Controller handle
  * @param msg Pointer to message structure to fill
  * @return true if message received
  */
-bool CAN_Receive(CAN_RxMsg_t *msg);
+bool CAN_Receive(CAN_Handle_t *hcan, CAN_RxMsg_t *msg);
 
 /**
  * @brief Get number of pending RX messages
  * @return Number of messages in FIFO
  */
-uint8_t CAN_GetRxCount(void);
+uint8_t CAN_GetRxCount(CAN_Handle_t *hcan);
+
+/**
+ * @brief Take one frame from the RX ring (filled by the RX interrupt
+ * when no callback is registered)
+ * @return true if a frame was copied to msg
+ */
+bool CAN_ReadRing(CAN_Handle_t *hcan, CAN_RxMsg_t *msg);
+
+/**
+ * @brief Enable adaptive interrupt/polling reception
+ * Starts in interrupt mode; CAN_RxHybridTick() must then be called
+ * periodically (e.g. from an existing 1 ms task)
+ */
+void CAN_EnableRxHybrid(CAN_Handle_t *hcan);
+
+/**
+ * @brief Periodic hybrid RX service: rate measurement, polling, mode switch
+ * The RX callback runs from here while polling, from the ISR otherwise
+ */
+void CAN_RxHybridTick(CAN_Handle_t *hcan);
+
+/**
+ * @brief Interrupts avoided so far (frames read minus RX interrupts taken)
+ */
+uint32_t CAN_GetRxIrqSaved(const CAN_Handle_t *hcan);
 
 /* ============================================================================
  * Implementation - Polling Mode
  * ============================================================================ */
 
-bool CAN_IsRxMessage(void)
+bool CAN_IsRxMessage(CAN_Handle_t *hcan)
 {
-    return (CAN->RF0R & CAN_RF0R_FMP0) != 0;
+    return (hcan->regs->RF0R & CAN_RF0R_FMP0) != 0;
 }
 
-uint8_t CAN_GetRxCount(void)
+uint8_t CAN_GetRxCount(CAN_Handle_t *hcan)
 {
-    return CAN->RF0R & CAN_RF0R_FMP0;
+    return hcan->regs->RF0R & CAN_RF0R_FMP0;
 }
 
-bool CAN_Receive(CAN_RxMsg_t *msg)
+/**
+ * @brief Read the FIFO 0 output mailbox and release it
+ * Caller has checked FMP0 != 0
+ */
+static void CAN_ReadFifo(CAN_TypeDef *can, CAN_RxMsg_t *msg)
 {
     CAN_RxFIFO_TypeDef *rx_fifo;
     
-    if (msg == NULL) {
-        return false;
-    }
-    
-    /* Check if message available */
-    if (!CAN_IsRxMessage()) {
-        return false;
-    }
-    
     /* Read from FIFO 0 */
-    rx_fifo = &CAN->sFIFOMailBox[0];
+    rx_fifo = &can->sFIFOMailBox[0];
     
     /* Extract ID and flags */
     uint32_t rir = rx_fifo->RIR;
@@ -106,11 +118,11 @@ bool CAN_Receive(CAN_RxMsg_t *msg)
     if (rir & CAN_RIR_IDE) {
         /* Extended ID (29-bit) */
         msg->ide = 1;
-        msg->id = rir >> 3;
+        msg->id = (rir >> 3) & 0x1FFFFFFFU;
     } else {
         /* Standard ID (11-bit) */
         msg->ide = 0;
-        msg->id = rir >> 21;
+        msg->id = (rir >> 21) & 0x7FFU;
     }
     
     msg->rtr = (rir & CAN_RIR_RTR) ? 1 : 0;
@@ -135,7 +147,41 @@ bool CAN_Receive(CAN_RxMsg_t *msg)
     msg->data[7] = (rdhr >> 24) & 0xFF;
     
     /* Release FIFO */
-    CAN->RF0R |= CAN_RF0R_RFOM0;
+    can->RF0R |= CAN_RF0R_RFOM0;
+    CAN_HW_SYNC(can);
+}
+
+bool CAN_Receive(CAN_Handle_t *hcan, CAN_RxMsg_t *msg)
+{
+    CAN_TypeDef *can = hcan->regs;
+    
+    if (msg == NULL) {
+        return false;
+    }
+    
+    /* Frames the software filter rejects are released and skipped */
+    while (can->RF0R & CAN_RF0R_FMP0) {
+        CAN_ReadFifo(can, msg);
+        if (CAN_SW_ACCEPT(hcan, msg)) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool CAN_ReadRing(CAN_Handle_t *hcan, CAN_RxMsg_t *msg)
+{
+    CAN_RxRing_t *ring = &hcan->rx;
+    uint16_t tail = ring->tail;
+    
+    if (tail == ring->head) {
+        return false;
+    }
+    
+    *msg = ring->msg[tail & (CAN_RX_RING_SIZE - 1U)];
+    CAN_BARRIER();
+    ring->tail = tail + 1U;  /* Publish the free slot after the copy */
     
     return true;
 }
@@ -144,41 +190,151 @@ bool CAN_Receive(CAN_RxMsg_t *msg)
  * Implementation - Interrupt Mode
  * ============================================================================ */
 
-/* RX callback function pointer */
-typedef void (*CAN_RxCallback_t)(const CAN_RxMsg_t *msg);
-static CAN_RxCallback_t rx_callback = NULL;
-
 /**
  * @brief Register RX callback
- * @param callback Function to call on RX
+ * @param hcan Controller handle
+ * @param callback Function to call on RX (NULL: use the RX ring)
  */
-void CAN_RegisterRxCallback(CAN_RxCallback_t callback)
+void CAN_RegisterRxCallback(CAN_Handle_t *hcan, CAN_RxCallback_t callback)
 {
-    rx_callback = callback;
+    hcan->rx_callback = callback;
 }
 
 /**
- * @brief RX Interrupt Handler
- * Call this from your ISR (e.g., CAN1_RX0_IRQHandler)
+ * @brief Empty FIFO 0 into the callback or the RX ring
+ * @return Number of frames read
  */
-void CAN_RX_IRQHandler(void)
+static uint32_t CAN_RxDrain(CAN_Handle_t *hcan)
 {
+    CAN_TypeDef *can = hcan->regs;
+    CAN_RxCallback_t callback = hcan->rx_callback;
+    CAN_RxRing_t *ring = &hcan->rx;
     CAN_RxMsg_t msg;
+    uint32_t count = 0;
     
     /* Check for overrun */
-    if (CAN->RF0R & CAN_RF0R_FOVR0) {
-        CAN->RF0R |= CAN_RF0R_FOVR0;  /* Clear overrun flag */
-        /* Handle overrun if needed */
+    if (can->RF0R & CAN_RF0R_FOVR0) {
+        can->RF0R |= CAN_RF0R_FOVR0;  /* Clear overrun flag */
+        CAN_HW_SYNC(can);
+        ring->fifo_overruns++;
     }
     
     /* Process all pending messages */
-    while (CAN_IsRxMessage()) {
-        if (CAN_Receive(&msg)) {
-            if (rx_callback != NULL) {
-                rx_callback(&msg);
+    while (can->RF0R & CAN_RF0R_FMP0) {
+        count++;
+        if (callback != NULL) {
+            CAN_ReadFifo(can, &msg);
+            if (!CAN_SW_ACCEPT(hcan, &msg)) {
+                continue;
+            }
+            CAN_TRACE_POINT(hcan, CAN_TRACE_RX_CB_ENTER, msg.fmi, msg.id);
+            callback(hcan, &msg);
+            CAN_TRACE_POINT(hcan, CAN_TRACE_RX_CB_EXIT, 0, 0);
+        } else if ((uint16_t)(ring->head - ring->tail) < CAN_RX_RING_SIZE) {
+            /* Decode straight into the ring slot - no extra copy. A
+             * rejected frame leaves head alone and the slot is reused */
+            CAN_RxMsg_t *slot = &ring->msg[ring->head & (CAN_RX_RING_SIZE - 1U)];
+            CAN_ReadFifo(can, slot);
+            if (CAN_SW_ACCEPT(hcan, slot)) {
+                CAN_BARRIER();
+                ring->head++;
+            }
+        } else {
+            CAN_ReadFifo(can, &msg);  /* Ring full: drop newest */
+            if (CAN_SW_ACCEPT(hcan, &msg)) {
+                ring->ring_overruns++;
             }
         }
     }
+    
+    hcan->rx_mode.frames += count;
+    
+    return count;
+}
+
+/**
+ * @brief RX Interrupt Handler
+ * Call this from your ISR with the instance handle
+ * (e.g. CAN1_RX0_IRQHandler -> CAN_RX_IRQHandler(&hcan1))
+ */
+void CAN_RX_IRQHandler(CAN_Handle_t *hcan)
+{
+    CAN_RxHybrid_t *mode = &hcan->rx_mode;
+    uint32_t count;
+    
+    CAN_TRACE_POINT(hcan, CAN_TRACE_RX_ISR_ENTER, hcan->regs->RF0R & CAN_RF0R_FMP0, 0);
+    
+    mode->irqs++;
+    if (mode->polling) {
+        /* FULL0 safety net: the poll period was too long for this burst */
+        hcan->regs->RF0R = CAN_RF0R_FULL0;
+        CAN_HW_SYNC(hcan->regs);
+        mode->safety_irqs++;
+    }
+    
+    count = CAN_RxDrain(hcan);
+    mode->window_frames += count;
+    
+    CAN_TRACE_POINT(hcan, CAN_TRACE_RX_ISR_EXIT, 0, count);
+}
+
+/* ============================================================================
+ * Implementation - Hybrid Mode
+ * ============================================================================ */
+
+void CAN_EnableRxHybrid(CAN_Handle_t *hcan)
+{
+    memset(&hcan->rx_mode, 0, sizeof(hcan->rx_mode));
+    hcan->regs->IER = (hcan->regs->IER & ~CAN_IER_FFIE0) | CAN_IER_FMPIE0;
+}
+
+void CAN_RxHybridTick(CAN_Handle_t *hcan)
+{
+    CAN_TypeDef *can = hcan->regs;
+    CAN_RxHybrid_t *mode = &hcan->rx_mode;
+    uint32_t count;
+    
+    if (!mode->polling) {
+        /* Interrupt mode: only measure the rate */
+        if (++mode->window_ticks < CAN_RX_HYBRID_WINDOW) {
+            return;
+        }
+        if (mode->window_frames >= CAN_RX_HYBRID_ENTER) {
+            /* High rate: per-frame interrupts off, FIFO full as safety net */
+            can->RF0R = CAN_RF0R_FULL0;
+            CAN_HW_SYNC(can);
+            can->IER = (can->IER & ~CAN_IER_FMPIE0) | CAN_IER_FFIE0;
+            mode->polling = 1;
+            mode->dry_polls = 0;
+            mode->mode_switches++;
+        }
+        mode->window_ticks = 0;
+        mode->window_frames = 0;
+        return;
+    }
+    
+    /* Polling mode: keep the FULL0 interrupt from draining concurrently */
+    can->IER &= ~CAN_IER_FFIE0;
+    count = CAN_RxDrain(hcan);
+    
+    if (count != 0) {
+        mode->dry_polls = 0;
+        can->IER |= CAN_IER_FFIE0;
+    } else if (++mode->dry_polls < CAN_RX_HYBRID_DRY_POLLS) {
+        can->IER |= CAN_IER_FFIE0;
+    } else {
+        /* Traffic has stopped: back to one interrupt per frame */
+        mode->polling = 0;
+        mode->window_ticks = 0;
+        mode->window_frames = 0;
+        mode->mode_switches++;
+        can->IER |= CAN_IER_FMPIE0;
+    }
+}
+
+uint32_t CAN_GetRxIrqSaved(const CAN_Handle_t *hcan)
+{
+    return hcan->rx_mode.frames - hcan->rx_mode.irqs;
 }
 
 /* ============================================================================
@@ -188,10 +344,10 @@ void CAN_RX_IRQHandler(void)
 /**
  * @brief Enable RX interrupt
  */
-void CAN_EnableRxInterrupt(void)
+void CAN_EnableRxInterrupt(CAN_Handle_t *hcan)
 {
     /* Enable RX FIFO 0 message pending interrupt */
-    CAN->IER |= CAN_IER_FMPIE0;
+    hcan->regs->IER |= CAN_IER_FMPIE0;
     
     /* Enable interrupt in NVIC */
     /* NVIC_EnableIRQ(CAN1_RX0_IRQn); */
@@ -200,9 +356,9 @@ void CAN_EnableRxInterrupt(void)
 /**
  * @brief Disable RX interrupt
  */
-void CAN_DisableRxInterrupt(void)
+void CAN_DisableRxInterrupt(CAN_Handle_t *hcan)
 {
-    CAN->IER &= ~CAN_IER_FMPIE0;
+    hcan->regs->IER &= ~CAN_IER_FMPIE0;
 }
 
 /* ============================================================================
@@ -210,17 +366,18 @@ void CAN_DisableRxInterrupt(void)
  * ============================================================================ */
 
 /*
+CAN_Handle_t hcan1;
+CAN_Handle_t hcan2;
+
 // Polling mode example:
 void main(void)
 {
     CAN_RxMsg_t msg;
     
-    CAN_Init();
+    CAN_Init(&hcan1, CAN1, 0);
     
     while (1) {
-        if (CAN_IsRxMessage()) {
-            CAN_Receive(&msg);
-            
+        if (CAN_Receive(&hcan1, &msg)) {
             // Process received message
             if (msg.id == 0x123) {
                 // Handle message with ID 0x123
@@ -229,22 +386,54 @@ void main(void)
     }
 }
 
-// Interrupt mode example:
-void rx_callback(const CAN_RxMsg_t *msg)
+// Interrupt mode example: CAN1 by callback, CAN2 through its RX ring
+void rx_callback(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
 {
     // Process message in interrupt context
     // Keep this function short!
-    process_message(msg);
+    process_message(hcan->index, msg);
+}
+
+void CAN1_RX0_IRQHandler(void)
+{
+    CAN_RX_IRQHandler(&hcan1);
+}
+
+void CAN2_RX0_IRQHandler(void)
+{
+    CAN_RX_IRQHandler(&hcan2);
 }
 
 void main(void)
 {
-    CAN_Init();
-    CAN_RegisterRxCallback(rx_callback);
-    CAN_EnableRxInterrupt();
+    CAN_RxMsg_t msg;
+    
+    CAN_Init(&hcan1, CAN1, 0);
+    CAN_Init(&hcan2, CAN2, 1);
+    CAN_RegisterRxCallback(&hcan1, rx_callback);
+    CAN_EnableRxInterrupt(&hcan1);
+    CAN_EnableRxInterrupt(&hcan2);
     
     while (1) {
-        // Main loop can do other tasks
+        while (CAN_ReadRing(&hcan2, &msg)) {
+            process_message(hcan2.index, &msg);
+        }
     }
 }
+
+// Hybrid mode example: interrupts at low load, polled from the 1 ms task
+// under bursts (bxCAN FIFO holds 3 frames: at 500 kbps FULL0 fires when a
+// burst of >3 frames arrives within one poll period)
+void Task_1ms(void)
+{
+    CAN_RxHybridTick(&hcan1);
+}
+
+void main(void)
+{
+    CAN_Init(&hcan1, CAN1, 0);
+    CAN_RegisterRxCallback(&hcan1, rx_callback);
+    CAN_EnableRxHybrid(&hcan1);
+    ...
+}
 */
@@ -0,0 +1,837 @@
+/**
+ * CAN Secure Onboard Communication Template
+ *
+ * This template authenticates selected CAN/CAN-FD frames (AUTOSAR SecOC
+ * style) with AES-128-CMAC over data ID, payload and a freshness value:
+ * - Secured frame = authentic payload | truncated freshness | truncated
+ *   MAC, both truncations configurable in bits per message
+ * - Freshness value manager: 64-bit counter per message, the receiver
+ *   rebuilds the full value from the truncated bits and rejects replays
+ * - Local software AES-128 (encryption only, one 1 KB T-table built at
+ *   init); round keys and CMAC subkeys K1/K2 precomputed per key slot
+ * - RX callbacks only queue secured frames; CanSecOC_MainFunction()
+ *   verifies them in batches of CANSECOC_BATCH, the AES rounds of the
+ *   batch interleaved, and hands authentic payloads to the application
+ * - Sits between the routing layer (gateway link_tx, TX scheduler) and
+ *   the driver: CanSecOC_Transmit() in front of CAN_TransmitQueued(),
+ *   CanSecOC_RxIndication() in the RX callback
+ *
+ * Freshness counters must survive a reset (store them, or resync from a
+ * freshness master), otherwise the receiver rejects a restarted sender
+ * and a restarted receiver accepts replays. MACs shorter than 24 bits
+ * are accepted by chance too often to be worth sending.
+ * Save the declarations up to the implementation as can_secoc.h.
+ *
+ * Requires: can-handle.template.h (driver hooks only)
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "can_handle.h"
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANSECOC_MAX_PDUS       16U     /* Secured messages, all controllers */
+#define CANSECOC_MAX_KEYS       4U      /* Key slots */
+#define CANSECOC_MAX_FRAME      64U     /* Largest secured frame (CAN-FD) */
+#define CANSECOC_RXQ_SIZE       16U     /* Frames waiting for verification (power of two) */
+#define CANSECOC_BATCH          4U      /* CMACs computed side by side */
+
+/* Queue lock: RX interrupt of every controller vs. CanSecOC_MainFunction */
+#define CANSECOC_ENTER_CRITICAL()   /* __disable_irq() */
+#define CANSECOC_EXIT_CRITICAL()    /* __enable_irq()  */
+
+#define CANSECOC_FV_BYTES       8U      /* Full freshness value in the MAC input */
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Per message configuration (const, in flash)
+ */
+typedef struct {
+    uint32_t can_id;
+    uint8_t  ide;
+    uint8_t  bus;               /* hcan->index the frame is sent/received on */
+    uint16_t data_id;           /* Authenticated, not sent */
+    uint8_t  key;               /* Key slot */
+    uint8_t  auth_len;          /* Authentic payload bytes */
+    uint8_t  fv_bits;           /* Freshness bits sent (0..64) */
+    uint8_t  mac_bits;          /* MAC bits sent (8..128) */
+} CanSecOC_Config_t;
+
+/**
+ * @brief Per message state (RAM)
+ */
+typedef struct {
+    const CanSecOC_Config_t *cfg;
+    uint64_t tx_fv;             /* Last freshness value sent */
+    uint64_t rx_fv;             /* Last freshness value accepted */
+    uint32_t verified;
+    uint32_t failed;            /* MAC or freshness wrong */
+    uint32_t dropped;           /* Verification queue full */
+} CanSecOC_Pdu_t;
+
+typedef enum {
+    CANSECOC_VERIFIED = 0,
+    CANSECOC_MAC_FAILED,        /* Wrong MAC, or a replayed/stale freshness value */
+    CANSECOC_FRESHNESS_FAILED,  /* Full freshness sent and not newer than the last */
+    CANSECOC_LENGTH_FAILED
+} CanSecOC_Status_t;
+
+/* Verification result; data/len are the authentic payload */
+typedef void (*CanSecOC_RxCallback_t)(CanSecOC_Pdu_t *pdu, CanSecOC_Status_t status,
+                                      const uint8_t *data, uint8_t len);
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Build the AES tables, clear keys, queue and registration
+ * @param rx_done Called by CanSecOC_MainFunction() per verified frame
+ */
+void CanSecOC_Init(CanSecOC_RxCallback_t rx_done);
+
+/**
+ * @brief Load a key: expands round keys and derives the CMAC subkeys
+ */
+bool CanSecOC_SetKey(uint8_t slot, const uint8_t key[16]);
+
+/**
+ * @brief Bind a message to its configuration, freshness counters at 0
+ */
+bool CanSecOC_PduInit(CanSecOC_Pdu_t *pdu, const CanSecOC_Config_t *cfg);
+
+/**
+ * @brief Messages used by the driver hooks
+ * @param pdus Initialized messages, sorted by (bus, ide, can_id)
+ */
+bool CanSecOC_Register(CanSecOC_Pdu_t *pdus, uint16_t count);
+
+/**
+ * @brief Build a secured frame with the next freshness value
+ * @param out Secured frame, *out_len bytes
+ * @return false if len is not auth_len
+ */
+bool CanSecOC_Secure(CanSecOC_Pdu_t *pdu, const uint8_t *authentic, uint8_t len,
+                     uint8_t *out, uint8_t *out_len);
+
+/**
+ * @brief Verify one secured frame now (no queue, no batching)
+ */
+CanSecOC_Status_t CanSecOC_Verify(CanSecOC_Pdu_t *pdu, const uint8_t *secured, uint8_t len);
+
+/**
+ * @brief Secure (if the ID is registered) and queue a classic frame
+ * msg->dlc is the authentic length; the frame on the bus is longer
+ */
+bool CanSecOC_Transmit(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg);
+
+/**
+ * @brief Queue a received frame for verification (RX callback)
+ * @return false if the ID is not secured: dispatch the frame as usual
+ */
+bool CanSecOC_RxIndication(const CAN_Handle_t *hcan, const CAN_RxMsg_t *msg);
+
+/**
+ * @brief Verify queued frames (task context)
+ * @return Frames verified (passed or failed)
+ */
+uint16_t CanSecOC_MainFunction(uint16_t max_frames);
+
+/**
+ * @brief AES-128-CMAC (RFC 4493) with a loaded key slot
+ */
+void CanSecOC_Cmac(uint8_t slot, const uint8_t *msg, uint16_t len, uint8_t mac[16]);
+
+/* ============================================================================
+ * Implementation - AES-128 (encryption only)
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t rk[44];            /* Round keys, big-endian words */
+    uint8_t  k1[16];            /* CMAC subkey, complete last block */
+    uint8_t  k2[16];            /* CMAC subkey, padded last block */
+    bool     loaded;
+} CanSecOC_Key_t;
+
+static uint8_t  cansecoc_sbox[256];
+static uint32_t cansecoc_te[256];   /* Round table, byte 0 of the column; ROTR for 1..3 */
+static CanSecOC_Key_t cansecoc_keys[CANSECOC_MAX_KEYS];
+
+#define CANSECOC_ROTR(x, n)     (((x) >> (n)) | ((x) << (32U - (n))))
+
+static uint8_t CanSecOC_Xtime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ ((x & 0x80U) ? 0x1BU : 0U));
+}
+
+/* S-box from the GF(2^8) inverse (powers of 3) and the affine map, so no
+ * 256-byte constant table has to be typed in */
+static void CanSecOC_BuildTables(void)
+{
+    uint8_t pow3[255];
+    uint8_t log3[256];
+    uint8_t x = 1U;
+
+    for (uint16_t i = 0; i < 255U; i++) {
+        pow3[i] = x;
+        log3[x] = (uint8_t)i;
+        x ^= CanSecOC_Xtime(x);
+    }
+    for (uint16_t i = 0; i < 256U; i++) {
+        uint8_t inv = (i == 0U) ? 0U : pow3[(255U - log3[i]) % 255U];
+        uint8_t s = inv;
+        for (uint8_t r = 1; r <= 4U; r++) {
+            s ^= (uint8_t)((inv << r) | (inv >> (8U - r)));
+        }
+        s ^= 0x63U;
+        cansecoc_sbox[i] = s;
+        cansecoc_te[i] = ((uint32_t)CanSecOC_Xtime(s) << 24) | ((uint32_t)s << 16) |
+                         ((uint32_t)s << 8) | (uint8_t)(CanSecOC_Xtime(s) ^ s);
+    }
+}
+
+static uint32_t CanSecOC_Load32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void CanSecOC_Store32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t CanSecOC_SubWord(uint32_t w)
+{
+    return ((uint32_t)cansecoc_sbox[w >> 24] << 24) | ((uint32_t)cansecoc_sbox[(w >> 16) & 0xFFU] << 16) |
+           ((uint32_t)cansecoc_sbox[(w >> 8) & 0xFFU] << 8) | cansecoc_sbox[w & 0xFFU];
+}
+
+static void CanSecOC_ExpandKey(uint32_t rk[44], const uint8_t key[16])
+{
+    uint8_t rcon = 1U;
+
+    for (uint8_t i = 0; i < 4U; i++) {
+        rk[i] = CanSecOC_Load32(&key[4U * i]);
+    }
+    for (uint8_t i = 4; i < 44U; i++) {
+        uint32_t t = rk[i - 1U];
+        if ((i & 3U) == 0U) {
+            t = CanSecOC_SubWord((t << 8) | (t >> 24)) ^ ((uint32_t)rcon << 24);
+            rcon = CanSecOC_Xtime(rcon);
+        }
+        rk[i] = rk[i - 4U] ^ t;
+    }
+}
+
+/*
+ * Encrypt n states in place, state i with round keys rk[i]. The lanes are
+ * independent, so the table loads of one lane overlap the others; with
+ * n = 1 this is a plain AES.
+ */
+static void CanSecOC_AesN(uint32_t (*st)[4], const uint32_t *const *rk, uint8_t n)
+{
+    const uint32_t *te = cansecoc_te;
+    uint8_t i;
+
+    for (i = 0; i < n; i++) {
+        st[i][0] ^= rk[i][0];
+        st[i][1] ^= rk[i][1];
+        st[i][2] ^= rk[i][2];
+        st[i][3] ^= rk[i][3];
+    }
+
+    for (uint8_t r = 1; r < 10U; r++) {
+        for (i = 0; i < n; i++) {
+            uint32_t s0 = st[i][0], s1 = st[i][1], s2 = st[i][2], s3 = st[i][3];
+            const uint32_t *k = &rk[i][4U * r];
+            st[i][0] = te[s0 >> 24] ^ CANSECOC_ROTR(te[(s1 >> 16) & 0xFFU], 8) ^
+                       CANSECOC_ROTR(te[(s2 >> 8) & 0xFFU], 16) ^ CANSECOC_ROTR(te[s3 & 0xFFU], 24) ^ k[0];
+            st[i][1] = te[s1 >> 24] ^ CANSECOC_ROTR(te[(s2 >> 16) & 0xFFU], 8) ^
+                       CANSECOC_ROTR(te[(s3 >> 8) & 0xFFU], 16) ^ CANSECOC_ROTR(te[s0 & 0xFFU], 24) ^ k[1];
+            st[i][2] = te[s2 >> 24] ^ CANSECOC_ROTR(te[(s3 >> 16) & 0xFFU], 8) ^
+                       CANSECOC_ROTR(te[(s0 >> 8) & 0xFFU], 16) ^ CANSECOC_ROTR(te[s1 & 0xFFU], 24) ^ k[2];
+            st[i][3] = te[s3 >> 24] ^ CANSECOC_ROTR(te[(s0 >> 16) & 0xFFU], 8) ^
+                       CANSECOC_ROTR(te[(s1 >> 8) & 0xFFU], 16) ^ CANSECOC_ROTR(te[s2 & 0xFFU], 24) ^ k[3];
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        uint32_t s0 = st[i][0], s1 = st[i][1], s2 = st[i][2], s3 = st[i][3];
+        const uint32_t *k = &rk[i][40];
+        st[i][0] = CanSecOC_SubWord((s0 & 0xFF000000UL) | (s1 & 0x00FF0000UL) | (s2 & 0x0000FF00UL) | (s3 & 0xFFU)) ^ k[0];
+        st[i][1] = CanSecOC_SubWord((s1 & 0xFF000000UL) | (s2 & 0x00FF0000UL) | (s3 & 0x0000FF00UL) | (s0 & 0xFFU)) ^ k[1];
+        st[i][2] = CanSecOC_SubWord((s2 & 0xFF000000UL) | (s3 & 0x00FF0000UL) | (s0 & 0x0000FF00UL) | (s1 & 0xFFU)) ^ k[2];
+        st[i][3] = CanSecOC_SubWord((s3 & 0xFF000000UL) | (s0 & 0x00FF0000UL) | (s1 & 0x0000FF00UL) | (s2 & 0xFFU)) ^ k[3];
+    }
+}
+
+/* ============================================================================
+ * Implementation - CMAC
+ * ============================================================================ */
+
+/**
+ * @brief One CMAC computation of a batch
+ */
+typedef struct {
+    const CanSecOC_Key_t *key;
+    const uint8_t *msg;
+    uint16_t len;
+    uint8_t mac[16];
+} CanSecOC_Lane_t;
+
+/* Subkey: left shift by one bit, conditional XOR with Rb = 0x87 */
+static void CanSecOC_Dbl(uint8_t out[16], const uint8_t in[16])
+{
+    uint8_t carry = in[0] >> 7;
+
+    for (uint8_t i = 0; i < 15U; i++) {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1U] >> 7));
+    }
+    out[15] = (uint8_t)((in[15] << 1) ^ (carry ? 0x87U : 0U));
+}
+
+/* Block b of a CMAC message with the last block rules applied */
+static void CanSecOC_CmacBlock(const CanSecOC_Lane_t *lane, uint16_t b, uint16_t blocks,
+                               uint8_t block[16])
+{
+    uint16_t off = (uint16_t)(16U * b);
+    uint16_t n = (uint16_t)(lane->len - off);
+
+    if (n > 16U) {
+        n = 16U;
+    }
+
+    memcpy(block, &lane->msg[off], n);
+    if (b + 1U < blocks) {
+        return;
+    }
+    if (n == 16U) {
+        for (uint8_t i = 0; i < 16U; i++) {
+            block[i] ^= lane->key->k1[i];
+        }
+    } else {
+        memset(&block[n], 0, 16U - n);
+        block[n] = 0x80U;
+        for (uint8_t i = 0; i < 16U; i++) {
+            block[i] ^= lane->key->k2[i];
+        }
+    }
+}
+
+/*
+ * CMAC of up to CANSECOC_BATCH messages side by side: block b of every
+ * lane that still has one goes through one CanSecOC_AesN() call.
+ */
+static void CanSecOC_CmacBatch(CanSecOC_Lane_t *lanes, uint8_t n)
+{
+    uint32_t st[CANSECOC_BATCH][4];
+    uint32_t act[CANSECOC_BATCH][4];
+    const uint32_t *rk[CANSECOC_BATCH];
+    uint16_t blocks[CANSECOC_BATCH];
+    uint16_t max_blocks = 0U;
+    uint8_t block[16];
+    uint8_t i;
+
+    memset(st, 0, sizeof(st));
+    for (i = 0; i < n; i++) {
+        blocks[i] = (uint16_t)((lanes[i].len == 0U) ? 1U : (lanes[i].len + 15U) / 16U);
+        if (blocks[i] > max_blocks) {
+            max_blocks = blocks[i];
+        }
+    }
+
+    for (uint16_t b = 0; b < max_blocks; b++) {
+        uint8_t m = 0U;
+        uint8_t idx[CANSECOC_BATCH];
+
+        for (i = 0; i < n; i++) {
+            if (b >= blocks[i]) {
+                continue;
+            }
+            CanSecOC_CmacBlock(&lanes[i], b, blocks[i], block);
+            for (uint8_t w = 0; w < 4U; w++) {
+                act[m][w] = st[i][w] ^ CanSecOC_Load32(&block[4U * w]);
+            }
+            rk[m] = lanes[i].key->rk;
+            idx[m++] = i;
+        }
+        CanSecOC_AesN(act, rk, m);
+        for (i = 0; i < m; i++) {
+            memcpy(st[idx[i]], act[i], sizeof(act[i]));
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        for (uint8_t w = 0; w < 4U; w++) {
+            CanSecOC_Store32(&lanes[i].mac[4U * w], st[i][w]);
+        }
+    }
+}
+
+void CanSecOC_Cmac(uint8_t slot, const uint8_t *msg, uint16_t len, uint8_t mac[16])
+{
+    CanSecOC_Lane_t lane = { &cansecoc_keys[slot], msg, len, { 0 } };
+
+    CanSecOC_CmacBatch(&lane, 1U);
+    memcpy(mac, lane.mac, 16);
+}
+
+bool CanSecOC_SetKey(uint8_t slot, const uint8_t key[16])
+{
+    CanSecOC_Key_t *k;
+    uint32_t l[1][4] = { { 0U, 0U, 0U, 0U } };
+    const uint32_t *rk[1];
+    uint8_t lb[16];
+
+    if (slot >= CANSECOC_MAX_KEYS) {
+        return false;
+    }
+    k = &cansecoc_keys[slot];
+    CanSecOC_ExpandKey(k->rk, key);
+
+    /* L = AES(K, 0), K1 = dbl(L), K2 = dbl(K1) */
+    rk[0] = k->rk;
+    CanSecOC_AesN(l, rk, 1U);
+    for (uint8_t w = 0; w < 4U; w++) {
+        CanSecOC_Store32(&lb[4U * w], l[0][w]);
+    }
+    CanSecOC_Dbl(k->k1, lb);
+    CanSecOC_Dbl(k->k2, k->k1);
+    k->loaded = true;
+    return true;
+}
+
+/* ============================================================================
+ * Implementation - Secured Frames and Freshness
+ * ============================================================================ */
+
+/**
+ * @brief Frame waiting for verification
+ */
+typedef struct {
+    CanSecOC_Pdu_t *pdu;
+    uint8_t len;
+    uint8_t data[CANSECOC_MAX_FRAME];
+} CanSecOC_RxEntry_t;
+
+static CanSecOC_RxCallback_t cansecoc_rx_done;
+static CanSecOC_Pdu_t *cansecoc_pdus;
+static uint16_t cansecoc_pdu_count;
+
+static CanSecOC_RxEntry_t cansecoc_rxq[CANSECOC_RXQ_SIZE];
+static volatile uint16_t cansecoc_rxq_head;     /* Written under the lock */
+static volatile uint16_t cansecoc_rxq_tail;     /* Written by the main function only */
+
+void CanSecOC_Init(CanSecOC_RxCallback_t rx_done)
+{
+    CanSecOC_BuildTables();
+    memset(cansecoc_keys, 0, sizeof(cansecoc_keys));
+    cansecoc_rx_done = rx_done;
+    cansecoc_pdus = NULL;
+    cansecoc_pdu_count = 0U;
+    cansecoc_rxq_head = 0U;
+    cansecoc_rxq_tail = 0U;
+}
+
+static uint8_t CanSecOC_SecuredLen(const CanSecOC_Config_t *cfg)
+{
+    return (uint8_t)(cfg->auth_len + (cfg->fv_bits + cfg->mac_bits + 7U) / 8U);
+}
+
+bool CanSecOC_PduInit(CanSecOC_Pdu_t *pdu, const CanSecOC_Config_t *cfg)
+{
+    if (cfg->key >= CANSECOC_MAX_KEYS || cfg->fv_bits > 64U ||
+        cfg->mac_bits < 8U || cfg->mac_bits > 128U ||
+        CanSecOC_SecuredLen(cfg) > CANSECOC_MAX_FRAME) {
+        return false;
+    }
+    memset(pdu, 0, sizeof(*pdu));
+    pdu->cfg = cfg;
+    return true;
+}
+
+/* MSB-first bit field at bit position pos of a frame */
+static void CanSecOC_PutBits(uint8_t *buf, uint16_t pos, uint64_t v, uint8_t bits)
+{
+    for (uint8_t i = 0; i < bits; i++, pos++) {
+        uint8_t bit = (uint8_t)((v >> (bits - 1U - i)) & 1U);
+        buf[pos >> 3] = (uint8_t)((buf[pos >> 3] & ~(0x80U >> (pos & 7U))) | (bit << (7U - (pos & 7U))));
+    }
+}
+
+static uint64_t CanSecOC_GetBits(const uint8_t *buf, uint16_t pos, uint8_t bits)
+{
+    uint64_t v = 0U;
+
+    for (uint8_t i = 0; i < bits; i++, pos++) {
+        v = (v << 1) | ((buf[pos >> 3] >> (7U - (pos & 7U))) & 1U);
+    }
+    return v;
+}
+
+/* MAC input: data ID (big endian) | authentic payload | full freshness */
+static uint16_t CanSecOC_MacInput(const CanSecOC_Config_t *cfg, const uint8_t *authentic,
+                                  uint64_t fv, uint8_t *buf)
+{
+    buf[0] = (uint8_t)(cfg->data_id >> 8);
+    buf[1] = (uint8_t)cfg->data_id;
+    memcpy(&buf[2], authentic, cfg->auth_len);
+    CanSecOC_Store32(&buf[2U + cfg->auth_len], (uint32_t)(fv >> 32));
+    CanSecOC_Store32(&buf[6U + cfg->auth_len], (uint32_t)fv);
+    return (uint16_t)(2U + cfg->auth_len + CANSECOC_FV_BYTES);
+}
+
+bool CanSecOC_Secure(CanSecOC_Pdu_t *pdu, const uint8_t *authentic, uint8_t len,
+                     uint8_t *out, uint8_t *out_len)
+{
+    const CanSecOC_Config_t *cfg = pdu->cfg;
+    uint8_t input[2U + CANSECOC_MAX_FRAME + CANSECOC_FV_BYTES];
+    CanSecOC_Lane_t lane;
+    uint16_t pos = (uint16_t)(8U * cfg->auth_len);
+    uint64_t fv = pdu->tx_fv + 1U;
+    uint8_t secured_len = CanSecOC_SecuredLen(cfg);
+
+    if (len != cfg->auth_len || !cansecoc_keys[cfg->key].loaded) {
+        return false;
+    }
+
+    lane.key = &cansecoc_keys[cfg->key];
+    lane.msg = input;
+    lane.len = CanSecOC_MacInput(cfg, authentic, fv, input);
+    CanSecOC_CmacBatch(&lane, 1U);
+
+    memcpy(out, authentic, len);
+    memset(&out[len], 0, secured_len - len);
+    if (cfg->fv_bits != 0U) {
+        CanSecOC_PutBits(out, pos, (cfg->fv_bits == 64U) ? fv : fv & ((1ULL << cfg->fv_bits) - 1U),
+                         cfg->fv_bits);
+    }
+    pos = (uint16_t)(pos + cfg->fv_bits);
+    for (uint8_t i = 0; i < cfg->mac_bits; i += 8U) {
+        uint8_t bits = (uint8_t)(cfg->mac_bits - i);
+        if (bits > 8U) {
+            bits = 8U;
+        }
+        CanSecOC_PutBits(out, (uint16_t)(pos + i), lane.mac[i / 8U] >> (8U - bits), bits);
+    }
+
+    pdu->tx_fv = fv;
+    *out_len = secured_len;
+    return true;
+}
+
+/*
+ * Full freshness from the truncated bits: same upper bits as the last
+ * accepted value if the received lower bits are larger, else the next
+ * upper value. A replayed frame therefore gets a newer freshness than
+ * it was secured with, and its MAC fails.
+ */
+static bool CanSecOC_Freshness(const CanSecOC_Pdu_t *pdu, const uint8_t *secured, uint64_t *fv)
+{
+    uint8_t bits = pdu->cfg->fv_bits;
+    uint64_t tfv;
+    uint64_t mask;
+
+    if (bits == 64U) {
+        *fv = CanSecOC_GetBits(secured, (uint16_t)(8U * pdu->cfg->auth_len), 64U);
+        return *fv > pdu->rx_fv;
+    }
+    mask = (1ULL << bits) - 1U;
+    tfv = CanSecOC_GetBits(secured, (uint16_t)(8U * pdu->cfg->auth_len), bits);
+    *fv = (pdu->rx_fv & ~mask) | tfv;
+    if (tfv <= (pdu->rx_fv & mask)) {
+        *fv += mask + 1U;
+    }
+    return true;
+}
+
+/* Constant time compare of the sent MAC bits */
+static bool CanSecOC_MacMatches(const CanSecOC_Config_t *cfg, const uint8_t *secured,
+                                const uint8_t mac[16])
+{
+    uint16_t pos = (uint16_t)(8U * cfg->auth_len + cfg->fv_bits);
+    uint8_t diff = 0U;
+
+    for (uint8_t i = 0; i < cfg->mac_bits; i += 8U) {
+        uint8_t bits = (uint8_t)(cfg->mac_bits - i);
+        if (bits > 8U) {
+            bits = 8U;
+        }
+        diff |= (uint8_t)(CanSecOC_GetBits(secured, (uint16_t)(pos + i), bits) ^ (mac[i / 8U] >> (8U - bits)));
+    }
+    return diff == 0U;
+}
+
+/*
+ * Verify n frames of distinct messages: freshness and MAC input per
+ * frame, one batched CMAC, then compare and accept.
+ */
+static void CanSecOC_VerifyBatch(CanSecOC_RxEntry_t *const *frames, uint8_t n,
+                                 CanSecOC_Status_t *status)
+{
+    uint8_t input[CANSECOC_BATCH][2U + CANSECOC_MAX_FRAME + CANSECOC_FV_BYTES];
+    CanSecOC_Lane_t lanes[CANSECOC_BATCH];
+    uint64_t fv[CANSECOC_BATCH];
+    uint8_t lane_of[CANSECOC_BATCH];
+    uint8_t m = 0U;
+    uint8_t i;
+
+    for (i = 0; i < n; i++) {
+        const CanSecOC_Pdu_t *pdu = frames[i]->pdu;
+        const CanSecOC_Config_t *cfg = pdu->cfg;
+
+        lane_of[i] = 0xFFU;
+        if (frames[i]->len != CanSecOC_SecuredLen(cfg) || !cansecoc_keys[cfg->key].loaded) {
+            status[i] = CANSECOC_LENGTH_FAILED;
+        } else if (!CanSecOC_Freshness(pdu, frames[i]->data, &fv[i])) {
+            status[i] = CANSECOC_FRESHNESS_FAILED;
+        } else {
+            lanes[m].key = &cansecoc_keys[cfg->key];
+            lanes[m].msg = input[m];
+            lanes[m].len = CanSecOC_MacInput(cfg, frames[i]->data, fv[i], input[m]);
+            lane_of[i] = m++;
+        }
+    }
+
+    CanSecOC_CmacBatch(lanes, m);
+
+    for (i = 0; i < n; i++) {
+        CanSecOC_Pdu_t *pdu = frames[i]->pdu;
+
+        if (lane_of[i] != 0xFFU) {
+            if (CanSecOC_MacMatches(pdu->cfg, frames[i]->data, lanes[lane_of[i]].mac)) {
+                pdu->rx_fv = fv[i];
+                status[i] = CANSECOC_VERIFIED;
+            } else {
+                status[i] = CANSECOC_MAC_FAILED;
+            }
+        }
+        if (status[i] == CANSECOC_VERIFIED) {
+            pdu->verified++;
+        } else {
+            pdu->failed++;
+        }
+    }
+}
+
+CanSecOC_Status_t CanSecOC_Verify(CanSecOC_Pdu_t *pdu, const uint8_t *secured, uint8_t len)
+{
+    CanSecOC_RxEntry_t entry;
+    CanSecOC_RxEntry_t *frames[1] = { &entry };
+    CanSecOC_Status_t status;
+
+    if (len > CANSECOC_MAX_FRAME) {
+        pdu->failed++;
+        return CANSECOC_LENGTH_FAILED;
+    }
+    entry.pdu = pdu;
+    entry.len = len;
+    memcpy(entry.data, secured, len);
+    CanSecOC_VerifyBatch(frames, 1U, &status);
+    return status;
+}
+
+/* ============================================================================
+ * Implementation - Driver Hooks and Main Function
+ * ============================================================================ */
+
+static uint32_t CanSecOC_Key(uint8_t bus, uint8_t ide, uint32_t id)
+{
+    return ((uint32_t)bus << 30) | (ide ? (1UL << 29) : 0U) | (id & 0x1FFFFFFFU);
+}
+
+bool CanSecOC_Register(CanSecOC_Pdu_t *pdus, uint16_t count)
+{
+    if (count > CANSECOC_MAX_PDUS) {
+        return false;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        const CanSecOC_Config_t *cfg = pdus[i].cfg;
+        if (cfg == NULL || cfg->bus > 3U ||
+            (i > 0U && CanSecOC_Key(cfg->bus, cfg->ide, cfg->can_id) <=
+                       CanSecOC_Key(pdus[i - 1U].cfg->bus, pdus[i - 1U].cfg->ide,
+                                    pdus[i - 1U].cfg->can_id))) {
+            return false;
+        }
+    }
+    cansecoc_pdus = pdus;
+    cansecoc_pdu_count = count;
+    return true;
+}
+
+static CanSecOC_Pdu_t *CanSecOC_Find(uint8_t bus, uint8_t ide, uint32_t id)
+{
+    uint32_t key = CanSecOC_Key(bus, ide, id);
+    uint16_t lo = 0U;
+    uint16_t hi = cansecoc_pdu_count;
+
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2U);
+        const CanSecOC_Config_t *cfg = cansecoc_pdus[mid].cfg;
+        uint32_t k = CanSecOC_Key(cfg->bus, cfg->ide, cfg->can_id);
+        if (k == key) {
+            return &cansecoc_pdus[mid];
+        }
+        if (k < key) {
+            lo = (uint16_t)(mid + 1U);
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+bool CanSecOC_Transmit(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg)
+{
+    CanSecOC_Pdu_t *pdu = CanSecOC_Find(hcan->index, msg->ide, msg->id);
+    uint8_t secured[CANSECOC_MAX_FRAME];
+    CAN_TxMsg_t out;
+    uint8_t len;
+
+    if (pdu == NULL || msg->rtr) {
+        return CAN_TransmitQueued(hcan, msg);
+    }
+    if (CanSecOC_SecuredLen(pdu->cfg) > sizeof(out.data) ||
+        !CanSecOC_Secure(pdu, msg->data, msg->dlc, secured, &len)) {
+        return false;
+    }
+
+    /* A refused frame keeps its freshness value used: never reuse one */
+    out = *msg;
+    out.dlc = len;
+    memcpy(out.data, secured, len);
+    return CAN_TransmitQueued(hcan, &out);
+}
+
+bool CanSecOC_RxIndication(const CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    CanSecOC_Pdu_t *pdu = CanSecOC_Find(hcan->index, msg->ide, msg->id);
+    uint8_t len = (msg->dlc > 8U) ? 8U : msg->dlc;
+    uint16_t head;
+
+    if (pdu == NULL || msg->rtr) {
+        return false;
+    }
+
+    CANSECOC_ENTER_CRITICAL();
+    head = cansecoc_rxq_head;
+    if ((uint16_t)(head - cansecoc_rxq_tail) < CANSECOC_RXQ_SIZE) {
+        CanSecOC_RxEntry_t *e = &cansecoc_rxq[head & (CANSECOC_RXQ_SIZE - 1U)];
+        e->pdu = pdu;
+        e->len = len;
+        memcpy(e->data, msg->data, len);
+        cansecoc_rxq_head = (uint16_t)(head + 1U);
+    } else {
+        pdu->dropped++;
+    }
+    CANSECOC_EXIT_CRITICAL();
+
+    return true;
+}
+
+/*
+ * Batches take queued frames in order and stop at a second frame of a
+ * message already in the batch: its freshness depends on whether the
+ * first one is accepted.
+ */
+uint16_t CanSecOC_MainFunction(uint16_t max_frames)
+{
+    CanSecOC_RxEntry_t *frames[CANSECOC_BATCH];
+    CanSecOC_Status_t status[CANSECOC_BATCH];
+    uint16_t done = 0U;
+
+    while (done < max_frames) {
+        uint16_t tail = cansecoc_rxq_tail;
+        uint16_t avail = (uint16_t)(cansecoc_rxq_head - tail);
+        uint8_t n = 0U;
+
+        while (n < CANSECOC_BATCH && n < avail && done + n < max_frames) {
+            CanSecOC_RxEntry_t *e = &cansecoc_rxq[(tail + n) & (CANSECOC_RXQ_SIZE - 1U)];
+            bool repeat = false;
+            for (uint8_t i = 0; i < n; i++) {
+                repeat = repeat || (frames[i]->pdu == e->pdu);
+            }
+            if (repeat) {
+                break;
+            }
+            frames[n++] = e;
+        }
+        if (n == 0U) {
+            break;
+        }
+
+        CanSecOC_VerifyBatch(frames, n, status);
+        for (uint8_t i = 0; i < n; i++) {
+            if (cansecoc_rx_done != NULL) {
+                cansecoc_rx_done(frames[i]->pdu, status[i], frames[i]->data,
+                                 frames[i]->pdu->cfg->auth_len);
+            }
+        }
+        CAN_BARRIER();
+        cansecoc_rxq_tail = (uint16_t)(tail + n);   /* Slots free after the callbacks */
+        done = (uint16_t)(done + n);
+    }
+    return done;
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Torque request 0x101: 4 data bytes | 8 freshness bits | 24 MAC bits = 8 bytes
+
+static const CanSecOC_Config_t secoc_torque = { .can_id = 0x101, .data_id = 0x0101,
+    .key = 0, .auth_len = 4, .fv_bits = 8, .mac_bits = 24 };
+static CanSecOC_Pdu_t secoc_pdus[1];
+
+static void secoc_rx_done(CanSecOC_Pdu_t *pdu, CanSecOC_Status_t status,
+                          const uint8_t *data, uint8_t len)
+{
+    if (status == CANSECOC_VERIFIED) {
+        App_TorqueRequest(data, len);
+    } else {
+        Dem_ReportAuthFailure(pdu->cfg->can_id, status);
+    }
+}
+
+void App_SecOCInit(void)
+{
+    CanSecOC_Init(secoc_rx_done);
+    CanSecOC_SetKey(0, key_from_secure_storage);
+    CanSecOC_PduInit(&secoc_pdus[0], &secoc_torque);
+    secoc_pdus[0].tx_fv = nvm_fv_tx;            // Restored freshness
+    secoc_pdus[0].rx_fv = nvm_fv_rx;
+    CanSecOC_Register(secoc_pdus, 1);
+}
+
+// RX interrupt: secured frames are only copied, plain frames dispatched
+void rx_callback(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    if (!CanSecOC_RxIndication(hcan, msg)) {
+        App_Dispatch(msg);
+    }
+}
+
+// 1 ms task: verify what arrived (up to 16 frames per call)
+void Task_1ms(void)
+{
+    CanSecOC_MainFunction(16);
+}
+
+// TX: the gateway's or scheduler's link_tx goes through CanSecOC_Transmit
+static bool sched_tx(uint8_t channel, const CAN_TxMsg_t *msg)
+{
+    return CanSecOC_Transmit(&hcan1, msg);
+}
+*/
@@ -0,0 +1,443 @@
+/**
+ * CAN Signal Codec Template
+ *
+ * This template provides signal packing/unpacking for classic CAN payloads:
+ * - The payload is loaded as one 64-bit word (little-endian for Intel,
+ *   byte-swapped for Motorola) and every signal is one shift and one mask
+ * - Signed signals are sign-extended with xor/subtract, no branches
+ * - Signal descriptions are compiled once (CanSig_Compile) into shift/mask
+ *   form; CanSig_DecodeFrame() decodes all signals of a frame with a
+ *   single pair of payload loads
+ * - CANSIG_DEFINE() generates specialized inline accessors whose layout is
+ *   a compile-time constant, so each one folds to a handful of instructions
+ *
+ * Bit numbering follows DBC: Intel start bit = LSB, Motorola start bit =
+ * MSB in sawtooth numbering (bit 7 of byte 0 is 7, bit 0 of byte 1 is 8).
+ *
+ * Save everything above "Implementation - Compile" as can_signal.h (code
+ * generated by scripts/can_dbc_import.py includes it) and the rest as
+ * can_signal.c.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+/* Physical value type. float uses the single precision FPU of Cortex-M4F/M7;
+ * raw values above 24 bits should be read with the raw API */
+typedef float CanSig_Phys_t;
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef enum {
+    CANSIG_INTEL    = 0,            /* Little-endian, start bit = LSB */
+    CANSIG_MOTOROLA = 1             /* Big-endian, start bit = MSB */
+} CanSig_ByteOrder_t;
+
+/**
+ * @brief Signal description (as found in a DBC SG_ line)
+ */
+typedef struct {
+    uint8_t start_bit;
+    uint8_t length;                 /* 1..64 */
+    uint8_t byte_order;             /* CanSig_ByteOrder_t */
+    uint8_t is_signed;
+    CanSig_Phys_t factor;
+    CanSig_Phys_t offset;
+} CanSig_Signal_t;
+
+/**
+ * @brief Compiled signal: everything needed at runtime, no decisions left
+ */
+typedef struct {
+    uint64_t mask;                  /* Right-aligned, 'length' ones */
+    uint64_t sign;                  /* Sign bit of the raw value, 0 if unsigned */
+    uint8_t  shift;                 /* LSB position in the loaded word */
+    uint8_t  order;                 /* Index into the loaded words (byte order) */
+    CanSig_Phys_t factor;
+    CanSig_Phys_t offset;
+} CanSig_Codec_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Compile a signal description
+ * @return false if the signal does not fit into 8 bytes
+ */
+bool CanSig_Compile(const CanSig_Signal_t *signal, CanSig_Codec_t *codec);
+
+/**
+ * @brief Compile a signal table (e.g. all signals of one message)
+ * @return false if any signal is invalid
+ */
+bool CanSig_CompileTable(const CanSig_Signal_t *signals, CanSig_Codec_t *codecs,
+                         uint8_t count);
+
+/**
+ * @brief Raw value of one signal (sign-extended if signed)
+ */
+int64_t CanSig_ExtractRaw(const CanSig_Codec_t *codec, const uint8_t data[8]);
+
+/**
+ * @brief Write the raw value of one signal, other bits are kept
+ */
+void CanSig_InsertRaw(const CanSig_Codec_t *codec, uint8_t data[8], int64_t raw);
+
+/**
+ * @brief Physical value of one signal (raw * factor + offset)
+ */
+CanSig_Phys_t CanSig_Decode(const CanSig_Codec_t *codec, const uint8_t data[8]);
+
+/**
+ * @brief Write a physical value, rounded to the nearest raw step and
+ * saturated to the signal range
+ */
+void CanSig_Encode(const CanSig_Codec_t *codec, uint8_t data[8], CanSig_Phys_t value);
+
+/**
+ * @brief Decode all signals of one frame
+ * @param codecs Compiled signals of the message
+ * @param count Number of signals
+ * @param data Payload
+ * @param values Output, one physical value per signal
+ */
+void CanSig_DecodeFrame(const CanSig_Codec_t *codecs, uint8_t count,
+                        const uint8_t data[8], CanSig_Phys_t *values);
+
+/**
+ * @brief Decode all signals of one frame to raw values
+ */
+void CanSig_DecodeFrameRaw(const CanSig_Codec_t *codecs, uint8_t count,
+                           const uint8_t data[8], int64_t *raw);
+
+/**
+ * @brief Encode all signals of one frame (bits not covered by a signal
+ * are left unchanged)
+ */
+void CanSig_EncodeFrame(const CanSig_Codec_t *codecs, uint8_t count,
+                        const CanSig_Phys_t *values, uint8_t data[8]);
+
+/* ============================================================================
+ * Payload Access
+ * ============================================================================ */
+
+/* memcpy of 8 bytes compiles to one or two word loads on Cortex-M3/M4/M7
+ * (unaligned access allowed); byte swap is REV */
+static inline uint64_t CanSig_LoadLE(const uint8_t data[8])
+{
+    uint64_t word;
+
+    memcpy(&word, data, sizeof(word));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+static inline void CanSig_StoreLE(uint8_t data[8], uint64_t word)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    word = __builtin_bswap64(word);
+#endif
+    memcpy(data, &word, sizeof(word));
+}
+
+/* Motorola bit layout: byte 0 is the most significant byte */
+static inline uint64_t CanSig_LoadBE(const uint8_t data[8])
+{
+    return __builtin_bswap64(CanSig_LoadLE(data));
+}
+
+static inline void CanSig_StoreBE(uint8_t data[8], uint64_t word)
+{
+    CanSig_StoreLE(data, __builtin_bswap64(word));
+}
+
+/* Sign extension of a right-aligned field: (v ^ s) - s, s = sign bit or 0 */
+static inline int64_t CanSig_SignExtend(uint64_t value, uint64_t sign)
+{
+    return (int64_t)((value ^ sign) - sign);
+}
+
+/* ============================================================================
+ * Generated Accessors
+ * ============================================================================ */
+
+/* LSB position of a signal in the word returned by CanSig_LoadLE/LoadBE */
+#define CANSIG_SHIFT(order, start, len) \
+    ((order) == CANSIG_MOTOROLA \
+        ? ((7U - (start) / 8U) * 8U + (start) % 8U + 1U - (len)) \
+        : (start))
+
+#define CANSIG_MASK(len) \
+    ((len) >= 64U ? UINT64_MAX : ((1ULL << (len)) - 1ULL))
+
+#define CANSIG_SIGN(sgn, len) \
+    ((sgn) ? (1ULL << ((len) - 1U)) : 0ULL)
+
+/**
+ * Generate name_raw(), name_set_raw(), name_get() and name_set() for one
+ * signal. All layout parameters are constants, so name_get() compiles to
+ * load (+ REV), shift, mask, sign fix-up and one multiply-add.
+ *
+ * CANSIG_DEFINE(EngineSpeed, 24, 16, CANSIG_INTEL, 0, 0.25f, 0.0f)
+ */
+#define CANSIG_DEFINE(name, start, len, order, sgn, factor, offset)            \
+static inline int64_t name##_raw(const uint8_t data[8])                       \
+{                                                                             \
+    uint64_t word = ((order) == CANSIG_MOTOROLA) ? CanSig_LoadBE(data)        \
+                                                 : CanSig_LoadLE(data);       \
+    return CanSig_SignExtend((word >> CANSIG_SHIFT(order, start, len))        \
+                             & CANSIG_MASK(len), CANSIG_SIGN(sgn, len));      \
+}                                                                             \
+static inline void name##_set_raw(uint8_t data[8], int64_t raw)               \
+{                                                                             \
+    const uint64_t field = CANSIG_MASK(len) << CANSIG_SHIFT(order, start, len);\
+    uint64_t word = ((order) == CANSIG_MOTOROLA) ? CanSig_LoadBE(data)        \
+                                                 : CanSig_LoadLE(data);       \
+    word = (word & ~field)                                                    \
+         | (((uint64_t)raw << CANSIG_SHIFT(order, start, len)) & field);      \
+    if ((order) == CANSIG_MOTOROLA) {                                         \
+        CanSig_StoreBE(data, word);                                           \
+    } else {                                                                  \
+        CanSig_StoreLE(data, word);                                           \
+    }                                                                         \
+}                                                                             \
+static inline CanSig_Phys_t name##_get(const uint8_t data[8])                 \
+{                                                                             \
+    return (CanSig_Phys_t)name##_raw(data) * (factor) + (offset);             \
+}                                                                             \
+static inline void name##_set(uint8_t data[8], CanSig_Phys_t value)           \
+{                                                                             \
+    static const CanSig_Codec_t codec = {                                     \
+        CANSIG_MASK(len), CANSIG_SIGN(sgn, len),                              \
+        CANSIG_SHIFT(order, start, len), (order), (factor), (offset)          \
+    };                                                                        \
+    CanSig_Encode(&codec, data, value);                                       \
+}
+
+/* ============================================================================
+ * Implementation - Compile
+ * ============================================================================ */
+
+bool CanSig_Compile(const CanSig_Signal_t *signal, CanSig_Codec_t *codec)
+{
+    int shift;
+
+    if ((signal->length == 0U) || (signal->length > 64U) || (signal->start_bit > 63U)) {
+        return false;
+    }
+
+    if (signal->byte_order == CANSIG_MOTOROLA) {
+        shift = (7 - signal->start_bit / 8) * 8 + signal->start_bit % 8 + 1 - signal->length;
+        if (shift < 0) {
+            return false;   /* Runs past the last byte */
+        }
+    } else {
+        shift = signal->start_bit;
+        if (shift + signal->length > 64) {
+            return false;
+        }
+    }
+
+    codec->mask = CANSIG_MASK(signal->length);
+    codec->sign = CANSIG_SIGN(signal->is_signed, signal->length);
+    codec->shift = (uint8_t)shift;
+    codec->order = (signal->byte_order == CANSIG_MOTOROLA) ? 1U : 0U;
+    codec->factor = signal->factor;
+    codec->offset = signal->offset;
+    return true;
+}
+
+bool CanSig_CompileTable(const CanSig_Signal_t *signals, CanSig_Codec_t *codecs,
+                         uint8_t count)
+{
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        if (!CanSig_Compile(&signals[i], &codecs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Implementation - Single Signal
+ * ============================================================================ */
+
+static inline int64_t CanSig_Field(const CanSig_Codec_t *codec, const uint64_t words[2])
+{
+    return CanSig_SignExtend((words[codec->order] >> codec->shift) & codec->mask,
+                             codec->sign);
+}
+
+int64_t CanSig_ExtractRaw(const CanSig_Codec_t *codec, const uint8_t data[8])
+{
+    uint64_t words[2];
+
+    words[0] = CanSig_LoadLE(data);
+    words[1] = __builtin_bswap64(words[0]);
+    return CanSig_Field(codec, words);
+}
+
+void CanSig_InsertRaw(const CanSig_Codec_t *codec, uint8_t data[8], int64_t raw)
+{
+    uint64_t field = codec->mask << codec->shift;
+    uint64_t bits = ((uint64_t)raw << codec->shift) & field;
+    uint64_t word = CanSig_LoadLE(data);
+
+    if (codec->order != 0U) {
+        /* Same physical bits seen from the little-endian word */
+        field = __builtin_bswap64(field);
+        bits = __builtin_bswap64(bits);
+    }
+    CanSig_StoreLE(data, (word & ~field) | bits);
+}
+
+CanSig_Phys_t CanSig_Decode(const CanSig_Codec_t *codec, const uint8_t data[8])
+{
+    return (CanSig_Phys_t)CanSig_ExtractRaw(codec, data) * codec->factor + codec->offset;
+}
+
+/* Physical -> raw: round to nearest and saturate to the field range */
+static int64_t CanSig_ToRaw(const CanSig_Codec_t *codec, CanSig_Phys_t value)
+{
+    CanSig_Phys_t scaled = (value - codec->offset) / codec->factor;
+    int64_t min = -(int64_t)codec->sign;
+    int64_t max = (int64_t)(codec->mask >> 1);
+
+    if ((codec->sign == 0U) && (codec->mask != UINT64_MAX)) {
+        max = (int64_t)codec->mask;     /* 64-bit unsigned stays at INT64_MAX */
+    }
+    if (scaled >= (CanSig_Phys_t)max) {
+        return max;
+    }
+    if (scaled <= (CanSig_Phys_t)min) {
+        return min;
+    }
+    scaled += (scaled < 0) ? -0.5f : 0.5f;
+    return (int64_t)scaled;
+}
+
+void CanSig_Encode(const CanSig_Codec_t *codec, uint8_t data[8], CanSig_Phys_t value)
+{
+    CanSig_InsertRaw(codec, data, CanSig_ToRaw(codec, value));
+}
+
+/* ============================================================================
+ * Implementation - Batch
+ * ============================================================================ */
+
+void CanSig_DecodeFrame(const CanSig_Codec_t *codecs, uint8_t count,
+                        const uint8_t data[8], CanSig_Phys_t *values)
+{
+    uint64_t words[2];
+    uint8_t i;
+
+    /* One load + one REV per frame, then shift/mask per signal */
+    words[0] = CanSig_LoadLE(data);
+    words[1] = __builtin_bswap64(words[0]);
+
+    for (i = 0; i < count; i++) {
+        values[i] = (CanSig_Phys_t)CanSig_Field(&codecs[i], words) * codecs[i].factor
+                  + codecs[i].offset;
+    }
+}
+
+void CanSig_DecodeFrameRaw(const CanSig_Codec_t *codecs, uint8_t count,
+                           const uint8_t data[8], int64_t *raw)
+{
+    uint64_t words[2];
+    uint8_t i;
+
+    words[0] = CanSig_LoadLE(data);
+    words[1] = __builtin_bswap64(words[0]);
+
+    for (i = 0; i < count; i++) {
+        raw[i] = CanSig_Field(&codecs[i], words);
+    }
+}
+
+void CanSig_EncodeFrame(const CanSig_Codec_t *codecs, uint8_t count,
+                        const CanSig_Phys_t *values, uint8_t data[8])
+{
+    /* Build Intel and Motorola signals in their own word, merge once */
+    uint64_t bits[2] = { 0U, 0U };
+    uint64_t fields[2] = { 0U, 0U };
+    uint64_t word;
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        const CanSig_Codec_t *c = &codecs[i];
+        uint64_t field = c->mask << c->shift;
+
+        fields[c->order] |= field;
+        bits[c->order] |= ((uint64_t)CanSig_ToRaw(c, values[i]) << c->shift) & field;
+    }
+
+    fields[0] |= __builtin_bswap64(fields[1]);
+    bits[0] |= __builtin_bswap64(bits[1]);
+
+    word = CanSig_LoadLE(data);
+    CanSig_StoreLE(data, (word & ~fields[0]) | bits[0]);
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Generated accessors - one per signal, layout folded at compile time
+CANSIG_DEFINE(EngineSpeed,   0, 16, CANSIG_INTEL,    0, 0.25f, 0.0f)      // rpm
+CANSIG_DEFINE(CoolantTemp,  16,  8, CANSIG_INTEL,    0, 1.0f, -40.0f)     // degC
+CANSIG_DEFINE(SteeringAngle, 39, 16, CANSIG_MOTOROLA, 1, 0.1f,  0.0f)     // deg
+
+static void engine_rx(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    float rpm = EngineSpeed_get(msg->data);
+    float temp = CoolantTemp_get(msg->data);
+    ...
+}
+
+// Table driven - decode the whole frame in one call
+static const CanSig_Signal_t chassis_signals[] = {
+    //  start len  order            signed factor  offset
+    {    7,  16, CANSIG_MOTOROLA,    1,    0.1f,    0.0f  },   // YawRate
+    {   23,  12, CANSIG_MOTOROLA,    1,    0.01f,   0.0f  },   // LatAccel
+    {   32,   4, CANSIG_INTEL,       0,    1.0f,    0.0f  },   // AliveCounter
+};
+#define CHASSIS_SIGNALS (sizeof(chassis_signals) / sizeof(chassis_signals[0]))
+
+static CanSig_Codec_t chassis_codecs[CHASSIS_SIGNALS];
+static float chassis_values[CHASSIS_SIGNALS];
+
+void App_Init(void)
+{
+    CanSig_CompileTable(chassis_signals, chassis_codecs, CHASSIS_SIGNALS);
+}
+
+static void chassis_rx(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    CanSig_DecodeFrame(chassis_codecs, CHASSIS_SIGNALS, msg->data, chassis_values);
+}
+
+// Transmit
+void App_SendEngine(float rpm, float temp)
+{
+    CAN_TxMsg_t tx = { .id = 0x100, .ide = 0, .rtr = 0, .dlc = 8 };
+
+    memset(tx.data, 0, sizeof(tx.data));
+    EngineSpeed_set(tx.data, rpm);
+    CoolantTemp_set(tx.data, temp);
+    CAN_TransmitQueued(&hcan1, &tx);
+}
+*/
@@ -0,0 +1,293 @@
+/**
+ * CAN Software Acceptance Filter Template
+ *
+ * This template filters received frames in software when the controller
+ * has fewer filter banks than the node has RX IDs (bxCAN: 28 banks shared
+ * by CAN1/CAN2, see references/common-mcu-can.md). Hardware then runs
+ * accept-all or a few coarse masks, and this table decides:
+ * - Up to CANSWF_MAX_ENTRIES (code, mask) entries, standard or extended,
+ *   optionally data frames only; the first matching entry wins
+ * - 11-bit fast path: a 2048-bit bitmap per frame type (data/remote) built
+ *   from the table, one load per standard frame
+ * - Table scan compares 8 entries per step with AVX2, 4 with SSE2 (host
+ *   builds: simulator, log tools) and 4 per unrolled step in plain C on
+ *   the MCU
+ * - Hooked into the RX path with -DCAN_SW_FILTER (hcan->sw_filter)
+ *
+ * Rebuild the bitmap (CanSwf_Build) after changing the table; lookups do
+ * not lock, so swap tables by pointer rather than editing a live one.
+ * Save the declarations up to the implementation as can_swfilter.h.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANSWF_MAX_ENTRIES      256U    /* Multiple of CANSWF_LANES */
+#define CANSWF_LANES            8U      /* Widest compare step (AVX2) */
+
+#if defined(__GNUC__)
+#define CAN_SWF_ALIGNED         __attribute__((aligned(32)))
+#else
+#define CAN_SWF_ALIGNED
+#endif
+
+/* Entry flags */
+#define CANSWF_EXT              0x01U   /* Extended (29-bit) ID */
+#define CANSWF_DATA_ONLY        0x02U   /* Reject remote frames */
+
+/* Lookup key: ID in bits 28:0, RTR bit 30, IDE bit 31. Bit 29 is never
+ * set in a key, so an entry requiring it matches nothing (padding) */
+#define CANSWF_KEY_RTR          (1UL << 30)
+#define CANSWF_KEY_IDE          (1UL << 31)
+#define CANSWF_KEY_NEVER        (1UL << 29)
+#define CANSWF_KEY(id, ide, rtr) \
+    (((id) & 0x1FFFFFFFUL) | ((ide) ? CANSWF_KEY_IDE : 0U) | ((rtr) ? CANSWF_KEY_RTR : 0U))
+
+#define CANSWF_STD_IDS          2048U
+#define CANSWF_NO_MATCH         (-1)
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Filter table
+ *
+ * Codes and masks are kept in separate arrays so one vector load fetches
+ * CANSWF_LANES entries. Slots from count up to the next multiple of
+ * CANSWF_LANES hold never-matching entries, so the scan needs no tail.
+ */
+typedef struct CanSwf_Table_s {
+    CAN_SWF_ALIGNED uint32_t code[CANSWF_MAX_ENTRIES];
+    CAN_SWF_ALIGNED uint32_t mask[CANSWF_MAX_ENTRIES];
+    uint16_t count;
+    uint16_t scan;                  /* count rounded up to CANSWF_LANES */
+    uint32_t std_map[2][CANSWF_STD_IDS / 32U];  /* [rtr][id]: a standard entry matches */
+} CanSwf_Table_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Empty table (rejects everything)
+ */
+void CanSwf_Init(CanSwf_Table_t *t);
+
+/**
+ * @brief Add an entry: a frame matches when its ID equals id in every bit
+ * set in mask, and its type matches flags (standard and extended entries
+ * never match the other type)
+ * @param mask 0x7FF / 0x1FFFFFFF: exact ID, 0: every ID of the type
+ * @return Entry index, CANSWF_NO_MATCH if the table is full
+ */
+int16_t CanSwf_Add(CanSwf_Table_t *t, uint32_t id, uint32_t mask, uint8_t flags);
+
+/**
+ * @brief Add exact data-frame entries for an RX ID list (as CAN_Filter_IdList)
+ * Standard IDs get indices 0..std_count-1, extended IDs follow.
+ * @return false if the table is full (entries added so far are kept)
+ */
+bool CanSwf_AddIdList(CanSwf_Table_t *t,
+                      const uint16_t *std_ids, uint16_t std_count,
+                      const uint32_t *ext_ids, uint16_t ext_count);
+
+/**
+ * @brief Build the 11-bit bitmaps; call after the last CanSwf_Add
+ */
+void CanSwf_Build(CanSwf_Table_t *t);
+
+/**
+ * @brief Accept decision (standard frames: bitmap only)
+ */
+bool CanSwf_Accept(const CanSwf_Table_t *t, uint32_t id, uint8_t ide, uint8_t rtr);
+
+/**
+ * @brief Index of the first matching entry
+ * @return Entry index, CANSWF_NO_MATCH if none
+ */
+int16_t CanSwf_Match(const CanSwf_Table_t *t, uint32_t id, uint8_t ide, uint8_t rtr);
+
+/* ============================================================================
+ * Implementation - Table
+ * ============================================================================ */
+
+void CanSwf_Init(CanSwf_Table_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    for (uint16_t i = 0; i < CANSWF_MAX_ENTRIES; i++) {
+        t->code[i] = CANSWF_KEY_NEVER;
+        t->mask[i] = 0xFFFFFFFFU;
+    }
+}
+
+int16_t CanSwf_Add(CanSwf_Table_t *t, uint32_t id, uint32_t mask, uint8_t flags)
+{
+    uint32_t width = (flags & CANSWF_EXT) ? 0x1FFFFFFFU : 0x7FFU;
+    uint16_t i = t->count;
+
+    if (i >= CANSWF_MAX_ENTRIES) {
+        return CANSWF_NO_MATCH;
+    }
+
+    /* IDE always compared: a standard entry must not accept an extended
+     * frame whose low bits happen to match, nor the other way round */
+    t->mask[i] = (mask & width) | CANSWF_KEY_IDE | ((flags & CANSWF_DATA_ONLY) ? CANSWF_KEY_RTR : 0U);
+    t->code[i] = (id & mask & width) | ((flags & CANSWF_EXT) ? CANSWF_KEY_IDE : 0U);
+    t->count = (uint16_t)(i + 1U);
+    t->scan = (uint16_t)((t->count + CANSWF_LANES - 1U) & ~(CANSWF_LANES - 1U));
+
+    return (int16_t)i;
+}
+
+bool CanSwf_AddIdList(CanSwf_Table_t *t,
+                      const uint16_t *std_ids, uint16_t std_count,
+                      const uint32_t *ext_ids, uint16_t ext_count)
+{
+    uint16_t i;
+
+    for (i = 0; i < std_count; i++) {
+        if (CanSwf_Add(t, std_ids[i], 0x7FFU, CANSWF_DATA_ONLY) < 0) {
+            return false;
+        }
+    }
+    for (i = 0; i < ext_count; i++) {
+        if (CanSwf_Add(t, ext_ids[i], 0x1FFFFFFFU, CANSWF_EXT | CANSWF_DATA_ONLY) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Set the bits of every 11-bit ID that (code, mask) matches: walk the
+ * subsets of the don't-care bits, 2^(11 - bits in mask) IDs per entry */
+static void CanSwf_MapEntry(uint32_t *map, uint32_t code, uint32_t mask)
+{
+    uint32_t free_bits = ~mask & 0x7FFU;
+    uint32_t sub = 0U;
+
+    do {
+        uint32_t id = (code & 0x7FFU) | sub;
+        map[id >> 5] |= 1UL << (id & 31U);
+        sub = (sub - free_bits) & free_bits;
+    } while (sub != 0U);
+}
+
+void CanSwf_Build(CanSwf_Table_t *t)
+{
+    memset(t->std_map, 0, sizeof(t->std_map));
+
+    for (uint16_t i = 0; i < t->count; i++) {
+        if (t->code[i] & CANSWF_KEY_IDE) {
+            continue;                       /* Extended entry */
+        }
+        CanSwf_MapEntry(t->std_map[0], t->code[i], t->mask[i]);
+        if (!(t->mask[i] & CANSWF_KEY_RTR)) {
+            CanSwf_MapEntry(t->std_map[1], t->code[i], t->mask[i]);
+        }
+    }
+}
+
+/* ============================================================================
+ * Implementation - Lookup
+ * ============================================================================ */
+
+/* First i with ((key ^ code[i]) & mask[i]) == 0 */
+static int16_t CanSwf_Scan(const CanSwf_Table_t *t, uint32_t key)
+{
+    const uint32_t *c = t->code;
+    const uint32_t *m = t->mask;
+    uint16_t i;
+
+#if defined(__AVX2__)
+    const __m256i k = _mm256_set1_epi32((int)key);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (i = 0; i < t->scan; i += 8U) {
+        __m256i x = _mm256_and_si256(_mm256_xor_si256(k, _mm256_load_si256((const __m256i *)&c[i])),
+                                     _mm256_load_si256((const __m256i *)&m[i]));
+        uint32_t hit = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, zero)));
+        if (hit != 0U) {
+            return (int16_t)(i + (uint16_t)__builtin_ctz(hit));
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i k = _mm_set1_epi32((int)key);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (i = 0; i < t->scan; i += 4U) {
+        __m128i x = _mm_and_si128(_mm_xor_si128(k, _mm_load_si128((const __m128i *)&c[i])),
+                                  _mm_load_si128((const __m128i *)&m[i]));
+        uint32_t hit = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, zero)));
+        if (hit != 0U) {
+            return (int16_t)(i + (uint16_t)__builtin_ctz(hit));
+        }
+    }
+#else
+    /* Cortex-M SIMD works on 8/16-bit lanes only: plain 32-bit compares,
+     * four per step so the loop overhead is paid once per four entries */
+    for (i = 0; i < t->scan; i += 4U) {
+        if (((key ^ c[i]) & m[i]) == 0U)           return (int16_t)i;
+        if (((key ^ c[i + 1U]) & m[i + 1U]) == 0U) return (int16_t)(i + 1U);
+        if (((key ^ c[i + 2U]) & m[i + 2U]) == 0U) return (int16_t)(i + 2U);
+        if (((key ^ c[i + 3U]) & m[i + 3U]) == 0U) return (int16_t)(i + 3U);
+    }
+#endif
+
+    return CANSWF_NO_MATCH;
+}
+
+bool CanSwf_Accept(const CanSwf_Table_t *t, uint32_t id, uint8_t ide, uint8_t rtr)
+{
+    if (!ide) {
+        id &= 0x7FFU;
+        return (t->std_map[rtr ? 1U : 0U][id >> 5] >> (id & 31U)) & 1U;
+    }
+    return CanSwf_Scan(t, CANSWF_KEY(id, 1U, rtr)) >= 0;
+}
+
+int16_t CanSwf_Match(const CanSwf_Table_t *t, uint32_t id, uint8_t ide, uint8_t rtr)
+{
+    /* Most standard frames on a busy bus are not for this node: the
+     * bitmap rejects them before any scan */
+    if (!ide && !CanSwf_Accept(t, id, 0U, rtr)) {
+        return CANSWF_NO_MATCH;
+    }
+    return CanSwf_Scan(t, CANSWF_KEY(id & (ide ? 0x1FFFFFFFU : 0x7FFU), ide, rtr));
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// 40 RX IDs from the DBC import on a controller with 2 free banks:
+// hardware accepts all, software keeps the list (build with -DCAN_SW_FILTER)
+
+static CanSwf_Table_t rx_table;
+
+void App_FilterInit(CAN_Handle_t *hcan)
+{
+    CanSwf_Init(&rx_table);
+    CanSwf_AddIdList(&rx_table, rx_std_ids, RX_STD_COUNT, rx_ext_ids, RX_EXT_COUNT);
+    CanSwf_Add(&rx_table, 0x18DA00F1U, 0x1FFF00FFU, CANSWF_EXT);   // UDS physical, any target
+    CanSwf_Build(&rx_table);
+
+    CAN_Filter_AcceptAll(hcan);
+    hcan->sw_filter = &rx_table;            // Rejected frames: hcan->sw_rejected
+}
+
+// Dispatch by entry index instead of a second ID search:
+//   int16_t entry = CanSwf_Match(&rx_table, msg->id, msg->ide, msg->rtr);
+*/
@@ -0,0 +1,428 @@
+/**
+ * CAN Timer Wheel Template
+ *
+ * This template provides the timer service shared by the CAN stack
+ * (CanTp STmin / N_As / N_Bs / N_Cr, UDS S3 and P2*, CanNm, bus-off
+ * recovery, mode change and mailbox timeouts of the driver).
+ * Drive CanTimer_Tick() from one periodic hardware timer instead of giving
+ * every protocol its own countdown loop.
+ *
+ * The wheel is hierarchical: CAN_TIMER_LEVELS levels of CAN_TIMER_SLOTS
+ * slots, each level 64 times coarser than the one below. Start, stop and
+ * expiry are O(1); a long timer is moved down at most LEVELS-1 times on
+ * its way to level 0, so hundreds of armed timers cost a few list
+ * operations per tick.
+ *
+ * Tickless operation: stop the periodic tick before sleeping, program a
+ * wakeup after CanTimer_NextExpiry() ticks, and call CanTimer_Advance()
+ * with the ticks actually slept as the first thing after waking up.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+/* Tick period - must match the hardware timer calling CanTimer_Tick() */
+#define CAN_TIMER_TICK_US       100U     /* 100us covers STmin 0xF1-0xF9 */
+
+/* Wheel geometry: 4 levels x 64 slots cover 2^24 ticks (28 min at 100us)
+ * directly; longer timers wait in the top level and are re-placed */
+#define CAN_TIMER_LEVELS        4U
+#define CAN_TIMER_LEVEL_BITS    6U
+#define CAN_TIMER_SLOTS         (1U << CAN_TIMER_LEVEL_BITS)
+#define CAN_TIMER_SLOT_MASK     (CAN_TIMER_SLOTS - 1U)
+#define CAN_TIMER_RANGE         (1UL << (CAN_TIMER_LEVELS * CAN_TIMER_LEVEL_BITS))
+
+/* Interrupt lock around list updates, so timers may be started and
+ * stopped from any ISR as well as from tasks. Must nest (save/restore
+ * PRIMASK or BASEPRI) when timers are armed with interrupts disabled */
+#define CAN_TIMER_ENTER_CRITICAL()  /* uint32_t pm = __get_PRIMASK(); __disable_irq() */
+#define CAN_TIMER_EXIT_CRITICAL()   /* __set_PRIMASK(pm) */
+
+/* Time conversion helpers (round up so a timer never fires early) */
+#define CAN_TIMER_US_TO_TICKS(us) \
+    (((uint32_t)(us) + CAN_TIMER_TICK_US - 1U) / CAN_TIMER_TICK_US)
+#define CAN_TIMER_MS_TO_TICKS(ms) \
+    CAN_TIMER_US_TO_TICKS((uint32_t)(ms) * 1000U)
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef struct CanTimer_s CanTimer_t;
+
+/**
+ * @brief Expiry callback, runs in the context of CanTimer_Tick()
+ */
+typedef void (*CanTimer_Callback_t)(CanTimer_t *timer, void *arg);
+
+/**
+ * @brief Timer object - embedded in the owner's state, no dynamic memory
+ */
+struct CanTimer_s {
+    CanTimer_t *next;               /* Slot list linkage */
+    CanTimer_t *prev;
+    CanTimer_t **list;              /* Head of the list it is linked into */
+    uint32_t expires;               /* Absolute expiry tick */
+    CanTimer_Callback_t callback;
+    void *arg;
+    uint16_t slot;                  /* level * SLOTS + slot, or CAN_TIMER_NO_SLOT */
+    uint8_t active;
+};
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Initialize the timer wheel
+ * Call before anything arms a timer (CAN_Init() included)
+ */
+void CanTimer_Init(void);
+
+/**
+ * @brief Bind callback and argument to a timer object
+ * @param timer Timer object
+ * @param callback Expiry callback
+ * @param arg Argument passed to callback
+ */
+void CanTimer_Setup(CanTimer_t *timer, CanTimer_Callback_t callback, void *arg);
+
+/**
+ * @brief Arm (or re-arm) a timer - O(1), callable from any context
+ * @param timer Timer object
+ * @param ticks Delay in ticks (0 is treated as 1, at most 2^31 - 1)
+ */
+void CanTimer_Start(CanTimer_t *timer, uint32_t ticks);
+
+/**
+ * @brief Disarm a timer (no effect if not armed) - O(1), any context
+ * @param timer Timer object
+ */
+void CanTimer_Stop(CanTimer_t *timer);
+
+/**
+ * @brief Check if a timer is armed
+ */
+bool CanTimer_IsActive(const CanTimer_t *timer);
+
+/**
+ * @brief Advance the wheel by one tick and run expired callbacks
+ * Call this from your tick ISR every CAN_TIMER_TICK_US
+ */
+void CanTimer_Tick(void);
+
+/**
+ * @brief Get the tick counter (wraps at 2^32)
+ */
+uint32_t CanTimer_Now(void);
+
+/**
+ * @brief Ticks until the next CanTimer_Tick() that has work to do
+ * (an expiry, or moving a long timer down a level)
+ * @return 1 .. 2^24, or UINT32_MAX if no timer is armed
+ */
+uint32_t CanTimer_NextExpiry(void);
+
+/**
+ * @brief Catch up after a tickless sleep
+ * Runs only the ticks that have work, skips the rest in one step
+ * @param ticks Ticks elapsed since the last CanTimer_Tick()/Advance()
+ */
+void CanTimer_Advance(uint32_t ticks);
+
+/* ============================================================================
+ * Implementation
+ * ============================================================================ */
+
+#define CAN_TIMER_NO_SLOT       0xFFFFU
+
+static CanTimer_t *wheel[CAN_TIMER_LEVELS][CAN_TIMER_SLOTS];
+static uint64_t wheel_used[CAN_TIMER_LEVELS];   /* Non-empty slots */
+static volatile uint32_t wheel_now = 0;
+
+void CanTimer_Init(void)
+{
+    for (uint32_t l = 0; l < CAN_TIMER_LEVELS; l++) {
+        for (uint32_t i = 0; i < CAN_TIMER_SLOTS; i++) {
+            wheel[l][i] = NULL;
+        }
+        wheel_used[l] = 0;
+    }
+    wheel_now = 0;
+}
+
+void CanTimer_Setup(CanTimer_t *timer, CanTimer_Callback_t callback, void *arg)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->list = NULL;
+    timer->expires = 0;
+    timer->slot = CAN_TIMER_NO_SLOT;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->active = 0;
+}
+
+static void CanTimer_Link(CanTimer_t *timer, CanTimer_t **list)
+{
+    /* Push front - O(1) */
+    timer->list = list;
+    timer->prev = NULL;
+    timer->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = timer;
+    }
+    *list = timer;
+}
+
+static void CanTimer_Unlink(CanTimer_t *timer)
+{
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->list = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+
+    if (timer->slot != CAN_TIMER_NO_SLOT && *timer->list == NULL) {
+        wheel_used[timer->slot / CAN_TIMER_SLOTS] &=
+            ~(1ULL << (timer->slot & CAN_TIMER_SLOT_MASK));
+    }
+    timer->slot = CAN_TIMER_NO_SLOT;
+}
+
+/* Place by distance to expiry: level 0 holds the next 64 ticks, level n
+ * the next 64^(n+1). Caller holds the lock */
+static void CanTimer_Place(CanTimer_t *timer)
+{
+    uint32_t expires = timer->expires;
+    uint32_t delta = expires - wheel_now;
+    uint32_t level = 0;
+    uint32_t slot;
+
+    if (delta >= CAN_TIMER_RANGE) {
+        /* Beyond the top level: park at its far end, re-placed from there */
+        expires = wheel_now + (uint32_t)(CAN_TIMER_RANGE - 1U);
+        delta = (uint32_t)(CAN_TIMER_RANGE - 1U);
+    }
+    while (delta >= (1UL << ((level + 1U) * CAN_TIMER_LEVEL_BITS))) {
+        level++;
+    }
+
+    slot = (expires >> (level * CAN_TIMER_LEVEL_BITS)) & CAN_TIMER_SLOT_MASK;
+    CanTimer_Link(timer, &wheel[level][slot]);
+    timer->slot = (uint16_t)(level * CAN_TIMER_SLOTS + slot);
+    wheel_used[level] |= 1ULL << slot;
+}
+
+void CanTimer_Start(CanTimer_t *timer, uint32_t ticks)
+{
+    if (ticks == 0) {
+        ticks = 1;  /* Earliest expiry is the next tick */
+    }
+
+    CAN_TIMER_ENTER_CRITICAL();
+    if (timer->active) {
+        CanTimer_Unlink(timer);
+    }
+    timer->expires = wheel_now + ticks;
+    CanTimer_Place(timer);
+    timer->active = 1;
+    CAN_TIMER_EXIT_CRITICAL();
+}
+
+void CanTimer_Stop(CanTimer_t *timer)
+{
+    CAN_TIMER_ENTER_CRITICAL();
+    if (timer->active) {
+        CanTimer_Unlink(timer);
+        timer->active = 0;
+    }
+    CAN_TIMER_EXIT_CRITICAL();
+}
+
+bool CanTimer_IsActive(const CanTimer_t *timer)
+{
+    return timer->active != 0;
+}
+
+uint32_t CanTimer_Now(void)
+{
+    return wheel_now;
+}
+
+/* Detach a slot so its timers can be handled one by one while ISRs
+ * (and callbacks) keep starting and stopping timers. Caller holds the lock */
+static void CanTimer_Detach(uint32_t level, uint32_t slot, CanTimer_t **list)
+{
+    CanTimer_t *timer;
+
+    *list = wheel[level][slot];
+    wheel[level][slot] = NULL;
+    wheel_used[level] &= ~(1ULL << slot);
+    for (timer = *list; timer != NULL; timer = timer->next) {
+        timer->list = list;
+        timer->slot = CAN_TIMER_NO_SLOT;
+    }
+}
+
+/* Move the timers of one upper-level slot down by their remaining time */
+static void CanTimer_Cascade(uint32_t level, uint32_t slot)
+{
+    CanTimer_t *pending;
+    CanTimer_t *timer;
+
+    CAN_TIMER_ENTER_CRITICAL();
+    CanTimer_Detach(level, slot, &pending);
+    CAN_TIMER_EXIT_CRITICAL();
+
+    for (;;) {
+        CAN_TIMER_ENTER_CRITICAL();
+        timer = pending;
+        if (timer == NULL) {
+            CAN_TIMER_EXIT_CRITICAL();
+            break;
+        }
+        CanTimer_Unlink(timer);
+        CanTimer_Place(timer);
+        CAN_TIMER_EXIT_CRITICAL();
+    }
+}
+
+void CanTimer_Tick(void)
+{
+    CanTimer_t *pending;
+    CanTimer_t *timer;
+    CanTimer_Callback_t callback;
+    uint32_t now = wheel_now + 1U;
+    uint32_t level;
+
+    wheel_now = now;
+
+    /* At each 64^n boundary the matching slot of level n comes due and is
+     * spread over the levels below (level 0 last, so it is run below) */
+    for (level = 1; level < CAN_TIMER_LEVELS; level++) {
+        if (((now >> ((level - 1U) * CAN_TIMER_LEVEL_BITS)) & CAN_TIMER_SLOT_MASK) != 0) {
+            break;
+        }
+    }
+    while (--level > 0) {
+        CanTimer_Cascade(level, (now >> (level * CAN_TIMER_LEVEL_BITS)) & CAN_TIMER_SLOT_MASK);
+    }
+
+    CAN_TIMER_ENTER_CRITICAL();
+    CanTimer_Detach(0, now & CAN_TIMER_SLOT_MASK, &pending);
+    CAN_TIMER_EXIT_CRITICAL();
+
+    /* Only the current slot is visited - cost depends on the timers due,
+     * not on the total armed count. Callbacks run unlocked and may
+     * start/stop any timer, including ones still waiting in this list */
+    for (;;) {
+        CAN_TIMER_ENTER_CRITICAL();
+        timer = pending;
+        if (timer == NULL) {
+            CAN_TIMER_EXIT_CRITICAL();
+            break;
+        }
+        CanTimer_Unlink(timer);
+        timer->active = 0;
+        callback = timer->callback;
+        CAN_TIMER_EXIT_CRITICAL();
+
+        if (callback != NULL) {
+            callback(timer, timer->arg);
+        }
+    }
+}
+
+/* Ticks until the next occupied slot of a level comes due */
+static uint32_t CanTimer_LevelNext(uint32_t level, uint32_t now)
+{
+    uint32_t shift = level * CAN_TIMER_LEVEL_BITS;
+    uint32_t block = now >> shift;
+    uint32_t start = (block + 1U) & CAN_TIMER_SLOT_MASK;
+    uint64_t used = wheel_used[level];
+    uint64_t rotated;
+
+    if (used == 0) {
+        return UINT32_MAX;
+    }
+
+    /* Rotate so bit 0 is the next slot visited, then count up to a set bit */
+    rotated = (used >> start) | (used << ((CAN_TIMER_SLOTS - start) & CAN_TIMER_SLOT_MASK));
+    block += (uint32_t)__builtin_ctzll(rotated) + 1U;
+    return (block << shift) - now;
+}
+
+uint32_t CanTimer_NextExpiry(void)
+{
+    uint32_t now = wheel_now;
+    uint32_t next = UINT32_MAX;
+    uint32_t ticks;
+
+    CAN_TIMER_ENTER_CRITICAL();
+    for (uint32_t level = 0; level < CAN_TIMER_LEVELS; level++) {
+        ticks = CanTimer_LevelNext(level, now);
+        if (ticks < next) {
+            next = ticks;
+        }
+    }
+    CAN_TIMER_EXIT_CRITICAL();
+
+    return next;
+}
+
+void CanTimer_Advance(uint32_t ticks)
+{
+    uint32_t next;
+
+    while (ticks > 0) {
+        next = CanTimer_NextExpiry();
+        if (next > ticks) {
+            /* Nothing due in the skipped ticks: jump */
+            wheel_now += ticks;
+            return;
+        }
+        wheel_now += next - 1U;
+        ticks -= next;
+        CanTimer_Tick();
+    }
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// 100us hardware tick (e.g. TIM6 update interrupt)
+void TIM6_IRQHandler(void)
+{
+    TIM6->SR = 0;
+    CanTimer_Tick();
+}
+
+static CanTimer_t led_timer;
+
+static void led_timeout(CanTimer_t *timer, void *arg)
+{
+    (void)arg;
+    LED_Toggle();
+    CanTimer_Start(timer, CAN_TIMER_MS_TO_TICKS(500));  // Periodic
+}
+
+void main(void)
+{
+    CanTimer_Init();
+    CanTimer_Setup(&led_timer, led_timeout, NULL);
+    CanTimer_Start(&led_timer, CAN_TIMER_MS_TO_TICKS(500));
+}
+*/
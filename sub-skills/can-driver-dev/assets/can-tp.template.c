@@ -0,0 +1,957 @@
+/**
+ * CAN Transport Protocol (CanTp, ISO 15765-2) Template
+ *
+ * This template provides segmentation and reassembly of diagnostic messages
+ * on top of the CAN TX/RX templates:
+ * - Many concurrent channels (one per tester/ECU pair), full duplex
+ * - Zero-copy: TX reads the caller's buffer, RX reassembles straight into
+ *   a buffer provided by the upper layer (no intermediate copy)
+ * - STmin / N_As / N_Bs / N_Cr handled by the timer wheel, never busy waits
+ * - Classic CAN (TX_DL = 8) and CAN-FD (TX_DL up to 64), FF_DL escape for
+ *   messages larger than 4095 bytes
+ *
+ * Requires: can-timer.template.c
+ * Adapt the link layer adapter (see Example Usage) for your MCU.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANTP_MAX_CHANNELS      16U      /* Number of CanTp channels */
+#define CANTP_RX_HASH_SIZE      32U      /* Power of two, >= 2x channels */
+
+/* Consecutive frames kept in flight when the peer allows STmin = 0.
+ * Set to the number of TX mailboxes; with several mailboxes the controller
+ * must transmit in request order (bxCAN: MCR.TXFP = 1) */
+#define CANTP_TX_PIPELINE       3U
+
+#define CANTP_PADDING_BYTE      0xCCU    /* Fill byte for unused payload */
+#define CANTP_WFT_MAX           8U       /* Max consecutive FC(WAIT) accepted */
+
+/* Default timeouts (ISO 15765-2 performance requirements) */
+#define CANTP_N_AS_MS           1000U    /* Frame TX confirmation */
+#define CANTP_N_BS_MS           1000U    /* Wait for Flow Control */
+#define CANTP_N_CR_MS           1000U    /* Wait for Consecutive Frame */
+
+/* ============================================================================
+ * Protocol Definitions
+ * ============================================================================ */
+
+/* N_PCI type (high nibble of the PCI byte) */
+#define CANTP_PCI_SF            0x00U    /* Single Frame */
+#define CANTP_PCI_FF            0x10U    /* First Frame */
+#define CANTP_PCI_CF            0x20U    /* Consecutive Frame */
+#define CANTP_PCI_FC            0x30U    /* Flow Control */
+
+/* Flow Status */
+#define CANTP_FS_CTS            0x00U    /* Continue To Send */
+#define CANTP_FS_WAIT           0x01U
+#define CANTP_FS_OVFLW          0x02U
+
+/* Largest FF_DL in the 12-bit field; larger messages use the escape form */
+#define CANTP_FF_DL_12BIT_MAX   4095U
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Addressing format
+ * Normal fixed uses the NORMAL framing, mixed 29-bit uses the MIXED framing;
+ * only the configured CAN IDs differ.
+ */
+typedef enum {
+    CANTP_ADDR_NORMAL = 0,  /* PCI in byte 0 */
+    CANTP_ADDR_EXTENDED,    /* N_TA in byte 0, PCI in byte 1 */
+    CANTP_ADDR_MIXED        /* N_AE in byte 0, PCI in byte 1 */
+} CanTp_AddrMode_t;
+
+/**
+ * @brief Transfer result (N_Result)
+ */
+typedef enum {
+    CANTP_OK = 0,
+    CANTP_E_TIMEOUT_A,      /* N_As: frame not confirmed by link layer */
+    CANTP_E_TIMEOUT_BS,     /* N_Bs: no Flow Control from receiver */
+    CANTP_E_TIMEOUT_CR,     /* N_Cr: no Consecutive Frame from sender */
+    CANTP_E_WRONG_SN,       /* Sequence number mismatch */
+    CANTP_E_INVALID_FS,     /* Unknown Flow Status */
+    CANTP_E_UNEXP_PDU,      /* New SF/FF aborted a reception */
+    CANTP_E_WFT_OVRN,       /* Too many FC(WAIT) */
+    CANTP_E_BUFFER_OVFLW    /* Receiver reported FC(OVFLW) */
+} CanTp_Result_t;
+
+/**
+ * @brief Static channel configuration
+ */
+typedef struct {
+    uint32_t rx_id;         /* CAN ID of frames from the peer */
+    uint32_t tx_id;         /* CAN ID of frames to the peer */
+    uint8_t  ide;           /* 0=Standard (11-bit), 1=Extended (29-bit) */
+    uint8_t  addr_mode;     /* CanTp_AddrMode_t */
+    uint8_t  tx_ta;         /* N_TA / N_AE sent in byte 0 (ext/mixed) */
+    uint8_t  rx_ta;         /* N_TA / N_AE expected in byte 0 (ext/mixed) */
+    uint8_t  fd;            /* 0=Classic CAN, 1=CAN-FD */
+    uint8_t  tx_dl;         /* 8, or 12/16/20/24/32/48/64 for CAN-FD */
+    uint8_t  bs;            /* Block size advertised when receiving (0=all) */
+    uint8_t  stmin;         /* STmin advertised when receiving (raw) */
+    uint16_t n_as_ms;       /* 0 = CANTP_N_AS_MS */
+    uint16_t n_bs_ms;       /* 0 = CANTP_N_BS_MS */
+    uint16_t n_cr_ms;       /* 0 = CANTP_N_CR_MS */
+} CanTp_ChannelConfig_t;
+
+/**
+ * @brief Upper and lower layer hooks
+ */
+typedef struct {
+    /* Queue one frame for transmission. Return false if no TX mailbox is
+     * free; CanTp retries on the next tick. 'len' is already padded to a
+     * valid (FD) frame length */
+    bool (*link_tx)(uint8_t channel, uint32_t id, uint8_t ide, uint8_t fd,
+                    const uint8_t *data, uint8_t len);
+
+    /* Provide a buffer of at least 'length' bytes for an incoming message,
+     * or NULL to reject it (multi-frame: FC(OVFLW) is sent) */
+    uint8_t *(*start_of_reception)(uint8_t channel, uint32_t length);
+
+    /* Reception finished (buffer is the one from start_of_reception) */
+    void (*rx_indication)(uint8_t channel, uint8_t *buffer, uint32_t length,
+                          CanTp_Result_t result);
+
+    /* Transmission finished, the TX buffer may be reused */
+    void (*tx_confirmation)(uint8_t channel, CanTp_Result_t result);
+} CanTp_Callbacks_t;
+
+/* Receiver states */
+typedef enum {
+    CANTP_RX_IDLE = 0,
+    CANTP_RX_SEND_FC,       /* FC could not be queued, retried by timer */
+    CANTP_RX_WAIT_CF
+} CanTp_RxState_t;
+
+/* Sender states */
+typedef enum {
+    CANTP_TX_IDLE = 0,
+    CANTP_TX_WAIT_FC,       /* N_Bs running */
+    CANTP_TX_SEND_CF,       /* CFs may be queued */
+    CANTP_TX_WAIT_STMIN,    /* STmin running */
+    CANTP_TX_WAIT_CONF      /* Last frame of message/block queued */
+} CanTp_TxState_t;
+
+/**
+ * @brief Channel runtime state
+ */
+typedef struct {
+    const CanTp_ChannelConfig_t *cfg;
+
+    /* Receiver */
+    uint8_t  rx_state;
+    uint8_t  rx_sn;         /* Next expected sequence number */
+    uint8_t  rx_bs_left;    /* CFs left before next FC (0 = unlimited) */
+    uint8_t  rx_fc_status;  /* FC to (re)send in CANTP_RX_SEND_FC */
+    uint8_t *rx_buf;
+    uint32_t rx_len;
+    uint32_t rx_pos;
+    CanTimer_t rx_timer;    /* N_Cr, FC retry */
+
+    /* Sender */
+    uint8_t  tx_state;
+    uint8_t  tx_sn;
+    uint8_t  tx_bs_left;    /* CFs left in current block (0 = unlimited) */
+    uint8_t  tx_wft;        /* Consecutive FC(WAIT) received */
+    uint8_t  tx_inflight;   /* Frames queued but not yet confirmed */
+    uint32_t tx_stmin_ticks;
+    const uint8_t *tx_data;
+    uint32_t tx_len;
+    uint32_t tx_pos;
+    CanTimer_t tx_timer;    /* N_Bs, STmin, link busy retry */
+    CanTimer_t as_timer;    /* N_As */
+} CanTp_Channel_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Initialize CanTp
+ * @param configs Array of channel configurations (index = channel number)
+ * @param count Number of channels (<= CANTP_MAX_CHANNELS)
+ * @param callbacks Upper/lower layer hooks
+ * @return true if successful
+ */
+bool CanTp_Init(const CanTp_ChannelConfig_t *configs, uint8_t count,
+                const CanTp_Callbacks_t *callbacks);
+
+/**
+ * @brief Start transmission of a message
+ * @param channel Channel number
+ * @param data Message buffer - must stay valid until tx_confirmation
+ * @param length Message length in bytes
+ * @return true if accepted, false if channel busy or no TX mailbox for SF/FF
+ */
+bool CanTp_Transmit(uint8_t channel, const uint8_t *data, uint32_t length);
+
+/**
+ * @brief Feed a received CAN frame (call from the RX callback)
+ * @return true if the frame belonged to a CanTp channel
+ */
+bool CanTp_RxIndication(uint32_t id, uint8_t ide, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Link layer confirmed transmission of a frame of this channel
+ * Call from the TX complete interrupt
+ */
+void CanTp_TxConfirmation(uint8_t channel);
+
+/**
+ * @brief Abort an ongoing transmission (no tx_confirmation is issued)
+ */
+void CanTp_CancelTransmit(uint8_t channel);
+
+/* ============================================================================
+ * Implementation - Helpers
+ * ============================================================================ */
+
+static CanTp_Channel_t cantp_channels[CANTP_MAX_CHANNELS];
+static uint8_t cantp_channel_count = 0;
+static const CanTp_Callbacks_t *cantp_cb = NULL;
+
+/* rx_id -> channel + 1 (0 = empty), open addressing */
+static uint8_t cantp_rx_hash[CANTP_RX_HASH_SIZE];
+
+static void CanTp_RxTimeout(CanTimer_t *timer, void *arg);
+static void CanTp_TxTimeout(CanTimer_t *timer, void *arg);
+static void CanTp_AsTimeout(CanTimer_t *timer, void *arg);
+static void CanTp_TxPump(CanTp_Channel_t *ch);
+
+static uint32_t CanTp_Hash(uint32_t id)
+{
+    /* Multiplicative hash - diagnostic IDs are often consecutive */
+    return ((uint32_t)(id * 2654435761UL) >> 24) & (CANTP_RX_HASH_SIZE - 1U);
+}
+
+static uint8_t CanTp_Index(const CanTp_Channel_t *ch)
+{
+    return (uint8_t)(ch - cantp_channels);
+}
+
+/* Address information bytes in front of the PCI */
+static uint8_t CanTp_Offset(const CanTp_ChannelConfig_t *cfg)
+{
+    return (cfg->addr_mode != CANTP_ADDR_NORMAL) ? 1U : 0U;
+}
+
+/* Round up to the next valid CAN-FD frame length */
+static uint8_t CanTp_FrameLength(uint8_t len)
+{
+    static const uint8_t fd_len[] = {12, 16, 20, 24, 32, 48, 64};
+
+    if (len <= 8) {
+        return len;
+    }
+    for (uint8_t i = 0; i < sizeof(fd_len); i++) {
+        if (len <= fd_len[i]) {
+            return fd_len[i];
+        }
+    }
+    return 64;
+}
+
+/* STmin raw value -> timer ticks */
+static uint32_t CanTp_StminTicks(uint8_t stmin)
+{
+    if (stmin == 0) {
+        return 0;
+    }
+    if (stmin <= 0x7F) {
+        return CAN_TIMER_MS_TO_TICKS(stmin);
+    }
+    if (stmin >= 0xF1 && stmin <= 0xF9) {
+        return CAN_TIMER_US_TO_TICKS((uint32_t)(stmin - 0xF0) * 100U);
+    }
+    return CAN_TIMER_MS_TO_TICKS(0x7F);  /* Reserved: use the maximum */
+}
+
+/**
+ * @brief Pad and hand a frame to the link layer
+ * @param frame Buffer of 64 bytes, 'len' bytes used
+ */
+static bool CanTp_SendFrame(CanTp_Channel_t *ch, uint8_t *frame, uint8_t len)
+{
+    const CanTp_ChannelConfig_t *cfg = ch->cfg;
+    uint8_t frame_len;
+
+    /* Classic CAN frames are always padded to 8 bytes */
+    frame_len = cfg->fd ? CanTp_FrameLength(len) : 8U;
+    if (frame_len < 8U) {
+        frame_len = 8U;
+    }
+    memset(&frame[len], CANTP_PADDING_BYTE, frame_len - len);
+
+    if (!cantp_cb->link_tx(CanTp_Index(ch), cfg->tx_id, cfg->ide, cfg->fd,
+                           frame, frame_len)) {
+        return false;
+    }
+
+    ch->tx_inflight++;
+    if (!CanTimer_IsActive(&ch->as_timer)) {
+        CanTimer_Start(&ch->as_timer,
+                       CAN_TIMER_MS_TO_TICKS(cfg->n_as_ms ? cfg->n_as_ms : CANTP_N_AS_MS));
+    }
+    return true;
+}
+
+static bool CanTp_SendFlowControl(CanTp_Channel_t *ch, uint8_t fs)
+{
+    const CanTp_ChannelConfig_t *cfg = ch->cfg;
+    uint8_t frame[64];
+    uint8_t off = CanTp_Offset(cfg);
+
+    if (off) {
+        frame[0] = cfg->tx_ta;
+    }
+    frame[off + 0] = CANTP_PCI_FC | fs;
+    frame[off + 1] = cfg->bs;
+    frame[off + 2] = cfg->stmin;
+
+    return CanTp_SendFrame(ch, frame, off + 3);
+}
+
+static void CanTp_StartCr(CanTp_Channel_t *ch)
+{
+    const CanTp_ChannelConfig_t *cfg = ch->cfg;
+
+    CanTimer_Start(&ch->rx_timer,
+                   CAN_TIMER_MS_TO_TICKS(cfg->n_cr_ms ? cfg->n_cr_ms : CANTP_N_CR_MS));
+}
+
+static void CanTp_StartBs(CanTp_Channel_t *ch)
+{
+    const CanTp_ChannelConfig_t *cfg = ch->cfg;
+
+    ch->tx_state = CANTP_TX_WAIT_FC;
+    CanTimer_Start(&ch->tx_timer,
+                   CAN_TIMER_MS_TO_TICKS(cfg->n_bs_ms ? cfg->n_bs_ms : CANTP_N_BS_MS));
+}
+
+static void CanTp_RxFinish(CanTp_Channel_t *ch, CanTp_Result_t result)
+{
+    uint8_t *buf = ch->rx_buf;
+    uint32_t len = ch->rx_pos;
+
+    CanTimer_Stop(&ch->rx_timer);
+    ch->rx_state = CANTP_RX_IDLE;
+    ch->rx_buf = NULL;
+
+    if (buf != NULL && cantp_cb->rx_indication != NULL) {
+        cantp_cb->rx_indication(CanTp_Index(ch), buf, len, result);
+    }
+}
+
+static void CanTp_TxFinish(CanTp_Channel_t *ch, CanTp_Result_t result)
+{
+    CanTimer_Stop(&ch->tx_timer);
+    ch->tx_state = CANTP_TX_IDLE;
+    ch->tx_data = NULL;
+
+    if (cantp_cb->tx_confirmation != NULL) {
+        cantp_cb->tx_confirmation(CanTp_Index(ch), result);
+    }
+}
+
+/* ============================================================================
+ * Implementation - Initialization
+ * ============================================================================ */
+
+bool CanTp_Init(const CanTp_ChannelConfig_t *configs, uint8_t count,
+                const CanTp_Callbacks_t *callbacks)
+{
+    if (configs == NULL || callbacks == NULL || callbacks->link_tx == NULL ||
+        count > CANTP_MAX_CHANNELS) {
+        return false;
+    }
+
+    cantp_cb = callbacks;
+    cantp_channel_count = count;
+    memset(cantp_rx_hash, 0, sizeof(cantp_rx_hash));
+
+    for (uint8_t i = 0; i < count; i++) {
+        CanTp_Channel_t *ch = &cantp_channels[i];
+        uint32_t slot;
+
+        if (configs[i].tx_dl < 8 || configs[i].tx_dl > 64 ||
+            (!configs[i].fd && configs[i].tx_dl != 8)) {
+            return false;
+        }
+
+        memset(ch, 0, sizeof(*ch));
+        ch->cfg = &configs[i];
+        CanTimer_Setup(&ch->rx_timer, CanTp_RxTimeout, ch);
+        CanTimer_Setup(&ch->tx_timer, CanTp_TxTimeout, ch);
+        CanTimer_Setup(&ch->as_timer, CanTp_AsTimeout, ch);
+
+        /* Channels sharing an rx_id (extended/mixed addressing) get
+         * consecutive entries, resolved by N_TA on lookup */
+        slot = CanTp_Hash(configs[i].rx_id);
+        while (cantp_rx_hash[slot] != 0) {
+            slot = (slot + 1U) & (CANTP_RX_HASH_SIZE - 1U);
+        }
+        cantp_rx_hash[slot] = i + 1U;
+    }
+
+    return true;
+}
+
+static CanTp_Channel_t *CanTp_Lookup(uint32_t id, uint8_t ide, const uint8_t *data,
+                                     uint8_t len)
+{
+    uint32_t slot = CanTp_Hash(id);
+
+    while (cantp_rx_hash[slot] != 0) {
+        CanTp_Channel_t *ch = &cantp_channels[cantp_rx_hash[slot] - 1U];
+        const CanTp_ChannelConfig_t *cfg = ch->cfg;
+
+        if (cfg->rx_id == id && cfg->ide == ide) {
+            if (cfg->addr_mode == CANTP_ADDR_NORMAL) {
+                return ch;
+            }
+            if (len > 0 && data[0] == cfg->rx_ta) {
+                return ch;
+            }
+        }
+        slot = (slot + 1U) & (CANTP_RX_HASH_SIZE - 1U);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Implementation - Transmit
+ * ============================================================================ */
+
+bool CanTp_Transmit(uint8_t channel, const uint8_t *data, uint32_t length)
+{
+    CanTp_Channel_t *ch;
+    const CanTp_ChannelConfig_t *cfg;
+    uint8_t frame[64];
+    uint8_t off;
+    uint8_t pos;
+    uint32_t sf_max;
+    uint32_t chunk;
+
+    if (channel >= cantp_channel_count || data == NULL || length == 0) {
+        return false;
+    }
+
+    ch = &cantp_channels[channel];
+    cfg = ch->cfg;
+    if (ch->tx_state != CANTP_TX_IDLE) {
+        return false;
+    }
+
+    off = CanTp_Offset(cfg);
+    pos = 0;
+    if (off) {
+        frame[pos++] = cfg->tx_ta;
+    }
+
+    /* SF_DL: 4-bit for TX_DL = 8, escape (PCI low nibble 0) for CAN-FD */
+    sf_max = (cfg->tx_dl == 8) ? (7U - off) : (uint32_t)(cfg->tx_dl - 2U - off);
+
+    ch->tx_data = data;
+    ch->tx_len = length;
+    ch->tx_inflight = 0;
+    ch->tx_wft = 0;
+
+    if (length <= sf_max) {
+        if (length <= 7U - off) {
+            frame[pos++] = CANTP_PCI_SF | (uint8_t)length;
+        } else {
+            frame[pos++] = CANTP_PCI_SF;
+            frame[pos++] = (uint8_t)length;
+        }
+        memcpy(&frame[pos], data, length);
+        pos += (uint8_t)length;
+
+        ch->tx_pos = length;
+        ch->tx_state = CANTP_TX_WAIT_CONF;
+    } else {
+        if (length <= CANTP_FF_DL_12BIT_MAX) {
+            frame[pos++] = CANTP_PCI_FF | (uint8_t)(length >> 8);
+            frame[pos++] = (uint8_t)length;
+        } else {
+            frame[pos++] = CANTP_PCI_FF;
+            frame[pos++] = 0;
+            frame[pos++] = (uint8_t)(length >> 24);
+            frame[pos++] = (uint8_t)(length >> 16);
+            frame[pos++] = (uint8_t)(length >> 8);
+            frame[pos++] = (uint8_t)length;
+        }
+        chunk = cfg->tx_dl - pos;
+        memcpy(&frame[pos], data, chunk);
+        pos += (uint8_t)chunk;
+
+        ch->tx_pos = chunk;
+        ch->tx_sn = 1;
+        CanTp_StartBs(ch);
+    }
+
+    if (!CanTp_SendFrame(ch, frame, pos)) {
+        CanTimer_Stop(&ch->tx_timer);
+        ch->tx_state = CANTP_TX_IDLE;
+        ch->tx_data = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Queue as many CFs as STmin and the pipeline depth allow
+ */
+static void CanTp_TxPump(CanTp_Channel_t *ch)
+{
+    const CanTp_ChannelConfig_t *cfg = ch->cfg;
+    uint8_t frame[64];
+    uint8_t off = CanTp_Offset(cfg);
+    uint8_t limit = (ch->tx_stmin_ticks == 0) ? CANTP_TX_PIPELINE : 1U;
+
+    if (off) {
+        frame[0] = cfg->tx_ta;
+    }
+
+    while (ch->tx_state == CANTP_TX_SEND_CF && ch->tx_inflight < limit) {
+        uint32_t chunk = ch->tx_len - ch->tx_pos;
+
+        if (chunk > (uint32_t)(cfg->tx_dl - 1U - off)) {
+            chunk = cfg->tx_dl - 1U - off;
+        }
+
+        frame[off] = CANTP_PCI_CF | ch->tx_sn;
+        memcpy(&frame[off + 1], &ch->tx_data[ch->tx_pos], chunk);
+
+        if (!CanTp_SendFrame(ch, frame, (uint8_t)(off + 1U + chunk))) {
+            /* No free mailbox - retry on next tick */
+            CanTimer_Start(&ch->tx_timer, 1);
+            return;
+        }
+
+        ch->tx_pos += chunk;
+        ch->tx_sn = (ch->tx_sn + 1U) & 0x0FU;
+
+        if (ch->tx_pos >= ch->tx_len) {
+            ch->tx_state = CANTP_TX_WAIT_CONF;
+        } else if (ch->tx_bs_left != 0 && --ch->tx_bs_left == 0) {
+            ch->tx_state = CANTP_TX_WAIT_CONF;  /* Block done, FC follows */
+        }
+    }
+}
+
+void CanTp_TxConfirmation(uint8_t channel)
+{
+    CanTp_Channel_t *ch;
+    const CanTp_ChannelConfig_t *cfg;
+
+    if (channel >= cantp_channel_count) {
+        return;
+    }
+    ch = &cantp_channels[channel];
+    cfg = ch->cfg;
+
+    if (ch->tx_inflight == 0) {
+        return;
+    }
+    if (--ch->tx_inflight == 0) {
+        CanTimer_Stop(&ch->as_timer);
+    } else {
+        CanTimer_Start(&ch->as_timer,
+                       CAN_TIMER_MS_TO_TICKS(cfg->n_as_ms ? cfg->n_as_ms : CANTP_N_AS_MS));
+    }
+
+    switch (ch->tx_state) {
+    case CANTP_TX_SEND_CF:
+        if (ch->tx_stmin_ticks != 0) {
+            /* STmin counts from the end of the previous CF */
+            ch->tx_state = CANTP_TX_WAIT_STMIN;
+            CanTimer_Start(&ch->tx_timer, ch->tx_stmin_ticks);
+        } else {
+            CanTp_TxPump(ch);
+        }
+        break;
+
+    case CANTP_TX_WAIT_CONF:
+        if (ch->tx_inflight != 0) {
+            break;
+        }
+        if (ch->tx_pos >= ch->tx_len) {
+            CanTp_TxFinish(ch, CANTP_OK);
+        } else {
+            CanTp_StartBs(ch);
+        }
+        break;
+
+    default:
+        /* FF/FC confirmations need no action */
+        break;
+    }
+}
+
+void CanTp_CancelTransmit(uint8_t channel)
+{
+    CanTp_Channel_t *ch;
+
+    if (channel >= cantp_channel_count) {
+        return;
+    }
+    ch = &cantp_channels[channel];
+
+    CanTimer_Stop(&ch->tx_timer);
+    ch->tx_state = CANTP_TX_IDLE;
+    ch->tx_data = NULL;
+}
+
+static void CanTp_RxFlowControl(CanTp_Channel_t *ch, const uint8_t *pci, uint8_t avail)
+{
+    if (ch->tx_state != CANTP_TX_WAIT_FC || avail < 3) {
+        return;  /* Unexpected FC is ignored */
+    }
+
+    switch (pci[0] & 0x0FU) {
+    case CANTP_FS_CTS:
+        CanTimer_Stop(&ch->tx_timer);
+        ch->tx_wft = 0;
+        ch->tx_bs_left = pci[1];
+        ch->tx_stmin_ticks = CanTp_StminTicks(pci[2]);
+        ch->tx_state = CANTP_TX_SEND_CF;
+        CanTp_TxPump(ch);
+        break;
+
+    case CANTP_FS_WAIT:
+        if (++ch->tx_wft > CANTP_WFT_MAX) {
+            CanTp_TxFinish(ch, CANTP_E_WFT_OVRN);
+        } else {
+            CanTp_StartBs(ch);
+        }
+        break;
+
+    case CANTP_FS_OVFLW:
+        CanTp_TxFinish(ch, CANTP_E_BUFFER_OVFLW);
+        break;
+
+    default:
+        CanTp_TxFinish(ch, CANTP_E_INVALID_FS);
+        break;
+    }
+}
+
+/* ============================================================================
+ * Implementation - Receive
+ * ============================================================================ */
+
+static void CanTp_RxSendFc(CanTp_Channel_t *ch, uint8_t fs)
+{
+    ch->rx_fc_status = fs;
+
+    if (CanTp_SendFlowControl(ch, fs)) {
+        if (fs == CANTP_FS_OVFLW) {
+            ch->rx_state = CANTP_RX_IDLE;
+            CanTimer_Stop(&ch->rx_timer);
+        } else {
+            ch->rx_state = CANTP_RX_WAIT_CF;
+            ch->rx_bs_left = ch->cfg->bs;
+            CanTp_StartCr(ch);
+        }
+    } else {
+        /* No free mailbox - retry on next tick */
+        ch->rx_state = CANTP_RX_SEND_FC;
+        CanTimer_Start(&ch->rx_timer, 1);
+    }
+}
+
+static void CanTp_RxSingleFrame(CanTp_Channel_t *ch, const uint8_t *pci, uint8_t avail)
+{
+    uint32_t dl = pci[0] & 0x0FU;
+    uint8_t hdr = 1;
+    uint8_t *buf;
+
+    if (dl == 0 && avail > 8) {
+        dl = pci[1];  /* CAN-FD escape: SF_DL in second byte */
+        hdr = 2;
+    }
+    if (dl == 0 || dl > (uint32_t)(avail - hdr)) {
+        return;  /* Invalid SF_DL is ignored */
+    }
+
+    if (ch->rx_state != CANTP_RX_IDLE) {
+        CanTp_RxFinish(ch, CANTP_E_UNEXP_PDU);
+    }
+
+    buf = cantp_cb->start_of_reception(CanTp_Index(ch), dl);
+    if (buf == NULL) {
+        return;
+    }
+    memcpy(buf, &pci[hdr], dl);
+
+    ch->rx_buf = buf;
+    ch->rx_pos = dl;
+    CanTp_RxFinish(ch, CANTP_OK);
+}
+
+static void CanTp_RxFirstFrame(CanTp_Channel_t *ch, const uint8_t *pci, uint8_t avail)
+{
+    uint32_t dl;
+    uint8_t hdr = 2;
+    uint32_t chunk;
+
+    if (avail < 8U - CanTp_Offset(ch->cfg)) {
+        return;  /* FF always uses the full frame */
+    }
+
+    dl = ((uint32_t)(pci[0] & 0x0FU) << 8) | pci[1];
+    if (dl == 0) {
+        dl = ((uint32_t)pci[2] << 24) | ((uint32_t)pci[3] << 16) |
+             ((uint32_t)pci[4] << 8)  | pci[5];
+        hdr = 6;
+    }
+    if (dl <= (uint32_t)(avail - hdr)) {
+        return;  /* Would have fit into a SF */
+    }
+
+    if (ch->rx_state != CANTP_RX_IDLE) {
+        CanTp_RxFinish(ch, CANTP_E_UNEXP_PDU);
+    }
+
+    ch->rx_buf = cantp_cb->start_of_reception(CanTp_Index(ch), dl);
+    if (ch->rx_buf == NULL) {
+        CanTp_RxSendFc(ch, CANTP_FS_OVFLW);
+        return;
+    }
+
+    chunk = avail - hdr;
+    memcpy(ch->rx_buf, &pci[hdr], chunk);
+    ch->rx_len = dl;
+    ch->rx_pos = chunk;
+    ch->rx_sn = 1;
+
+    CanTp_RxSendFc(ch, CANTP_FS_CTS);
+}
+
+static void CanTp_RxConsecutiveFrame(CanTp_Channel_t *ch, const uint8_t *pci, uint8_t avail)
+{
+    uint32_t chunk;
+
+    if (ch->rx_state != CANTP_RX_WAIT_CF) {
+        return;  /* Unexpected CF is ignored */
+    }
+
+    if ((pci[0] & 0x0FU) != ch->rx_sn) {
+        CanTp_RxFinish(ch, CANTP_E_WRONG_SN);
+        return;
+    }
+    ch->rx_sn = (ch->rx_sn + 1U) & 0x0FU;
+
+    /* Copy straight into the upper layer buffer */
+    chunk = ch->rx_len - ch->rx_pos;
+    if (chunk > (uint32_t)(avail - 1U)) {
+        chunk = avail - 1U;
+    }
+    memcpy(&ch->rx_buf[ch->rx_pos], &pci[1], chunk);
+    ch->rx_pos += chunk;
+
+    if (ch->rx_pos >= ch->rx_len) {
+        CanTp_RxFinish(ch, CANTP_OK);
+    } else if (ch->rx_bs_left != 0 && --ch->rx_bs_left == 0) {
+        CanTp_RxSendFc(ch, CANTP_FS_CTS);
+    } else {
+        CanTp_StartCr(ch);
+    }
+}
+
+bool CanTp_RxIndication(uint32_t id, uint8_t ide, const uint8_t *data, uint8_t len)
+{
+    CanTp_Channel_t *ch;
+    const uint8_t *pci;
+    uint8_t off;
+    uint8_t avail;
+
+    ch = CanTp_Lookup(id, ide, data, len);
+    if (ch == NULL) {
+        return false;
+    }
+
+    off = CanTp_Offset(ch->cfg);
+    if (len < off + 1U) {
+        return true;
+    }
+    pci = &data[off];
+    avail = len - off;
+
+    switch (pci[0] & 0xF0U) {
+    case CANTP_PCI_SF:
+        CanTp_RxSingleFrame(ch, pci, avail);
+        break;
+    case CANTP_PCI_FF:
+        CanTp_RxFirstFrame(ch, pci, avail);
+        break;
+    case CANTP_PCI_CF:
+        CanTp_RxConsecutiveFrame(ch, pci, avail);
+        break;
+    case CANTP_PCI_FC:
+        CanTp_RxFlowControl(ch, pci, avail);
+        break;
+    default:
+        break;  /* Reserved PCI type */
+    }
+
+    return true;
+}
+
+/* ============================================================================
+ * Implementation - Timer Callbacks
+ * ============================================================================ */
+
+static void CanTp_RxTimeout(CanTimer_t *timer, void *arg)
+{
+    CanTp_Channel_t *ch = (CanTp_Channel_t *)arg;
+    (void)timer;
+
+    if (ch->rx_state == CANTP_RX_SEND_FC) {
+        CanTp_RxSendFc(ch, ch->rx_fc_status);
+    } else if (ch->rx_state == CANTP_RX_WAIT_CF) {
+        CanTp_RxFinish(ch, CANTP_E_TIMEOUT_CR);
+    }
+}
+
+static void CanTp_TxTimeout(CanTimer_t *timer, void *arg)
+{
+    CanTp_Channel_t *ch = (CanTp_Channel_t *)arg;
+    (void)timer;
+
+    switch (ch->tx_state) {
+    case CANTP_TX_WAIT_FC:
+        CanTp_TxFinish(ch, CANTP_E_TIMEOUT_BS);
+        break;
+    case CANTP_TX_WAIT_STMIN:
+        ch->tx_state = CANTP_TX_SEND_CF;
+        CanTp_TxPump(ch);
+        break;
+    case CANTP_TX_SEND_CF:
+        CanTp_TxPump(ch);  /* Link layer was busy */
+        break;
+    default:
+        break;
+    }
+}
+
+static void CanTp_AsTimeout(CanTimer_t *timer, void *arg)
+{
+    CanTp_Channel_t *ch = (CanTp_Channel_t *)arg;
+    (void)timer;
+
+    ch->tx_inflight = 0;
+    if (ch->tx_state != CANTP_TX_IDLE) {
+        CanTp_TxFinish(ch, CANTP_E_TIMEOUT_A);
+    }
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Channel 0: physical diagnostics, classic CAN
+// Channel 1: same ECU over CAN-FD with 64 byte frames
+static const CanTp_ChannelConfig_t cantp_config[] = {
+    { .rx_id = 0x7E0, .tx_id = 0x7E8, .ide = 0, .addr_mode = CANTP_ADDR_NORMAL,
+      .fd = 0, .tx_dl = 8,  .bs = 0, .stmin = 0 },
+    { .rx_id = 0x7E1, .tx_id = 0x7E9, .ide = 0, .addr_mode = CANTP_ADDR_NORMAL,
+      .fd = 1, .tx_dl = 64, .bs = 0, .stmin = 0 },
+};
+
+CAN_Handle_t hcan1;
+
+// Which channel owns each TX mailbox, for TX confirmation
+static uint8_t mailbox_owner[3];
+
+static bool link_tx(uint8_t channel, uint32_t id, uint8_t ide, uint8_t fd,
+                    const uint8_t *data, uint8_t len)
+{
+    CAN_TxMsg_t msg = { .id = id, .ide = ide, .rtr = 0, .dlc = len };
+    int8_t mailbox = CAN_GetEmptyMailbox(&hcan1);
+
+    (void)fd;  // Classic controller: FD channels need an FDCAN TX path
+    if (mailbox < 0) {
+        return false;
+    }
+    memcpy(msg.data, data, len);
+    mailbox_owner[mailbox] = channel;
+    return CAN_Transmit(&hcan1, &msg);
+}
+
+static uint8_t rx_buffer[4096 + 2];
+
+static uint8_t *start_of_reception(uint8_t channel, uint32_t length)
+{
+    (void)channel;
+    return (length <= sizeof(rx_buffer)) ? rx_buffer : NULL;
+}
+
+static void rx_indication(uint8_t channel, uint8_t *buffer, uint32_t length,
+                          CanTp_Result_t result)
+{
+    if (result == CANTP_OK) {
+        Dcm_HandleRequest(channel, buffer, length);
+    }
+}
+
+static void tx_confirmation(uint8_t channel, CanTp_Result_t result)
+{
+    (void)channel;
+    (void)result;
+}
+
+static const CanTp_Callbacks_t cantp_callbacks = {
+    .link_tx = link_tx,
+    .start_of_reception = start_of_reception,
+    .rx_indication = rx_indication,
+    .tx_confirmation = tx_confirmation,
+};
+
+static void can_rx(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    (void)hcan;
+    if (CanTp_RxIndication(msg->id, msg->ide, msg->data, msg->dlc)) {
+        return;
+    }
+    // Not a CanTp frame - application dispatch
+}
+
+static void can_tx_done(CAN_Handle_t *hcan, uint8_t mailbox)
+{
+    (void)hcan;
+    CanTp_TxConfirmation(mailbox_owner[mailbox]);
+}
+
+void CAN1_RX0_IRQHandler(void) { CAN_RX_IRQHandler(&hcan1); }
+void CAN1_TX_IRQHandler(void)  { CAN_TX_IRQHandler(&hcan1); }
+
+void main(void)
+{
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);
+    hcan1.regs->MCR |= CAN_MCR_TXFP;  // Keep pipelined CFs in order
+    CanTp_Init(cantp_config, 2, &cantp_callbacks);
+    CAN_RegisterRxCallback(&hcan1, can_rx);
+    hcan1.tx_callback = can_tx_done;
+    CAN_EnableRxInterrupt(&hcan1);
+    hcan1.regs->IER |= CAN_IER_TMEIE;
+
+    while (1) {
+    }
+}
+*/
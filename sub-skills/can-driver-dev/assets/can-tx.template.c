@@ -2,35 +2,25 @@
  * CAN Transmit Template
  * 
  * This template provides CAN transmission functions.
+ * Functions take the controller handle (can-handle.template.h); frames
+ * that find no free mailbox can be queued per instance and are sent from
+ * the TX interrupt. Nothing here waits: TX timeouts abort the mailbox from
+ * the timer wheel (can-timer.template.c).
  * Adapt register names and addresses for your specific MCU.
  */
 
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include "can_handle.h"
 
 /* ============================================================================
  * Configuration
  * ============================================================================ */
 
-/* Timeout for TX operations */
+/* Typical timeout for CAN_TransmitTimeout() */
 #define CAN_TX_TIMEOUT      1000U   /* milliseconds */
 
-/* ============================================================================
- * Type Definitions
- * ============================================================================ */
-
-/**
- * @brief CAN message structure
- */
-typedef struct {
-    uint32_t id;            /* Standard or Extended ID */
-    uint8_t  ide;           /* 0=Standard (11-bit), 1=Extended (29-bit) */
-    uint8_t  rtr;           /* 0=Data frame, 1=Remote frame */
-    uint8_t  dlc;           /* Data Length Code (0-8) */
-    uint8_t  data[8];       /* Data payload */
-} CAN_TxMsg_t;
-
 /* ============================================================================
  * Register Definitions
  * ============================================================================ */
@@ -48,6 +38,15 @@ typedef struct {
 #define CAN_TSR_TME1        (1U << 27)   /* TX Mailbox 1 Empty */
 #define CAN_TSR_TME2        (1U << 28)   /* TX Mailbox 2 Empty */
 #define CAN_TSR_RQCP0       (1U << 0)    /* Request Complete Mailbox 0 */
+#define CAN_TSR_RQCP1       (1U << 8)    /* Request Complete Mailbox 1 */
+#define CAN_TSR_RQCP2       (1U << 16)   /* Request Complete Mailbox 2 */
+#define CAN_TSR_TXOK0       (1U << 1)    /* Transmission OK Mailbox 0 */
+#define CAN_TSR_TXOK1       (1U << 9)    /* Transmission OK Mailbox 1 */
+#define CAN_TSR_TXOK2       (1U << 17)   /* Transmission OK Mailbox 2 */
+#define CAN_TSR_ABRQ0       (1U << 7)    /* Abort Request Mailbox 0 */
+#define CAN_TSR_ABRQ1       (1U << 15)   /* Abort Request Mailbox 1 */
+#define CAN_TSR_ABRQ2       (1U << 23)   /* Abort Request Mailbox 2 */
+#define CAN_IER_TMEIE       (1U << 0)    /* TX Mailbox Empty Interrupt */
 #define CAN_TIR_TXRQ        (1U << 0)    /* TX Request */
 #define CAN_TIR_RTR         (1U << 1)    /* Remote TX Request */
 #define CAN_TIR_IDE         (1U << 2)    /* ID Extended */
@@ -58,53 +57,75 @@ typedef struct {
 
 /**
  * @brief Transmit a CAN message
+ * @param hcan Controller handle
+ * @param msg Pointer to message structure
+ * @return true if transmitted successfully, false if no mailbox is free
+ */
+bool CAN_Transmit(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg);
+
+/**
+ * @brief Transmit, or queue the message if all mailboxes are busy
+ * Requires CAN_TX_IRQHandler() to be called from the TX interrupt
+ * @param hcan Controller handle
  * @param msg Pointer to message structure
- * @return true if transmitted successfully
+ * @return false only if the TX queue is full
  */
-bool CAN_Transmit(const CAN_TxMsg_t *msg);
+bool CAN_TransmitQueued(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg);
 
 /**
- * @brief Transmit with blocking wait
+ * @brief Transmit, aborting the frame if it is not sent within the timeout
+ * Does not wait: the abort runs from the timer wheel and is counted in
+ * hcan->tx.timeouts; success is reported through tx_callback
+ * @param hcan Controller handle
  * @param msg Pointer to message structure
  * @param timeout_ms Timeout in milliseconds
- * @return true if transmitted and acknowledged
+ * @return Mailbox used (0-2), or -1 if no mailbox is free
  */
-bool CAN_TransmitBlocking(const CAN_TxMsg_t *msg, uint32_t timeout_ms);
+int8_t CAN_TransmitTimeout(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg, uint32_t timeout_ms);
 
 /**
  * @brief Check if TX mailbox is available
  * @return true if at least one mailbox is empty
  */
-bool CAN_IsTxReady(void);
+bool CAN_IsTxReady(CAN_Handle_t *hcan);
 
 /**
  * @brief Get empty mailbox number
  * @return Mailbox number (0-2) or -1 if none available
  */
-int8_t CAN_GetEmptyMailbox(void);
+int8_t CAN_GetEmptyMailbox(CAN_Handle_t *hcan);
+
+/**
+ * @brief TX interrupt handler
+ * Call this from your ISR with the instance handle
+ * (e.g. CAN1_TX_IRQHandler -> CAN_TX_IRQHandler(&hcan1))
+ */
+void CAN_TX_IRQHandler(CAN_Handle_t *hcan);
 
 /* ============================================================================
  * Implementation
  * ============================================================================ */
 
-bool CAN_Transmit(const CAN_TxMsg_t *msg)
+static int8_t CAN_FindEmptyMailbox(const CAN_TypeDef *can)
 {
-    int8_t mailbox;
-    CAN_TxMailBox_TypeDef *tx_mb;
+    uint32_t tsr = can->TSR;
     
-    /* Validate input */
-    if (msg == NULL || msg->dlc > 8) {
-        return false;
-    }
+    if (tsr & CAN_TSR_TME0) return 0;
+    if (tsr & CAN_TSR_TME1) return 1;
+    if (tsr & CAN_TSR_TME2) return 2;
+    return -1;
+}
+
+static void CAN_WriteMailbox(CAN_Handle_t *hcan, int8_t mailbox, const CAN_TxMsg_t *msg)
+{
+    CAN_TypeDef *can = hcan->regs;
+    CAN_TxMailBox_TypeDef *tx_mb = &can->sTxMailBox[mailbox];
     
-    /* Get empty mailbox */
-    mailbox = CAN_GetEmptyMailbox();
-    if (mailbox < 0) {
-        return false;  /* No empty mailbox */
+    /* A timeout left from the previous frame must not abort this one */
+    if (CanTimer_IsActive(&hcan->tx_timer[mailbox])) {
+        CanTimer_Stop(&hcan->tx_timer[mailbox]);
     }
     
-    tx_mb = &CAN->sTxMailBox[mailbox];
-    
     /* Configure identifier */
     if (msg->ide) {
         /* Extended ID (29-bit) */
@@ -135,55 +156,147 @@ bool CAN_Transmit(const CAN_TxMsg_t *msg)
     
     /* Request transmission */
     tx_mb->TIR |= CAN_TIR_TXRQ;
+    CAN_HW_SYNC(can);
+    
+    CAN_TRACE_POINT(hcan, CAN_TRACE_TX_MAILBOX, mailbox, msg->id);
+}
+
+bool CAN_Transmit(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg)
+{
+    CAN_TypeDef *can = hcan->regs;  /* One load, then plain register access */
+    int8_t mailbox;
+    
+    /* Validate input */
+    if (msg == NULL || msg->dlc > 8) {
+        return false;
+    }
+    
+    /* Get empty mailbox */
+    mailbox = CAN_FindEmptyMailbox(can);
+    if (mailbox < 0) {
+        CAN_TRACE_POINT(hcan, CAN_TRACE_TX_MAILBOX, 0xFFU, msg->id);
+        return false;  /* No empty mailbox */
+    }
+    
+    CAN_WriteMailbox(hcan, mailbox, msg);
     
     return true;
 }
 
-bool CAN_TransmitBlocking(const CAN_TxMsg_t *msg, uint32_t timeout_ms)
+bool CAN_TransmitQueued(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg)
 {
-    uint32_t start_time = 0;  /* TODO: Get current time */
-    uint32_t mailbox_mask;
+    CAN_TypeDef *can = hcan->regs;
+    CAN_TxQueue_t *q = &hcan->tx;
+    bool ok = true;
+    int8_t mailbox;
     
-    /* Transmit message */
-    if (!CAN_Transmit(msg)) {
+    if (msg == NULL || msg->dlc > 8) {
         return false;
     }
     
-    /* Determine which mailbox was used */
-    if (CAN->TSR & CAN_TSR_TME0) {
-        mailbox_mask = CAN_TSR_RQCP0;
-    } else if (CAN->TSR & CAN_TSR_TME1) {
-        mailbox_mask = CAN_TSR_RQCP1;
+    /* Mask only this instance's TX interrupt while deciding */
+    can->IER &= ~CAN_IER_TMEIE;
+    
+    /* Bypass the queue only when it is empty, to keep frame order */
+    if (q->head == q->tail && (mailbox = CAN_FindEmptyMailbox(can)) >= 0) {
+        CAN_WriteMailbox(hcan, mailbox, msg);
+    } else if ((uint16_t)(q->head - q->tail) >= CAN_TX_QUEUE_SIZE) {
+        q->dropped++;
+        ok = false;
     } else {
-        mailbox_mask = CAN_TSR_RQCP2;
+        q->msg[q->head & (CAN_TX_QUEUE_SIZE - 1U)] = *msg;
+        q->head++;
     }
     
-    /* Wait for completion */
-    while (!(CAN->TSR & mailbox_mask)) {
-        /* TODO: Check timeout
-         * if ((GetTick() - start_time) >= timeout_ms) {
-         *     return false;
-         * }
-         */
+    can->IER |= CAN_IER_TMEIE;
+    
+    return ok;
+}
+
+void CAN_TX_IRQHandler(CAN_Handle_t *hcan)
+{
+    static const uint32_t rqcp[3] = { CAN_TSR_RQCP0, CAN_TSR_RQCP1, CAN_TSR_RQCP2 };
+    static const uint32_t txok[3] = { CAN_TSR_TXOK0, CAN_TSR_TXOK1, CAN_TSR_TXOK2 };
+    CAN_TypeDef *can = hcan->regs;
+    CAN_TxQueue_t *q = &hcan->tx;
+    uint32_t tsr = can->TSR;
+    int8_t mailbox;
+    
+    /* RQCP0/1/2 (bits 0, 8, 16) packed into a 3-bit mask */
+    CAN_TRACE_POINT(hcan, CAN_TRACE_TX_ISR_ENTER,
+                    (tsr & 1U) | ((tsr >> 7) & 2U) | ((tsr >> 14) & 4U), 0);
+    
+    /* Acknowledge completed mailboxes; aborted ones are not confirmed */
+    for (uint8_t mb = 0; mb < 3; mb++) {
+        if (tsr & rqcp[mb]) {
+            can->TSR = rqcp[mb];
+            CAN_HW_SYNC(can);
+            if (CanTimer_IsActive(&hcan->tx_timer[mb])) {
+                CanTimer_Stop(&hcan->tx_timer[mb]);
+            }
+            if ((tsr & txok[mb]) && hcan->tx_callback != NULL) {
+                CAN_TRACE_POINT(hcan, CAN_TRACE_TX_CB_ENTER, mb, 0);
+                hcan->tx_callback(hcan, mb);
+                CAN_TRACE_POINT(hcan, CAN_TRACE_TX_CB_EXIT, mb, 0);
+            }
+        }
     }
     
-    /* Clear the request complete flag */
-    CAN->TSR = mailbox_mask;
+    /* Refill free mailboxes from the queue */
+    while (q->tail != q->head && (mailbox = CAN_FindEmptyMailbox(can)) >= 0) {
+        CAN_WriteMailbox(hcan, mailbox, &q->msg[q->tail & (CAN_TX_QUEUE_SIZE - 1U)]);
+        q->tail++;
+    }
     
-    return true;
+    CAN_TRACE_POINT(hcan, CAN_TRACE_TX_ISR_EXIT, 0, q->head - q->tail);
 }
 
-bool CAN_IsTxReady(void)
+static void CAN_TxTimeout(CanTimer_t *timer, void *arg)
 {
-    return (CAN->TSR & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) != 0;
+    static const uint32_t tme[3] = { CAN_TSR_TME0, CAN_TSR_TME1, CAN_TSR_TME2 };
+    static const uint32_t abrq[3] = { CAN_TSR_ABRQ0, CAN_TSR_ABRQ1, CAN_TSR_ABRQ2 };
+    CAN_Handle_t *hcan = (CAN_Handle_t *)arg;
+    CAN_TypeDef *can = hcan->regs;
+    uint8_t mb = (uint8_t)(timer - hcan->tx_timer);
+    
+    /* Still pending (arbitration always lost, no ACK, bus-off): abort.
+     * The mailbox completes without TXOK, so no TX confirmation */
+    if (!(can->TSR & tme[mb])) {
+        can->TSR = abrq[mb];
+        CAN_HW_SYNC(can);
+        hcan->tx.timeouts++;
+    }
 }
 
-int8_t CAN_GetEmptyMailbox(void)
+int8_t CAN_TransmitTimeout(CAN_Handle_t *hcan, const CAN_TxMsg_t *msg, uint32_t timeout_ms)
 {
-    if (CAN->TSR & CAN_TSR_TME0) return 0;
-    if (CAN->TSR & CAN_TSR_TME1) return 1;
-    if (CAN->TSR & CAN_TSR_TME2) return 2;
-    return -1;
+    int8_t mailbox;
+    
+    if (msg == NULL || msg->dlc > 8) {
+        return -1;
+    }
+    
+    mailbox = CAN_FindEmptyMailbox(hcan->regs);
+    if (mailbox < 0) {
+        return -1;
+    }
+    
+    CAN_WriteMailbox(hcan, mailbox, msg);
+    
+    CanTimer_Setup(&hcan->tx_timer[mailbox], CAN_TxTimeout, hcan);
+    CanTimer_Start(&hcan->tx_timer[mailbox], CAN_TIMER_MS_TO_TICKS(timeout_ms));
+    
+    return mailbox;
+}
+
+bool CAN_IsTxReady(CAN_Handle_t *hcan)
+{
+    return (hcan->regs->TSR & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2)) != 0;
+}
+
+int8_t CAN_GetEmptyMailbox(CAN_Handle_t *hcan)
+{
+    return CAN_FindEmptyMailbox(hcan->regs);
 }
 
 /* ============================================================================
@@ -193,7 +306,7 @@ int8_t CAN_GetEmptyMailbox(void)
 /**
  * @brief Transmit standard ID message (convenience function)
  */
-bool CAN_TransmitStd(uint32_t id, const uint8_t *data, uint8_t len)
+bool CAN_TransmitStd(CAN_Handle_t *hcan, uint32_t id, const uint8_t *data, uint8_t len)
 {
     CAN_TxMsg_t msg = {
         .id = id,
@@ -206,13 +319,13 @@ bool CAN_TransmitStd(uint32_t id, const uint8_t *data, uint8_t len)
         memcpy(msg.data, data, msg.dlc);
     }
     
-    return CAN_Transmit(&msg);
+    return CAN_Transmit(hcan, &msg);
 }
 
 /**
  * @brief Transmit extended ID message (convenience function)
  */
-bool CAN_TransmitExt(uint32_t id, const uint8_t *data, uint8_t len)
+bool CAN_TransmitExt(CAN_Handle_t *hcan, uint32_t id, const uint8_t *data, uint8_t len)
 {
     CAN_TxMsg_t msg = {
         .id = id,
@@ -225,13 +338,13 @@ bool CAN_TransmitExt(uint32_t id, const uint8_t *data, uint8_t len)
         memcpy(msg.data, data, msg.dlc);
     }
     
-    return CAN_Transmit(&msg);
+    return CAN_Transmit(hcan, &msg);
 }
 
 /**
  * @brief Transmit remote frame (convenience function)
  */
-bool CAN_TransmitRemote(uint32_t id, uint8_t dlc)
+bool CAN_TransmitRemote(CAN_Handle_t *hcan, uint32_t id, uint8_t dlc)
 {
     CAN_TxMsg_t msg = {
         .id = id,
@@ -241,5 +354,25 @@ bool CAN_TransmitRemote(uint32_t id, uint8_t dlc)
         .data = {0}
     };
     
-    return CAN_Transmit(&msg);
+    return CAN_Transmit(hcan, &msg);
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+extern CAN_Handle_t hcan1;
+
+void CAN1_TX_IRQHandler(void)
+{
+    CAN_TX_IRQHandler(&hcan1);
+}
+
+void send_status(void)
+{
+    CAN_TxMsg_t msg = { .id = 0x321, .ide = 0, .rtr = 0, .dlc = 2, .data = { 1, 2 } };
+
+    CAN_TransmitQueued(&hcan1, &msg);
 }
+*/
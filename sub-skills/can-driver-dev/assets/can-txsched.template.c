@@ -0,0 +1,727 @@
+/**
+ * CAN Periodic TX Scheduler Template
+ *
+ * This template owns all cyclic and on-change TX messages of the ECU
+ * instead of each application task calling CAN_TransmitStd() on its own:
+ * - Per message: ID, DLC, mode, period, offset, MDT and a data source
+ *   callback (or the value last given to CanSched_Write())
+ * - Phase offsets chosen at init so that equal periods do not pile up in
+ *   the same tick (least loaded phase, shortest periods placed first)
+ * - Frames due in the same tick are handed to the TX path in arbitration
+ *   order (lowest ID first), so the TX queue never delays a higher
+ *   priority frame behind a lower one
+ * - Report of the worst-case burst (frames in one tick) and the peak
+ *   load within a window, with and without the chosen offsets
+ * - On-change and mixed messages (AUTOSAR COM style): a write is sent only
+ *   if the payload differs from the one on the bus, and at most once per
+ *   minimum delay time (MDT); updates within the MDT are coalesced and the
+ *   latest value goes out when it expires. Cyclic frames of a mixed
+ *   message are never held back by the MDT; they restart it instead.
+ *   On-change traffic is not part of the load report
+ *
+ * Runs on the shared timer wheel; a tick costs only the messages that are
+ * due (calendar of CANSCHED_SLOTS lists plus a priority bitmap).
+ *
+ * Requires: can-timer.template.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANSCHED_MAX_MSGS       128U     /* Cyclic messages, all channels */
+#define CANSCHED_MAX_CHANNELS   2U       /* CAN buses (offsets are per bus) */
+#define CANSCHED_TICK_MS        1U       /* Scheduler resolution */
+
+/* Calendar slots (power of two), at least the longest period in ticks */
+#define CANSCHED_SLOTS          1024U
+#define CANSCHED_SLOT_MASK      (CANSCHED_SLOTS - 1U)
+
+/* Offset analysis runs over the hyperperiod (LCM of the periods) up to
+ * this many ticks; longer hyperperiods are approximated by this horizon.
+ * The load arrays (3 bytes per tick) are only used by CanSched_Init() */
+#define CANSCHED_HORIZON_MAX    2000U
+
+/* Bus figures of the report */
+#define CANSCHED_BITRATE        500000UL /* Nominal bit rate in bit/s */
+#define CANSCHED_WINDOW_MS      10U      /* Window of the peak load figure */
+
+/* offset_ms value: let CanSched_Init() choose the phase */
+#define CANSCHED_OFFSET_AUTO    0xFFFFU
+
+/* Interrupt lock for CanSched_Write() against the timer tick */
+#define CANSCHED_ENTER_CRITICAL()   /* __disable_irq() */
+#define CANSCHED_EXIT_CRITICAL()    /* __enable_irq()  */
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Transmission mode
+ */
+typedef enum {
+    CANSCHED_PERIODIC = 0,      /* Every period_ms */
+    CANSCHED_ON_CHANGE,         /* On CanSched_Write() with a new payload */
+    CANSCHED_MIXED              /* Both; a cyclic frame also ends the MDT wait */
+} CanSched_TxMode_t;
+
+/**
+ * @brief Message configuration
+ */
+typedef struct {
+    uint32_t id;
+    uint8_t  ide;               /* 0=Standard (11-bit), 1=Extended (29-bit) */
+    uint8_t  dlc;               /* 0-8 */
+    uint8_t  channel;           /* Bus, passed to link_tx */
+    uint8_t  mode;              /* CanSched_TxMode_t */
+    uint16_t period_ms;         /* Multiple of CANSCHED_TICK_MS (unused for ON_CHANGE) */
+    uint16_t offset_ms;         /* Phase within the period, or CANSCHED_OFFSET_AUTO */
+    uint16_t mdt_ms;            /* Minimum delay between on-change frames, 0: none */
+
+    /* Fill the payload of a cyclic frame (zeroed before the call); false
+     * skips this cycle. Runs in CanTimer_Tick() context.
+     * NULL: send the last value given to CanSched_Write() */
+    bool (*source)(uint16_t msg, uint8_t *data);
+} CanSched_MsgConfig_t;
+
+/**
+ * @brief Lower layer hook
+ */
+typedef struct {
+    /* Queue the frame (e.g. CAN_TransmitQueued); false if refused */
+    bool (*link_tx)(uint8_t channel, uint32_t id, uint8_t ide,
+                    const uint8_t *data, uint8_t len);
+} CanSched_Callbacks_t;
+
+/**
+ * @brief Schedule analysis of one channel, filled by CanSched_Init()
+ * "aligned" figures are those of the same set with all automatic
+ * offsets at 0, i.e. what tasks calling CAN_TransmitStd() produce
+ */
+typedef struct {
+    uint16_t messages;
+    uint16_t horizon_ms;            /* Analysed hyperperiod */
+    uint8_t  horizon_exact;         /* 0: hyperperiod longer than CANSCHED_HORIZON_MAX */
+    uint16_t max_burst;             /* Most frames due in one tick */
+    uint16_t max_burst_aligned;
+    uint32_t peak_window_bits;      /* Most bits due within CANSCHED_WINDOW_MS */
+    uint32_t peak_window_bits_aligned;
+    uint16_t peak_load_permille;    /* peak_window_bits / window capacity */
+    uint16_t peak_load_aligned_permille;
+    uint16_t avg_load_permille;     /* Long-term load of the cyclic set */
+} CanSched_Report_t;
+
+/**
+ * @brief Runtime counters
+ */
+typedef struct {
+    uint32_t sent;                  /* Cyclic frames */
+    uint32_t skipped;               /* source() returned false */
+    uint32_t tx_refused;            /* link_tx() returned false */
+    uint16_t max_due;               /* Most frames seen due in one tick */
+    uint32_t event_sent;            /* On-change frames */
+    uint32_t unchanged;             /* Writes equal to the payload on the bus */
+    uint32_t coalesced;             /* Updates replaced by a newer one within the MDT */
+} CanSched_Stats_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Validate the table, choose offsets and start sending
+ * @param configs Message table (index = msg handle passed to source())
+ * @param count Number of messages (<= CANSCHED_MAX_MSGS)
+ * @param callbacks Lower layer hook
+ * @return false on a bad entry (cyclic with period 0 / too long, dlc > 8)
+ */
+bool CanSched_Init(const CanSched_MsgConfig_t *configs, uint16_t count,
+                   const CanSched_Callbacks_t *callbacks);
+
+/**
+ * @brief Stop all TX (e.g. Prepare Bus-Sleep, bus-off with flush)
+ * CanSched_Write() keeps updating the values, changes go out on Start
+ */
+void CanSched_Stop(void);
+
+/**
+ * @brief Restart all cyclic TX with the chosen phases, from the next tick,
+ * and send the on-change values written while stopped
+ */
+void CanSched_Start(void);
+
+/**
+ * @brief Update the payload of a message
+ * ON_CHANGE / MIXED: sent now if it differs from the payload on the bus
+ * and the MDT has passed, otherwise when the MDT expires (latest value).
+ * PERIODIC: only stored for a NULL source. Callable from tasks and ISRs
+ * @param msg Message handle (index in the table)
+ * @param data dlc bytes
+ * @return false on a bad handle
+ */
+bool CanSched_Write(uint16_t msg, const uint8_t *data);
+
+/**
+ * @brief Offset chosen for a message, in ms
+ */
+uint16_t CanSched_GetOffset(uint16_t msg);
+
+/**
+ * @brief Schedule analysis of a channel
+ */
+const CanSched_Report_t *CanSched_GetReport(uint8_t channel);
+
+const CanSched_Stats_t *CanSched_GetStats(void);
+
+/* ============================================================================
+ * Implementation - State
+ * ============================================================================ */
+
+#define CANSCHED_DUE_WORDS      ((CANSCHED_MAX_MSGS + 31U) / 32U)
+#define CANSCHED_WINDOW_TICKS   (CANSCHED_WINDOW_MS / CANSCHED_TICK_MS)
+
+typedef struct CanSched_Msg_s CanSched_Msg_t;
+
+struct CanSched_Msg_s {
+    CanSched_Msg_t *next;           /* Calendar slot list */
+    const CanSched_MsgConfig_t *cfg;
+    uint16_t period;                /* Ticks */
+    uint16_t offset;                /* Ticks */
+    uint16_t bits;                  /* Worst-case frame length with stuffing */
+    uint8_t  rank;                  /* Arbitration order, 0 = highest priority */
+    uint8_t  pending;               /* Changed payload waiting for the MDT */
+    uint8_t  on_bus;                /* last[] holds a sent payload */
+    uint8_t  data[8];               /* Latest value (CanSched_Write) */
+    uint8_t  last[8];               /* Last value handed to link_tx */
+    CanTimer_t mdt_timer;
+};
+
+static CanSched_Msg_t cansched_msgs[CANSCHED_MAX_MSGS];
+static CanSched_Msg_t *cansched_by_rank[CANSCHED_MAX_MSGS];
+static CanSched_Msg_t *cansched_slot[CANSCHED_SLOTS];
+static uint32_t cansched_due[CANSCHED_DUE_WORDS];
+static uint16_t cansched_count;
+static uint32_t cansched_now;
+static CanTimer_t cansched_timer;
+static bool cansched_running;
+static const CanSched_Callbacks_t *cansched_cb;
+static CanSched_Report_t cansched_report[CANSCHED_MAX_CHANNELS];
+static CanSched_Stats_t cansched_stats;
+
+/* Offset analysis, per tick of the horizon */
+static uint8_t  cansched_frames[CANSCHED_HORIZON_MAX];
+static uint16_t cansched_bits[CANSCHED_HORIZON_MAX];
+
+/* ============================================================================
+ * Implementation - Helpers
+ * ============================================================================ */
+
+/* Worst-case frame length incl. stuff bits and interframe space
+ * (34 / 54 stuffable header bits for standard / extended frames) */
+static uint16_t CanSched_FrameBits(uint8_t ide, uint8_t dlc)
+{
+    uint32_t g = ide ? 54U : 34U;
+    uint32_t payload = 8U * dlc;
+
+    return (uint16_t)(g + payload + 13U + (g + payload - 1U) / 4U);
+}
+
+/* Arbitration key: base ID, then IDE (standard wins), then extended bits */
+static uint32_t CanSched_ArbKey(const CanSched_MsgConfig_t *cfg)
+{
+    if (cfg->ide) {
+        return ((cfg->id >> 18) << 19) | (1UL << 18) | (cfg->id & 0x3FFFFUL);
+    }
+    return (cfg->id & 0x7FFUL) << 19;
+}
+
+static uint32_t CanSched_Gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void CanSched_AddLoad(const CanSched_Msg_t *m, uint16_t offset, uint32_t horizon)
+{
+    for (uint32_t t = offset; t < horizon; t += m->period) {
+        cansched_frames[t]++;
+        cansched_bits[t] += m->bits;
+    }
+}
+
+static void CanSched_Measure(uint32_t horizon, uint16_t *burst, uint32_t *peak_bits)
+{
+    uint32_t window = 0;
+    uint32_t w = CANSCHED_WINDOW_TICKS;
+
+    *burst = 0;
+    *peak_bits = 0;
+
+    if (w > horizon) {
+        w = horizon;
+    }
+
+    /* Sliding window over the circular horizon */
+    for (uint32_t t = 0; t < w; t++) {
+        window += cansched_bits[t];
+    }
+    for (uint32_t t = 0; t < horizon; t++) {
+        if (cansched_frames[t] > *burst) {
+            *burst = cansched_frames[t];
+        }
+        if (window > *peak_bits) {
+            *peak_bits = window;
+        }
+        window += cansched_bits[(t + w) % horizon];
+        window -= cansched_bits[t];
+    }
+}
+
+/* Lowest (max frames, max bits) over the ticks the message would use */
+static uint16_t CanSched_BestOffset(const CanSched_Msg_t *m, uint32_t horizon)
+{
+    uint16_t best = 0;
+    uint32_t best_cost = UINT32_MAX;
+
+    for (uint16_t o = 0; o < m->period && best_cost != 0; o++) {
+        uint32_t frames = 0;
+        uint32_t bits = 0;
+        uint32_t cost;
+
+        for (uint32_t t = o; t < horizon; t += m->period) {
+            if (cansched_frames[t] > frames) frames = cansched_frames[t];
+            if (cansched_bits[t] > bits) bits = cansched_bits[t];
+        }
+
+        cost = (frames << 16) | (bits > 0xFFFFU ? 0xFFFFU : bits);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = o;
+        }
+    }
+    return best;
+}
+
+static uint16_t CanSched_Permille(uint32_t bits, uint32_t ticks)
+{
+    uint64_t capacity = (uint64_t)CANSCHED_BITRATE * ticks * CANSCHED_TICK_MS / 1000U;
+
+    return (capacity == 0) ? 0 : (uint16_t)(((uint64_t)bits * 1000U) / capacity);
+}
+
+/* Choose the automatic offsets of one channel and fill its report */
+static void CanSched_Plan(uint8_t channel)
+{
+    static CanSched_Msg_t *order[CANSCHED_MAX_MSGS];
+    CanSched_Report_t *r = &cansched_report[channel];
+    uint32_t horizon = 1;
+    uint32_t total_bits = 0;
+    uint16_t n = 0;
+    uint16_t i;
+
+    memset(r, 0, sizeof(*r));
+    r->horizon_exact = 1;
+
+    for (i = 0; i < cansched_count; i++) {
+        CanSched_Msg_t *m = &cansched_msgs[i];
+        if (m->cfg->channel != channel || m->period == 0) {
+            continue;   /* On-change only frames have no phase */
+        }
+        order[n++] = m;
+        horizon = horizon / CanSched_Gcd(horizon, m->period) * m->period;
+        if (horizon > CANSCHED_HORIZON_MAX) {
+            horizon = CANSCHED_HORIZON_MAX;
+            r->horizon_exact = 0;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+    if (horizon < CANSCHED_WINDOW_TICKS) {
+        /* Whole hyperperiods, at least one window long */
+        horizon *= (CANSCHED_WINDOW_TICKS + horizon - 1U) / horizon;
+    }
+    r->messages = n;
+    r->horizon_ms = (uint16_t)(horizon * CANSCHED_TICK_MS);
+
+    /* Reference: automatic offsets at 0 */
+    memset(cansched_frames, 0, sizeof(cansched_frames));
+    memset(cansched_bits, 0, sizeof(cansched_bits));
+    for (i = 0; i < n; i++) {
+        CanSched_AddLoad(order[i], order[i]->cfg->offset_ms == CANSCHED_OFFSET_AUTO ?
+                         0U : order[i]->offset, horizon);
+    }
+    CanSched_Measure(horizon, &r->max_burst_aligned, &r->peak_window_bits_aligned);
+
+    /* Shortest period first (fewest phases to choose from), then priority */
+    for (i = 1; i < n; i++) {
+        CanSched_Msg_t *m = order[i];
+        uint16_t j = i;
+        while (j > 0 && (order[j - 1]->period > m->period ||
+                         (order[j - 1]->period == m->period && order[j - 1]->rank > m->rank))) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = m;
+    }
+
+    /* Fixed offsets are load already present, then place the rest */
+    memset(cansched_frames, 0, sizeof(cansched_frames));
+    memset(cansched_bits, 0, sizeof(cansched_bits));
+    for (i = 0; i < n; i++) {
+        if (order[i]->cfg->offset_ms != CANSCHED_OFFSET_AUTO) {
+            CanSched_AddLoad(order[i], order[i]->offset, horizon);
+        }
+    }
+    for (i = 0; i < n; i++) {
+        CanSched_Msg_t *m = order[i];
+        if (m->cfg->offset_ms == CANSCHED_OFFSET_AUTO) {
+            m->offset = CanSched_BestOffset(m, horizon);
+            CanSched_AddLoad(m, m->offset, horizon);
+        }
+        total_bits += (uint32_t)m->bits * ((horizon + m->period - 1U) / m->period);
+    }
+    CanSched_Measure(horizon, &r->max_burst, &r->peak_window_bits);
+
+    r->peak_load_permille = CanSched_Permille(r->peak_window_bits, CANSCHED_WINDOW_TICKS);
+    r->peak_load_aligned_permille = CanSched_Permille(r->peak_window_bits_aligned,
+                                                      CANSCHED_WINDOW_TICKS);
+    r->avg_load_permille = CanSched_Permille(total_bits, horizon);
+}
+
+/* ============================================================================
+ * Implementation - Runtime
+ * ============================================================================ */
+
+/* Hand a payload to the TX path; a sent frame opens a new MDT window */
+static bool CanSched_Transmit(CanSched_Msg_t *m, const uint8_t *data)
+{
+    const CanSched_MsgConfig_t *cfg = m->cfg;
+
+    if (!cansched_cb->link_tx(cfg->channel, cfg->id, cfg->ide, data, cfg->dlc)) {
+        cansched_stats.tx_refused++;
+        return false;
+    }
+
+    if (cfg->mode != CANSCHED_PERIODIC) {
+        memcpy(m->last, data, cfg->dlc);
+        m->on_bus = 1;
+        m->pending = 0;
+        if (cfg->mdt_ms != 0) {
+            CanTimer_Start(&m->mdt_timer, CAN_TIMER_MS_TO_TICKS(cfg->mdt_ms));
+        }
+    }
+    return true;
+}
+
+static void CanSched_Send(CanSched_Msg_t *m)
+{
+    const CanSched_MsgConfig_t *cfg = m->cfg;
+    uint8_t data[8] = {0};
+
+    if (cfg->source != NULL && !cfg->source((uint16_t)(m - cansched_msgs), data)) {
+        cansched_stats.skipped++;
+        return;
+    }
+
+    /* MIXED: the cyclic frame carries any pending update and restarts the MDT */
+    CANSCHED_ENTER_CRITICAL();
+    if (CanSched_Transmit(m, (cfg->source == NULL) ? m->data : data)) {
+        cansched_stats.sent++;
+    }
+    CANSCHED_EXIT_CRITICAL();
+}
+
+/* MDT over: send the latest value if it still differs from the bus */
+static void CanSched_MdtExpired(CanTimer_t *timer, void *arg)
+{
+    CanSched_Msg_t *m = (CanSched_Msg_t *)arg;
+    (void)timer;
+
+    CANSCHED_ENTER_CRITICAL();
+    if (m->pending) {
+        if (CanSched_Transmit(m, m->data)) {
+            cansched_stats.event_sent++;
+        } else {
+            CanTimer_Start(&m->mdt_timer, 1U);   /* TX queue full: retry */
+        }
+    }
+    CANSCHED_EXIT_CRITICAL();
+}
+
+static void CanSched_Tick(CanTimer_t *timer, void *arg)
+{
+    CanSched_Msg_t *list;
+    CanSched_Msg_t *m;
+    uint32_t now = ++cansched_now;
+    uint16_t due = 0;
+    (void)arg;
+
+    CanTimer_Start(timer, CAN_TIMER_MS_TO_TICKS(CANSCHED_TICK_MS));
+
+    /* Collect this tick's messages by priority, re-arm them one period on */
+    list = cansched_slot[now & CANSCHED_SLOT_MASK];
+    cansched_slot[now & CANSCHED_SLOT_MASK] = NULL;
+    while (list != NULL) {
+        m = list;
+        list = m->next;
+        cansched_due[m->rank / 32U] |= 1UL << (m->rank % 32U);
+        m->next = cansched_slot[(now + m->period) & CANSCHED_SLOT_MASK];
+        cansched_slot[(now + m->period) & CANSCHED_SLOT_MASK] = m;
+        due++;
+    }
+    if (due == 0) {
+        return;
+    }
+    if (due > cansched_stats.max_due) {
+        cansched_stats.max_due = due;
+    }
+
+    /* Highest priority first */
+    for (uint32_t w = 0; w < CANSCHED_DUE_WORDS; w++) {
+        while (cansched_due[w] != 0) {
+            uint32_t bit = (uint32_t)__builtin_ctz(cansched_due[w]);
+            cansched_due[w] &= cansched_due[w] - 1U;
+            CanSched_Send(cansched_by_rank[w * 32U + bit]);
+        }
+    }
+}
+
+/* ============================================================================
+ * Implementation - Public API
+ * ============================================================================ */
+
+bool CanSched_Init(const CanSched_MsgConfig_t *configs, uint16_t count,
+                   const CanSched_Callbacks_t *callbacks)
+{
+    uint16_t i;
+
+    CanTimer_Stop(&cansched_timer);
+    for (i = 0; i < cansched_count; i++) {
+        CanTimer_Stop(&cansched_msgs[i].mdt_timer);
+    }
+    memset(cansched_msgs, 0, sizeof(cansched_msgs));
+    memset(&cansched_stats, 0, sizeof(cansched_stats));
+    cansched_count = 0;
+
+    if (count > CANSCHED_MAX_MSGS || callbacks == NULL || callbacks->link_tx == NULL) {
+        return false;
+    }
+
+    for (i = 0; i < count; i++) {
+        const CanSched_MsgConfig_t *cfg = &configs[i];
+        uint32_t period = cfg->period_ms / CANSCHED_TICK_MS;
+
+        if (cfg->mode == CANSCHED_ON_CHANGE) {
+            period = 0;
+        } else if (period == 0 || period > CANSCHED_SLOTS ||
+                   (cfg->offset_ms != CANSCHED_OFFSET_AUTO && cfg->offset_ms >= cfg->period_ms)) {
+            return false;
+        }
+        if (cfg->dlc > 8 || cfg->mode > CANSCHED_MIXED || cfg->channel >= CANSCHED_MAX_CHANNELS) {
+            return false;
+        }
+
+        cansched_msgs[i].cfg = cfg;
+        cansched_msgs[i].period = (uint16_t)period;
+        CanTimer_Setup(&cansched_msgs[i].mdt_timer, CanSched_MdtExpired, &cansched_msgs[i]);
+        cansched_msgs[i].bits = CanSched_FrameBits(cfg->ide, cfg->dlc);
+        if (period != 0 && cfg->offset_ms != CANSCHED_OFFSET_AUTO) {
+            cansched_msgs[i].offset = (uint16_t)(cfg->offset_ms / CANSCHED_TICK_MS);
+        }
+    }
+
+    /* Rank = arbitration order (insertion sort, init only) */
+    for (i = 0; i < count; i++) {
+        CanSched_Msg_t *m = &cansched_msgs[i];
+        uint32_t key = CanSched_ArbKey(m->cfg);
+        uint16_t j = i;
+        while (j > 0 && CanSched_ArbKey(cansched_by_rank[j - 1]->cfg) > key) {
+            cansched_by_rank[j] = cansched_by_rank[j - 1];
+            j--;
+        }
+        cansched_by_rank[j] = m;
+    }
+    for (i = 0; i < count; i++) {
+        cansched_by_rank[i]->rank = (uint8_t)i;
+    }
+
+    cansched_count = count;
+    cansched_cb = callbacks;
+
+    for (uint8_t ch = 0; ch < CANSCHED_MAX_CHANNELS; ch++) {
+        CanSched_Plan(ch);
+    }
+
+    CanTimer_Setup(&cansched_timer, CanSched_Tick, NULL);
+    CanSched_Start();
+    return true;
+}
+
+void CanSched_Stop(void)
+{
+    CANSCHED_ENTER_CRITICAL();
+    cansched_running = false;
+    CanTimer_Stop(&cansched_timer);
+    for (uint16_t i = 0; i < cansched_count; i++) {
+        CanTimer_Stop(&cansched_msgs[i].mdt_timer);
+        cansched_msgs[i].pending = 0;
+    }
+    CANSCHED_EXIT_CRITICAL();
+}
+
+void CanSched_Start(void)
+{
+    uint32_t start = cansched_now + 1U;
+
+    CanTimer_Stop(&cansched_timer);
+    memset(cansched_slot, 0, sizeof(cansched_slot));
+    memset(cansched_due, 0, sizeof(cansched_due));
+
+    for (uint16_t i = 0; i < cansched_count; i++) {
+        CanSched_Msg_t *m = &cansched_msgs[i];
+        uint32_t slot = (start + m->offset) & CANSCHED_SLOT_MASK;
+        if (m->pending) {
+            CanTimer_Start(&m->mdt_timer, 1U);
+        }
+        if (m->period == 0) {
+            continue;
+        }
+        m->next = cansched_slot[slot];
+        cansched_slot[slot] = m;
+    }
+
+    CanTimer_Start(&cansched_timer, CAN_TIMER_MS_TO_TICKS(CANSCHED_TICK_MS));
+    cansched_running = true;
+}
+
+bool CanSched_Write(uint16_t msg, const uint8_t *data)
+{
+    CanSched_Msg_t *m;
+    uint8_t mode;
+
+    if (msg >= cansched_count || data == NULL) {
+        return false;
+    }
+    m = &cansched_msgs[msg];
+    mode = m->cfg->mode;
+
+    CANSCHED_ENTER_CRITICAL();
+    memcpy(m->data, data, m->cfg->dlc);
+
+    if (mode == CANSCHED_PERIODIC) {
+        /* Next cycle picks it up */
+    } else if (m->on_bus && memcmp(m->data, m->last, m->cfg->dlc) == 0) {
+        /* Back to the value on the bus: drop what was waiting */
+        cansched_stats.unchanged++;
+        if (m->pending) {
+            m->pending = 0;
+            cansched_stats.coalesced++;
+        }
+    } else if (!cansched_running || CanTimer_IsActive(&m->mdt_timer)) {
+        if (m->pending) {
+            cansched_stats.coalesced++;
+        }
+        m->pending = 1;
+    } else if (CanSched_Transmit(m, m->data)) {
+        cansched_stats.event_sent++;
+    } else {
+        m->pending = 1;     /* TX queue full: retry on the next timer tick */
+        CanTimer_Start(&m->mdt_timer, 1U);
+    }
+    CANSCHED_EXIT_CRITICAL();
+    return true;
+}
+
+uint16_t CanSched_GetOffset(uint16_t msg)
+{
+    return (msg < cansched_count) ?
+           (uint16_t)(cansched_msgs[msg].offset * CANSCHED_TICK_MS) : 0U;
+}
+
+const CanSched_Report_t *CanSched_GetReport(uint8_t channel)
+{
+    return (channel < CANSCHED_MAX_CHANNELS) ? &cansched_report[channel] : NULL;
+}
+
+const CanSched_Stats_t *CanSched_GetStats(void)
+{
+    return &cansched_stats;
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+extern CAN_Handle_t hcan1;
+
+enum { MSG_ENGINE, MSG_WHEELS, MSG_BODY, MSG_STATUS, MSG_DOORS, MSG_LIGHTS };
+
+static bool engine_data(uint16_t msg, uint8_t *data)
+{
+    (void)msg;
+    Engine_Pack(&engine_signals, data);     // can-signal.template.c accessors
+    return true;
+}
+
+static bool status_data(uint16_t msg, uint8_t *data)
+{
+    (void)msg;
+    data[0] = App_GetStatus();
+    return App_IsRunning();                 // Skip the cycle while starting
+}
+
+static const CanSched_MsgConfig_t tx_table[] = {
+    [MSG_ENGINE] = { .id = 0x100, .dlc = 8, .period_ms = 10,  .offset_ms = CANSCHED_OFFSET_AUTO, .source = engine_data },
+    [MSG_WHEELS] = { .id = 0x120, .dlc = 8, .period_ms = 10,  .offset_ms = CANSCHED_OFFSET_AUTO, .source = wheels_data },
+    [MSG_BODY]   = { .id = 0x300, .dlc = 4, .period_ms = 100, .offset_ms = CANSCHED_OFFSET_AUTO, .source = body_data },
+    [MSG_STATUS] = { .id = 0x500, .dlc = 1, .period_ms = 100, .offset_ms = 0,                    .source = status_data },
+    // Door switches: on change only, bounce within 20 ms collapses to one frame
+    [MSG_DOORS]  = { .id = 0x210, .dlc = 2, .mode = CANSCHED_ON_CHANGE, .mdt_ms = 20 },
+    // Light request: every 500 ms and on change, at most every 50 ms
+    [MSG_LIGHTS] = { .id = 0x220, .dlc = 1, .mode = CANSCHED_MIXED, .period_ms = 500,
+                     .offset_ms = CANSCHED_OFFSET_AUTO, .mdt_ms = 50 },
+};
+
+static bool sched_tx(uint8_t channel, uint32_t id, uint8_t ide, const uint8_t *data, uint8_t len)
+{
+    CAN_TxMsg_t msg = { .id = id, .ide = ide, .rtr = 0, .dlc = len };
+    (void)channel;
+    memcpy(msg.data, data, len);
+    return CAN_TransmitQueued(&hcan1, &msg);
+}
+
+static const CanSched_Callbacks_t sched_callbacks = { .link_tx = sched_tx };
+
+void main(void)
+{
+    const CanSched_Report_t *r;
+
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);
+    CanSched_Init(tx_table, 6, &sched_callbacks);
+
+    r = CanSched_GetReport(0);
+    printf("burst %u (aligned %u) frames/tick, peak %u.%u%% (aligned %u.%u%%) in %u ms\n",
+           r->max_burst, r->max_burst_aligned,
+           r->peak_load_permille / 10, r->peak_load_permille % 10,
+           r->peak_load_aligned_permille / 10, r->peak_load_aligned_permille % 10,
+           CANSCHED_WINDOW_MS);
+}
+
+void Doors_Changed(uint16_t state)       // Switch ISR / debounce task
+{
+    uint8_t data[2] = { (uint8_t)state, (uint8_t)(state >> 8) };
+    CanSched_Write(MSG_DOORS, data);
+}
+*/
@@ -0,0 +1,1080 @@
+/**
+ * UDS Diagnostic Server Template (ISO 14229-1)
+ *
+ * This template provides a table-driven UDS server on top of CanTp:
+ * - SID -> service lookup through a 256-entry table (constant time)
+ * - DID and RID tables sorted by identifier, binary search
+ * - Session (0x10) and security (0x27) checks per service, S3 timeout
+ * - Pending responses (NRC 0x78): long operations are continued from
+ *   Uds_MainFunction() and never block the CAN RX path
+ * - Download (0x34/0x36/0x37) streamed into a flash-write callback with
+ *   ping-pong request buffers, so the next block is received while the
+ *   previous one is being programmed
+ *
+ * Requires: can-tp.template.c, can-timer.template.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+/* Request buffer size = max TransferData block (SID + BSC + data).
+ * Reported to the tester as maxNumberOfBlockLength in the 0x34 response */
+#define UDS_RX_BUFFER_SIZE      4095U
+#define UDS_TX_BUFFER_SIZE      1024U
+
+/* Application timing (reported in the 0x10 response) */
+#define UDS_P2_SERVER_MS        50U
+#define UDS_P2STAR_SERVER_MS    5000U
+#define UDS_RCRRP_FIRST_MS      40U      /* First NRC 0x78 before P2 ends */
+#define UDS_RCRRP_INTERVAL_MS   4000U    /* Repeat NRC 0x78 before P2* ends */
+#define UDS_S3_SERVER_MS        5000U
+
+/* Security access */
+#define UDS_SA_MAX_ATTEMPTS     3U
+#define UDS_SA_DELAY_MS         10000U
+#define UDS_SA_MAX_SEED_LEN     16U
+
+/* ============================================================================
+ * Protocol Definitions
+ * ============================================================================ */
+
+/* Service identifiers */
+#define UDS_SID_SESSION_CONTROL     0x10U
+#define UDS_SID_ECU_RESET           0x11U
+#define UDS_SID_READ_DID            0x22U
+#define UDS_SID_SECURITY_ACCESS     0x27U
+#define UDS_SID_WRITE_DID           0x2EU
+#define UDS_SID_ROUTINE_CONTROL     0x31U
+#define UDS_SID_REQUEST_DOWNLOAD    0x34U
+#define UDS_SID_TRANSFER_DATA       0x36U
+#define UDS_SID_TRANSFER_EXIT       0x37U
+#define UDS_SID_TESTER_PRESENT      0x3EU
+
+#define UDS_NEGATIVE_RESPONSE       0x7FU
+#define UDS_POSITIVE_OFFSET         0x40U
+#define UDS_SUPPRESS_POS_RSP        0x80U    /* Sub-function bit 7 */
+
+/* Sessions */
+#define UDS_SESSION_DEFAULT         0x01U
+#define UDS_SESSION_PROGRAMMING     0x02U
+#define UDS_SESSION_EXTENDED        0x03U
+#define UDS_SESSION_BIT(s)          (uint8_t)(1U << ((s) - 1U))
+#define UDS_SESSION_ALL             0x07U
+
+/* Handler return codes: UDS_OK, UDS_PENDING or a negative response code */
+#define UDS_OK                                  0x00U
+#define UDS_NRC_GENERAL_REJECT                  0x10U
+#define UDS_NRC_SERVICE_NOT_SUPPORTED           0x11U
+#define UDS_NRC_SUBFUNCTION_NOT_SUPPORTED       0x12U
+#define UDS_NRC_INCORRECT_LENGTH                0x13U
+#define UDS_NRC_RESPONSE_TOO_LONG               0x14U
+#define UDS_NRC_CONDITIONS_NOT_CORRECT          0x22U
+#define UDS_NRC_REQUEST_SEQUENCE_ERROR          0x24U
+#define UDS_NRC_REQUEST_OUT_OF_RANGE            0x31U
+#define UDS_NRC_SECURITY_ACCESS_DENIED          0x33U
+#define UDS_NRC_INVALID_KEY                     0x35U
+#define UDS_NRC_EXCEEDED_ATTEMPTS               0x36U
+#define UDS_NRC_TIME_DELAY_NOT_EXPIRED          0x37U
+#define UDS_NRC_UPLOAD_DOWNLOAD_NOT_ACCEPTED    0x70U
+#define UDS_NRC_TRANSFER_DATA_SUSPENDED         0x71U
+#define UDS_NRC_GENERAL_PROGRAMMING_FAILURE     0x72U
+#define UDS_NRC_WRONG_BLOCK_SEQUENCE_COUNTER    0x73U
+#define UDS_PENDING                             0x78U
+#define UDS_NRC_SUBFUNCTION_NOT_IN_SESSION      0x7EU
+#define UDS_NRC_SERVICE_NOT_IN_SESSION          0x7FU
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief Request being processed
+ */
+typedef struct {
+    uint8_t  channel;       /* CanTp channel of the request */
+    uint8_t  functional;    /* 1 = functionally addressed */
+    uint8_t  first_call;    /* 0 when re-invoked after UDS_PENDING */
+    const uint8_t *req;     /* Request, req[0] = SID */
+    uint32_t req_len;
+    uint8_t *resp;          /* Response, resp[0] = SID + 0x40 preset */
+    uint32_t resp_len;      /* Set by handler, includes SID byte */
+    uint32_t resp_max;
+} Uds_Request_t;
+
+/**
+ * @brief Service handler
+ * @return UDS_OK, UDS_PENDING (call again later) or NRC
+ */
+typedef uint8_t (*Uds_ServiceHandler_t)(Uds_Request_t *rq);
+
+/**
+ * @brief Service table entry
+ */
+typedef struct {
+    uint8_t  sid;
+    uint8_t  min_len;       /* Minimum request length including SID */
+    uint8_t  subfunction;   /* 1 = byte 1 is a sub-function */
+    uint8_t  sessions;      /* UDS_SESSION_BIT() mask */
+    uint8_t  security;      /* Levels that unlock (bit n = level n+1), 0 = none */
+    Uds_ServiceHandler_t handler;
+} Uds_Service_t;
+
+/**
+ * @brief Data identifier table entry (table sorted by did)
+ */
+typedef struct {
+    uint16_t did;
+    uint16_t length;        /* Data length in bytes */
+    uint8_t  sessions;      /* UDS_SESSION_BIT() mask */
+    uint8_t  write_security;/* Levels allowed to write, 0 = none */
+    const uint8_t *data;    /* Static data for reads, or NULL to use read() */
+    uint8_t (*read)(uint16_t did, uint8_t *out);
+    uint8_t (*write)(uint16_t did, const uint8_t *in);  /* NULL = read-only */
+} Uds_Did_t;
+
+/**
+ * @brief Routine identifier table entry (table sorted by rid)
+ */
+typedef struct {
+    uint16_t rid;
+    uint8_t  sessions;
+    uint8_t  security;
+    /* sub: 1=start, 2=stop, 3=results. May return UDS_PENDING */
+    uint8_t (*handler)(uint8_t sub, const uint8_t *opt, uint32_t opt_len,
+                       uint8_t *out, uint32_t *out_len, uint32_t out_max);
+} Uds_Routine_t;
+
+/**
+ * @brief Server configuration
+ */
+typedef struct {
+    uint8_t phys_channel;   /* CanTp channel for physical requests */
+    uint8_t func_channel;   /* CanTp channel for functional requests */
+
+    /* Application services - added to / override the built-in ones */
+    const Uds_Service_t *services;
+    uint8_t service_count;
+
+    const Uds_Did_t *dids;
+    uint16_t did_count;
+
+    const Uds_Routine_t *routines;
+    uint16_t routine_count;
+
+    /* Optional: veto/prepare a session change (NULL = always allowed) */
+    uint8_t (*session_change)(uint8_t new_session);
+
+    /* Required by their services (NULL = refused with NRC 0x22 / 0x70) */
+    void    (*ecu_reset)(uint8_t type);             /* After response sent */
+    uint8_t (*get_seed)(uint8_t level, uint8_t *seed, uint8_t *len);
+    bool    (*compare_key)(uint8_t level, const uint8_t *key, uint32_t len);
+    uint8_t (*request_download)(uint32_t address, uint32_t size);
+
+    /* Start programming 'length' bytes at 'address'. Return UDS_PENDING
+     * while the previous write is still busy, UDS_OK once this write has
+     * been accepted. 'data' stays valid until the next accepted write.
+     * data == NULL, length == 0: flush, UDS_OK when all writes finished */
+    uint8_t (*flash_write)(uint32_t address, const uint8_t *data, uint32_t length);
+} Uds_Config_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Initialize the UDS server
+ * @return false if the DID/RID tables are not sorted
+ */
+bool Uds_Init(const Uds_Config_t *config);
+
+/**
+ * @brief Continue pending requests, retry responses
+ * Call periodically from the main loop / a low priority task
+ */
+void Uds_MainFunction(void);
+
+/**
+ * @brief CanTp start_of_reception hook
+ */
+uint8_t *Uds_StartOfReception(uint8_t channel, uint32_t length);
+
+/**
+ * @brief CanTp rx_indication hook - dispatches the request
+ */
+void Uds_RxIndication(uint8_t channel, uint8_t *buffer, uint32_t length,
+                      CanTp_Result_t result);
+
+/**
+ * @brief CanTp tx_confirmation hook
+ */
+void Uds_TxConfirmation(uint8_t channel, CanTp_Result_t result);
+
+/**
+ * @brief Get active session
+ */
+uint8_t Uds_GetSession(void);
+
+/* ============================================================================
+ * Implementation - Server State
+ * ============================================================================ */
+
+typedef enum {
+    UDS_STATE_IDLE = 0,
+    UDS_STATE_PENDING,      /* Handler returned UDS_PENDING */
+    UDS_STATE_TX_RETRY,     /* Final response waiting for CanTp */
+    UDS_STATE_TX            /* Final response in CanTp */
+} Uds_State_t;
+
+#define UDS_NO_BUFFER   0xFFU
+
+typedef struct {
+    const Uds_Config_t *cfg;
+    const Uds_Service_t *sid_table[256];
+
+    volatile uint8_t state;
+    volatile uint8_t rcrrp_due;     /* Time to repeat NRC 0x78 */
+    uint8_t rcrrp_sent;             /* 0x78 was sent for this request */
+    uint8_t suppress;               /* Suppress positive response */
+    uint8_t reset_type;             /* ECU reset after response, 0 = none */
+    uint8_t rx_index;               /* Buffer holding the current request */
+    uint8_t flash_index;            /* Buffer still read by flash_write */
+    const Uds_Service_t *service;
+    Uds_Request_t rq;
+
+    /* Session / security */
+    volatile uint8_t session;
+    volatile uint8_t security_level;/* 0 = locked */
+    uint8_t seed_level;             /* Level whose seed was sent, 0 = none */
+    uint8_t sa_attempts;
+    volatile uint8_t sa_delay;
+
+    /* Download */
+    uint8_t  dl_active;
+    uint8_t  dl_bsc;                /* Last accepted block sequence counter */
+    uint32_t dl_address;
+    uint32_t dl_size;
+    uint32_t dl_received;
+
+    CanTimer_t p2_timer;            /* NRC 0x78 repetition */
+    CanTimer_t s3_timer;            /* Non-default session timeout */
+    CanTimer_t sa_timer;            /* Security access delay */
+
+    uint8_t rx_buf[2][UDS_RX_BUFFER_SIZE];
+    uint8_t tx_buf[UDS_TX_BUFFER_SIZE];
+    uint8_t nrc_buf[3];
+} Uds_Server_t;
+
+static Uds_Server_t uds;
+
+/* Built-in services, see handlers below */
+static uint8_t Uds_SessionControl(Uds_Request_t *rq);
+static uint8_t Uds_EcuReset(Uds_Request_t *rq);
+static uint8_t Uds_ReadDataByIdentifier(Uds_Request_t *rq);
+static uint8_t Uds_SecurityAccess(Uds_Request_t *rq);
+static uint8_t Uds_WriteDataByIdentifier(Uds_Request_t *rq);
+static uint8_t Uds_RoutineControl(Uds_Request_t *rq);
+static uint8_t Uds_RequestDownload(Uds_Request_t *rq);
+static uint8_t Uds_TransferData(Uds_Request_t *rq);
+static uint8_t Uds_RequestTransferExit(Uds_Request_t *rq);
+static uint8_t Uds_TesterPresent(Uds_Request_t *rq);
+
+#define UDS_SA_LEVEL_1  0x01U
+#define UDS_SA_LEVEL_2  0x02U   /* Programming */
+
+static const Uds_Service_t uds_builtin_services[] = {
+    /* sid                        min sub sessions                                     security        handler */
+    { UDS_SID_SESSION_CONTROL,    2,  1,  UDS_SESSION_ALL,                             0,              Uds_SessionControl },
+    { UDS_SID_ECU_RESET,          2,  1,  UDS_SESSION_ALL,                             0,              Uds_EcuReset },
+    { UDS_SID_READ_DID,           3,  0,  UDS_SESSION_ALL,                             0,              Uds_ReadDataByIdentifier },
+    { UDS_SID_SECURITY_ACCESS,    2,  1,  UDS_SESSION_BIT(UDS_SESSION_PROGRAMMING) |
+                                          UDS_SESSION_BIT(UDS_SESSION_EXTENDED),       0,              Uds_SecurityAccess },
+    { UDS_SID_WRITE_DID,          4,  0,  UDS_SESSION_ALL,                             0,              Uds_WriteDataByIdentifier },
+    { UDS_SID_ROUTINE_CONTROL,    4,  1,  UDS_SESSION_ALL,                             0,              Uds_RoutineControl },
+    { UDS_SID_REQUEST_DOWNLOAD,   5,  0,  UDS_SESSION_BIT(UDS_SESSION_PROGRAMMING),    UDS_SA_LEVEL_2, Uds_RequestDownload },
+    { UDS_SID_TRANSFER_DATA,      2,  0,  UDS_SESSION_BIT(UDS_SESSION_PROGRAMMING),    UDS_SA_LEVEL_2, Uds_TransferData },
+    { UDS_SID_TRANSFER_EXIT,      1,  0,  UDS_SESSION_BIT(UDS_SESSION_PROGRAMMING),    UDS_SA_LEVEL_2, Uds_RequestTransferExit },
+    { UDS_SID_TESTER_PRESENT,     2,  1,  UDS_SESSION_ALL,                             0,              Uds_TesterPresent },
+};
+
+/* ============================================================================
+ * Implementation - Helpers
+ * ============================================================================ */
+
+static bool Uds_SecurityOk(uint8_t required)
+{
+    if (required == 0) {
+        return true;
+    }
+    return uds.security_level != 0 &&
+           (required & (1U << (uds.security_level - 1U))) != 0;
+}
+
+static bool Uds_SessionOk(uint8_t sessions)
+{
+    return (sessions & UDS_SESSION_BIT(uds.session)) != 0;
+}
+
+static uint16_t Uds_Get16(const uint8_t *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+/* Binary search in a table sorted by its leading uint16_t key */
+static const void *Uds_Search(const void *table, uint16_t count, size_t size,
+                              uint16_t key)
+{
+    const uint8_t *base = (const uint8_t *)table;
+    uint16_t lo = 0;
+    uint16_t hi = count;
+
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2U);
+        uint16_t mid_key = *(const uint16_t *)(const void *)(base + (size_t)mid * size);
+
+        if (mid_key == key) {
+            return base + (size_t)mid * size;
+        }
+        if (mid_key < key) {
+            lo = mid + 1U;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+static bool Uds_IsSorted(const void *table, uint16_t count, size_t size)
+{
+    const uint8_t *base = (const uint8_t *)table;
+
+    for (uint16_t i = 1; i < count; i++) {
+        if (*(const uint16_t *)(const void *)(base + (size_t)i * size) <=
+            *(const uint16_t *)(const void *)(base + (size_t)(i - 1U) * size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Uds_SetSession(uint8_t session)
+{
+    uds.session = session;
+    uds.security_level = 0;     /* Every session change re-locks */
+    uds.seed_level = 0;
+
+    if (session == UDS_SESSION_DEFAULT) {
+        CanTimer_Stop(&uds.s3_timer);
+        uds.dl_active = 0;
+    } else {
+        CanTimer_Start(&uds.s3_timer, CAN_TIMER_MS_TO_TICKS(UDS_S3_SERVER_MS));
+    }
+}
+
+/* ============================================================================
+ * Implementation - Timer Callbacks (tick interrupt context)
+ * ============================================================================ */
+
+static void Uds_P2Timeout(CanTimer_t *timer, void *arg)
+{
+    (void)arg;
+    uds.rcrrp_due = 1;
+    CanTimer_Start(timer, CAN_TIMER_MS_TO_TICKS(UDS_RCRRP_INTERVAL_MS));
+}
+
+static void Uds_S3Timeout(CanTimer_t *timer, void *arg)
+{
+    (void)timer;
+    (void)arg;
+    if (uds.state == UDS_STATE_IDLE) {
+        Uds_SetSession(UDS_SESSION_DEFAULT);
+    } else {
+        CanTimer_Start(&uds.s3_timer, CAN_TIMER_MS_TO_TICKS(UDS_S3_SERVER_MS));
+    }
+}
+
+static void Uds_SaTimeout(CanTimer_t *timer, void *arg)
+{
+    (void)timer;
+    (void)arg;
+    uds.sa_delay = 0;
+    uds.sa_attempts = 0;
+}
+
+/* ============================================================================
+ * Implementation - Dispatch
+ * ============================================================================ */
+
+bool Uds_Init(const Uds_Config_t *config)
+{
+    if (config == NULL ||
+        !Uds_IsSorted(config->dids, config->did_count, sizeof(Uds_Did_t)) ||
+        !Uds_IsSorted(config->routines, config->routine_count, sizeof(Uds_Routine_t))) {
+        return false;
+    }
+
+    memset(&uds, 0, sizeof(uds));
+    uds.cfg = config;
+    uds.session = UDS_SESSION_DEFAULT;
+    uds.flash_index = UDS_NO_BUFFER;
+
+    /* Build the SID table once - dispatch is a single array lookup */
+    for (uint8_t i = 0; i < sizeof(uds_builtin_services) / sizeof(uds_builtin_services[0]); i++) {
+        uds.sid_table[uds_builtin_services[i].sid] = &uds_builtin_services[i];
+    }
+    for (uint8_t i = 0; i < config->service_count; i++) {
+        uds.sid_table[config->services[i].sid] = &config->services[i];
+    }
+
+    CanTimer_Setup(&uds.p2_timer, Uds_P2Timeout, NULL);
+    CanTimer_Setup(&uds.s3_timer, Uds_S3Timeout, NULL);
+    CanTimer_Setup(&uds.sa_timer, Uds_SaTimeout, NULL);
+
+    return true;
+}
+
+uint8_t Uds_GetSession(void)
+{
+    return uds.session;
+}
+
+static bool Uds_Send(const uint8_t *data, uint32_t len)
+{
+    return CanTp_Transmit(uds.rq.channel, data, len);
+}
+
+static bool Uds_SendPending(void)
+{
+    uds.nrc_buf[0] = UDS_NEGATIVE_RESPONSE;
+    uds.nrc_buf[1] = uds.rq.req[0];
+    uds.nrc_buf[2] = UDS_PENDING;
+
+    if (!Uds_Send(uds.nrc_buf, 3)) {
+        return false;
+    }
+    uds.rcrrp_sent = 1;
+    uds.rcrrp_due = 0;
+    return true;
+}
+
+/**
+ * @brief Build and send the final response for the current request
+ */
+static void Uds_Finish(uint8_t nrc)
+{
+    Uds_Request_t *rq = &uds.rq;
+
+    CanTimer_Stop(&uds.p2_timer);
+
+    if (nrc != UDS_OK) {
+        /* Functional requests stay silent on "not for me" NRCs */
+        if (rq->functional && !uds.rcrrp_sent &&
+            (nrc == UDS_NRC_SERVICE_NOT_SUPPORTED ||
+             nrc == UDS_NRC_SUBFUNCTION_NOT_SUPPORTED ||
+             nrc == UDS_NRC_REQUEST_OUT_OF_RANGE ||
+             nrc == UDS_NRC_SUBFUNCTION_NOT_IN_SESSION ||
+             nrc == UDS_NRC_SERVICE_NOT_IN_SESSION)) {
+            uds.state = UDS_STATE_IDLE;
+            return;
+        }
+        uds.reset_type = 0;
+        rq->resp[0] = UDS_NEGATIVE_RESPONSE;
+        rq->resp[1] = rq->req[0];
+        rq->resp[2] = nrc;
+        rq->resp_len = 3;
+    } else if (uds.suppress && !uds.rcrrp_sent) {
+        /* Suppressed positive response (a 0x78 forces a final response) */
+        uds.state = UDS_STATE_IDLE;
+        if (uds.reset_type != 0 && uds.cfg->ecu_reset != NULL) {
+            uds.cfg->ecu_reset(uds.reset_type);
+        }
+        return;
+    }
+
+    uds.state = Uds_Send(rq->resp, rq->resp_len) ? UDS_STATE_TX : UDS_STATE_TX_RETRY;
+}
+
+static uint8_t Uds_Dispatch(void)
+{
+    Uds_Request_t *rq = &uds.rq;
+    const Uds_Service_t *svc = uds.sid_table[rq->req[0]];
+
+    if (svc == NULL || svc->handler == NULL) {
+        return UDS_NRC_SERVICE_NOT_SUPPORTED;
+    }
+    if (!Uds_SessionOk(svc->sessions)) {
+        return UDS_NRC_SERVICE_NOT_IN_SESSION;
+    }
+    if (rq->req_len < svc->min_len) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if (!Uds_SecurityOk(svc->security)) {
+        return UDS_NRC_SECURITY_ACCESS_DENIED;
+    }
+
+    uds.service = svc;
+    uds.suppress = svc->subfunction && (rq->req[1] & UDS_SUPPRESS_POS_RSP);
+    return svc->handler(rq);
+}
+
+uint8_t *Uds_StartOfReception(uint8_t channel, uint32_t length)
+{
+    (void)channel;
+
+    if (uds.state != UDS_STATE_IDLE || length > UDS_RX_BUFFER_SIZE) {
+        return NULL;  /* One request at a time */
+    }
+
+    /* Never hand out the buffer flash_write may still be reading */
+    uds.rx_index = (uds.flash_index == 0) ? 1U : 0U;
+    return uds.rx_buf[uds.rx_index];
+}
+
+void Uds_RxIndication(uint8_t channel, uint8_t *buffer, uint32_t length,
+                      CanTp_Result_t result)
+{
+    Uds_Request_t *rq = &uds.rq;
+    uint8_t nrc;
+
+    if (result != CANTP_OK || length == 0 || uds.state != UDS_STATE_IDLE ||
+        (channel != uds.cfg->phys_channel && channel != uds.cfg->func_channel)) {
+        return;
+    }
+
+    rq->channel = channel;
+    rq->functional = (channel == uds.cfg->func_channel);
+    rq->first_call = 1;
+    rq->req = buffer;
+    rq->req_len = length;
+    rq->resp = uds.tx_buf;
+    rq->resp[0] = (uint8_t)(buffer[0] + UDS_POSITIVE_OFFSET);
+    rq->resp_len = 1;
+    rq->resp_max = sizeof(uds.tx_buf);
+    uds.rcrrp_sent = 0;
+    uds.rcrrp_due = 0;
+    uds.reset_type = 0;
+
+    /* Any request keeps a non-default session alive */
+    if (uds.session != UDS_SESSION_DEFAULT) {
+        CanTimer_Start(&uds.s3_timer, CAN_TIMER_MS_TO_TICKS(UDS_S3_SERVER_MS));
+    }
+
+    nrc = Uds_Dispatch();
+    if (nrc == UDS_PENDING) {
+        /* Continue in Uds_MainFunction(); NRC 0x78 only goes out if the
+         * final response is not ready shortly before P2 expires */
+        uds.state = UDS_STATE_PENDING;
+        CanTimer_Start(&uds.p2_timer, CAN_TIMER_MS_TO_TICKS(UDS_RCRRP_FIRST_MS));
+        return;
+    }
+
+    Uds_Finish(nrc);
+}
+
+void Uds_TxConfirmation(uint8_t channel, CanTp_Result_t result)
+{
+    (void)channel;
+    (void)result;
+
+    if (uds.state != UDS_STATE_TX) {
+        return;  /* Confirmation of a 0x78 */
+    }
+    uds.state = UDS_STATE_IDLE;
+
+    /* ECU reset only after the positive response left the node */
+    if (uds.reset_type != 0 && uds.cfg->ecu_reset != NULL) {
+        uds.cfg->ecu_reset(uds.reset_type);
+    }
+}
+
+void Uds_MainFunction(void)
+{
+    uint8_t nrc;
+
+    switch (uds.state) {
+    case UDS_STATE_TX_RETRY:
+        if (Uds_Send(uds.rq.resp, uds.rq.resp_len)) {
+            uds.state = UDS_STATE_TX;
+        }
+        break;
+
+    case UDS_STATE_PENDING:
+        if (uds.rcrrp_due) {
+            (void)Uds_SendPending();  /* Retried next call if CanTp busy */
+        }
+
+        uds.rq.first_call = 0;
+        nrc = uds.service->handler(&uds.rq);
+        if (nrc != UDS_PENDING) {
+            Uds_Finish(nrc);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* ============================================================================
+ * Implementation - Session / Reset / TesterPresent
+ * ============================================================================ */
+
+static uint8_t Uds_SessionControl(Uds_Request_t *rq)
+{
+    uint8_t session = rq->req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP;
+    uint8_t nrc;
+
+    if (rq->req_len != 2) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if (session < UDS_SESSION_DEFAULT || session > UDS_SESSION_EXTENDED) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+    if (uds.cfg->session_change != NULL) {
+        nrc = uds.cfg->session_change(session);
+        if (nrc != UDS_OK) {
+            return nrc;  /* May be UDS_PENDING, e.g. jump to bootloader */
+        }
+    }
+
+    Uds_SetSession(session);
+
+    rq->resp[1] = session;
+    rq->resp[2] = (uint8_t)(UDS_P2_SERVER_MS >> 8);
+    rq->resp[3] = (uint8_t)UDS_P2_SERVER_MS;
+    rq->resp[4] = (uint8_t)((UDS_P2STAR_SERVER_MS / 10U) >> 8);
+    rq->resp[5] = (uint8_t)(UDS_P2STAR_SERVER_MS / 10U);
+    rq->resp_len = 6;
+    return UDS_OK;
+}
+
+static uint8_t Uds_EcuReset(Uds_Request_t *rq)
+{
+    uint8_t type = rq->req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP;
+
+    if (rq->req_len != 2) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if (type < 0x01U || type > 0x03U) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+    if (uds.cfg->ecu_reset == NULL) {
+        return UDS_NRC_CONDITIONS_NOT_CORRECT;
+    }
+
+    uds.reset_type = type;  /* Executed after TX confirmation */
+    rq->resp[1] = type;
+    rq->resp_len = 2;
+    return UDS_OK;
+}
+
+static uint8_t Uds_TesterPresent(Uds_Request_t *rq)
+{
+    if (rq->req_len != 2) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if ((rq->req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP) != 0x00U) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+
+    rq->resp[1] = 0x00;
+    rq->resp_len = 2;
+    return UDS_OK;
+}
+
+/* ============================================================================
+ * Implementation - Security Access (0x27)
+ * ============================================================================ */
+
+static uint8_t Uds_SecurityAccess(Uds_Request_t *rq)
+{
+    uint8_t sub = rq->req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP;
+    uint8_t level = (uint8_t)((sub + 1U) / 2U);
+    uint8_t seed_len = UDS_SA_MAX_SEED_LEN;
+    uint8_t nrc;
+
+    if (sub == 0 || sub > 0x7EU) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+    if (uds.cfg->get_seed == NULL || uds.cfg->compare_key == NULL) {
+        return UDS_NRC_CONDITIONS_NOT_CORRECT;
+    }
+    if (uds.sa_delay) {
+        return UDS_NRC_TIME_DELAY_NOT_EXPIRED;
+    }
+
+    rq->resp[1] = sub;
+
+    if (sub & 0x01U) {
+        /* requestSeed */
+        if (rq->req_len != 2) {
+            return UDS_NRC_INCORRECT_LENGTH;
+        }
+        if (uds.security_level == level) {
+            /* Already unlocked: zero seed */
+            memset(&rq->resp[2], 0, 4);
+            rq->resp_len = 6;
+            return UDS_OK;
+        }
+        nrc = uds.cfg->get_seed(level, &rq->resp[2], &seed_len);
+        if (nrc != UDS_OK) {
+            return nrc;
+        }
+        uds.seed_level = level;
+        rq->resp_len = 2U + seed_len;
+        return UDS_OK;
+    }
+
+    /* sendKey */
+    if (uds.seed_level != level) {
+        return UDS_NRC_REQUEST_SEQUENCE_ERROR;
+    }
+    uds.seed_level = 0;  /* A seed is valid for one key only */
+
+    if (!uds.cfg->compare_key(level, &rq->req[2], rq->req_len - 2U)) {
+        if (++uds.sa_attempts >= UDS_SA_MAX_ATTEMPTS) {
+            uds.sa_delay = 1;
+            CanTimer_Start(&uds.sa_timer, CAN_TIMER_MS_TO_TICKS(UDS_SA_DELAY_MS));
+            return UDS_NRC_EXCEEDED_ATTEMPTS;
+        }
+        return UDS_NRC_INVALID_KEY;
+    }
+
+    uds.sa_attempts = 0;
+    uds.security_level = level;
+    rq->resp_len = 2;
+    return UDS_OK;
+}
+
+/* ============================================================================
+ * Implementation - Data Identifiers (0x22 / 0x2E)
+ * ============================================================================ */
+
+static uint8_t Uds_ReadDataByIdentifier(Uds_Request_t *rq)
+{
+    uint32_t pos = 1;
+    uint8_t nrc;
+
+    /* One or more DIDs, 2 bytes each */
+    if ((rq->req_len - 1U) % 2U != 0) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+
+    for (uint32_t i = 1; i < rq->req_len; i += 2) {
+        uint16_t did = Uds_Get16(&rq->req[i]);
+        const Uds_Did_t *entry = (const Uds_Did_t *)Uds_Search(
+            uds.cfg->dids, uds.cfg->did_count, sizeof(Uds_Did_t), did);
+
+        if (entry == NULL || !Uds_SessionOk(entry->sessions)) {
+            return UDS_NRC_REQUEST_OUT_OF_RANGE;
+        }
+        if (pos + 2U + entry->length > rq->resp_max) {
+            return UDS_NRC_RESPONSE_TOO_LONG;
+        }
+
+        rq->resp[pos++] = (uint8_t)(did >> 8);
+        rq->resp[pos++] = (uint8_t)did;
+
+        if (entry->data != NULL) {
+            memcpy(&rq->resp[pos], entry->data, entry->length);
+        } else if (entry->read != NULL) {
+            nrc = entry->read(did, &rq->resp[pos]);
+            if (nrc != UDS_OK) {
+                return nrc;  /* UDS_PENDING re-reads all DIDs later */
+            }
+        } else {
+            return UDS_NRC_REQUEST_OUT_OF_RANGE;
+        }
+        pos += entry->length;
+    }
+
+    rq->resp_len = pos;
+    return UDS_OK;
+}
+
+static uint8_t Uds_WriteDataByIdentifier(Uds_Request_t *rq)
+{
+    uint16_t did = Uds_Get16(&rq->req[1]);
+    const Uds_Did_t *entry = (const Uds_Did_t *)Uds_Search(
+        uds.cfg->dids, uds.cfg->did_count, sizeof(Uds_Did_t), did);
+    uint8_t nrc;
+
+    if (entry == NULL || entry->write == NULL || !Uds_SessionOk(entry->sessions)) {
+        return UDS_NRC_REQUEST_OUT_OF_RANGE;
+    }
+    if (rq->req_len != 3U + entry->length) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if (!Uds_SecurityOk(entry->write_security)) {
+        return UDS_NRC_SECURITY_ACCESS_DENIED;
+    }
+
+    nrc = entry->write(did, &rq->req[3]);
+    if (nrc != UDS_OK) {
+        return nrc;
+    }
+
+    rq->resp[1] = rq->req[1];
+    rq->resp[2] = rq->req[2];
+    rq->resp_len = 3;
+    return UDS_OK;
+}
+
+/* ============================================================================
+ * Implementation - Routine Control (0x31)
+ * ============================================================================ */
+
+static uint8_t Uds_RoutineControl(Uds_Request_t *rq)
+{
+    uint8_t sub = rq->req[1] & (uint8_t)~UDS_SUPPRESS_POS_RSP;
+    uint16_t rid = Uds_Get16(&rq->req[2]);
+    const Uds_Routine_t *entry;
+    uint32_t out_len = 0;
+    uint8_t nrc;
+
+    if (sub < 0x01U || sub > 0x03U) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+
+    entry = (const Uds_Routine_t *)Uds_Search(
+        uds.cfg->routines, uds.cfg->routine_count, sizeof(Uds_Routine_t), rid);
+    if (entry == NULL || !Uds_SessionOk(entry->sessions)) {
+        return UDS_NRC_REQUEST_OUT_OF_RANGE;
+    }
+    if (!Uds_SecurityOk(entry->security)) {
+        return UDS_NRC_SECURITY_ACCESS_DENIED;
+    }
+
+    nrc = entry->handler(sub, &rq->req[4], rq->req_len - 4U,
+                         &rq->resp[4], &out_len, rq->resp_max - 4U);
+    if (nrc != UDS_OK) {
+        return nrc;  /* e.g. UDS_PENDING during flash erase */
+    }
+
+    rq->resp[1] = sub;
+    rq->resp[2] = rq->req[2];
+    rq->resp[3] = rq->req[3];
+    rq->resp_len = 4U + out_len;
+    return UDS_OK;
+}
+
+/* ============================================================================
+ * Implementation - Download (0x34 / 0x36 / 0x37)
+ * ============================================================================ */
+
+static uint8_t Uds_RequestDownload(Uds_Request_t *rq)
+{
+    uint8_t format = rq->req[1];
+    uint8_t alfid = rq->req[2];
+    uint8_t addr_len = alfid & 0x0FU;
+    uint8_t size_len = alfid >> 4;
+    uint32_t address = 0;
+    uint32_t size = 0;
+    uint8_t nrc;
+
+    if (addr_len == 0 || addr_len > 4 || size_len == 0 || size_len > 4) {
+        return UDS_NRC_REQUEST_OUT_OF_RANGE;
+    }
+    if (rq->req_len != 3U + addr_len + size_len) {
+        return UDS_NRC_INCORRECT_LENGTH;
+    }
+    if (format != 0x00U) {
+        return UDS_NRC_REQUEST_OUT_OF_RANGE;  /* No compression/encryption */
+    }
+    if (uds.dl_active) {
+        return UDS_NRC_CONDITIONS_NOT_CORRECT;
+    }
+    if (uds.cfg->request_download == NULL || uds.cfg->flash_write == NULL) {
+        return UDS_NRC_UPLOAD_DOWNLOAD_NOT_ACCEPTED;
+    }
+
+    for (uint8_t i = 0; i < addr_len; i++) {
+        address = (address << 8) | rq->req[3U + i];
+    }
+    for (uint8_t i = 0; i < size_len; i++) {
+        size = (size << 8) | rq->req[3U + addr_len + i];
+    }
+
+    nrc = uds.cfg->request_download(address, size);
+    if (nrc != UDS_OK) {
+        return nrc;
+    }
+
+    uds.dl_active = 1;
+    uds.dl_bsc = 0;
+    uds.dl_address = address;
+    uds.dl_size = size;
+    uds.dl_received = 0;
+
+    /* lengthFormatIdentifier: 2-byte maxNumberOfBlockLength */
+    rq->resp[1] = 0x20;
+    rq->resp[2] = (uint8_t)(UDS_RX_BUFFER_SIZE >> 8);
+    rq->resp[3] = (uint8_t)UDS_RX_BUFFER_SIZE;
+    rq->resp_len = 4;
+    return UDS_OK;
+}
+
+static uint8_t Uds_TransferData(Uds_Request_t *rq)
+{
+    uint8_t bsc = rq->req[1];
+    uint32_t len = rq->req_len - 2U;
+    uint8_t result;
+
+    if (!uds.dl_active) {
+        return UDS_NRC_REQUEST_SEQUENCE_ERROR;
+    }
+
+    rq->resp[1] = bsc;
+    rq->resp_len = 2;
+
+    /* Repeated block (our response was lost): acknowledge, don't rewrite */
+    if (bsc == uds.dl_bsc && uds.dl_received != 0) {
+        return UDS_OK;
+    }
+    if (bsc != (uint8_t)(uds.dl_bsc + 1U)) {
+        return UDS_NRC_WRONG_BLOCK_SEQUENCE_COUNTER;
+    }
+    if (len == 0 || uds.dl_received + len > uds.dl_size) {
+        return UDS_NRC_TRANSFER_DATA_SUSPENDED;
+    }
+
+    /* Data goes to flash straight from the CanTp reassembly buffer */
+    result = uds.cfg->flash_write(uds.dl_address + uds.dl_received, &rq->req[2], len);
+    if (result == UDS_PENDING) {
+        return UDS_PENDING;  /* Previous block still programming */
+    }
+    if (result != UDS_OK) {
+        return UDS_NRC_GENERAL_PROGRAMMING_FAILURE;
+    }
+
+    /* Accepted: this buffer now belongs to flash_write, respond at once
+     * so the tester sends the next block into the other buffer */
+    uds.flash_index = uds.rx_index;
+    uds.dl_received += len;
+    uds.dl_bsc = bsc;
+    return UDS_OK;
+}
+
+static uint8_t Uds_RequestTransferExit(Uds_Request_t *rq)
+{
+    uint8_t result;
+
+    if (!uds.dl_active) {
+        return UDS_NRC_REQUEST_SEQUENCE_ERROR;
+    }
+
+    /* Wait until the last block has been programmed */
+    result = uds.cfg->flash_write(0, NULL, 0);
+    if (result == UDS_PENDING) {
+        return UDS_PENDING;
+    }
+
+    uds.dl_active = 0;
+    uds.flash_index = UDS_NO_BUFFER;
+    if (result != UDS_OK) {
+        return UDS_NRC_GENERAL_PROGRAMMING_FAILURE;
+    }
+    if (uds.dl_received != uds.dl_size) {
+        return UDS_NRC_REQUEST_SEQUENCE_ERROR;
+    }
+
+    rq->resp_len = 1;
+    return UDS_OK;
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+static const uint8_t vin[17] = "WDB1234567890ABCD";
+
+static uint8_t read_voltage(uint16_t did, uint8_t *out)
+{
+    uint16_t mv = ADC_ReadSupplyMv();
+    (void)did;
+    out[0] = (uint8_t)(mv >> 8);
+    out[1] = (uint8_t)mv;
+    return UDS_OK;
+}
+
+// Sorted by DID
+static const Uds_Did_t dids[] = {
+    { 0x0100, 2,  UDS_SESSION_ALL, 0, NULL, read_voltage, NULL },
+    { 0xF190, 17, UDS_SESSION_ALL, 0, vin,  NULL,         NULL },
+};
+
+// Erase runs in the background; results are polled via UDS_PENDING
+static uint8_t routine_erase(uint8_t sub, const uint8_t *opt, uint32_t opt_len,
+                             uint8_t *out, uint32_t *out_len, uint32_t out_max)
+{
+    if (sub != 0x01) {
+        return UDS_NRC_SUBFUNCTION_NOT_SUPPORTED;
+    }
+    if (!Flash_EraseBusy()) {
+        if (!Flash_EraseStarted()) {
+            Flash_StartErase(opt, opt_len);
+            return UDS_PENDING;
+        }
+        out[0] = Flash_EraseOk() ? 0x00 : 0x01;
+        *out_len = 1;
+        return UDS_OK;
+    }
+    return UDS_PENDING;
+}
+
+static const Uds_Routine_t routines[] = {
+    { 0xFF00, UDS_SESSION_BIT(UDS_SESSION_PROGRAMMING), UDS_SA_LEVEL_2, routine_erase },
+};
+
+// Non-blocking programming: start the write, report busy via UDS_PENDING
+static uint8_t flash_write(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    if (Flash_ProgramBusy()) {
+        return UDS_PENDING;
+    }
+    if (Flash_ProgramError()) {
+        return UDS_NRC_GENERAL_PROGRAMMING_FAILURE;
+    }
+    if (length != 0) {
+        Flash_StartProgram(address, data, length);  // DMA / flash controller
+    }
+    return UDS_OK;
+}
+
+static const Uds_Config_t uds_config = {
+    .phys_channel = 0,
+    .func_channel = 1,
+    .dids = dids,         .did_count = 2,
+    .routines = routines, .routine_count = 1,
+    .get_seed = App_GetSeed,
+    .compare_key = App_CompareKey,
+    .ecu_reset = App_Reset,
+    .request_download = App_CheckDownload,
+    .flash_write = flash_write,
+};
+
+// CanTp upper layer = UDS server (BS=0, STmin=0 for download speed)
+static const CanTp_Callbacks_t cantp_callbacks = {
+    .link_tx = link_tx,
+    .start_of_reception = Uds_StartOfReception,
+    .rx_indication = Uds_RxIndication,
+    .tx_confirmation = Uds_TxConfirmation,
+};
+
+void main(void)
+{
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);
+    CanTp_Init(cantp_config, 2, &cantp_callbacks);
+    Uds_Init(&uds_config);
+
+    while (1) {
+        Uds_MainFunction();
+    }
+}
+*/
@@ -0,0 +1,529 @@
+/**
+ * CAN Driver Microbenchmark Template (host)
+ *
+ * This template measures the driver hot paths on the host against the
+ * peripheral simulator (can-sim.template.c):
+ * - CAN_Transmit, CAN_Receive, CAN_RX_IRQHandler (callback and ring
+ *   dispatch) per frame, CAN_Filter_* setup per call
+ * - Wall time (ns) and retired instructions (Linux perf counter, when the
+ *   kernel allows it) per frame
+ * - Each sample times a calibrated batch; per-op setup (frame injection,
+ *   mailbox completion) runs in the batch too and is measured separately
+ *   and subtracted
+ * - Median and quartiles over CANBENCH_SAMPLES samples, printed as JSON
+ *   for scripts/can_bench.py (baselines, regression check, bit timing)
+ *
+ * Numbers include the simulator's register hook (CanSim_Sync), so they are
+ * for comparing two builds of the templates, not target cycle budgets.
+ * Instructions are nearly noise free; use them to judge small changes.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_sim.h"
+#include "can_handle.h"
+#ifdef CAN_SW_FILTER
+#include "can_swfilter.h"
+#endif
+#ifdef CAN_E2E
+#include "can_e2e.h"
+#endif
+#ifdef CAN_SECOC
+#include "can_secoc.h"
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANBENCH_SAMPLES        31U         /* Odd: median is one sample */
+#define CANBENCH_SAMPLE_NS      2000000ULL  /* Batch length per sample */
+#define CANBENCH_BATCH_MAX      (1UL << 20)
+#define CANBENCH_IDLIST_IDS     40U         /* CAN_Filter_IdList case */
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+/**
+ * @brief One benchmark case
+ */
+typedef struct {
+    const char *name;
+    const char *unit;               /* What ops_per_run counts */
+    uint32_t ops_per_run;           /* Frames (or calls) per run() */
+    void (*reset)(void);            /* Once before the case, untimed */
+    void (*prepare)(void);          /* Before each run(), subtracted; NULL: none */
+    void (*run)(void);              /* Measured */
+} CanBench_Case_t;
+
+/**
+ * @brief Result of one case, per op
+ */
+typedef struct {
+    double ns_median;
+    double ns_p25;
+    double ns_p75;
+    double ns_min;
+    double instr_median;            /* < 0: counter not available */
+    uint32_t batch;                 /* run() calls per sample */
+} CanBench_Result_t;
+
+/* ============================================================================
+ * Implementation - Clock and Counter
+ * ============================================================================ */
+
+static int canbench_perf_fd = -1;
+
+static uint64_t CanBench_Ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Retired user-space instructions of this thread, false without perf */
+static bool CanBench_PerfOpen(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    canbench_perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    return canbench_perf_fd >= 0;
+}
+
+static uint64_t CanBench_Instructions(void)
+{
+    uint64_t count = 0;
+
+#ifdef __linux__
+    if (canbench_perf_fd < 0 || read(canbench_perf_fd, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+    }
+#endif
+    return count;
+}
+
+/* ============================================================================
+ * Implementation - Cases
+ * ============================================================================ */
+
+static CAN_Handle_t canbench_hcan;
+static CAN_TxMsg_t canbench_tx = { .id = 0x123, .dlc = 8, .data = { 1, 2, 3, 4, 5, 6, 7, 8 } };
+static CanSim_Frame_t canbench_rx = { .id = 0x321, .dlc = 8, .data = { 8, 7, 6, 5, 4, 3, 2, 1 } };
+static volatile uint32_t canbench_sink;
+
+static void CanBench_RxCallback(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    (void)hcan;
+    canbench_sink += msg->data[0];
+}
+
+/* Controller up, accept-all filter, no interrupts: runs call the driver directly */
+static void CanBench_Reset(void)
+{
+    CanSim_Init();
+    CanTimer_Init();
+    CAN_Init(&canbench_hcan, CAN1, 0);
+    CAN_Filter_AcceptAll(&canbench_hcan);
+}
+
+static void CanBench_ResetCallback(void)
+{
+    CanBench_Reset();
+    CAN_RegisterRxCallback(&canbench_hcan, CanBench_RxCallback);
+}
+
+/* All three mailboxes transmitted and free again */
+static void CanBench_CompleteTx(void)
+{
+    CanSim_Advance(CanSim_Now() + 1000000U);
+}
+
+static void CanBench_Transmit(void)
+{
+    (void)CAN_Transmit(&canbench_hcan, &canbench_tx);
+    (void)CAN_Transmit(&canbench_hcan, &canbench_tx);
+    (void)CAN_Transmit(&canbench_hcan, &canbench_tx);
+}
+
+/* FIFO 0 full (3 frames); the ring is emptied so dispatch never drops */
+static void CanBench_FillFifo(void)
+{
+    canbench_hcan.rx.tail = canbench_hcan.rx.head;
+    CanSim_Inject(0, &canbench_rx);
+    CanSim_Inject(0, &canbench_rx);
+    CanSim_Inject(0, &canbench_rx);
+}
+
+static void CanBench_Receive(void)
+{
+    CAN_RxMsg_t msg;
+
+    (void)CAN_Receive(&canbench_hcan, &msg);
+    (void)CAN_Receive(&canbench_hcan, &msg);
+    (void)CAN_Receive(&canbench_hcan, &msg);
+    canbench_sink += msg.data[0];
+}
+
+static void CanBench_RxIrq(void)
+{
+    CAN_RX_IRQHandler(&canbench_hcan);
+}
+
+static void CanBench_FilterAcceptAll(void)
+{
+    CAN_Filter_AcceptAll(&canbench_hcan);
+}
+
+static void CanBench_FilterIdRange(void)
+{
+    CAN_Filter_IdRange(&canbench_hcan, 0x100, 0x7F0);
+}
+
+static void CanBench_FilterFourIds(void)
+{
+    static const uint16_t ids[4] = { 0x100, 0x200, 0x300, 0x400 };
+    CAN_Filter_FourIds(&canbench_hcan, ids);
+}
+
+static void CanBench_FilterIdList(void)
+{
+    static uint16_t ids[CANBENCH_IDLIST_IDS];
+
+    if (ids[1] == 0) {
+        for (uint16_t i = 0; i < CANBENCH_IDLIST_IDS; i++) {
+            ids[i] = (uint16_t)(0x100U + 7U * i);
+        }
+    }
+    (void)CAN_Filter_IdList(&canbench_hcan, ids, CANBENCH_IDLIST_IDS, NULL, 0, 14);
+}
+
+#ifdef CAN_SW_FILTER
+static CanSwf_Table_t canbench_swf;
+
+/* Full table: standard IDs in the bitmap, the rest extended, so an
+ * extended miss scans every entry */
+static void CanBench_ResetSwFilter(void)
+{
+    CanBench_Reset();
+    CanSwf_Init(&canbench_swf);
+    for (uint32_t i = 0; i < CANSWF_MAX_ENTRIES / 2U; i++) {
+        (void)CanSwf_Add(&canbench_swf, 0x100U + 5U * i, 0x7FFU, CANSWF_DATA_ONLY);
+        (void)CanSwf_Add(&canbench_swf, 0x18DA0000U + 3U * i, 0x1FFFFFFFU, CANSWF_EXT);
+    }
+    CanSwf_Build(&canbench_swf);
+}
+
+static void CanBench_SwAcceptStd(void)
+{
+    for (uint32_t i = 0; i < 8U; i++) {
+        canbench_sink += CanSwf_Accept(&canbench_swf, 0x100U + i, 0U, 0U);
+    }
+}
+
+static void CanBench_SwMatchExtMiss(void)
+{
+    for (uint32_t i = 0; i < 8U; i++) {
+        canbench_sink += (uint32_t)CanSwf_Match(&canbench_swf, 0x0CF00400U + i, 1U, 0U);
+    }
+}
+
+/* Hardware accept-all, table on the RX path */
+static void CanBench_ResetSwFilterRing(void)
+{
+    CanBench_ResetSwFilter();
+    canbench_hcan.sw_filter = &canbench_swf;
+}
+#endif /* CAN_SW_FILTER */
+
+#ifdef CAN_E2E
+/* One channel per profile, 8-byte frames (P04: 16, its header is 12) */
+static const uint8_t canbench_e2e_ids[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+static const CanE2E_Config_t canbench_e2e_cfg[4] = {
+    { .profile = CANE2E_P01, .length = 8,  .data_id = 0x0123, .max_delta = 2, .window = 8, .min_ok = 3, .max_err = 1 },
+    { .profile = CANE2E_P02, .length = 8,  .data_id_list = canbench_e2e_ids, .max_delta = 2, .window = 8, .min_ok = 3, .max_err = 1 },
+    { .profile = CANE2E_P04, .length = 16, .data_id = 0x01234567, .max_delta = 2, .window = 8, .min_ok = 3, .max_err = 1 },
+    { .profile = CANE2E_P05, .length = 8,  .data_id = 0x0123, .max_delta = 2, .window = 8, .min_ok = 3, .max_err = 1 },
+};
+static CanE2E_Channel_t canbench_e2e_tx[4];
+static CanE2E_Channel_t canbench_e2e_rx[4];
+static uint8_t canbench_e2e_frame[4][4][16];    /* Consecutive protected frames */
+
+static void CanBench_ResetE2E(void)
+{
+    CanE2E_Init();
+    for (uint8_t p = 0; p < 4U; p++) {
+        (void)CanE2E_ChannelInit(&canbench_e2e_tx[p], &canbench_e2e_cfg[p]);
+        (void)CanE2E_ChannelInit(&canbench_e2e_rx[p], &canbench_e2e_cfg[p]);
+        for (uint8_t f = 0; f < 4U; f++) {
+            memcpy(canbench_e2e_frame[p][f], canbench_tx.data, 8);
+            (void)CanE2E_Protect(&canbench_e2e_tx[p], canbench_e2e_frame[p][f], canbench_e2e_cfg[p].length);
+        }
+    }
+}
+
+static void CanBench_E2EProtect(uint8_t p)
+{
+    for (uint8_t f = 0; f < 4U; f++) {
+        (void)CanE2E_Protect(&canbench_e2e_tx[p], canbench_e2e_frame[p][f], canbench_e2e_cfg[p].length);
+    }
+}
+
+/* Every run replays the same four frames, so the first check of a run
+ * is a sequence error; it costs the same as an OK check */
+static void CanBench_E2ECheck(uint8_t p)
+{
+    for (uint8_t f = 0; f < 4U; f++) {
+        canbench_sink += CanE2E_Check(&canbench_e2e_rx[p], canbench_e2e_frame[p][f], canbench_e2e_cfg[p].length);
+    }
+}
+
+static void CanBench_E2EProtectP01(void) { CanBench_E2EProtect(CANE2E_P01); }
+static void CanBench_E2EProtectP02(void) { CanBench_E2EProtect(CANE2E_P02); }
+static void CanBench_E2EProtectP04(void) { CanBench_E2EProtect(CANE2E_P04); }
+static void CanBench_E2EProtectP05(void) { CanBench_E2EProtect(CANE2E_P05); }
+static void CanBench_E2ECheckP01(void)   { CanBench_E2ECheck(CANE2E_P01); }
+static void CanBench_E2ECheckP02(void)   { CanBench_E2ECheck(CANE2E_P02); }
+static void CanBench_E2ECheckP04(void)   { CanBench_E2ECheck(CANE2E_P04); }
+static void CanBench_E2ECheckP05(void)   { CanBench_E2ECheck(CANE2E_P05); }
+#endif /* CAN_E2E */
+
+#ifdef CAN_SECOC
+/* Four messages 0x200..0x203 on CAN1: 4 data bytes | 8 freshness bits |
+ * 24 MAC bits, one key */
+static const uint8_t canbench_secoc_key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                                0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static const CanSecOC_Config_t canbench_secoc_cfg[4] = {
+    { .can_id = 0x200, .data_id = 0x10, .auth_len = 4, .fv_bits = 8, .mac_bits = 24 },
+    { .can_id = 0x201, .data_id = 0x11, .auth_len = 4, .fv_bits = 8, .mac_bits = 24 },
+    { .can_id = 0x202, .data_id = 0x12, .auth_len = 4, .fv_bits = 8, .mac_bits = 24 },
+    { .can_id = 0x203, .data_id = 0x13, .auth_len = 4, .fv_bits = 8, .mac_bits = 24 },
+};
+static CanSecOC_Pdu_t canbench_secoc_pdu[4];
+static CAN_RxMsg_t canbench_secoc_frame[4];     /* First secured frame of each message */
+
+static void CanBench_ResetSecOC(void)
+{
+    CanBench_Reset();
+    CanSecOC_Init(NULL);
+    (void)CanSecOC_SetKey(0, canbench_secoc_key);
+    for (uint8_t p = 0; p < 4U; p++) {
+        (void)CanSecOC_PduInit(&canbench_secoc_pdu[p], &canbench_secoc_cfg[p]);
+        canbench_secoc_frame[p].id = canbench_secoc_cfg[p].can_id;
+        (void)CanSecOC_Secure(&canbench_secoc_pdu[p], canbench_tx.data, 4,
+                              canbench_secoc_frame[p].data, &canbench_secoc_frame[p].dlc);
+    }
+    (void)CanSecOC_Register(canbench_secoc_pdu, 4);
+}
+
+/* Freshness back to 0, so every run verifies (and accepts) the frames */
+static void CanBench_SecOCRewind(void)
+{
+    for (uint8_t p = 0; p < 4U; p++) {
+        canbench_secoc_pdu[p].rx_fv = 0U;
+    }
+}
+
+static void CanBench_SecOCQueue(void)
+{
+    CanBench_SecOCRewind();
+    for (uint8_t p = 0; p < 4U; p++) {
+        (void)CanSecOC_RxIndication(&canbench_hcan, &canbench_secoc_frame[p]);
+    }
+}
+
+static void CanBench_SecOCVerify(void)
+{
+    for (uint8_t p = 0; p < 4U; p++) {
+        canbench_sink += CanSecOC_Verify(&canbench_secoc_pdu[p], canbench_secoc_frame[p].data,
+                                         canbench_secoc_frame[p].dlc);
+    }
+}
+
+static void CanBench_SecOCMain(void)
+{
+    canbench_sink += CanSecOC_MainFunction(4);
+}
+#endif /* CAN_SECOC */
+
+static const CanBench_Case_t canbench_cases[] = {
+    { "CAN_Transmit",              "frame", 3, CanBench_Reset,         CanBench_CompleteTx, CanBench_Transmit },
+    { "CAN_Receive",               "frame", 3, CanBench_Reset,         CanBench_FillFifo,   CanBench_Receive },
+    { "CAN_RX_IRQHandler.ring",    "frame", 3, CanBench_Reset,         CanBench_FillFifo,   CanBench_RxIrq },
+    { "CAN_RX_IRQHandler.callback","frame", 3, CanBench_ResetCallback, CanBench_FillFifo,   CanBench_RxIrq },
+    { "CAN_Filter_AcceptAll",      "call",  1, CanBench_Reset,         NULL,                CanBench_FilterAcceptAll },
+    { "CAN_Filter_IdRange",        "call",  1, CanBench_Reset,         NULL,                CanBench_FilterIdRange },
+    { "CAN_Filter_FourIds",        "call",  1, CanBench_Reset,         NULL,                CanBench_FilterFourIds },
+    { "CAN_Filter_IdList.40",      "call",  1, CanBench_Reset,         NULL,                CanBench_FilterIdList },
+#ifdef CAN_SW_FILTER
+    { "CanSwf_Accept.std",         "frame", 8, CanBench_ResetSwFilter, NULL,                CanBench_SwAcceptStd },
+    { "CanSwf_Match.ext_miss",     "frame", 8, CanBench_ResetSwFilter, NULL,                CanBench_SwMatchExtMiss },
+    { "CAN_RX_IRQHandler.swfilter","frame", 3, CanBench_ResetSwFilterRing, CanBench_FillFifo, CanBench_RxIrq },
+#endif
+#ifdef CAN_E2E
+    { "CanE2E_Protect.P01",        "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2EProtectP01 },
+    { "CanE2E_Protect.P02",        "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2EProtectP02 },
+    { "CanE2E_Protect.P04",        "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2EProtectP04 },
+    { "CanE2E_Protect.P05",        "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2EProtectP05 },
+    { "CanE2E_Check.P01",          "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2ECheckP01 },
+    { "CanE2E_Check.P02",          "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2ECheckP02 },
+    { "CanE2E_Check.P04",          "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2ECheckP04 },
+    { "CanE2E_Check.P05",          "frame", 4, CanBench_ResetE2E,      NULL,                CanBench_E2ECheckP05 },
+#endif
+#ifdef CAN_SECOC
+    { "CanSecOC_Verify",           "verify", 4, CanBench_ResetSecOC,   CanBench_SecOCRewind, CanBench_SecOCVerify },
+    { "CanSecOC_MainFunction.batch","verify", 4, CanBench_ResetSecOC,  CanBench_SecOCQueue, CanBench_SecOCMain },
+#endif
+};
+
+/* ============================================================================
+ * Implementation - Measurement
+ * ============================================================================ */
+
+/* Time batch x (prepare + run), or batch x prepare only */
+static void CanBench_Batch(const CanBench_Case_t *c, uint32_t batch, bool with_run,
+                           uint64_t *ns, uint64_t *instr)
+{
+    uint64_t t0, i0;
+
+    i0 = CanBench_Instructions();
+    t0 = CanBench_Ns();
+    for (uint32_t i = 0; i < batch; i++) {
+        if (c->prepare != NULL) {
+            c->prepare();
+        }
+        if (with_run) {
+            c->run();
+        }
+    }
+    *ns = CanBench_Ns() - t0;
+    *instr = CanBench_Instructions() - i0;
+}
+
+static int CanBench_Compare(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void CanBench_RunCase(const CanBench_Case_t *c, CanBench_Result_t *r)
+{
+    double ns[CANBENCH_SAMPLES];
+    double instr[CANBENCH_SAMPLES];
+    uint64_t t_full, t_base, i_full, i_base;
+    uint32_t batch = 1;
+    uint32_t s;
+
+    c->reset();
+
+    /* Calibrate: double the batch until it fills CANBENCH_SAMPLE_NS */
+    for (;;) {
+        CanBench_Batch(c, batch, true, &t_full, &i_full);
+        if (t_full >= CANBENCH_SAMPLE_NS || batch >= CANBENCH_BATCH_MAX) {
+            break;
+        }
+        batch *= 2U;
+    }
+
+    for (s = 0; s < CANBENCH_SAMPLES; s++) {
+        double ops = (double)batch * c->ops_per_run;
+
+        CanBench_Batch(c, batch, true, &t_full, &i_full);
+        if (c->prepare != NULL) {
+            CanBench_Batch(c, batch, false, &t_base, &i_base);
+        } else {
+            t_base = 0;
+            i_base = 0;
+        }
+        ns[s] = (t_full > t_base) ? (double)(t_full - t_base) / ops : 0.0;
+        instr[s] = (i_full > i_base) ? (double)(i_full - i_base) / ops : 0.0;
+    }
+
+    qsort(ns, CANBENCH_SAMPLES, sizeof(ns[0]), CanBench_Compare);
+    qsort(instr, CANBENCH_SAMPLES, sizeof(instr[0]), CanBench_Compare);
+    r->ns_min = ns[0];
+    r->ns_p25 = ns[CANBENCH_SAMPLES / 4U];
+    r->ns_median = ns[CANBENCH_SAMPLES / 2U];
+    r->ns_p75 = ns[(3U * CANBENCH_SAMPLES) / 4U];
+    r->instr_median = (canbench_perf_fd >= 0) ? instr[CANBENCH_SAMPLES / 2U] : -1.0;
+    r->batch = batch;
+}
+
+/**
+ * @brief Run all cases whose name starts with filter (NULL: all), JSON to out
+ */
+void CanBench_RunAll(FILE *out, const char *filter)
+{
+    const uint32_t count = sizeof(canbench_cases) / sizeof(canbench_cases[0]);
+    CanBench_Result_t r;
+    bool first = true;
+
+    CanBench_PerfOpen();
+
+    fprintf(out, "{\n  \"samples\": %u,\n  \"cases\": [\n", CANBENCH_SAMPLES);
+    for (uint32_t i = 0; i < count; i++) {
+        const CanBench_Case_t *c = &canbench_cases[i];
+
+        if (filter != NULL && strncmp(c->name, filter, strlen(filter)) != 0) {
+            continue;
+        }
+        CanBench_RunCase(c, &r);
+
+        fprintf(out, "%s    {\"name\": \"%s\", \"unit\": \"%s\", \"batch\": %u, "
+                "\"ns\": {\"median\": %.2f, \"p25\": %.2f, \"p75\": %.2f, \"min\": %.2f}, ",
+                first ? "" : ",\n", c->name, c->unit, r.batch,
+                r.ns_median, r.ns_p25, r.ns_p75, r.ns_min);
+        if (r.instr_median >= 0.0) {
+            fprintf(out, "\"instructions\": %.1f}", r.instr_median);
+        } else {
+            fprintf(out, "\"instructions\": null}");
+        }
+        first = false;
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Host build: see can-sim.template.c, add can_bench.c; optimize as for
+// the target (-O2) and compare builds made with the same flags:
+//   gcc -O2 -include can_sim.h -include can_timer.h can_sim.c can_timer.c \
+//       can_init.c can_filter.c can_rx.c can_tx.c can_bench.c -o can_bench
+//   python scripts/can_bench.py --bin ./can_bench --save baseline.json
+//   ... change a template, rebuild ...
+//   python scripts/can_bench.py --bin ./can_bench --baseline baseline.json
+// Software filter cases: add -DCAN_SW_FILTER and can_swfilter.c.
+// E2E cases: add -DCAN_E2E and can_e2e.c; build once per CANE2E_CRC_SLICE
+// setting to compare the kernels.
+// SecOC cases: add -DCAN_SECOC and can_secoc.c; single frame verification
+// against the batched main function (queueing not included).
+
+int main(int argc, char **argv)
+{
+    CanBench_RunAll(stdout, argc > 1 ? argv[1] : NULL);
+    return 0;
+}
+*/
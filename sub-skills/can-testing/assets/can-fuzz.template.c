@@ -0,0 +1,911 @@
+/**
+ * CAN Differential Fuzz Template (host, libFuzzer)
+ *
+ * This template drives the TX/RX/filter templates through the peripheral
+ * simulator (can-sim.template.c) with fuzzer-generated cases and compares
+ * every result against an executable reference model:
+ * - Acceptance: what each CAN_Filter_* call is documented to accept
+ *   (frame type, ID, data/remote) and which FMI the match reports,
+ *   written from the API description, not from the register encoding
+ * - Framing: a transmitted CAN_TxMsg_t appears on the bus exactly once
+ *   with the same ID, flags, DLC and payload; a received frame decodes to
+ *   the same fields
+ * - Delivery: RX frames arrive in order, and none is lost unless the
+ *   simulator or the RX ring reports an overrun
+ *
+ * One input is one case: filter configuration, receiving instance, RX
+ * mode (polling, ring, callback), ISR latency, then a sequence of frame
+ * injections, transmissions, time steps, application polls and filter
+ * reconfigurations. A mismatch prints the case and aborts, so libFuzzer
+ * keeps the input as a crash file; replay it with the standalone build.
+ *
+ * With -DCAN_SW_FILTER the same filter is also built as a software table
+ * (can-swfilter.template.c): every offered frame is checked against
+ * CanSwf_Match(), and some cases run the hardware as accept-all with the
+ * table on the RX path (hcan->sw_filter) doing the filtering.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_sim.h"
+#include "can_handle.h"
+#ifdef CAN_SW_FILTER
+#include "can_swfilter.h"
+#endif
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANFUZZ_MAX_EVENTS      64U     /* Events read from one input */
+#define CANFUZZ_MAX_STD_IDS     12U     /* CAN_Filter_IdList standard IDs */
+#define CANFUZZ_MAX_EXT_IDS     6U      /* CAN_Filter_IdList extended IDs */
+#define CANFUZZ_INSTANCE_BANKS  14U     /* Filter banks per instance (CAN2SB) */
+#define CANFUZZ_SETTLE_NS       100000000ULL    /* End of case: drain TX/RX */
+#define CANFUZZ_CRASH_FILE      "canfuzz-crash.bin"
+
+#define CANFUZZ_STD_MASK        0x7FFU
+#define CANFUZZ_EXT_MASK        0x1FFFFFFFU
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef enum {
+    CANFUZZ_F_ACCEPT_ALL = 0,
+    CANFUZZ_F_SINGLE_STD,
+    CANFUZZ_F_ID_RANGE,
+    CANFUZZ_F_TWO_IDS,
+    CANFUZZ_F_FOUR_IDS,
+    CANFUZZ_F_EXTENDED,
+    CANFUZZ_F_ID_LIST,
+    CANFUZZ_F_COUNT
+} CanFuzz_FilterKind_t;
+
+typedef enum {
+    CANFUZZ_RX_POLL = 0,        /* CAN_Receive() on poll events */
+    CANFUZZ_RX_RING,            /* CAN_RX_IRQHandler() -> ring, CAN_ReadRing() */
+    CANFUZZ_RX_CALLBACK,        /* CAN_RX_IRQHandler() -> callback */
+    CANFUZZ_RX_COUNT
+} CanFuzz_RxMode_t;
+
+/**
+ * @brief Filter request as passed to the driver (IDs not masked)
+ */
+typedef struct {
+    CanFuzz_FilterKind_t kind;
+    uint16_t std_ids[CANFUZZ_MAX_STD_IDS];  /* SINGLE_STD/ID_RANGE: [0], [1] = mask */
+    uint32_t ext_ids[CANFUZZ_MAX_EXT_IDS];
+    uint8_t std_count;
+    uint8_t ext_count;
+    uint8_t max_banks;
+    uint8_t software;       /* CAN_SW_FILTER: hardware accept-all, table on the RX path */
+} CanFuzz_Filter_t;
+
+/**
+ * @brief Counters over all cases (what the inputs reached)
+ */
+typedef struct {
+    uint64_t cases;
+    uint64_t events;
+    uint64_t accepted[CANFUZZ_F_COUNT];
+    uint64_t rejected[CANFUZZ_F_COUNT];
+    uint64_t delivered;
+    uint64_t overruns;          /* Hardware FIFO + RX ring */
+    uint64_t tx_sent;
+    uint64_t tx_refused;        /* DLC > 8 or queue full */
+    uint64_t idlist_fallback;   /* CAN_Filter_IdList ran out of banks */
+    uint64_t sw_rejected;       /* Dropped by the software filter on the RX path */
+} CanFuzz_Stats_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Run one case; aborts on a mismatch with the reference model
+ */
+void CanFuzz_RunCase(const uint8_t *data, size_t size);
+
+/**
+ * @brief Reference acceptance of one bus frame
+ * @param fmi Filter match index the hardware must report
+ * @return true if the configured filter must accept the frame
+ */
+bool CanFuzz_RefAccept(const CanFuzz_Filter_t *f, const CanSim_Frame_t *frame, uint8_t *fmi);
+
+const CanFuzz_Stats_t *CanFuzz_GetStats(void);
+
+/* ============================================================================
+ * Implementation - State
+ * ============================================================================ */
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} CanFuzz_Input_t;
+
+static CAN_Handle_t canfuzz_hcan[2];
+static CanFuzz_Stats_t canfuzz_stats;
+
+/* Current case */
+static const uint8_t *canfuzz_data;
+static size_t canfuzz_size;
+static CanFuzz_Filter_t canfuzz_filter;
+static uint8_t canfuzz_rx_node;
+static CanFuzz_RxMode_t canfuzz_rx_mode;
+#ifdef CAN_SW_FILTER
+static CanSwf_Table_t canfuzz_swf;
+#endif
+
+/* Frames the model accepted, in bus order, FMI in frame.fmi */
+static CanSim_Frame_t canfuzz_expected[2U * CANFUZZ_MAX_EVENTS];
+static uint16_t canfuzz_expected_count;
+static uint16_t canfuzz_delivered_count;    /* Matched prefix of expected */
+
+/* Frames accepted by CAN_TransmitQueued, not yet seen on the bus */
+static CAN_TxMsg_t canfuzz_tx_pending[CANFUZZ_MAX_EVENTS];
+static uint16_t canfuzz_tx_count;
+
+/* ============================================================================
+ * Implementation - Reference Model
+ * ============================================================================ */
+
+/* Index of id in ids[0..count) after masking, -1 if absent */
+static int CanFuzz_Find16(const uint16_t *ids, uint8_t count, uint32_t id)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        if ((ids[i] & CANFUZZ_STD_MASK) == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int CanFuzz_Find32(const uint32_t *ids, uint8_t count, uint32_t id)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        if ((ids[i] & CANFUZZ_EXT_MASK) == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* CAN_Filter_IdList needs one bank per 4 standard / 2 extended IDs */
+static bool CanFuzz_IdListFits(const CanFuzz_Filter_t *f)
+{
+    return (f->std_count + 3U) / 4U + (f->ext_count + 1U) / 2U <= f->max_banks;
+}
+
+/*
+ * Semantics of the filter API:
+ * - AcceptAll: every frame, FMI 0
+ * - SingleStdId, IdRange (mask mode): standard data and remote frames
+ *   whose 11-bit ID matches, FMI 0
+ * - ExtendedId (mask mode): extended data and remote frames, FMI 0
+ * - TwoIds, FourIds, IdList (list mode): data frames only, FMI = position
+ *   of the first matching entry in the caller's list; IdList extended IDs
+ *   follow the standard banks (4 filter numbers per standard bank)
+ * IDs are taken modulo their width (11 or 29 bits).
+ */
+bool CanFuzz_RefAccept(const CanFuzz_Filter_t *f, const CanSim_Frame_t *frame, uint8_t *fmi)
+{
+    int k = -1;
+
+    *fmi = 0U;
+    switch (f->kind) {
+    case CANFUZZ_F_ACCEPT_ALL:
+        return true;
+    case CANFUZZ_F_SINGLE_STD:
+        return !frame->ide && frame->id == (f->std_ids[0] & CANFUZZ_STD_MASK);
+    case CANFUZZ_F_ID_RANGE:
+        return !frame->ide &&
+               ((frame->id ^ f->std_ids[0]) & f->std_ids[1] & CANFUZZ_STD_MASK) == 0U;
+    case CANFUZZ_F_EXTENDED:
+        return frame->ide && frame->id == (f->ext_ids[0] & CANFUZZ_EXT_MASK);
+    case CANFUZZ_F_TWO_IDS:
+    case CANFUZZ_F_FOUR_IDS:
+        if (frame->ide || frame->rtr) {
+            return false;
+        }
+        k = CanFuzz_Find16(f->std_ids, f->std_count, frame->id);
+        break;
+    case CANFUZZ_F_ID_LIST:
+        if (!CanFuzz_IdListFits(f)) {
+            return true;    /* Falls back to accept-all */
+        }
+        if (frame->rtr) {
+            return false;
+        }
+        if (frame->ide) {
+            k = CanFuzz_Find32(f->ext_ids, f->ext_count, frame->id);
+            if (k >= 0) {
+                k += (int)(4U * ((f->std_count + 3U) / 4U));
+            }
+        } else {
+            k = CanFuzz_Find16(f->std_ids, f->std_count, frame->id);
+        }
+        break;
+    default:
+        return false;
+    }
+
+    if (k < 0) {
+        return false;
+    }
+    *fmi = (uint8_t)k;
+    return true;
+}
+
+/* Bus frame a CAN_TxMsg_t must produce */
+static bool CanFuzz_RefFrameMatches(const CAN_TxMsg_t *msg, const CanSim_Frame_t *frame)
+{
+    uint32_t id = msg->id & (msg->ide ? CANFUZZ_EXT_MASK : CANFUZZ_STD_MASK);
+
+    if (frame->id != id || frame->ide != (msg->ide ? 1U : 0U) ||
+        frame->rtr != (msg->rtr ? 1U : 0U) || frame->dlc != msg->dlc) {
+        return false;
+    }
+    return msg->rtr || memcmp(frame->data, msg->data, msg->dlc) == 0;
+}
+
+/* CAN_RxMsg_t a bus frame must decode to */
+static bool CanFuzz_RefRxMatches(const CanSim_Frame_t *frame, const CAN_RxMsg_t *msg)
+{
+    uint8_t len = frame->dlc > 8U ? 8U : frame->dlc;
+
+    if (msg->id != frame->id || msg->ide != frame->ide || msg->rtr != frame->rtr ||
+        msg->dlc != frame->dlc || msg->fmi != frame->fmi) {
+        return false;
+    }
+    return frame->rtr || memcmp(msg->data, frame->data, len) == 0;
+}
+
+/* ============================================================================
+ * Implementation - Failure Report
+ * ============================================================================ */
+
+static const char *const canfuzz_filter_names[CANFUZZ_F_COUNT] = {
+    "AcceptAll", "SingleStdId", "IdRange", "TwoIds", "FourIds", "ExtendedId", "IdList"
+};
+
+static void CanFuzz_PrintFilter(const CanFuzz_Filter_t *f)
+{
+    fprintf(stderr, "  filter %s std[", canfuzz_filter_names[f->kind]);
+    for (uint8_t i = 0; i < f->std_count; i++) {
+        fprintf(stderr, "%s0x%X", i ? " " : "", f->std_ids[i]);
+    }
+    fprintf(stderr, "] ext[");
+    for (uint8_t i = 0; i < f->ext_count; i++) {
+        fprintf(stderr, "%s0x%X", i ? " " : "", (unsigned)f->ext_ids[i]);
+    }
+    fprintf(stderr, "] max_banks %u%s\n", f->max_banks, f->software ? " (software)" : "");
+}
+
+static void CanFuzz_PrintFrame(const char *what, const CanSim_Frame_t *fr)
+{
+    fprintf(stderr, "  %s id 0x%X %s%s dlc %u fmi %u data %02X %02X %02X %02X %02X %02X %02X %02X\n",
+            what, (unsigned)fr->id, fr->ide ? "ext" : "std", fr->rtr ? " rtr" : "", fr->dlc,
+            fr->fmi, fr->data[0], fr->data[1], fr->data[2], fr->data[3],
+            fr->data[4], fr->data[5], fr->data[6], fr->data[7]);
+}
+
+static void CanFuzz_PrintMsg(const char *what, uint32_t id, uint8_t ide, uint8_t rtr,
+                             uint8_t dlc, uint8_t fmi, const uint8_t *data)
+{
+    CanSim_Frame_t fr = { .id = id, .ide = ide, .rtr = rtr, .dlc = dlc, .fmi = fmi };
+
+    memcpy(fr.data, data, 8);
+    CanFuzz_PrintFrame(what, &fr);
+}
+
+static void CanFuzz_Fail(const char *why)
+{
+    static const char *const modes[CANFUZZ_RX_COUNT] = { "poll", "ring", "callback" };
+
+    fprintf(stderr, "\nCANFUZZ MISMATCH: %s\n", why);
+    fprintf(stderr, "  case: CAN%u rx %s, %u frames expected, %u delivered\n",
+            canfuzz_rx_node + 1U, modes[canfuzz_rx_mode],
+            canfuzz_expected_count, canfuzz_delivered_count);
+    CanFuzz_PrintFilter(&canfuzz_filter);
+
+#ifdef CANFUZZ_STANDALONE
+    {
+        FILE *f = fopen(CANFUZZ_CRASH_FILE, "wb");
+        if (f != NULL) {
+            fwrite(canfuzz_data, 1, canfuzz_size, f);
+            fclose(f);
+            fprintf(stderr, "  input written to %s (%zu bytes)\n", CANFUZZ_CRASH_FILE, canfuzz_size);
+        }
+    }
+#endif
+    abort();
+}
+
+/* ============================================================================
+ * Implementation - Input Decoding
+ * ============================================================================ */
+
+/* Exhausted input reads as zeros: every prefix is a valid case */
+static uint8_t CanFuzz_U8(CanFuzz_Input_t *in)
+{
+    return (in->pos < in->size) ? in->data[in->pos++] : 0U;
+}
+
+static uint16_t CanFuzz_U16(CanFuzz_Input_t *in)
+{
+    uint16_t v = CanFuzz_U8(in);
+    return (uint16_t)(v | ((uint16_t)CanFuzz_U8(in) << 8));
+}
+
+static uint32_t CanFuzz_U32(CanFuzz_Input_t *in)
+{
+    uint32_t v = CanFuzz_U16(in);
+    return v | ((uint32_t)CanFuzz_U16(in) << 16);
+}
+
+static void CanFuzz_ReadFilter(CanFuzz_Input_t *in, CanFuzz_Filter_t *f)
+{
+    uint8_t kind = CanFuzz_U8(in);
+
+    memset(f, 0, sizeof(*f));
+    f->kind = (CanFuzz_FilterKind_t)(kind % CANFUZZ_F_COUNT);
+#ifdef CAN_SW_FILTER
+    f->software = (kind & 0x80U) ? 1U : 0U;
+#endif
+
+    switch (f->kind) {
+    case CANFUZZ_F_SINGLE_STD:
+        f->std_count = 1U;
+        break;
+    case CANFUZZ_F_ID_RANGE:
+        f->std_count = 2U;      /* Base, mask */
+        break;
+    case CANFUZZ_F_TWO_IDS:
+        f->std_count = 2U;
+        break;
+    case CANFUZZ_F_FOUR_IDS:
+        f->std_count = 4U;
+        break;
+    case CANFUZZ_F_EXTENDED:
+        f->ext_count = 1U;
+        break;
+    case CANFUZZ_F_ID_LIST:
+        f->std_count = (uint8_t)(CanFuzz_U8(in) % (CANFUZZ_MAX_STD_IDS + 1U));
+        f->ext_count = (uint8_t)(CanFuzz_U8(in) % (CANFUZZ_MAX_EXT_IDS + 1U));
+        f->max_banks = (uint8_t)(1U + CanFuzz_U8(in) % CANFUZZ_INSTANCE_BANKS);
+        break;
+    default:
+        break;
+    }
+    for (uint8_t i = 0; i < f->std_count; i++) {
+        f->std_ids[i] = CanFuzz_U16(in);
+    }
+    for (uint8_t i = 0; i < f->ext_count; i++) {
+        f->ext_ids[i] = CanFuzz_U32(in);
+    }
+}
+
+/* Bus frame; IDs are often taken from the filter so matches are common */
+static void CanFuzz_ReadFrame(CanFuzz_Input_t *in, CanSim_Frame_t *fr)
+{
+    const CanFuzz_Filter_t *f = &canfuzz_filter;
+    uint8_t flags = CanFuzz_U8(in);
+    uint8_t pick = CanFuzz_U8(in);
+    uint32_t raw = CanFuzz_U32(in);
+
+    memset(fr, 0, sizeof(*fr));
+    fr->ide = flags & 1U;
+    fr->rtr = (flags >> 1) & 1U;
+    fr->dlc = (uint8_t)((flags >> 2) & 0x0FU);
+
+    if ((pick & 0x80U) && !fr->ide && f->std_count != 0U) {
+        raw = f->std_ids[pick % f->std_count];
+    } else if ((pick & 0x80U) && fr->ide && f->ext_count != 0U) {
+        raw = f->ext_ids[pick % f->ext_count];
+    }
+    if (pick & 0x40U) {
+        raw ^= 1UL << (pick & 0x0FU);   /* Near miss */
+    }
+    fr->id = raw & (fr->ide ? CANFUZZ_EXT_MASK : CANFUZZ_STD_MASK);
+
+    for (uint8_t i = 0; i < 8U; i++) {
+        fr->data[i] = CanFuzz_U8(in);
+    }
+}
+
+/* ============================================================================
+ * Implementation - Driver Side
+ * ============================================================================ */
+
+static void CanFuzz_RxIsr0(void) { CAN_RX_IRQHandler(&canfuzz_hcan[0]); }
+static void CanFuzz_RxIsr1(void) { CAN_RX_IRQHandler(&canfuzz_hcan[1]); }
+static void CanFuzz_TxIsr0(void) { CAN_TX_IRQHandler(&canfuzz_hcan[0]); }
+static void CanFuzz_TxIsr1(void) { CAN_TX_IRQHandler(&canfuzz_hcan[1]); }
+
+/* Check one frame the driver handed to the application */
+static void CanFuzz_Deliver(const CAN_RxMsg_t *msg)
+{
+    canfuzz_stats.delivered++;
+
+    /* Overruns drop frames, never reorder them: skip to the next match */
+    while (canfuzz_delivered_count < canfuzz_expected_count) {
+        if (CanFuzz_RefRxMatches(&canfuzz_expected[canfuzz_delivered_count++], msg)) {
+            return;
+        }
+    }
+
+    CanFuzz_PrintMsg("delivered", msg->id, msg->ide, msg->rtr, msg->dlc, msg->fmi, msg->data);
+    if (canfuzz_expected_count != 0U) {
+        CanFuzz_PrintFrame("last expected", &canfuzz_expected[canfuzz_expected_count - 1U]);
+    }
+    CanFuzz_Fail("RX frame not expected by the model (decode, FMI or order)");
+}
+
+static void CanFuzz_RxCallback(CAN_Handle_t *hcan, const CAN_RxMsg_t *msg)
+{
+    (void)hcan;
+    CanFuzz_Deliver(msg);
+}
+
+static void CanFuzz_Poll(void)
+{
+    CAN_Handle_t *hcan = &canfuzz_hcan[canfuzz_rx_node];
+    CAN_RxMsg_t msg;
+
+    if (canfuzz_rx_mode == CANFUZZ_RX_POLL) {
+        while (CAN_Receive(hcan, &msg)) {
+            CanFuzz_Deliver(&msg);
+        }
+    } else if (canfuzz_rx_mode == CANFUZZ_RX_RING) {
+        while (CAN_ReadRing(hcan, &msg)) {
+            CanFuzz_Deliver(&msg);
+        }
+    }
+}
+
+#ifdef CAN_SW_FILTER
+/* Hardware FMI the model gives for software table entry i */
+static uint8_t CanFuzz_SwFmi(const CanFuzz_Filter_t *f, int16_t i)
+{
+    switch (f->kind) {
+    case CANFUZZ_F_TWO_IDS:
+    case CANFUZZ_F_FOUR_IDS:
+        return (uint8_t)i;
+    case CANFUZZ_F_ID_LIST:
+        if (!CanFuzz_IdListFits(f)) {
+            return 0U;
+        }
+        if (i < (int16_t)f->std_count) {
+            return (uint8_t)i;
+        }
+        return (uint8_t)(4U * ((f->std_count + 3U) / 4U) + (uint16_t)(i - f->std_count));
+    default:
+        return 0U;              /* Mask mode and accept-all report FMI 0 */
+    }
+}
+
+/* The same request as a software table, entries in the caller's order */
+static void CanFuzz_SwBuild(const CanFuzz_Filter_t *f, CanSwf_Table_t *t)
+{
+    CanSwf_Init(t);
+    switch (f->kind) {
+    case CANFUZZ_F_SINGLE_STD:
+        CanSwf_Add(t, f->std_ids[0], CANFUZZ_STD_MASK, 0U);
+        break;
+    case CANFUZZ_F_ID_RANGE:
+        CanSwf_Add(t, f->std_ids[0], f->std_ids[1], 0U);
+        break;
+    case CANFUZZ_F_TWO_IDS:
+    case CANFUZZ_F_FOUR_IDS:
+        CanSwf_AddIdList(t, f->std_ids, f->std_count, NULL, 0U);
+        break;
+    case CANFUZZ_F_EXTENDED:
+        CanSwf_Add(t, f->ext_ids[0], CANFUZZ_EXT_MASK, CANSWF_EXT);
+        break;
+    case CANFUZZ_F_ID_LIST:
+        if (CanFuzz_IdListFits(f)) {
+            CanSwf_AddIdList(t, f->std_ids, f->std_count, f->ext_ids, f->ext_count);
+            break;
+        }
+        /* fall through: accept-all like the driver */
+    default:
+        CanSwf_Add(t, 0U, 0U, 0U);
+        CanSwf_Add(t, 0U, 0U, CANSWF_EXT);
+        break;
+    }
+    CanSwf_Build(t);
+}
+
+/* Table lookup against the model: decision, and which entry matched */
+static void CanFuzz_SwCheck(const CanSim_Frame_t *frame, bool model, uint8_t fmi)
+{
+    int16_t entry = CanSwf_Match(&canfuzz_swf, frame->id, frame->ide, frame->rtr);
+
+    if (CanSwf_Accept(&canfuzz_swf, frame->id, frame->ide, frame->rtr) != model ||
+        (entry >= 0) != model) {
+        CanFuzz_PrintFrame("frame", frame);
+        CanFuzz_Fail(model ? "software filter rejected a frame the model accepts"
+                           : "software filter accepted a frame the model rejects");
+    }
+    if (model && CanFuzz_SwFmi(&canfuzz_filter, entry) != fmi) {
+        CanFuzz_PrintFrame("frame", frame);
+        fprintf(stderr, "  software entry %d\n", entry);
+        CanFuzz_Fail("software filter matched another entry than the model");
+    }
+}
+#endif /* CAN_SW_FILTER */
+
+/* A frame reaches the receiving controller: model and simulator must agree */
+static void CanFuzz_Offer(const CanSim_Frame_t *frame)
+{
+    CanSim_Frame_t expected = *frame;
+    bool model = CanFuzz_RefAccept(&canfuzz_filter, frame, &expected.fmi);
+    bool hardware = model;
+
+#ifdef CAN_SW_FILTER
+    CanFuzz_SwCheck(frame, model, expected.fmi);
+    if (canfuzz_filter.software) {
+        expected.fmi = 0U;      /* Hardware runs accept-all */
+        hardware = true;
+        if (!model) {
+            canfuzz_stats.sw_rejected++;
+        }
+    }
+#endif
+
+    /* Recorded before injecting: a zero-latency ISR delivers inside Inject */
+    if (model) {
+        canfuzz_expected[canfuzz_expected_count++] = expected;
+        canfuzz_stats.accepted[canfuzz_filter.kind]++;
+    } else {
+        canfuzz_stats.rejected[canfuzz_filter.kind]++;
+    }
+
+    if (CanSim_Inject(canfuzz_rx_node, frame) != hardware) {
+        if (model) {
+            canfuzz_expected_count--;
+        }
+        CanFuzz_PrintFrame("frame", frame);
+        CanFuzz_Fail(hardware ? "filter rejected a frame the model accepts"
+                              : "filter accepted a frame the model rejects");
+    }
+}
+
+/* Bus sink: frames sent by the transmitting instance */
+static void CanFuzz_TxSink(uint8_t index, const CanSim_Frame_t *frame)
+{
+    uint16_t i;
+
+    if (index == canfuzz_rx_node) {
+        return;
+    }
+    for (i = 0; i < canfuzz_tx_count; i++) {
+        if (CanFuzz_RefFrameMatches(&canfuzz_tx_pending[i], frame)) {
+            canfuzz_tx_pending[i] = canfuzz_tx_pending[--canfuzz_tx_count];
+            canfuzz_stats.tx_sent++;
+            CanFuzz_Offer(frame);   /* Same wire: round trip into the receiver */
+            return;
+        }
+    }
+    CanFuzz_PrintFrame("on bus", frame);
+    CanFuzz_Fail("transmitted frame matches no queued CAN_TxMsg_t (encode)");
+}
+
+static void CanFuzz_ApplyFilter(const CanFuzz_Filter_t *f)
+{
+    CAN_Handle_t *hcan = &canfuzz_hcan[canfuzz_rx_node];
+    bool fits;
+
+#ifdef CAN_SW_FILTER
+    /* The table judges frames when they are read, the hardware when they
+     * arrive: empty the FIFO before either side of a swap is software */
+    if (canfuzz_filter.software || f->software) {
+        CanSim_Advance(CanSim_Now() + CANFUZZ_SETTLE_NS);
+        CanFuzz_Poll();
+    }
+#endif
+    canfuzz_filter = *f;
+#ifdef CAN_SW_FILTER
+    CanFuzz_SwBuild(f, &canfuzz_swf);
+    hcan->sw_filter = f->software ? &canfuzz_swf : NULL;
+    if (f->software) {
+        CAN_Filter_AcceptAll(hcan);
+        return;
+    }
+#endif
+    switch (f->kind) {
+    case CANFUZZ_F_ACCEPT_ALL:
+        CAN_Filter_AcceptAll(hcan);
+        break;
+    case CANFUZZ_F_SINGLE_STD:
+        CAN_Filter_SingleStdId(hcan, f->std_ids[0]);
+        break;
+    case CANFUZZ_F_ID_RANGE:
+        CAN_Filter_IdRange(hcan, f->std_ids[0], f->std_ids[1]);
+        break;
+    case CANFUZZ_F_TWO_IDS:
+        CAN_Filter_TwoIds(hcan, f->std_ids[0], f->std_ids[1]);
+        break;
+    case CANFUZZ_F_FOUR_IDS:
+        CAN_Filter_FourIds(hcan, f->std_ids);
+        break;
+    case CANFUZZ_F_EXTENDED:
+        CAN_Filter_ExtendedId(hcan, f->ext_ids[0]);
+        break;
+    case CANFUZZ_F_ID_LIST:
+        fits = CAN_Filter_IdList(hcan, f->std_ids, f->std_count,
+                                 f->ext_ids, f->ext_count, f->max_banks);
+        if (fits != CanFuzz_IdListFits(f)) {
+            CanFuzz_Fail("CAN_Filter_IdList return value");
+        }
+        if (!fits) {
+            canfuzz_stats.idlist_fallback++;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void CanFuzz_Transmit(CanFuzz_Input_t *in)
+{
+    CAN_Handle_t *hcan = &canfuzz_hcan[canfuzz_rx_node ^ 1U];
+    uint8_t flags = CanFuzz_U8(in);
+    CAN_TxMsg_t msg;
+    uint32_t dropped = hcan->tx.dropped;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.id = CanFuzz_U32(in);
+    msg.ide = flags & 1U;
+    msg.rtr = (flags >> 1) & 1U;
+    msg.dlc = (uint8_t)((flags >> 2) & 0x0FU);
+    for (uint8_t i = 0; i < 8U; i++) {
+        msg.data[i] = CanFuzz_U8(in);
+    }
+
+    /* Recorded first: with a free mailbox the frame may complete at once */
+    canfuzz_tx_pending[canfuzz_tx_count++] = msg;
+    if (CAN_TransmitQueued(hcan, &msg)) {
+        if (msg.dlc > 8U) {
+            CanFuzz_Fail("CAN_TransmitQueued accepted DLC > 8");
+        }
+        return;
+    }
+
+    canfuzz_tx_count--;
+    canfuzz_stats.tx_refused++;
+    if (msg.dlc <= 8U && hcan->tx.dropped == dropped) {
+        CanFuzz_Fail("CAN_TransmitQueued refused a valid frame without counting a drop");
+    }
+}
+
+/* ============================================================================
+ * Implementation - Case
+ * ============================================================================ */
+
+void CanFuzz_RunCase(const uint8_t *data, size_t size)
+{
+    static const CanSim_Isr_t rx_isr[2] = { CanFuzz_RxIsr0, CanFuzz_RxIsr1 };
+    static const CanSim_Isr_t tx_isr[2] = { CanFuzz_TxIsr0, CanFuzz_TxIsr1 };
+    CanFuzz_Input_t in = { data, size, 0U };
+    CanFuzz_Filter_t filter;
+    CanSim_Frame_t frame;
+    uint8_t setup;
+    uint8_t tx_node;
+    uint32_t overruns;
+
+    canfuzz_data = data;
+    canfuzz_size = size;
+    canfuzz_expected_count = 0U;
+    canfuzz_delivered_count = 0U;
+    canfuzz_tx_count = 0U;
+    memset(&canfuzz_filter, 0, sizeof(canfuzz_filter));
+    canfuzz_stats.cases++;
+
+    setup = CanFuzz_U8(&in);
+    canfuzz_rx_node = setup & 1U;
+    canfuzz_rx_mode = (CanFuzz_RxMode_t)(((setup >> 1) & 3U) % CANFUZZ_RX_COUNT);
+    tx_node = canfuzz_rx_node ^ 1U;
+
+    CanSim_Init();
+    CanSim_SetTxSink(CanFuzz_TxSink);
+    CanSim_SetIrqLatency(canfuzz_rx_node, (uint32_t)(setup >> 3) * 1000U);
+    CanTimer_Init();
+    CAN_Init(&canfuzz_hcan[0], CAN1, 0);
+    CAN_Init(&canfuzz_hcan[1], CAN2, 1);
+
+    CanSim_AttachIsr(tx_node, CANSIM_IRQ_TX, tx_isr[tx_node]);
+    if (canfuzz_rx_mode != CANFUZZ_RX_POLL) {
+        CanSim_AttachIsr(canfuzz_rx_node, CANSIM_IRQ_RX0, rx_isr[canfuzz_rx_node]);
+        CAN_EnableRxInterrupt(&canfuzz_hcan[canfuzz_rx_node]);
+    }
+    if (canfuzz_rx_mode == CANFUZZ_RX_CALLBACK) {
+        CAN_RegisterRxCallback(&canfuzz_hcan[canfuzz_rx_node], CanFuzz_RxCallback);
+    }
+
+    CanFuzz_ReadFilter(&in, &filter);
+    CanFuzz_ApplyFilter(&filter);
+
+    for (uint32_t ev = 0; ev < CANFUZZ_MAX_EVENTS && in.pos < in.size; ev++) {
+        uint8_t op = CanFuzz_U8(&in);
+
+        canfuzz_stats.events++;
+        switch (op % 8U) {
+        case 0:
+        case 1:
+        case 2:
+            CanFuzz_ReadFrame(&in, &frame);
+            CanFuzz_Offer(&frame);
+            break;
+        case 3:
+            CanFuzz_Transmit(&in);
+            break;
+        case 4:
+        case 5:
+            CanSim_Advance(CanSim_Now() + (uint64_t)(op >> 3) * 20000U);
+            break;
+        case 6:
+            CanFuzz_Poll();
+            break;
+        default:
+            CanFuzz_ReadFilter(&in, &filter);
+            CanFuzz_ApplyFilter(&filter);
+            break;
+        }
+    }
+
+    /* Let the bus and the ISRs finish, then read what is left */
+    CanSim_Advance(CanSim_Now() + CANFUZZ_SETTLE_NS);
+    CanFuzz_Poll();
+
+    if (canfuzz_tx_count != 0U) {
+        CanFuzz_PrintMsg("never sent", canfuzz_tx_pending[0].id, canfuzz_tx_pending[0].ide,
+                         canfuzz_tx_pending[0].rtr, canfuzz_tx_pending[0].dlc, 0,
+                         canfuzz_tx_pending[0].data);
+        CanFuzz_Fail("frame accepted for TX never reached the bus");
+    }
+
+    overruns = CanSim_GetStats(canfuzz_rx_node)->overruns +
+               canfuzz_hcan[canfuzz_rx_node].rx.ring_overruns;
+    canfuzz_stats.overruns += overruns;
+    if (overruns == 0U && canfuzz_delivered_count != canfuzz_expected_count) {
+        CanFuzz_PrintFrame("first missing", &canfuzz_expected[canfuzz_delivered_count]);
+        CanFuzz_Fail("accepted frame lost without an overrun");
+    }
+}
+
+const CanFuzz_Stats_t *CanFuzz_GetStats(void)
+{
+    return &canfuzz_stats;
+}
+
+/* ============================================================================
+ * Fuzzer Entry Points
+ * ============================================================================ */
+
+#ifndef CANFUZZ_STANDALONE
+
+/* libFuzzer: coverage-guided, keeps inputs that reach new driver code */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    CanFuzz_RunCase(data, size);
+    return 0;
+}
+
+#else
+
+/* Standalone (gcc, no libFuzzer): random inputs, or replay of files */
+static uint64_t canfuzz_rng = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t CanFuzz_Rand(void)
+{
+    canfuzz_rng ^= canfuzz_rng << 13;
+    canfuzz_rng ^= canfuzz_rng >> 7;
+    canfuzz_rng ^= canfuzz_rng << 17;
+    return canfuzz_rng;
+}
+
+static void CanFuzz_Replay(const char *path)
+{
+    static uint8_t buf[1U << 16];
+    FILE *f = fopen(path, "rb");
+    size_t n;
+
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+    n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    CanFuzz_RunCase(buf, n);
+    printf("%s: %zu bytes, model and driver agree\n", path, n);
+}
+
+int main(int argc, char **argv)
+{
+    static uint8_t buf[1024];
+    const CanFuzz_Stats_t *st = CanFuzz_GetStats();
+    uint64_t cases = 1000000ULL;
+    struct timespec t0, t1;
+    double secs;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            cases = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            canfuzz_rng = strtoull(argv[++i], NULL, 0) * 0x9E3779B97F4A7C15ULL | 1U;
+        } else {
+            CanFuzz_Replay(argv[i]);
+            cases = 0U;
+        }
+    }
+    if (cases == 0U) {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint64_t c = 0; c < cases; c++) {
+        size_t size = 8U + (size_t)(CanFuzz_Rand() % (sizeof(buf) - 8U));
+
+        for (size_t k = 0; k < size; k += 8U) {
+            uint64_t r = CanFuzz_Rand();
+            memcpy(&buf[k], &r, (size - k < 8U) ? size - k : 8U);
+        }
+        CanFuzz_RunCase(buf, size);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+    printf("%llu cases, %llu events in %.1f s (%.0f cases/min)\n",
+           (unsigned long long)st->cases, (unsigned long long)st->events, secs,
+           (double)st->cases * 60.0 / secs);
+    printf("  %-12s %12s %12s\n", "filter", "accepted", "rejected");
+    for (i = 0; i < (int)CANFUZZ_F_COUNT; i++) {
+        printf("  %-12s %12llu %12llu\n", canfuzz_filter_names[i],
+               (unsigned long long)st->accepted[i], (unsigned long long)st->rejected[i]);
+    }
+    printf("  delivered %llu, overruns %llu, TX sent %llu, refused %llu, IdList fallback %llu\n",
+           (unsigned long long)st->delivered, (unsigned long long)st->overruns,
+           (unsigned long long)st->tx_sent, (unsigned long long)st->tx_refused,
+           (unsigned long long)st->idlist_fallback);
+#ifdef CAN_SW_FILTER
+    printf("  software filter on the RX path dropped %llu\n",
+           (unsigned long long)st->sw_rejected);
+#endif
+    return 0;
+}
+
+#endif /* CANFUZZ_STANDALONE */
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Host build: see can-sim.template.c, add can_fuzz.c.
+// libFuzzer (clang), with the sanitizers so shift/overflow UB is caught:
+//   clang -g -O1 -fsanitize=fuzzer,address,undefined \
+//       -include can_sim.h -include can_timer.h can_sim.c can_timer.c \
+//       can_init.c can_filter.c can_rx.c can_tx.c can_fuzz.c -o can_fuzz
+//   ./can_fuzz -max_len=1024 -max_total_time=600 corpus/
+//
+// Standalone (gcc), random cases or replay of a crash file:
+//   gcc -O2 -DCANFUZZ_STANDALONE -fsanitize=undefined ... can_fuzz.c -o can_fuzz
+//   ./can_fuzz -n 2000000 -s 7
+//   ./can_fuzz canfuzz-crash.bin
+//
+// Software acceptance filter as well: add -DCAN_SW_FILTER and
+// can_swfilter.c (can_swfilter.h: its declarations); -mavx2 or -mno-avx2
+// checks the vector and the SSE2 scan.
+//
+// Driver changes must keep the model in CanFuzz_RefAccept() true; when a
+// filter function's documented behaviour changes, change the model with it.
+*/
@@ -0,0 +1,542 @@
+/**
+ * CAN Log Replay Template (host)
+ *
+ * This template replays a recorded bus log into the driver through the
+ * peripheral simulator (can-sim.template.c): each frame is injected into
+ * the simulated FIFO and the real CAN_RX_IRQHandler() drains it.
+ * - Log formats: candump, Vector ASC, simple (same as scripts/can_analyzer.py)
+ * - Timing: original, scaled (speed factor) or as fast as the bus allows
+ * - Streaming: one line buffer, constant memory for any log size
+ * - Deterministic: virtual time only, a run gives the same result every time
+ * - Maximum sustained frame rate before the first FIFO overrun
+ *
+ * Use it to reproduce field logs on the host, to check a FIFO/ISR latency
+ * budget against real traffic and to regression-test RX changes.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "can_sim.h"
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANREPLAY_LINE_MAX      256U    /* Longer lines are skipped */
+#define CANREPLAY_MAX_TOKENS    16U
+#define CANREPLAY_SEARCH_STEPS  16U     /* Bisection steps of CanReplay_MaxRate */
+#define CANREPLAY_SPEED_MIN     (1.0 / 1024.0)
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef enum {
+    CANREPLAY_ORIGINAL = 0,     /* Log timestamps */
+    CANREPLAY_SCALED,           /* Log timestamps / speed */
+    CANREPLAY_AFAP              /* Back to back, limited by the bus bit rate */
+} CanReplay_Timing_t;
+
+typedef struct {
+    uint64_t t_ns;              /* Log timestamp */
+    CanSim_Frame_t frame;
+} CanReplay_Frame_t;
+
+typedef struct {
+    const char *path;
+    uint8_t channel;            /* Simulator instance receiving the frames */
+    CanReplay_Timing_t timing;
+    double speed;               /* CANREPLAY_SCALED: 2.0 = twice as fast */
+    uint32_t max_frames;        /* 0: whole log */
+    bool stop_on_overrun;
+
+    /* Called before every run: CanSim_Init(), driver init, ISR attach */
+    void (*reset)(void *ctx);
+
+    /* Application tick (e.g. CAN_RxHybridTick, task drain), 0: none */
+    uint32_t tick_us;
+    void (*tick)(void *ctx);
+    void *ctx;
+} CanReplay_Config_t;
+
+typedef struct {
+    uint32_t lines;
+    uint32_t frames;            /* Injected into the simulator */
+    uint32_t skipped;           /* Not parsable (headers, CAN-FD, error frames) */
+    uint32_t overruns;          /* Hardware FIFO overruns */
+    uint32_t rejected;          /* Dropped by the acceptance filter */
+    uint64_t duration_ns;       /* First to last frame, virtual time */
+    uint64_t first_overrun_ns;  /* 0: none */
+    double rate_fps;            /* Frames per second over duration_ns */
+    double speed;               /* Speed factor of this run */
+} CanReplay_Result_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Parse one log line
+ * @return true if the line is a classic CAN data/remote frame
+ */
+bool CanReplay_ParseLine(const char *line, CanReplay_Frame_t *out);
+
+/**
+ * @brief Replay a log once
+ * @return false if the log cannot be opened or the bit rate is unknown
+ */
+bool CanReplay_Run(const CanReplay_Config_t *cfg, CanReplay_Result_t *result);
+
+/**
+ * @brief Highest replay speed without a FIFO overrun
+ *
+ * Runs the log in scaled mode, doubling/halving the speed to bracket the
+ * limit, then bisects. Each run stops at the first overrun; set
+ * cfg->max_frames to bound the time per run on long logs.
+ * @param result Run at the highest overrun-free speed (rate_fps = max rate)
+ * @return false if even CANREPLAY_SPEED_MIN overruns
+ */
+bool CanReplay_MaxRate(const CanReplay_Config_t *cfg, CanReplay_Result_t *result);
+
+/* ============================================================================
+ * Implementation - Log Parser
+ * ============================================================================ */
+
+/* "12.345678" -> ns, integer only so every platform parses alike */
+static bool CanReplay_ParseTime(const char *s, uint64_t *t_ns)
+{
+    uint64_t sec = 0U;
+    uint64_t frac = 0U;
+    uint32_t digits = 0U;
+
+    if (*s < '0' || *s > '9') {
+        return false;
+    }
+    while (*s >= '0' && *s <= '9') {
+        sec = sec * 10U + (uint64_t)(*s++ - '0');
+    }
+    if (*s == '.') {
+        s++;
+        while (*s >= '0' && *s <= '9') {
+            if (digits < 9U) {
+                frac = frac * 10U + (uint64_t)(*s - '0');
+                digits++;
+            }
+            s++;
+        }
+    }
+    while (digits++ < 9U) {
+        frac *= 10U;
+    }
+    *t_ns = sec * 1000000000ULL + frac;
+
+    return *s == '\0' || *s == ')';
+}
+
+static int CanReplay_Hex(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Hex number of the whole token, optional 'x' suffix (Vector extended ID) */
+static bool CanReplay_ParseId(const char *s, uint32_t *id, bool *x_suffix)
+{
+    uint32_t v = 0U;
+    uint32_t n = 0U;
+    int d;
+
+    *x_suffix = false;
+    for (; (d = CanReplay_Hex(*s)) >= 0; s++, n++) {
+        v = (v << 4) | (uint32_t)d;
+    }
+    if (*s == 'x' || *s == 'X') {
+        *x_suffix = true;
+        s++;
+    }
+    *id = v;
+
+    return n > 0U && n <= 8U && *s == '\0' && v <= 0x1FFFFFFFU;
+}
+
+static bool CanReplay_ParseByte(const char *s, uint8_t *b)
+{
+    int hi = CanReplay_Hex(s[0]);
+    int lo = (hi >= 0) ? CanReplay_Hex(s[1]) : -1;
+
+    if (lo < 0) {
+        return false;
+    }
+    *b = (uint8_t)((hi << 4) | lo);
+    return true;
+}
+
+static bool CanReplay_IsDir(const char *s)
+{
+    return (s[0] == 'R' || s[0] == 'T') && s[1] == 'x' && s[2] == '\0';
+}
+
+/* (1436509052.249713) can0 123#0011223344556677 / 12345678#R / 123#R2 */
+static bool CanReplay_ParseCandump(char **tok, uint32_t n, CanReplay_Frame_t *out)
+{
+    CanSim_Frame_t *f = &out->frame;
+    char *hash;
+    char *p;
+    bool x;
+
+    if (n < 3U || !CanReplay_ParseTime(tok[0] + 1, &out->t_ns) ||
+        (hash = strchr(tok[2], '#')) == NULL) {
+        return false;
+    }
+    *hash = '\0';
+    if (!CanReplay_ParseId(tok[2], &f->id, &x) || x) {
+        return false;
+    }
+    f->ide = (hash - tok[2] > 3) ? 1U : 0U;     /* 8 digits: 29-bit ID */
+    p = hash + 1;
+
+    if (*p == '#') {
+        return false;                           /* CAN-FD frame */
+    }
+    if (*p == 'R') {
+        f->rtr = 1U;
+        f->dlc = (p[1] >= '0' && p[1] <= '8') ? (uint8_t)(p[1] - '0') : 0U;
+        return true;
+    }
+    for (f->dlc = 0U; *p != '\0'; ) {
+        if (*p == '.') {
+            p++;                                /* Optional byte separator */
+            continue;
+        }
+        if (f->dlc == 8U || !CanReplay_ParseByte(p, &f->data[f->dlc])) {
+            return false;
+        }
+        f->dlc++;
+        p += 2;
+    }
+    return true;
+}
+
+/* id [Rx|Tx d|r] dlc bytes... starting at tok[0] */
+static bool CanReplay_ParseFields(char **tok, uint32_t n, bool vector, CanSim_Frame_t *f)
+{
+    uint32_t k = 1U;
+    bool x;
+
+    if (!CanReplay_ParseId(tok[0], &f->id, &x)) {
+        return false;
+    }
+    f->ide = (x || f->id > 0x7FFU) ? 1U : 0U;
+
+    if (vector) {
+        k++;                                    /* Rx/Tx */
+        if (k >= n || (tok[k][0] != 'd' && tok[k][0] != 'r')) {
+            return false;                       /* ErrorFrame, statistics ... */
+        }
+        f->rtr = (tok[k][0] == 'r') ? 1U : 0U;
+        if (tok[k][1] != '\0') {
+            tok[k]++;                           /* "d8": DLC in the same token */
+        } else {
+            k++;
+        }
+    }
+    if (k >= n || tok[k][0] < '0' || tok[k][0] > '8' || tok[k][1] != '\0') {
+        return false;
+    }
+    f->dlc = (uint8_t)(tok[k++][0] - '0');
+
+    if (!f->rtr) {
+        for (uint8_t i = 0; i < f->dlc; i++, k++) {
+            if (k >= n || tok[k][2] != '\0' || !CanReplay_ParseByte(tok[k], &f->data[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool CanReplay_ParseLine(const char *line, CanReplay_Frame_t *out)
+{
+    char buf[CANREPLAY_LINE_MAX];
+    char *tok[CANREPLAY_MAX_TOKENS];
+    uint32_t n = 0U;
+    size_t len = strlen(line);
+    char *p = buf;
+
+    if (len >= sizeof(buf)) {
+        return false;
+    }
+    memcpy(buf, line, len + 1U);
+    memset(&out->frame, 0, sizeof(out->frame));
+
+    /* Split on whitespace */
+    while (n < CANREPLAY_MAX_TOKENS) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') *p++ = '\0';
+        if (*p == '\0') break;
+        tok[n++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    }
+    if (n == 0U) {
+        return false;
+    }
+
+    if (tok[0][0] == '(') {
+        return CanReplay_ParseCandump(tok, n, out);
+    }
+    if (n < 3U || !CanReplay_ParseTime(tok[0], &out->t_ns)) {
+        return false;                           /* Comments, ASC header lines */
+    }
+
+    /* Vector: time [channel] id Rx|Tx d dlc data, simple: time id dlc data */
+    if (CanReplay_IsDir(tok[2])) {
+        return CanReplay_ParseFields(&tok[1], n - 1U, true, &out->frame);
+    }
+    if (n > 3U && CanReplay_IsDir(tok[3])) {
+        return CanReplay_ParseFields(&tok[2], n - 2U, true, &out->frame);
+    }
+    return CanReplay_ParseFields(&tok[1], n - 1U, false, &out->frame);
+}
+
+/* ============================================================================
+ * Implementation - Replay
+ * ============================================================================ */
+
+/* Run application ticks due up to t_ns, then move the simulator to t_ns */
+static void CanReplay_AdvanceTo(const CanReplay_Config_t *cfg, uint64_t *next_tick,
+                                uint64_t t_ns)
+{
+    uint64_t period = (uint64_t)cfg->tick_us * 1000U;
+
+    if (cfg->tick != NULL && period != 0U) {
+        while (*next_tick <= t_ns) {
+            CanSim_Advance(*next_tick);
+            cfg->tick(cfg->ctx);
+            *next_tick += period;
+        }
+    }
+    CanSim_Advance(t_ns);
+}
+
+bool CanReplay_Run(const CanReplay_Config_t *cfg, CanReplay_Result_t *result)
+{
+    const CanSim_Stats_t *stats;
+    char line[CANREPLAY_LINE_MAX];
+    CanReplay_Frame_t rec;
+    uint64_t base_ns = 0U;
+    uint64_t first_ns = 0U;
+    uint64_t t_ns = 0U;
+    uint64_t bus_free_ns = 0U;
+    uint64_t next_tick;
+    FILE *fp;
+
+    memset(result, 0, sizeof(*result));
+    result->speed = (cfg->timing == CANREPLAY_SCALED) ? cfg->speed : 1.0;
+    if (cfg->timing == CANREPLAY_SCALED && !(cfg->speed > 0.0)) {
+        return false;
+    }
+
+    fp = fopen(cfg->path, "r");
+    if (fp == NULL) {
+        return false;
+    }
+    if (cfg->reset != NULL) {
+        cfg->reset(cfg->ctx);
+    }
+    if (CanSim_BitTimeNs(cfg->channel) == 0U) {
+        fclose(fp);
+        return false;                           /* Driver did not set BTR */
+    }
+    CanSim_ClearStats(cfg->channel);
+    stats = CanSim_GetStats(cfg->channel);
+    next_tick = CanSim_Now() + (uint64_t)cfg->tick_us * 1000U;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t len = strlen(line);
+
+        if (len == sizeof(line) - 1U && line[len - 1U] != '\n') {
+            /* Overlong line: skip the rest of it */
+            int c;
+            while ((c = fgetc(fp)) != EOF && c != '\n') {}
+            result->lines++;
+            result->skipped++;
+            continue;
+        }
+        result->lines++;
+        if (!CanReplay_ParseLine(line, &rec)) {
+            result->skipped++;
+            continue;
+        }
+        if (cfg->max_frames != 0U && result->frames == cfg->max_frames) {
+            break;
+        }
+
+        if (result->frames == 0U) {
+            base_ns = rec.t_ns;
+            first_ns = CanSim_Now();
+        }
+        rec.t_ns = (rec.t_ns > base_ns) ? rec.t_ns - base_ns : 0U;
+
+        /* Arrival = end of frame. Scaled/AFAP timing cannot compress
+         * frames below their length on the bus */
+        switch (cfg->timing) {
+        case CANREPLAY_SCALED:
+            t_ns = first_ns + (uint64_t)((double)rec.t_ns / cfg->speed);
+            break;
+        case CANREPLAY_AFAP:
+            t_ns = first_ns;
+            break;
+        default:
+            t_ns = first_ns + rec.t_ns;
+            break;
+        }
+        if (cfg->timing != CANREPLAY_ORIGINAL || result->frames == 0U) {
+            uint64_t earliest = bus_free_ns + CanSim_FrameTimeNs(cfg->channel, &rec.frame);
+            if (t_ns < earliest) {
+                t_ns = earliest;
+            }
+        }
+        if (t_ns < CanSim_Now()) {
+            t_ns = CanSim_Now();                /* Unsorted log */
+        }
+        bus_free_ns = t_ns;
+
+        CanReplay_AdvanceTo(cfg, &next_tick, t_ns);
+        CanSim_Inject(cfg->channel, &rec.frame);
+        result->frames++;
+
+        if (cfg->stop_on_overrun && stats->overruns != 0U) {
+            break;
+        }
+    }
+    fclose(fp);
+
+    /* Let the last frames reach the ISR and the application */
+    CanReplay_AdvanceTo(cfg, &next_tick, t_ns + (uint64_t)cfg->tick_us * 1000U + 1000000U);
+
+    result->overruns = stats->overruns;
+    result->rejected = stats->rejected;
+    result->first_overrun_ns = stats->first_overrun_ns;
+    result->duration_ns = (result->frames > 0U) ? bus_free_ns - first_ns : 0U;
+    if (result->duration_ns != 0U) {
+        result->rate_fps = (double)(result->frames - 1U) * 1e9 / (double)result->duration_ns;
+    }
+    return true;
+}
+
+bool CanReplay_MaxRate(const CanReplay_Config_t *cfg, CanReplay_Result_t *result)
+{
+    CanReplay_Config_t c = *cfg;
+    CanReplay_Result_t run;
+    double lo;
+    double hi;
+    uint8_t step;
+
+    c.timing = CANREPLAY_SCALED;
+    c.stop_on_overrun = true;
+    c.speed = 1.0;
+    if (!CanReplay_Run(&c, &run)) {
+        return false;
+    }
+
+    if (run.overruns == 0U) {
+        /* Speed up until it overruns or the bus is saturated */
+        *result = run;
+        for (;;) {
+            c.speed = result->speed * 2.0;
+            CanReplay_Run(&c, &run);
+            if (run.overruns != 0U) {
+                break;
+            }
+            if (run.duration_ns == result->duration_ns || c.speed > 1e9) {
+                *result = run;
+                return true;                    /* Bus limited, no overrun */
+            }
+            *result = run;
+        }
+        lo = result->speed;
+        hi = c.speed;
+    } else {
+        /* Slow down until it does not overrun */
+        hi = 1.0;
+        for (;;) {
+            c.speed = hi / 2.0;
+            if (c.speed < CANREPLAY_SPEED_MIN) {
+                *result = run;
+                return false;
+            }
+            CanReplay_Run(&c, &run);
+            if (run.overruns == 0U) {
+                break;
+            }
+            hi = c.speed;
+        }
+        *result = run;
+        lo = c.speed;
+    }
+
+    for (step = 0; step < CANREPLAY_SEARCH_STEPS && hi / lo > 1.001; step++) {
+        c.speed = (lo + hi) / 2.0;
+        CanReplay_Run(&c, &run);
+        if (run.overruns == 0U) {
+            lo = c.speed;
+            *result = run;
+        } else {
+            hi = c.speed;
+        }
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Host build: see can-sim.template.c, add can_replay.c and this file
+CAN_Handle_t hcan1;
+
+static void can1_rx0_isr(void) { CAN_RX_IRQHandler(&hcan1); }
+
+static void replay_reset(void *ctx)
+{
+    (void)ctx;
+    CanSim_Init();
+    CanSim_AttachIsr(0, CANSIM_IRQ_RX0, can1_rx0_isr);
+    CanSim_SetIrqLatency(0, 20000);        // Worst case: 20 us to ISR entry
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);
+    CAN_Filter_AcceptAll(&hcan1);
+    CAN_EnableRxInterrupt(&hcan1);
+}
+
+static void app_tick(void *ctx)            // 1 ms task drains the ring
+{
+    CAN_RxMsg_t msg;
+    (void)ctx;
+    while (CAN_ReadRing(&hcan1, &msg)) {}
+}
+
+int main(int argc, char **argv)
+{
+    CanReplay_Config_t cfg = {
+        .path = argv[1], .channel = 0, .timing = CANREPLAY_ORIGINAL,
+        .reset = replay_reset, .tick_us = 1000, .tick = app_tick,
+    };
+    CanReplay_Result_t r;
+
+    CanReplay_Run(&cfg, &r);
+    printf("%u frames, %u overruns, %u ring overruns\n",
+           r.frames, r.overruns, hcan1.rx.ring_overruns);
+
+    cfg.max_frames = 100000;
+    if (CanReplay_MaxRate(&cfg, &r)) {
+        printf("max %.0f frames/s (x%.2f) without FIFO overrun\n",
+               r.rate_fps, r.speed);
+    }
+    return 0;
+}
+*/
@@ -0,0 +1,917 @@
+/**
+ * CAN Peripheral Simulator Template (host)
+ *
+ * This template emulates bxCAN register behaviour on the host so the
+ * driver templates (init, filter, tx, rx, error) run unmodified:
+ * - Register block in RAM, CAN1/CAN2 point into it
+ * - 3-deep RX FIFOs with FMP/FULL/FOVR flags, RFOM release, RFLM
+ * - Hardware acceptance filters (FA1R/FS1R/FM1R/FFA1R, CAN2SB), FMI
+ * - 3 TX mailboxes: TXRQ, TME/RQCP/TXOK, ABRQ, ID priority, frame time
+ *   from BTR, loopback (LBKM) and silent (SILM) modes
+ * - Error counters / LEC / bus-off with 128 x 11 recessive bit recovery
+ * - Interrupts: the driver's IRQ handlers are called from CanSim_Advance()
+ *   with a configurable entry latency, on virtual time
+ *
+ * Everything runs on virtual time (nanoseconds), so a run is exactly
+ * reproducible. Use the declarations below as device header (can_sim.h)
+ * instead of the MCU header; it binds the driver's CAN_HW_SYNC() hook to
+ * CanSim_Sync().
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+/* ============================================================================
+ * Host Register Block (save with the declarations below as can_sim.h)
+ * ============================================================================ */
+
+typedef struct {
+    volatile uint32_t TIR;
+    volatile uint32_t TDTR;
+    volatile uint32_t TDLR;
+    volatile uint32_t TDHR;
+} CAN_TxMailBox_TypeDef;
+
+typedef struct {
+    volatile uint32_t RIR;
+    volatile uint32_t RDTR;
+    volatile uint32_t RDLR;
+    volatile uint32_t RDHR;
+} CAN_RxFIFO_TypeDef;
+
+typedef struct {
+    volatile uint32_t FR1;
+    volatile uint32_t FR2;
+} CAN_FilterRegister_TypeDef;
+
+/* Same layout as the STM32 bxCAN block */
+typedef struct {
+    volatile uint32_t MCR;
+    volatile uint32_t MSR;
+    volatile uint32_t TSR;
+    volatile uint32_t RF0R;
+    volatile uint32_t RF1R;
+    volatile uint32_t IER;
+    volatile uint32_t ESR;
+    volatile uint32_t BTR;
+    uint32_t RESERVED0[88];
+    CAN_TxMailBox_TypeDef sTxMailBox[3];
+    CAN_RxFIFO_TypeDef sFIFOMailBox[2];
+    uint32_t RESERVED1[12];
+    volatile uint32_t FMR;
+    volatile uint32_t FM1R;
+    uint32_t RESERVED2;
+    volatile uint32_t FS1R;
+    uint32_t RESERVED3;
+    volatile uint32_t FFA1R;
+    uint32_t RESERVED4;
+    volatile uint32_t FA1R;
+    uint32_t RESERVED5[8];
+    CAN_FilterRegister_TypeDef sFilterRegister[28];
+} CAN_TypeDef;
+
+#define CANSIM_INSTANCES    2U
+
+extern CAN_TypeDef CanSim_Regs[CANSIM_INSTANCES];
+
+#define CAN1                (&CanSim_Regs[0])
+#define CAN2                (&CanSim_Regs[1])
+
+/* Driver register write hook (can-handle.template.h) */
+#define CAN_HW_SYNC(can)    CanSim_Sync(can)
+
+/* Trace timestamps in CAN_TRACE builds: host wall clock, not virtual time,
+ * so the trace shows what the driver code costs on this machine */
+#define CAN_TRACE_CYCLES()          CanSim_HostNs()
+#define CAN_TRACE_CYCLES_PER_US     1000U
+#define CAN_TRACE_CLOCK_START()     ((void)0)
+
+/* ============================================================================
+ * Configuration
+ * ============================================================================ */
+
+#define CANSIM_PCLK_HZ      36000000ULL  /* Must match CAN_APB_CLOCK */
+#define CANSIM_FIFO_DEPTH   3U           /* bxCAN hardware FIFO */
+#define CANSIM_FILTER_BANKS 28U
+#define CANSIM_MAX_REENTRY  16U          /* Bound for a level IRQ nobody clears */
+
+/* ============================================================================
+ * Type Definitions
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t id;
+    uint8_t  ide;
+    uint8_t  rtr;
+    uint8_t  dlc;
+    uint8_t  fmi;                   /* Set on reception */
+    uint8_t  data[8];
+} CanSim_Frame_t;
+
+/* Interrupt vector: calls the driver handler with its handle */
+typedef void (*CanSim_Isr_t)(void);
+
+/* Frame put on the bus by a node (not called in silent mode) */
+typedef void (*CanSim_TxSink_t)(uint8_t index, const CanSim_Frame_t *frame);
+
+typedef enum {
+    CANSIM_IRQ_TX = 0,
+    CANSIM_IRQ_RX0,
+    CANSIM_IRQ_RX1,
+    CANSIM_IRQ_SCE,
+    CANSIM_IRQ_COUNT
+} CanSim_Irq_t;
+
+typedef struct {
+    uint32_t injected;              /* Frames offered by the bus */
+    uint32_t offline;               /* Controller in init/sleep/bus-off */
+    uint32_t rejected;              /* No filter matched */
+    uint32_t accepted;
+    uint32_t overruns;              /* FIFO full: frame lost */
+    uint32_t transmitted;
+    uint32_t aborted;
+    uint32_t irqs[CANSIM_IRQ_COUNT];
+    uint8_t  fifo_peak;             /* Highest FIFO 0/1 fill */
+    uint64_t first_overrun_ns;      /* 0: none */
+    uint64_t irq_delay_max_ns;      /* Request -> ISR entry */
+} CanSim_Stats_t;
+
+/* ============================================================================
+ * Function Prototypes
+ * ============================================================================ */
+
+/**
+ * @brief Reset all instances to their reset register values, time = 0
+ */
+void CanSim_Init(void);
+
+/**
+ * @brief Connect an interrupt vector of an instance
+ */
+void CanSim_AttachIsr(uint8_t index, CanSim_Irq_t irq, CanSim_Isr_t isr);
+
+/**
+ * @brief Delay between an interrupt request and ISR entry
+ * Models interrupt latency plus higher priority ISRs; this is what makes
+ * the 3-deep FIFO overrun at high frame rates
+ */
+void CanSim_SetIrqLatency(uint8_t index, uint32_t latency_ns);
+
+/**
+ * @brief Receive frames transmitted by the instances (NULL: none)
+ */
+void CanSim_SetTxSink(CanSim_TxSink_t sink);
+
+/**
+ * @brief Frame arriving from the bus at the current time
+ * @return true if accepted into a FIFO
+ */
+bool CanSim_Inject(uint8_t index, const CanSim_Frame_t *frame);
+
+/**
+ * @brief Advance virtual time: finish transmissions, run due interrupts
+ * @param now_ns Absolute time, must not go backwards
+ */
+void CanSim_Advance(uint64_t now_ns);
+
+/**
+ * @brief Current virtual time
+ */
+uint64_t CanSim_Now(void);
+
+/**
+ * @brief Set error counters and last error code as the bus would
+ * Updates EWGF/EPVF/BOFF and raises the SCE interrupt if enabled
+ */
+void CanSim_SetErrors(uint8_t index, uint16_t tec, uint8_t rec, uint8_t lec);
+
+/**
+ * @brief Nominal bit time from BTR (0 if BTR not configured)
+ */
+uint32_t CanSim_BitTimeNs(uint8_t index);
+
+/**
+ * @brief Frame duration on the bus (no stuff bits)
+ */
+uint32_t CanSim_FrameTimeNs(uint8_t index, const CanSim_Frame_t *frame);
+
+const CanSim_Stats_t *CanSim_GetStats(uint8_t index);
+void CanSim_ClearStats(uint8_t index);
+
+/**
+ * @brief Register write hook, bound to CAN_HW_SYNC() in the driver build
+ */
+void CanSim_Sync(CAN_TypeDef *can);
+
+/**
+ * @brief Host monotonic clock in ns (wraps), CAN_TRACE_CYCLES() source
+ */
+uint32_t CanSim_HostNs(void);
+
+/* ============================================================================
+ * Implementation - Register Bits
+ * ============================================================================ */
+
+#define SIM_MCR_INRQ        (1U << 0)
+#define SIM_MCR_SLEEP       (1U << 1)
+#define SIM_MCR_TXFP        (1U << 2)
+#define SIM_MCR_RFLM        (1U << 3)
+#define SIM_MCR_ABOM        (1U << 6)
+#define SIM_MSR_INAK        (1U << 0)
+#define SIM_MSR_SLAK        (1U << 1)
+#define SIM_MSR_ERRI        (1U << 2)
+#define SIM_RFR_FMP         (3U << 0)
+#define SIM_RFR_FULL        (1U << 3)
+#define SIM_RFR_FOVR        (1U << 4)
+#define SIM_RFR_RFOM        (1U << 5)
+#define SIM_TSR_RQCP(mb)    (1U << ((mb) * 8U))
+#define SIM_TSR_TXOK(mb)    (1U << ((mb) * 8U + 1U))
+#define SIM_TSR_ABRQ(mb)    (1U << ((mb) * 8U + 7U))
+#define SIM_TSR_TME(mb)     (1U << (26U + (mb)))
+#define SIM_TSR_MB_FLAGS(mb) (0x0FU << ((mb) * 8U))    /* RQCP TXOK ALST TERR */
+#define SIM_TIR_TXRQ        (1U << 0)
+#define SIM_IER_TMEIE       (1U << 0)
+#define SIM_IER_FMPIE(f)    (1U << (1U + 3U * (f)))
+#define SIM_IER_FFIE(f)     (1U << (2U + 3U * (f)))
+#define SIM_IER_FOVIE(f)    (1U << (3U + 3U * (f)))
+#define SIM_IER_EWGIE       (1U << 8)
+#define SIM_IER_EPVIE       (1U << 9)
+#define SIM_IER_BOFIE       (1U << 10)
+#define SIM_IER_LECIE       (1U << 11)
+#define SIM_IER_ERRIE       (1U << 15)
+#define SIM_ESR_EWGF        (1U << 0)
+#define SIM_ESR_EPVF        (1U << 1)
+#define SIM_ESR_BOFF        (1U << 2)
+#define SIM_BTR_LBKM        (1U << 30)
+#define SIM_BTR_SILM        (1U << 31)
+#define SIM_FMR_FINIT       (1U << 0)
+#define SIM_NEVER           UINT64_MAX
+
+/* ============================================================================
+ * Implementation - State
+ * ============================================================================ */
+
+typedef struct {
+    /* Receive FIFOs */
+    CanSim_Frame_t fifo[2][CANSIM_FIFO_DEPTH];
+    uint8_t head[2];
+    uint8_t count[2];
+    bool full[2];
+    bool overrun[2];
+
+    /* Transmit mailboxes */
+    uint8_t tx_pending;             /* Bit per mailbox */
+    uint32_t tx_seq[3];             /* Request order (TXFP) */
+    uint32_t seq;
+    int8_t tx_active;               /* Mailbox on the bus, -1: idle */
+    uint64_t tx_done_ns;
+    uint32_t tsr;                   /* RQCP/TXOK/ALST/TERR per mailbox */
+
+    /* Errors */
+    uint16_t tec;
+    uint8_t rec;
+    uint8_t lec;
+    bool erri;
+    bool busoff;
+    uint64_t rejoin_ns;             /* Bus-off recovery done, SIM_NEVER: waiting */
+
+    /* Interrupts */
+    CanSim_Isr_t isr[CANSIM_IRQ_COUNT];
+    uint64_t pending_since[CANSIM_IRQ_COUNT];
+    uint32_t latency_ns;
+    bool in_isr[CANSIM_IRQ_COUNT];
+
+    /* Last values written to the registers, to recognise driver writes */
+    uint32_t pub_rfr[2];
+    uint32_t pub_tsr;
+    uint32_t pub_msr;
+    uint32_t pub_esr;
+    uint32_t last_mcr;
+
+    CanSim_Stats_t stats;
+} CanSim_Node_t;
+
+CAN_TypeDef CanSim_Regs[CANSIM_INSTANCES];
+
+static CanSim_Node_t sim_nodes[CANSIM_INSTANCES];
+static uint64_t sim_now_ns;
+static CanSim_TxSink_t sim_tx_sink;
+
+static void CanSim_Publish(uint8_t index);
+static void CanSim_RunIrqs(uint8_t index);
+
+/* ============================================================================
+ * Implementation - Timing
+ * ============================================================================ */
+
+uint32_t CanSim_BitTimeNs(uint8_t index)
+{
+    uint32_t btr = CanSim_Regs[index].BTR;
+    uint32_t brp = (btr & 0x3FFU) + 1U;
+    uint32_t ts1 = ((btr >> 16) & 0x0FU) + 1U;
+    uint32_t ts2 = ((btr >> 20) & 0x07U) + 1U;
+
+    if ((btr & 0x007F03FFU) == 0U) {
+        return 0U;
+    }
+    return (uint32_t)((uint64_t)brp * (1U + ts1 + ts2) * 1000000000ULL / CANSIM_PCLK_HZ);
+}
+
+uint32_t CanSim_FrameTimeNs(uint8_t index, const CanSim_Frame_t *frame)
+{
+    /* SOF..EOF + 3 bit intermission; 47 bits standard, 67 extended */
+    uint32_t bits = (frame->ide ? 67U : 47U) + (frame->rtr ? 0U : 8U * frame->dlc);
+
+    return bits * CanSim_BitTimeNs(index);
+}
+
+/* ============================================================================
+ * Implementation - Acceptance Filter
+ * ============================================================================ */
+
+/**
+ * @brief Hardware filter match for one instance
+ * Priority as on bxCAN: 32-bit before 16-bit, list before mask, then the
+ * lower filter number. FMI numbers filters per FIFO from the first bank
+ * of the instance, active or not.
+ */
+static bool CanSim_Match(uint8_t index, const CanSim_Frame_t *frame,
+                         uint8_t *fifo, uint8_t *fmi)
+{
+    const CAN_TypeDef *fc = &CanSim_Regs[0];
+    uint8_t split = (uint8_t)((fc->FMR >> 8) & 0x3FU);
+    uint8_t first = (index == 0U) ? 0U : split;
+    uint8_t last = (index == 0U) ? split : CANSIM_FILTER_BANKS;
+    uint32_t w32 = frame->ide ? ((frame->id << 3) | (1U << 2)) : (frame->id << 21);
+    uint32_t w16 = frame->ide ? (((frame->id >> 18) << 5) | (1U << 3) | ((frame->id >> 15) & 7U))
+                              : (frame->id << 5);
+    uint8_t number[2] = { 0U, 0U };
+    uint8_t best_rank = 0xFFU;
+    uint8_t bank;
+
+    w32 |= (uint32_t)frame->rtr << 1;
+    w16 |= (uint32_t)frame->rtr << 4;
+
+    if (fc->FMR & SIM_FMR_FINIT) {
+        return false;   /* Filter init mode: reception off */
+    }
+
+    for (bank = first; bank < last; bank++) {
+        uint32_t bit = 1UL << bank;
+        uint8_t f = (fc->FFA1R & bit) ? 1U : 0U;
+        bool scale32 = (fc->FS1R & bit) != 0U;
+        bool list = (fc->FM1R & bit) != 0U;
+        uint32_t fr1 = fc->sFilterRegister[bank].FR1;
+        uint32_t fr2 = fc->sFilterRegister[bank].FR2;
+        uint8_t rank = (uint8_t)((scale32 ? 0U : 2U) + (list ? 0U : 1U));
+        uint8_t n = number[f];
+        int8_t hit = -1;
+
+        number[f] = (uint8_t)(n + (scale32 ? (list ? 2U : 1U) : (list ? 4U : 2U)));
+        if (!(fc->FA1R & bit) || rank >= best_rank) {
+            continue;
+        }
+
+        if (scale32 && list) {
+            hit = (w32 == fr1) ? 0 : (w32 == fr2) ? 1 : -1;
+        } else if (scale32) {
+            hit = ((w32 ^ fr1) & fr2) == 0U ? 0 : -1;
+        } else if (list) {
+            uint16_t ids[4] = { (uint16_t)fr1, (uint16_t)(fr1 >> 16),
+                                (uint16_t)fr2, (uint16_t)(fr2 >> 16) };
+            for (int8_t k = 0; k < 4 && hit < 0; k++) {
+                hit = (w16 == ids[k]) ? k : -1;
+            }
+        } else {
+            if (((w16 ^ fr1) & (fr1 >> 16) & 0xFFFFU) == 0U) {
+                hit = 0;
+            } else if (((w16 ^ fr2) & (fr2 >> 16) & 0xFFFFU) == 0U) {
+                hit = 1;
+            }
+        }
+
+        if (hit >= 0) {
+            best_rank = rank;
+            *fifo = f;
+            *fmi = (uint8_t)(n + hit);
+        }
+    }
+
+    return best_rank != 0xFFU;
+}
+
+/* ============================================================================
+ * Implementation - Register Model
+ * ============================================================================ */
+
+static bool CanSim_Online(uint8_t index)
+{
+    uint32_t mcr = CanSim_Regs[index].MCR;
+
+    return !(mcr & (SIM_MCR_INRQ | SIM_MCR_SLEEP)) && !sim_nodes[index].busoff;
+}
+
+static bool CanSim_IrqLevel(uint8_t index, CanSim_Irq_t irq)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    uint32_t ier = CanSim_Regs[index].IER;
+    uint8_t f;
+
+    switch (irq) {
+    case CANSIM_IRQ_TX:
+        return (ier & SIM_IER_TMEIE) &&
+               (n->tsr & (SIM_TSR_RQCP(0) | SIM_TSR_RQCP(1) | SIM_TSR_RQCP(2)));
+    case CANSIM_IRQ_RX0:
+    case CANSIM_IRQ_RX1:
+        f = (irq == CANSIM_IRQ_RX0) ? 0U : 1U;
+        return ((ier & SIM_IER_FMPIE(f)) && n->count[f]) ||
+               ((ier & SIM_IER_FFIE(f)) && n->full[f]) ||
+               ((ier & SIM_IER_FOVIE(f)) && n->overrun[f]);
+    case CANSIM_IRQ_SCE:
+        return (ier & SIM_IER_ERRIE) && n->erri;
+    default:
+        return false;
+    }
+}
+
+/* Write registers from the model and note the request time of new IRQs */
+static void CanSim_Publish(uint8_t index)
+{
+    CAN_TypeDef *can = &CanSim_Regs[index];
+    CanSim_Node_t *n = &sim_nodes[index];
+    uint32_t tsr = n->tsr;
+    uint32_t esr;
+    uint8_t f;
+    uint8_t mb;
+
+    for (f = 0; f < 2U; f++) {
+        uint32_t rfr = n->count[f] | (n->full[f] ? SIM_RFR_FULL : 0U) |
+                       (n->overrun[f] ? SIM_RFR_FOVR : 0U);
+
+        if (n->count[f] != 0U) {
+            const CanSim_Frame_t *fr = &n->fifo[f][n->head[f]];
+            uint32_t bit_ns = CanSim_BitTimeNs(index);
+            uint32_t time = bit_ns ? (uint32_t)(sim_now_ns / bit_ns) : 0U;   /* TIME counts bits */
+
+            can->sFIFOMailBox[f].RIR = (fr->ide ? ((fr->id << 3) | (1U << 2)) : (fr->id << 21)) |
+                                       ((uint32_t)fr->rtr << 1);
+            can->sFIFOMailBox[f].RDTR = fr->dlc | ((uint32_t)fr->fmi << 8) | ((time & 0xFFFFU) << 16);
+            can->sFIFOMailBox[f].RDLR = fr->data[0] | ((uint32_t)fr->data[1] << 8) |
+                                        ((uint32_t)fr->data[2] << 16) | ((uint32_t)fr->data[3] << 24);
+            can->sFIFOMailBox[f].RDHR = fr->data[4] | ((uint32_t)fr->data[5] << 8) |
+                                        ((uint32_t)fr->data[6] << 16) | ((uint32_t)fr->data[7] << 24);
+        }
+        n->pub_rfr[f] = rfr;
+        if (f == 0U) {
+            can->RF0R = rfr;
+        } else {
+            can->RF1R = rfr;
+        }
+    }
+
+    for (mb = 0; mb < 3U; mb++) {
+        if (!(n->tx_pending & (1U << mb))) {
+            tsr |= SIM_TSR_TME(mb);
+        }
+    }
+    can->TSR = n->pub_tsr = tsr;
+
+    can->MSR = n->pub_msr = ((can->MCR & SIM_MCR_INRQ) ? SIM_MSR_INAK : 0U) |
+                            (((can->MCR & (SIM_MCR_SLEEP | SIM_MCR_INRQ)) == SIM_MCR_SLEEP) ?
+                             SIM_MSR_SLAK : 0U) |
+                            (n->erri ? SIM_MSR_ERRI : 0U);
+
+    esr = ((uint32_t)n->rec << 24) | ((uint32_t)(n->tec > 255U ? 255U : n->tec) << 16) |
+          ((uint32_t)n->lec << 4) |
+          ((n->tec >= 96U || n->rec >= 96U) ? SIM_ESR_EWGF : 0U) |
+          ((n->tec > 127U || n->rec > 127U) ? SIM_ESR_EPVF : 0U) |
+          (n->busoff ? SIM_ESR_BOFF : 0U);
+    can->ESR = n->pub_esr = esr;
+
+    for (f = 0; f < CANSIM_IRQ_COUNT; f++) {
+        if (!CanSim_IrqLevel(index, (CanSim_Irq_t)f)) {
+            n->pending_since[f] = SIM_NEVER;
+        } else if (n->pending_since[f] == SIM_NEVER) {
+            n->pending_since[f] = sim_now_ns;
+        }
+    }
+}
+
+static void CanSim_FifoPop(CanSim_Node_t *n, uint8_t f)
+{
+    if (n->count[f] != 0U) {
+        n->head[f] = (uint8_t)((n->head[f] + 1U) % CANSIM_FIFO_DEPTH);
+        n->count[f]--;
+    }
+}
+
+static void CanSim_TxComplete(uint8_t index, uint8_t mb, bool ok)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    CAN_TypeDef *can = &CanSim_Regs[index];
+
+    n->tx_pending &= (uint8_t)~(1U << mb);
+    can->sTxMailBox[mb].TIR &= ~SIM_TIR_TXRQ;
+    n->tsr = (n->tsr & ~SIM_TSR_MB_FLAGS(mb)) | SIM_TSR_RQCP(mb) | (ok ? SIM_TSR_TXOK(mb) : 0U);
+}
+
+void CanSim_Sync(CAN_TypeDef *can)
+{
+    uint8_t index = (uint8_t)(can - CanSim_Regs);
+    CanSim_Node_t *n;
+    uint32_t v;
+    uint8_t f;
+    uint8_t mb;
+
+    if (index >= CANSIM_INSTANCES) {
+        return;
+    }
+    n = &sim_nodes[index];
+
+    /* RFxR: RFOM releases the output mailbox, FULL/FOVR are write-1-clear.
+     * A read-modify-write (RF0R |= RFOM0) clears set flags as on silicon */
+    for (f = 0; f < 2U; f++) {
+        v = (f == 0U) ? can->RF0R : can->RF1R;
+        if (v != n->pub_rfr[f]) {
+            if (v & SIM_RFR_RFOM) {
+                CanSim_FifoPop(n, f);
+                n->full[f] = false;
+            }
+            if (v & SIM_RFR_FULL) {
+                n->full[f] = false;
+            }
+            if (v & SIM_RFR_FOVR) {
+                n->overrun[f] = false;
+            }
+        }
+    }
+
+    /* TSR: RQCPx clears the mailbox flags, ABRQx aborts a pending request */
+    v = can->TSR;
+    if (v != n->pub_tsr) {
+        for (mb = 0; mb < 3U; mb++) {
+            if (v & SIM_TSR_RQCP(mb)) {
+                n->tsr &= ~SIM_TSR_MB_FLAGS(mb);
+            }
+            if ((v & SIM_TSR_ABRQ(mb)) && (n->tx_pending & (1U << mb)) && n->tx_active != (int8_t)mb) {
+                CanSim_TxComplete(index, mb, false);
+                n->stats.aborted++;
+            }
+        }
+    }
+
+    /* New transmit requests */
+    for (mb = 0; mb < 3U; mb++) {
+        if ((can->sTxMailBox[mb].TIR & SIM_TIR_TXRQ) && !(n->tx_pending & (1U << mb))) {
+            n->tx_pending |= (uint8_t)(1U << mb);
+            n->tx_seq[mb] = n->seq++;
+        }
+    }
+
+    /* MSR: ERRI is write-1-clear. Writing 1 leaves the register value
+     * unchanged, so inside the SCE ISR any synced write counts as the clear */
+    v = can->MSR;
+    if ((v & SIM_MSR_ERRI) && (v != n->pub_msr || n->in_isr[CANSIM_IRQ_SCE])) {
+        n->erri = false;
+    }
+
+    /* ESR: LEC is software writable */
+    v = can->ESR;
+    if (v != n->pub_esr) {
+        n->lec = (uint8_t)((v >> 4) & 7U);
+    }
+
+    /* Leaving init mode in bus-off starts the 128 x 11 recessive bit wait */
+    if ((n->last_mcr & SIM_MCR_INRQ) && !(can->MCR & SIM_MCR_INRQ) && n->busoff) {
+        n->rejoin_ns = sim_now_ns + 128ULL * 11ULL * CanSim_BitTimeNs(index);
+    }
+    n->last_mcr = can->MCR;
+
+    CanSim_Publish(index);
+}
+
+/* ============================================================================
+ * Implementation - Bus Events
+ * ============================================================================ */
+
+void CanSim_Init(void)
+{
+    uint8_t i;
+    uint8_t k;
+
+    memset(CanSim_Regs, 0, sizeof(CanSim_Regs));
+    memset(sim_nodes, 0, sizeof(sim_nodes));
+    sim_now_ns = 0U;
+
+    for (i = 0; i < CANSIM_INSTANCES; i++) {
+        CanSim_Regs[i].MCR = SIM_MCR_SLEEP;     /* Reset: sleep mode */
+        sim_nodes[i].last_mcr = SIM_MCR_SLEEP;
+        sim_nodes[i].tx_active = -1;
+        sim_nodes[i].rejoin_ns = SIM_NEVER;
+        for (k = 0; k < CANSIM_IRQ_COUNT; k++) {
+            sim_nodes[i].pending_since[k] = SIM_NEVER;
+        }
+        CanSim_Publish(i);
+    }
+    CanSim_Regs[0].FMR = (14U << 8) | SIM_FMR_FINIT;
+}
+
+void CanSim_AttachIsr(uint8_t index, CanSim_Irq_t irq, CanSim_Isr_t isr)
+{
+    sim_nodes[index].isr[irq] = isr;
+}
+
+void CanSim_SetIrqLatency(uint8_t index, uint32_t latency_ns)
+{
+    sim_nodes[index].latency_ns = latency_ns;
+}
+
+void CanSim_SetTxSink(CanSim_TxSink_t sink)
+{
+    sim_tx_sink = sink;
+}
+
+bool CanSim_Inject(uint8_t index, const CanSim_Frame_t *frame)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    uint8_t f = 0U;
+    uint8_t fmi = 0U;
+    uint8_t slot;
+
+    n->stats.injected++;
+    if (!CanSim_Online(index)) {
+        n->stats.offline++;
+        return false;
+    }
+    if (!CanSim_Match(index, frame, &f, &fmi)) {
+        n->stats.rejected++;
+        return false;
+    }
+
+    if (n->count[f] == CANSIM_FIFO_DEPTH) {
+        n->overrun[f] = true;
+        n->stats.overruns++;
+        if (n->stats.first_overrun_ns == 0U) {
+            n->stats.first_overrun_ns = sim_now_ns ? sim_now_ns : 1U;
+        }
+        if (CanSim_Regs[index].MCR & SIM_MCR_RFLM) {
+            CanSim_Publish(index);
+            CanSim_RunIrqs(index);
+            return false;                       /* Locked: new frame lost */
+        }
+        slot = (uint8_t)((n->head[f] + CANSIM_FIFO_DEPTH - 1U) % CANSIM_FIFO_DEPTH);
+    } else {
+        slot = (uint8_t)((n->head[f] + n->count[f]) % CANSIM_FIFO_DEPTH);
+        n->count[f]++;
+    }
+
+    n->fifo[f][slot] = *frame;
+    n->fifo[f][slot].fmi = fmi;
+    n->full[f] = (n->count[f] == CANSIM_FIFO_DEPTH);
+    n->stats.accepted++;
+    if (n->count[f] > n->stats.fifo_peak) {
+        n->stats.fifo_peak = n->count[f];
+    }
+
+    CanSim_Publish(index);
+    CanSim_RunIrqs(index);
+    return true;
+}
+
+void CanSim_SetErrors(uint8_t index, uint16_t tec, uint8_t rec, uint8_t lec)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    uint32_t ier = CanSim_Regs[index].IER;
+    uint32_t before = n->pub_esr;
+    uint32_t changed;
+
+    n->tec = tec;
+    n->rec = rec;
+    n->lec = lec;
+    if (tec > 255U && !n->busoff) {
+        n->busoff = true;
+        n->rejoin_ns = SIM_NEVER;
+        if (CanSim_Regs[index].MCR & SIM_MCR_ABOM) {
+            n->rejoin_ns = sim_now_ns + 128ULL * 11ULL * CanSim_BitTimeNs(index);
+        }
+    }
+    CanSim_Publish(index);
+
+    /* ERRI on a newly set status flag or a new error code */
+    changed = (n->pub_esr ^ before) & n->pub_esr;
+    if (((changed & SIM_ESR_EWGF) && (ier & SIM_IER_EWGIE)) ||
+        ((changed & SIM_ESR_EPVF) && (ier & SIM_IER_EPVIE)) ||
+        ((changed & SIM_ESR_BOFF) && (ier & SIM_IER_BOFIE)) ||
+        (lec != 0U && lec != 7U && (ier & SIM_IER_LECIE))) {
+        n->erri = true;
+        CanSim_Publish(index);
+    }
+    CanSim_RunIrqs(index);
+}
+
+/* Run every interrupt whose latency has elapsed */
+static void CanSim_RunIrqs(uint8_t index)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    uint8_t irq;
+
+    for (irq = 0; irq < CANSIM_IRQ_COUNT; irq++) {
+        uint8_t reentry = 0U;
+
+        while (n->isr[irq] != NULL && !n->in_isr[irq] &&
+               n->pending_since[irq] != SIM_NEVER &&
+               n->pending_since[irq] + n->latency_ns <= sim_now_ns &&
+               reentry++ < CANSIM_MAX_REENTRY) {
+            uint64_t delay = sim_now_ns - n->pending_since[irq];
+
+            if (delay > n->stats.irq_delay_max_ns) {
+                n->stats.irq_delay_max_ns = delay;
+            }
+            n->stats.irqs[irq]++;
+            n->in_isr[irq] = true;
+            n->isr[irq]();
+            n->in_isr[irq] = false;
+
+            /* Still asserted: the NVIC re-enters after the latency again */
+            if (n->pending_since[irq] != SIM_NEVER) {
+                n->pending_since[irq] = sim_now_ns;
+                if (n->latency_ns != 0U) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* Start the highest priority pending mailbox if the bus is idle */
+static void CanSim_TxStart(uint8_t index)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    CAN_TypeDef *can = &CanSim_Regs[index];
+    int8_t best = -1;
+    uint8_t mb;
+
+    if (n->tx_active >= 0 || n->tx_pending == 0U || !CanSim_Online(index)) {
+        return;
+    }
+
+    for (mb = 0; mb < 3U; mb++) {
+        if (!(n->tx_pending & (1U << mb))) {
+            continue;
+        }
+        if (best < 0) {
+            best = (int8_t)mb;
+        } else if (can->MCR & SIM_MCR_TXFP) {
+            if (n->tx_seq[mb] < n->tx_seq[best]) best = (int8_t)mb;
+        } else if ((can->sTxMailBox[mb].TIR >> 3) < (can->sTxMailBox[best].TIR >> 3)) {
+            best = (int8_t)mb;  /* Lower identifier wins arbitration */
+        }
+    }
+
+    {
+        CanSim_Frame_t frame;
+
+        frame.ide = (can->sTxMailBox[best].TIR >> 2) & 1U;
+        frame.dlc = can->sTxMailBox[best].TDTR & 0x0FU;
+        frame.rtr = (can->sTxMailBox[best].TIR >> 1) & 1U;
+        n->tx_active = best;
+        n->tx_done_ns = sim_now_ns + CanSim_FrameTimeNs(index, &frame);
+    }
+}
+
+static void CanSim_TxFinish(uint8_t index)
+{
+    CanSim_Node_t *n = &sim_nodes[index];
+    CAN_TypeDef *can = &CanSim_Regs[index];
+    uint8_t mb = (uint8_t)n->tx_active;
+    const CAN_TxMailBox_TypeDef *box = &can->sTxMailBox[mb];
+    CanSim_Frame_t frame;
+    uint8_t k;
+
+    frame.ide = (box->TIR >> 2) & 1U;
+    frame.id = frame.ide ? (box->TIR >> 3) : (box->TIR >> 21);
+    frame.rtr = (box->TIR >> 1) & 1U;
+    frame.dlc = box->TDTR & 0x0FU;
+    frame.fmi = 0U;
+    for (k = 0; k < 4U; k++) {
+        frame.data[k] = (uint8_t)(box->TDLR >> (8U * k));
+        frame.data[k + 4U] = (uint8_t)(box->TDHR >> (8U * k));
+    }
+
+    n->tx_active = -1;
+    CanSim_TxComplete(index, mb, true);
+    n->stats.transmitted++;
+    CanSim_Publish(index);
+
+    if (can->BTR & SIM_BTR_LBKM) {
+        CanSim_Inject(index, &frame);
+    }
+    if (!(can->BTR & SIM_BTR_SILM) && sim_tx_sink != NULL) {
+        sim_tx_sink(index, &frame);
+    }
+}
+
+void CanSim_Advance(uint64_t now_ns)
+{
+    uint8_t i;
+
+    for (i = 0; i < CANSIM_INSTANCES; i++) {
+        CanSim_Node_t *n = &sim_nodes[i];
+
+        /* Bus traffic in time order up to now */
+        CanSim_TxStart(i);
+        while (n->tx_active >= 0 && n->tx_done_ns <= now_ns) {
+            sim_now_ns = n->tx_done_ns > sim_now_ns ? n->tx_done_ns : sim_now_ns;
+            CanSim_TxFinish(i);
+            CanSim_RunIrqs(i);
+            CanSim_TxStart(i);
+        }
+        if (n->busoff && n->rejoin_ns <= now_ns) {
+            n->busoff = false;
+            n->tec = 0U;
+            n->rec = 0U;
+            n->rejoin_ns = SIM_NEVER;
+        }
+    }
+
+    if (now_ns > sim_now_ns) {
+        sim_now_ns = now_ns;
+    }
+    for (i = 0; i < CANSIM_INSTANCES; i++) {
+        CanSim_Publish(i);
+        CanSim_RunIrqs(i);
+    }
+}
+
+uint64_t CanSim_Now(void)
+{
+    return sim_now_ns;
+}
+
+uint32_t CanSim_HostNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+const CanSim_Stats_t *CanSim_GetStats(uint8_t index)
+{
+    return &sim_nodes[index].stats;
+}
+
+void CanSim_ClearStats(uint8_t index)
+{
+    memset(&sim_nodes[index].stats, 0, sizeof(sim_nodes[index].stats));
+}
+
+/* ============================================================================
+ * Example Usage
+ * ============================================================================ */
+
+/*
+// Host build (gcc/clang):
+//   gcc -include can_sim.h -include can_timer.h can_sim.c can_timer.c \
+//       can_init.c can_filter.c can_rx.c can_tx.c test.c
+// (drop the register typedef blocks of the driver templates; can_sim.h
+//  is the device header of the host build, can_timer.h the declaration
+//  part of can-timer.template.c)
+// Add -DCAN_TRACE to record the driver trace points with host timestamps
+
+CAN_Handle_t hcan1;
+
+static void can1_rx0_isr(void) { CAN_RX_IRQHandler(&hcan1); }
+static void can1_tx_isr(void)  { CAN_TX_IRQHandler(&hcan1); }
+
+int main(void)
+{
+    CanSim_Frame_t frame = { .id = 0x123, .dlc = 8, .data = { 1, 2, 3 } };
+    CAN_RxMsg_t msg;
+
+    CanSim_Init();
+    CanSim_AttachIsr(0, CANSIM_IRQ_RX0, can1_rx0_isr);
+    CanSim_AttachIsr(0, CANSIM_IRQ_TX, can1_tx_isr);
+    CanSim_SetIrqLatency(0, 2000);          // 2 us to ISR entry
+
+    CanTimer_Init();
+    CAN_Init(&hcan1, CAN1, 0);          // INAK follows INRQ at once here
+    CAN_Filter_AcceptAll(&hcan1);
+    CAN_EnableRxInterrupt(&hcan1);
+
+    CanSim_Inject(0, &frame);               // Frame arrives at t = 0
+    CanSim_Advance(2000);                   // ISR runs at t = 2 us
+    while (CAN_ReadRing(&hcan1, &msg)) {
+        printf("%03X [%u]\n", msg.id, msg.dlc);
+    }
+
+#ifdef CAN_TRACE
+    FILE *f = fopen("can1.trc", "wb");      // scripts/can_trace_decode.py can1.trc
+    fwrite(&hcan1.trace, sizeof(hcan1.trace), 1, f);
+    fclose(f);
+#endif
+    return 0;
+}
+*/
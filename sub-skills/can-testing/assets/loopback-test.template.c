@@ -2,7 +2,8 @@
  * CAN Loopback Test Template
  * 
  * Tests CAN TX/RX functionality in loopback mode.
- * No external hardware required.
+ * No external hardware required. Waits are bounded on the timer wheel
+ * (can-timer.template.c), whose tick must be running.
  */
 
 #include <stdint.h>
@@ -16,6 +17,15 @@
 #define TEST_ITERATIONS     100
 #define TEST_TIMEOUT_MS     1000
 
+/* Controller under test */
+extern CAN_Handle_t hcan1;
+#define TEST_HCAN           (&hcan1)
+#define TEST_CAN_REGS       CAN1
+#define TEST_CAN_INDEX      0
+
+/* Idle between checks; the timer tick and CAN interrupts wake the core */
+#define TEST_WAIT()         /* __WFI() */
+
 /* ============================================================================
  * Test Statistics
  * ============================================================================ */
@@ -30,6 +40,62 @@ typedef struct {
 
 static TestStats_t test_stats = {0};
 
+static volatile uint8_t test_mode_done;
+static volatile uint8_t test_mode_ok;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static void Test_ModeDone(CAN_Handle_t *hcan, bool ok)
+{
+    (void)hcan;
+    test_mode_ok = ok ? 1U : 0U;
+    test_mode_done = 1;
+}
+
+/**
+ * @brief Change mode and wait for the acknowledge
+ * CAN_SetMode() always reports within CAN_MODE_TIMEOUT_MS
+ */
+static bool Test_SetMode(bool init)
+{
+    /* Let a mode change still running (CAN_Init) finish first */
+    while (CAN_IsModePending(TEST_HCAN)) {
+        TEST_WAIT();
+    }
+    
+    test_mode_done = 0;
+    CAN_SetMode(TEST_HCAN, init, Test_ModeDone);
+    while (!test_mode_done) {
+        TEST_WAIT();
+    }
+    
+    return test_mode_ok != 0;
+}
+
+/**
+ * @brief Transmit and wait until the looped-back frame is in FIFO 0
+ * @return false on timeout (the mailbox is aborted by then)
+ */
+static bool Test_Send(const CAN_TxMsg_t *msg)
+{
+    uint32_t start = CanTimer_Now();
+    
+    if (CAN_TransmitTimeout(TEST_HCAN, msg, TEST_TIMEOUT_MS) < 0) {
+        return false;
+    }
+    
+    while (!CAN_IsRxMessage(TEST_HCAN)) {
+        if (CanTimer_Now() - start >= CAN_TIMER_MS_TO_TICKS(TEST_TIMEOUT_MS)) {
+            return false;
+        }
+        TEST_WAIT();
+    }
+    
+    return true;
+}
+
 /* ============================================================================
  * Test Functions
  * ============================================================================ */
@@ -41,11 +107,14 @@ void Test_Init(void)
 {
     memset(&test_stats, 0, sizeof(test_stats));
     
-    /* Enable loopback mode */
-    CAN->BTR |= CAN_BTR_LBKM;
-    
     /* Re-initialize CAN */
-    CAN_Init();
+    CAN_Init(TEST_HCAN, TEST_CAN_REGS, TEST_CAN_INDEX);
+    
+    /* Enable loopback mode (BTR is writable in init mode only) */
+    if (Test_SetMode(true)) {
+        TEST_HCAN->regs->BTR |= CAN_BTR_LBKM;
+    }
+    Test_SetMode(false);
 }
 
 /**
@@ -72,7 +141,7 @@ bool Test_Loopback(void)
         }
         
         /* Transmit */
-        if (!CAN_TransmitBlocking(&tx_msg, TEST_TIMEOUT_MS)) {
+        if (!Test_Send(&tx_msg)) {
             test_stats.timeout_count++;
             continue;
         }
@@ -80,7 +149,7 @@ bool Test_Loopback(void)
         test_stats.tx_count++;
         
         /* Receive (should be immediate in loopback) */
-        if (!CAN_Receive(&rx_msg)) {
+        if (!CAN_Receive(TEST_HCAN, &rx_msg)) {
             test_stats.error_count++;
             continue;
         }
@@ -126,12 +195,12 @@ bool Test_DataLengths(void)
             tx_msg.data[j] = (uint8_t)dlc;
         }
         
-        if (!CAN_TransmitBlocking(&tx_msg, TEST_TIMEOUT_MS)) {
+        if (!Test_Send(&tx_msg)) {
             all_passed = false;
             continue;
         }
         
-        if (!CAN_Receive(&rx_msg)) {
+        if (!CAN_Receive(TEST_HCAN, &rx_msg)) {
             all_passed = false;
             continue;
         }
@@ -163,12 +232,12 @@ bool Test_Identifiers(void)
         tx_msg.dlc = 8;
         memset(tx_msg.data, 0xAA, 8);
         
-        if (!CAN_TransmitBlocking(&tx_msg, TEST_TIMEOUT_MS)) {
+        if (!Test_Send(&tx_msg)) {
             all_passed = false;
             continue;
         }
         
-        if (!CAN_Receive(&rx_msg)) {
+        if (!CAN_Receive(TEST_HCAN, &rx_msg)) {
             all_passed = false;
             continue;
         }
@@ -198,11 +267,11 @@ bool Test_RemoteFrames(void)
     tx_msg.rtr = 1;
     tx_msg.dlc = 8;
     
-    if (!CAN_TransmitBlocking(&tx_msg, TEST_TIMEOUT_MS)) {
+    if (!Test_Send(&tx_msg)) {
         all_passed = false;
     }
     
-    if (!CAN_Receive(&rx_msg)) {
+    if (!CAN_Receive(TEST_HCAN, &rx_msg)) {
         all_passed = false;
     } else if (rx_msg.rtr != 1) {
         all_passed = false;
@@ -249,5 +318,8 @@ void Test_RunAll(void)
     result = Test_RemoteFrames() && result;
     
     /* Disable loopback mode */
-    CAN->BTR &= ~CAN_BTR_LBKM;
+    if (Test_SetMode(true)) {
+        TEST_HCAN->regs->BTR &= ~CAN_BTR_LBKM;
+    }
+    Test_SetMode(false);
 }
@@ -16,6 +16,15 @@
 #define STRESS_MESSAGE_RATE     5000   /* Messages per second */
 #define STRESS_DELAY_US         (1000000 / STRESS_MESSAGE_RATE)
 
+/* Controller under test */
+extern CAN_Handle_t hcan1;
+#define STRESS_HCAN             (&hcan1)
+
+/* Optional: its error manager (can-error.template.c). The error injection
+ * test then reports the errors by type and the state transitions */
+/* extern CanErr_Channel_t can1_err; */
+/* #define STRESS_CANERR        (&can1_err) */
+
 /* ============================================================================
  * Test Statistics
  * ============================================================================ */
@@ -95,7 +104,7 @@ bool StressTest_TxOnly(void)
         stress_stats.tx_attempted++;
         
         /* Try to transmit */
-        if (CAN_Transmit(&msg)) {
+        if (CAN_Transmit(STRESS_HCAN, &msg)) {
             stress_stats.tx_success++;
         } else {
             stress_stats.tx_errors++;
@@ -137,15 +146,15 @@ bool StressTest_Bidirectional(void)
         /* Transmit with timestamp */
         tx_start_time = GetTimeUs();
         
-        if (CAN_Transmit(&tx_msg)) {
+        if (CAN_Transmit(STRESS_HCAN, &tx_msg)) {
             stress_stats.tx_success++;
         } else {
             stress_stats.tx_errors++;
         }
         
         /* Process received messages */
-        while (CAN_IsRxMessage()) {
-            if (CAN_Receive(&rx_msg)) {
+        while (CAN_IsRxMessage(STRESS_HCAN)) {
+            if (CAN_Receive(STRESS_HCAN, &rx_msg)) {
                 stress_stats.rx_received++;
                 
                 /* Calculate latency (if echo test) */
@@ -201,14 +210,14 @@ bool StressTest_Burst(void)
         
         stress_stats.tx_attempted++;
         
-        if (CAN_Transmit(&msg)) {
+        if (CAN_Transmit(STRESS_HCAN, &msg)) {
             stress_stats.tx_success++;
             burst_count++;
         }
     }
     
     /* Wait for completion */
-    while (!CAN_IsTxReady()) {
+    while (!CAN_IsTxReady(STRESS_HCAN)) {
         /* Wait for all mailboxes to empty */
     }
     
@@ -235,11 +244,18 @@ bool StressTest_ErrorInjection(void)
 {
     CAN_TxMsg_t msg;
     uint32_t error_count_start;
+#ifdef STRESS_CANERR
+    CanErr_Snapshot_t err_start;
+    CanErr_Snapshot_t err_end;
+#endif
     
     StressTest_Init();
     
     /* Get initial error count */
-    error_count_start = (CAN->ESR >> 16) & 0xFF;  /* TEC */
+    error_count_start = (STRESS_HCAN->regs->ESR >> 16) & 0xFF;  /* TEC */
+#ifdef STRESS_CANERR
+    CanErr_Snapshot(STRESS_CANERR, &err_start);
+#endif
     
     msg.id = 0x300;
     msg.ide = 0;
@@ -249,30 +265,159 @@ bool StressTest_ErrorInjection(void)
     
     /* In single-node setup, should get ACK errors */
     for (uint32_t i = 0; i < 10; i++) {
-        if (!CAN_Transmit(&msg)) {
+        if (!CAN_Transmit(STRESS_HCAN, &msg)) {
             stress_stats.tx_errors++;
         }
         
         /* Wait and check for bus-off */
         DelayUs(1000);
         
-        if (CAN->ESR & CAN_ESR_BOFF) {
+        if (STRESS_HCAN->regs->ESR & CAN_ESR_BOFF) {
             /* Bus-off occurred */
             break;
         }
     }
     
-    uint32_t error_count_end = (CAN->ESR >> 16) & 0xFF;
+    uint32_t error_count_end = (STRESS_HCAN->regs->ESR >> 16) & 0xFF;
     
     /*
     printf("Error Injection Test:\n");
     printf("  TEC before: %lu\n", error_count_start);
     printf("  TEC after:  %lu\n", error_count_end);
     */
+
+#ifdef STRESS_CANERR
+    CanErr_Snapshot(STRESS_CANERR, &err_end);
+    /*
+    printf("  ACK errors: %lu\n", err_end.counters.lec[CANERR_LEC_ACK] -
+                                  err_start.counters.lec[CANERR_LEC_ACK]);
+    printf("  Bit errors: %lu\n",
+           (err_end.counters.lec[CANERR_LEC_BIT0] + err_end.counters.lec[CANERR_LEC_BIT1]) -
+           (err_start.counters.lec[CANERR_LEC_BIT0] + err_start.counters.lec[CANERR_LEC_BIT1]));
+    printf("  State transitions: %lu, max TEC %u\n",
+           err_end.events - err_start.events, err_end.counters.max_tec);
+    */
+    (void)err_start;
+    (void)err_end;
+#endif
     
     return true;  /* Expected to have errors */
 }
 
+/* ============================================================================
+ * CanTp Download Throughput (requires can-tp.template.c)
+ * ============================================================================ */
+
+/* An external tester downloads STRESS_CANTP_DOWNLOAD bytes to this node as
+ * a sequence of CanTp messages (e.g. UDS TransferData blocks) with
+ * FC BS=0, STmin=0. The result is compared with the bus limit. */
+#define STRESS_CAN_BITRATE          500000UL
+#define STRESS_CANTP_DOWNLOAD       (4UL * 1024UL * 1024UL)   /* 4 MB */
+#define STRESS_CANTP_BLOCK          4095U       /* Max CanTp message size */
+#define STRESS_CANTP_TIMEOUT_US     300000000UL /* 300 s */
+#define STRESS_CANTP_MIN_EFFICIENCY 92U         /* Stuff bits cost ~3-5% */
+
+static uint8_t stress_cantp_buf[STRESS_CANTP_BLOCK];
+static volatile uint32_t stress_cantp_bytes;
+static volatile uint32_t stress_cantp_errors;
+static volatile uint32_t stress_cantp_start_us;
+
+static uint8_t *StressTest_CanTpStart(uint8_t channel, uint32_t length)
+{
+    (void)channel;
+
+    if (stress_cantp_bytes == 0) {
+        stress_cantp_start_us = GetTimeUs();  /* Clock starts at first FF */
+    }
+    return (length <= sizeof(stress_cantp_buf)) ? stress_cantp_buf : NULL;
+}
+
+static void StressTest_CanTpRx(uint8_t channel, uint8_t *buffer, uint32_t length,
+                               CanTp_Result_t result)
+{
+    (void)channel;
+    (void)buffer;
+
+    if (result == CANTP_OK) {
+        stress_cantp_bytes += length;
+    } else {
+        stress_cantp_errors++;
+    }
+}
+
+/**
+ * @brief Theoretical CanTp payload limit in bytes/s (classic CAN)
+ *
+ * Every CF carries 7 payload bytes in an 8-byte frame:
+ * SOF(1) + ID(11) + RTR/IDE/r0(3) + DLC(4) + DATA(64) + CRC(16) + ACK(2) +
+ * EOF(7) + IFS(3) = 111 bits without stuff bits. With BS=0 the FF and the
+ * single FC per message are negligible.
+ */
+static uint32_t StressTest_CanTpLimit(void)
+{
+    return (uint32_t)(((uint64_t)STRESS_CAN_BITRATE * 7U) / 111U);
+}
+
+/**
+ * @brief Measure CanTp download throughput against the bus limit
+ * @param link_tx Link layer adapter used by the application's CanTp setup
+ */
+bool StressTest_CanTpDownload(bool (*link_tx)(uint8_t, uint32_t, uint8_t, uint8_t,
+                                              const uint8_t *, uint8_t))
+{
+    static const CanTp_ChannelConfig_t config = {
+        .rx_id = 0x7E0, .tx_id = 0x7E8, .ide = 0, .addr_mode = CANTP_ADDR_NORMAL,
+        .fd = 0, .tx_dl = 8, .bs = 0, .stmin = 0
+    };
+    CanTp_Callbacks_t callbacks = {
+        .link_tx = link_tx,
+        .start_of_reception = StressTest_CanTpStart,
+        .rx_indication = StressTest_CanTpRx,
+        .tx_confirmation = NULL
+    };
+    uint32_t wait_start;
+    uint32_t duration_us;
+    uint32_t rate;
+    uint32_t efficiency;
+
+    StressTest_Init();
+    stress_cantp_bytes = 0;
+    stress_cantp_errors = 0;
+
+    if (!CanTp_Init(&config, 1, &callbacks)) {
+        return false;
+    }
+
+    /* RX interrupt feeds CanTp_RxIndication, timer ISR drives CanTimer_Tick */
+    wait_start = GetTimeUs();
+    while (stress_cantp_bytes < STRESS_CANTP_DOWNLOAD) {
+        if (GetTimeUs() - wait_start > STRESS_CANTP_TIMEOUT_US) {
+            break;
+        }
+    }
+
+    duration_us = GetTimeUs() - stress_cantp_start_us;
+    if (duration_us == 0) {
+        return false;
+    }
+
+    rate = (uint32_t)(((uint64_t)stress_cantp_bytes * 1000000U) / duration_us);
+    efficiency = (uint32_t)(((uint64_t)rate * 100U) / StressTest_CanTpLimit());
+
+    /*
+    printf("CanTp Download Test:\n");
+    printf("  Received:   %lu bytes\n", stress_cantp_bytes);
+    printf("  Errors:     %lu\n", stress_cantp_errors);
+    printf("  Duration:   %lu us\n", duration_us);
+    printf("  Throughput: %lu B/s (limit %lu B/s)\n", rate, StressTest_CanTpLimit());
+    printf("  Efficiency: %lu%%\n", efficiency);
+    */
+
+    return (stress_cantp_errors == 0 &&
+            stress_cantp_bytes >= STRESS_CANTP_DOWNLOAD &&
+            efficiency >= STRESS_CANTP_MIN_EFFICIENCY);
+}
+
 /**
  * @brief Print stress test results
  */